@@ -0,0 +1,177 @@
+#include "tcp_server.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Shared against affine worker scheduling. `clients` clients each pipeline
+ * `sets` SETs in batches of 100 (throughput), then 2,000 SET k i / GET k
+ * pairs, counting the clients whose every GET saw the SET before it (order).
+ * Each mode gets a fresh server in this process with the default workers.
+ *
+ * Usage: affinity_bench [clients] [sets]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 3;
+constexpr size_t BATCH = 100;
+constexpr size_t PAIRS = 2000;
+
+class Client {
+public:
+    explicit Client(uint16_t port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (int attempt = 0; attempt < 200; ++attempt) {
+            socket_ = kv::Socket{::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+            if (::connect(socket_.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+                break;
+            socket_ = kv::Socket{};
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!socket_.valid())
+            throw std::runtime_error("server did not come up");
+        int one = 1;
+        ::setsockopt(socket_.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    void send(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t sent = ::write(socket_.fd(), data.data(), data.size());
+            if (sent <= 0)
+                throw std::runtime_error("write failed");
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+    }
+
+    // The next `count` reply lines
+    std::vector<std::string> replies(size_t count) {
+        std::vector<std::string> lines;
+        while (lines.size() < count) {
+            size_t end = pending_.find('\n');
+            if (end != std::string::npos) {
+                lines.push_back(pending_.substr(0, end));
+                pending_.erase(0, end + 1);
+                continue;
+            }
+            char buffer[64 * 1024];
+            ssize_t got = ::read(socket_.fd(), buffer, sizeof(buffer));
+            if (got <= 0)
+                throw std::runtime_error("server closed the connection");
+            pending_.append(buffer, static_cast<size_t>(got));
+        }
+        return lines;
+    }
+
+private:
+    kv::Socket socket_;
+    std::string pending_;
+};
+
+struct Result {
+    double sets_per_sec = 0;
+    int in_order = 0;
+};
+
+Result measure(uint16_t port, size_t clients, size_t sets) {
+    Result result;
+    std::atomic<int> in_order{0};
+    std::vector<std::unique_ptr<Client>> connections;
+    for (size_t c = 0; c < clients; ++c)
+        connections.push_back(std::make_unique<Client>(port));
+
+    auto start = Clock::now();
+    {
+        std::vector<std::jthread> threads;
+        for (size_t c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c]() {
+                std::string batch;
+                for (size_t i = 0; i < BATCH; ++i)
+                    batch += "SET affinity:" + std::to_string(c) + ":" + std::to_string(i) + " v\n";
+                for (size_t done = 0; done < sets; done += BATCH) {
+                    connections[c]->send(batch);
+                    connections[c]->replies(BATCH);
+                }
+            });
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.sets_per_sec = static_cast<double>(clients * sets) / seconds;
+
+    {
+        std::vector<std::jthread> threads;
+        for (size_t c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c]() {
+                std::string key = "affinity:pair:" + std::to_string(c);
+                std::string pairs;
+                for (size_t i = 0; i < PAIRS; ++i)
+                    pairs += "SET " + key + " " + std::to_string(i) + "\nGET " + key + "\n";
+                connections[c]->send(pairs);
+                std::vector<std::string> lines = connections[c]->replies(2 * PAIRS);
+                for (size_t i = 0; i < PAIRS; ++i) {
+                    if (lines[2 * i + 1] != "$" + std::to_string(i))
+                        return;
+                }
+                ++in_order;
+            });
+        }
+    }
+    result.in_order = in_order;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t clients = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 8;
+    size_t sets = argc > 2 ? std::max<size_t>(std::strtoull(argv[2], nullptr, 10) / BATCH * BATCH, BATCH) : 20'000;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    // Picks ports nobody is likely to use, the bench is not run in parallel with itself
+    uint16_t base = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    std::printf("%zu clients pipelining %zu SETs each, %zu at a time, best of %d runs\n", clients, sets, BATCH, RUNS);
+
+    const std::pair<const char*, kv::WorkerScheduling> modes[] = {
+        {"shared", kv::WorkerScheduling::Shared},
+        {"affine", kv::WorkerScheduling::Affine},
+    };
+    for (size_t m = 0; m < std::size(modes); ++m) {
+        kv::ServerOptions options;
+        options.address = "127.0.0.1";
+        options.port = static_cast<uint16_t>(base + m);
+        options.scheduling = modes[m].second;
+        kv::TcpServer<kv::KvStore> server{options};
+        std::thread reactor([&server]() { server.start(); });
+
+        Result best;
+        for (int run = 0; run < RUNS; ++run) {
+            Result result = measure(options.port, clients, sets);
+            best.sets_per_sec = std::max(best.sets_per_sec, result.sets_per_sec);
+            best.in_order = run == 0 ? result.in_order : std::min(best.in_order, result.in_order);
+        }
+        std::printf("%-7s %9.0f SET/s   clients with every GET in order: %d of %zu (worst run)\n", modes[m].first,
+                    best.sets_per_sec, best.in_order, clients);
+
+        server.stop();
+        reactor.join();
+    }
+}
@@ -0,0 +1,204 @@
+#include "tcp_server.hpp"
+#include "kv/bulk.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Filling an empty server with the same keys three ways: pipelined SETs,
+ * one LOAD stream over the socket and LOAD FILE from the bulk directory,
+ * then reading them all back with DUMP and DUMP FILE. Every fill gets a
+ * fresh server running in this process with the default worker count.
+ *
+ * Usage: bulk_load_bench [keys] [value_size]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 3;
+constexpr size_t SET_BATCH = 1000;
+
+class Client {
+public:
+    explicit Client(uint16_t port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        for (int attempt = 0; attempt < 200 && !socket_.valid(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            kv::Socket socket{::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+            if (::connect(socket.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+                socket_ = std::move(socket);
+        }
+        if (!socket_.valid())
+            throw std::runtime_error("server did not come up");
+        int one = 1;
+        ::setsockopt(socket_.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    void send(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t sent = ::write(socket_.fd(), data.data(), data.size());
+            if (sent <= 0)
+                throw std::runtime_error("write failed");
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+    }
+
+    // Reads until `count` more replies (lines) have arrived
+    void await_replies(size_t count) {
+        while (count > 0)
+            count -= static_cast<size_t>(std::count(buffer_, buffer_ + receive(), '\n'));
+    }
+
+    // Reads one length-prefixed reply like DUMP's, returns its size
+    size_t await_blob() {
+        size_t got = receive();
+        std::string_view head{buffer_, got};
+        size_t header_end = head.find('\n');
+        if (head.empty() || head[0] != '=' || header_end == std::string_view::npos)
+            throw std::runtime_error("unexpected reply " + std::string{head.substr(0, 80)});
+        size_t size = std::strtoull(buffer_ + 1, nullptr, 10);
+        size_t remaining = header_end + 1 + size + 1 - got;
+        while (remaining > 0)
+            remaining -= receive();
+        return size;
+    }
+
+private:
+    size_t receive() {
+        ssize_t got = ::read(socket_.fd(), buffer_, sizeof(buffer_));
+        if (got <= 0)
+            throw std::runtime_error("server closed the connection");
+        return static_cast<size_t>(got);
+    }
+
+    kv::Socket socket_;
+    char buffer_[256 * 1024];
+};
+
+// A server with its reactor on its own thread, stopped when dropped
+class Server {
+public:
+    Server(kv::ServerOptions options) : server_(options), reactor_([this]() { server_.start(); }) {}
+    ~Server() {
+        server_.stop();
+        reactor_.join();
+    }
+
+private:
+    kv::TcpServer<kv::KvStore> server_;
+    std::jthread reactor_;
+};
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1'000'000;
+    size_t value_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 32;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / ("kv_bulk_" + std::to_string(::getpid()));
+    std::filesystem::create_directories(directory);
+
+    kv::ServerOptions options;
+    options.address = "127.0.0.1";
+    // Picks ports nobody is likely to use, the bench is not run in parallel with itself
+    options.port = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    options.bulk_directory = directory.string();
+    // A socket DUMP of 1M keys is ~50 MB, past half the default hard limit
+    options.outbox_limits.hard_limit = 256 * 1024 * 1024;
+
+    std::string value(value_size, 'v');
+    std::vector<std::string> set_batches;
+    std::string stream;
+    for (size_t i = 0; i < keys; i += SET_BATCH) {
+        std::string& batch = set_batches.emplace_back();
+        for (size_t j = i; j < std::min(keys, i + SET_BATCH); ++j) {
+            std::string key = "key:" + std::to_string(j);
+            batch += "SET " + key + " " + value + "\n";
+            kv::BulkFormat::append(stream, key, value);
+        }
+    }
+    std::string load = "LOAD " + std::to_string(stream.size()) + "\n" + stream;
+    {
+        kv::BulkFileWriter file{(directory / "seed.kv").string()};
+        file.write(stream);
+        file.commit();
+    }
+
+    // Each fill runs against a fresh server, `after` runs on the filled one
+    auto fill = [&](const std::function<void(Client&)>& load_keys, const std::function<void(Client&)>& after = {}) {
+        double best = 1e9;
+        for (int run = 0; run < RUNS; ++run) {
+            Server server{options};
+            Client client{options.port};
+            auto start = Clock::now();
+            load_keys(client);
+            best = std::min(best, seconds_since(start));
+            if (after)
+                after(client);
+            ++options.port;
+        }
+        return best;
+    };
+
+    std::printf("%zu keys with %zu-byte values, %.1f MB as a bulk stream, best of %d runs\n", keys, value_size,
+                static_cast<double>(stream.size()) / 1e6, RUNS);
+    double sets = fill([&](Client& client) {
+        for (const std::string& batch : set_batches) {
+            client.send(batch);
+            client.await_replies(std::count(batch.begin(), batch.end(), '\n'));
+        }
+    });
+    double dump = 1e9, dump_file = 1e9;
+    double loaded = fill(
+        [&](Client& client) {
+            client.send(load);
+            client.await_replies(1);
+        },
+        [&](Client& client) {
+            auto start = Clock::now();
+            client.send("DUMP\n");
+            client.await_blob();
+            dump = std::min(dump, seconds_since(start));
+            start = Clock::now();
+            client.send("DUMP FILE backup.kv\n");
+            client.await_replies(1);
+            dump_file = std::min(dump_file, seconds_since(start));
+        });
+    double loaded_file = fill([&](Client& client) {
+        client.send("LOAD FILE seed.kv\n");
+        client.await_replies(1);
+    });
+
+    for (auto [label, seconds] : {std::pair{"pipelined SET", sets}, std::pair{"LOAD stream", loaded},
+                                  std::pair{"LOAD FILE", loaded_file}, std::pair{"DUMP", dump},
+                                  std::pair{"DUMP FILE", dump_file}}) {
+        std::printf("%-14s %8.0f ms  %10.0f keys/s\n", label, seconds * 1e3, static_cast<double>(keys) / seconds);
+    }
+    std::filesystem::remove_all(directory);
+}
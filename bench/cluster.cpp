@@ -0,0 +1,149 @@
+#include "kv_client.hpp"
+#include "tcp_server.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+ * The cluster client against in-process servers: request/response GETs to
+ * a plain server and to a one-node cluster (the cost of routing), then MSET
+ * and MGET of many keys on one node and split across three.
+ *
+ * Usage: cluster_bench [gets] [keys]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 3;
+
+// A server with its reactor on its own thread, stopped when dropped
+class Server {
+public:
+    explicit Server(kv::ServerOptions options) : server_(std::move(options)), reactor_([this]() { server_.start(); }) {}
+    ~Server() {
+        server_.stop();
+        reactor_.join();
+    }
+
+private:
+    kv::TcpServer<kv::KvStore> server_;
+    std::jthread reactor_;
+};
+
+kv::ServerOptions options_for(uint16_t port) {
+    kv::ServerOptions options;
+    options.address = "127.0.0.1";
+    options.port = port;
+    return options;
+}
+
+// Servers for the nodes of one cluster, the slots split evenly
+std::vector<std::unique_ptr<Server>> start_cluster(const std::vector<uint16_t>& ports) {
+    kv::SlotMap slots;
+    for (size_t i = 0; i < ports.size(); ++i) {
+        size_t first = kv::SlotMap::SLOTS * i / ports.size();
+        size_t last = kv::SlotMap::SLOTS * (i + 1) / ports.size() - 1;
+        slots.assign({"127.0.0.1", ports[i]}, std::to_string(first) + "-" + std::to_string(last));
+    }
+    std::vector<std::unique_ptr<Server>> servers;
+    for (uint16_t port : ports) {
+        kv::ServerOptions options = options_for(port);
+        options.cluster_slots = slots;
+        options.cluster_self = {"127.0.0.1", port};
+        servers.push_back(std::make_unique<Server>(options));
+    }
+    return servers;
+}
+
+template <typename Connect>
+auto connect_when_up(Connect connect) {
+    for (int attempt = 0;; ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        try {
+            return connect();
+        } catch (const kv::ClientError&) {
+            if (attempt == 200)
+                throw;
+        }
+    }
+}
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t gets = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000;
+    size_t key_count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200'000;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    // Picks ports nobody is likely to use, the bench is not run in parallel with itself
+    uint16_t base = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    Server plain{options_for(base)};
+    auto single = start_cluster({static_cast<uint16_t>(base + 1)});
+    auto triple = start_cluster({static_cast<uint16_t>(base + 2), static_cast<uint16_t>(base + 3),
+                                 static_cast<uint16_t>(base + 4)});
+
+    auto node = connect_when_up([&]() { return std::make_unique<kv::NodeClient>(kv::ClusterNode{"127.0.0.1", base}); });
+    auto one_node = connect_when_up([&]() {
+        return std::make_unique<kv::ClusterClient>(std::vector<kv::ClusterNode>{{"127.0.0.1", static_cast<uint16_t>(base + 1)}});
+    });
+    auto three_nodes = connect_when_up([&]() {
+        return std::make_unique<kv::ClusterClient>(std::vector<kv::ClusterNode>{{"127.0.0.1", static_cast<uint16_t>(base + 2)}});
+    });
+
+    std::vector<std::pair<std::string, std::string>> pairs;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < key_count; ++i) {
+        keys.push_back("key:" + std::to_string(i));
+        pairs.emplace_back(keys.back(), std::string(32, 'v'));
+    }
+    node->call("SET key:1 " + std::string(32, 'v'));
+    one_node->set("key:1", std::string(32, 'v'));
+
+    double plain_gets = 0, routed_gets = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < gets; ++i)
+            node->call("GET key:1");
+        plain_gets = std::max(plain_gets, static_cast<double>(gets) / seconds_since(start));
+        start = Clock::now();
+        for (size_t i = 0; i < gets; ++i)
+            one_node->get("key:1");
+        routed_gets = std::max(routed_gets, static_cast<double>(gets) / seconds_since(start));
+    }
+    std::printf("%zu request/response GETs, best of %d runs\n", gets, RUNS);
+    std::printf("%-28s %9.0f GET/s\n", "plain server, NodeClient", plain_gets);
+    std::printf("%-28s %9.0f GET/s\n", "1-node cluster, ClusterClient", routed_gets);
+
+    std::printf("\n%zu keys by MSET and MGET, %zu per command, best of %d runs\n", key_count,
+                kv::ClusterClient::BATCH_KEYS, RUNS);
+    for (auto [label, client] : {std::pair{"1 node", one_node.get()}, std::pair{"3 nodes", three_nodes.get()}}) {
+        double mset = 0, mget = 0;
+        for (int run = 0; run < RUNS; ++run) {
+            auto start = Clock::now();
+            client->mset(pairs);
+            mset = std::max(mset, static_cast<double>(key_count) / seconds_since(start));
+            start = Clock::now();
+            auto values = client->mget(keys);
+            mget = std::max(mget, static_cast<double>(key_count) / seconds_since(start));
+            if (std::count(values.begin(), values.end(), std::nullopt) != 0) {
+                std::fprintf(stderr, "missing values\n");
+                return 1;
+            }
+        }
+        std::printf("%-8s MSET %9.0f keys/s  MGET %9.0f keys/s\n", label, mset, mget);
+    }
+}
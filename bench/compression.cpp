@@ -0,0 +1,112 @@
+#include "kv/kv_store.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Memory and CPU cost of storing 200KB JSON/HTML-like values raw vs. compressed.
+ * Each mode runs in a forked child so its RSS is measured from a clean heap.
+ *
+ * Usage: compression_bench [num_values] [value_kb]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Records with a fixed schema and varying fields, like an API response or rendered list
+std::string make_value(size_t size, size_t seed) {
+    std::string text;
+    for (size_t i = seed * 1000; text.size() < size; ++i) {
+        size_t id = i * 7919 % 1000003;
+        text += "{\"id\": " + std::to_string(id) + ", \"name\": \"user_" + std::to_string(id % 5000) +
+                "\", \"email\": \"user_" + std::to_string(id % 5000) + "@example.com\", \"score\": " +
+                std::to_string(id % 997) + ", \"active\": " + (id % 3 ? "true" : "false") +
+                ", \"html\": \"<li class=\\\"item\\\"><a href=\\\"/items/" + std::to_string(id) +
+                "\\\">Item " + std::to_string(id) + "</a></li>\"},\n";
+    }
+    text.resize(size);
+    return text;
+}
+
+size_t rss_bytes() {
+    long pages = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(pages) * sysconf(_SC_PAGESIZE);
+}
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void run(bool compression, const std::vector<std::string>& values) {
+    size_t value_bytes = values.size() * values.front().size();
+    size_t rss_before = rss_bytes();
+    kv::KvStore store{kv::StoreOptions{.compression = compression}};
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < values.size(); ++i)
+        store.set("key" + std::to_string(i), values[i]);
+    double set_seconds = seconds_since(start);
+    size_t stored = rss_bytes() - rss_before;
+
+    // Full GET: the value as plain text, decompressed if needed
+    start = Clock::now();
+    size_t checksum = 0;
+    for (size_t i = 0; i < values.size(); ++i)
+        checksum += store.get("key" + std::to_string(i))->size();
+    double get_seconds = seconds_since(start);
+
+    // GETBLOB COMPRESSED: copy the stored bytes out as they are
+    start = Clock::now();
+    size_t sent = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        store.read_stored("key" + std::to_string(i), [&sent](std::string_view bytes, size_t) {
+            std::string reply{bytes};
+            sent += reply.size();
+        });
+    }
+    double stored_get_seconds = seconds_since(start);
+
+    std::printf("%-10s | %9.1f MB | %8.0f | %8.0f | %10.0f | %8.1f MB\n",
+                compression ? "compressed" : "raw", stored / 1e6,
+                value_bytes / set_seconds / 1e6, value_bytes / get_seconds / 1e6,
+                value_bytes / stored_get_seconds / 1e6, sent / 1e6);
+    if (checksum != value_bytes)
+        std::abort();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t num_values = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500;
+    size_t value_kb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    std::vector<std::string> values;
+    for (size_t i = 0; i < num_values; ++i)
+        values.push_back(make_value(value_kb * 1024, i));
+
+    std::printf("%zu values of %zu KB (%.1f MB), throughput in MB/s of uncompressed data\n\n",
+                num_values, value_kb, num_values * value_kb * 1024 / 1e6);
+    std::printf("%-10s | %12s | %8s | %8s | %10s | %11s\n",
+                "mode", "stored RSS", "SET", "GET", "stored GET", "stored sent");
+    for (bool compression : {false, true}) {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            run(compression, values);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+}
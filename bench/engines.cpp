@@ -0,0 +1,85 @@
+#include "kv/command_dispatcher.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/log_store.hpp"
+#include "kv/protocol.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+/*
+ * The same workload against every StorageEngine, through CommandDispatcher
+ * like a worker would run it: SET all keys, GET them back, then a 90/10
+ * GET/SET mix from several threads.
+ *
+ * Usage: engine_bench [keys] [value_bytes] [threads]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+template <kv::StorageEngine Engine>
+void run(const char* name, typename Engine::Options options, size_t keys, size_t value_bytes, size_t threads) {
+    Engine store{std::move(options)};
+    std::vector<kv::Command> sets;
+    std::vector<kv::Command> gets;
+    for (size_t i = 0; i < keys; ++i) {
+        std::string key = "key:" + std::to_string(i);
+        sets.push_back(kv::Set{key, std::string(value_bytes, static_cast<char>('a' + i % 26))});
+        gets.push_back(kv::Get{key});
+    }
+
+    auto start = Clock::now();
+    for (const kv::Command& set : sets)
+        kv::CommandDispatcher::execute(set, store);
+    double set_seconds = seconds_since(start);
+
+    start = Clock::now();
+    size_t bytes = 0;
+    for (const kv::Command& get : gets)
+        bytes += kv::CommandDispatcher::execute(get, store).size();
+    double get_seconds = seconds_since(start);
+
+    start = Clock::now();
+    std::vector<std::jthread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t n = 0; n < keys; ++n) {
+                size_t i = (n * 7919 + t * 104729) % keys;
+                kv::CommandDispatcher::execute(n % 10 == 0 ? sets[i] : gets[i], store);
+            }
+        });
+    }
+    workers.clear();
+    double mixed_seconds = seconds_since(start);
+
+    std::printf("%-6s | %10.0f | %10.0f | %10.0f | %zu\n", name, keys / set_seconds, keys / get_seconds,
+                keys * threads / mixed_seconds, bytes);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t value_bytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+    size_t threads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() /
+                                      ("kv_engine_bench_" + std::to_string(getpid()));
+
+    std::printf("%zu keys, %zu byte values, %zu threads for the mix\n", keys, value_bytes, threads);
+    std::printf("engine |      SET/s |      GET/s |    mixed/s | checksum\n");
+    run<kv::KvStore>("map", {}, keys, value_bytes, threads);
+    run<kv::LogStore>("log", {.directory = directory.string()}, keys, value_bytes, threads);
+    std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,123 @@
+#include "kv/hash_table.hpp"
+#include "kv/hot_keys.hpp"
+#include "kv/kv_store.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * What hot key tracking costs a GET: lock-free KvStore GETs with tracking
+ * off, sampled as by default and counting every read, for uniform keys and for a skewed mix where 10 keys take
+ * 90% of the reads. Times are wall time over all GETs of all threads.
+ * Also prints what HOTKEYS reports with the default sampling and the
+ * cost of HotKeyTracker::record() on its own, which is easier to see than
+ * the difference between whole GETs.
+ *
+ * Usage: hot_keys_bench [keys] [gets_per_thread] [threads]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 5;
+
+double ns_per_get(kv::KvStore& store, const std::vector<std::vector<size_t>>& picks,
+                  const std::vector<std::string>& keys) {
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (const auto& order : picks) {
+        threads.emplace_back([&store, &order, &keys]() {
+            for (size_t index : order) {
+                if (!store.get(keys[index]))
+                    std::abort();
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return ns / static_cast<double>(picks.size() * picks.front().size());
+}
+
+// HotKeyTracker::record() alone on one thread, the part a GET pays for
+double ns_per_record(uint32_t sample, const std::vector<size_t>& order, const std::vector<std::string>& keys) {
+    std::vector<uint32_t> hashes;
+    for (const std::string& key : keys)
+        hashes.push_back(kv::HashTable<int>::hash_of(key));
+    kv::HotKeyTracker tracker{std::chrono::seconds(5), sample};
+    double best = 1e9;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = Clock::now();
+        for (size_t index : order)
+            tracker.record(keys[index], hashes[index]);
+        best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+                                  static_cast<double>(order.size()));
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t key_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    size_t gets = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2'000'000;
+    size_t thread_count = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 4;
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < key_count; ++i)
+        keys.push_back("key:" + std::to_string(i));
+
+    std::mt19937_64 random{42};
+    std::vector<std::vector<size_t>> uniform(thread_count), skewed(thread_count);
+    for (size_t t = 0; t < thread_count; ++t) {
+        for (size_t i = 0; i < gets; ++i) {
+            uniform[t].push_back(random() % key_count);
+            skewed[t].push_back(random() % 10 < 9 ? random() % 10 : random() % key_count);
+        }
+    }
+
+    std::printf("%zu keys, %zu threads x %zu GETs, best of %d runs\n", key_count, thread_count, gets, RUNS);
+    // Tracking off, on as configured by default, and on for every read
+    const uint32_t samples[] = {0, kv::StoreOptions{}.hot_key_sample, 1};
+    std::vector<std::unique_ptr<kv::KvStore>> stores;
+    for (uint32_t sample : samples) {
+        stores.push_back(std::make_unique<kv::KvStore>(kv::StoreOptions{
+            .lock_free_reads = true,
+            .hot_key_half_life = std::chrono::milliseconds{sample == 0 ? 0 : 5000},
+            .hot_key_sample = sample}));
+        for (const std::string& key : keys)
+            stores.back()->set(key, std::string(32, 'v'));
+    }
+
+    // Runs alternate between the stores, so noise from the machine hits all alike
+    std::vector<std::array<double, 2>> best(stores.size(), {1e9, 1e9});
+    for (int run = 0; run < RUNS; ++run) {
+        for (size_t s = 0; s < stores.size(); ++s) {
+            best[s][0] = std::min(best[s][0], ns_per_get(*stores[s], uniform, keys));
+            best[s][1] = std::min(best[s][1], ns_per_get(*stores[s], skewed, keys));
+        }
+    }
+    for (size_t s = 0; s < stores.size(); ++s) {
+        std::string label = samples[s] == 0 ? "off" : "1 in " + std::to_string(samples[s]);
+        std::printf("tracking %-8s  uniform %6.1f ns/GET  skewed %6.1f ns/GET\n",
+                    label.c_str(), best[s][0], best[s][1]);
+    }
+
+    for (uint32_t sample : {samples[1], samples[2]}) {
+        std::printf("record() alone, 1 in %-3u  uniform %6.1f ns  skewed %6.1f ns\n", sample,
+                    ns_per_record(sample, uniform.front(), keys), ns_per_record(sample, skewed.front(), keys));
+    }
+
+    std::printf("HOTKEYS 10:");
+    for (const kv::HotKey& hot : stores[1]->hot_keys(10))
+        std::printf(" %s=%llu", hot.key.c_str(), static_cast<unsigned long long>(hot.count));
+    std::printf("\n");
+}
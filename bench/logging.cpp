@@ -0,0 +1,83 @@
+#include "kv/logger.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * Cost of a connection log line to the thread that writes it: std::cout with
+ * std::endl as the server used to do, Logger with the level enabled, and
+ * Logger with the level disabled at runtime. Messages come in bursts of
+ * 400 (less than a ring holds) with a pause between bursts, like connection
+ * churn, and only the bursts are timed. Output goes to a file.
+ *
+ * Usage: logger_bench [threads] [bursts] [file]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int BURST = 400;
+
+template <typename Fn>
+double ns_per_message(size_t threads, int bursts, Fn&& fn) {
+    std::vector<double> busy(threads, 0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int b = 0; b < bursts; ++b) {
+                auto start = Clock::now();
+                for (int i = 0; i < BURST; ++i)
+                    fn(b * BURST + i);
+                busy[t] += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                std::this_thread::sleep_for(std::chrono::milliseconds(25));
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    double total = 0;
+    for (double ns : busy)
+        total += ns;
+    return total / static_cast<double>(threads * bursts * BURST);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t threads = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 4;
+    int bursts = argc > 2 ? std::atoi(argv[2]) : 40;
+    const char* path = argc > 3 ? argv[3] : "/tmp/logger_bench.log";
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !std::freopen(path, "w", stdout)) {
+        std::perror(path);
+        return 1;
+    }
+    kv::Logger::set_output(fd);
+    uint16_t port = 12345;
+
+    double cout_ns = ns_per_message(threads, bursts, [&](int fd) {
+        std::cout << "Client [" << fd << "] connected on port " << port << std::endl;
+    });
+    double enabled_ns = ns_per_message(threads, bursts, [&](int fd) {
+        KV_LOG(Info, "Client [", fd, "] connected on port ", port);
+    });
+    kv::Logger::set_level(kv::LogLevel::Warn);
+    double disabled_ns = ns_per_message(threads, bursts, [&](int fd) {
+        KV_LOG(Info, "Client [", fd, "] connected on port ", port);
+    });
+    kv::Logger::flush();
+
+    std::fprintf(stderr, "threads %zu, %d bursts of %d messages each\n", threads, bursts, BURST);
+    std::fprintf(stderr, "std::cout + endl  %8.1f ns/message\n", cout_ns);
+    std::fprintf(stderr, "Logger, enabled   %8.1f ns/message (%llu dropped)\n", enabled_ns,
+                 static_cast<unsigned long long>(kv::Logger::dropped()));
+    std::fprintf(stderr, "Logger, disabled  %8.1f ns/message\n", disabled_ns);
+    close(fd);
+}
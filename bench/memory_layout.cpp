@@ -0,0 +1,98 @@
+#include "kv/kv_store.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * RSS and SET cost of the slab-allocated nodes and values, per 1M entries.
+ * 4 writer threads SET `key:<n>` keys with 16 B, 64 B and 1 KB values. Then
+ * they churn: every other key is deleted and written again with a value
+ * twice as large. Fragmentation is the RSS after that over the RSS the
+ * filled store would need for the extra bytes alone, i.e. how much the freed
+ * blocks of the smaller size class sit unused. Each size runs in a forked
+ * child so its RSS is measured from a clean heap.
+ *
+ * Usage: memory_layout_bench [entries] [threads]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+size_t rss_bytes() {
+    long pages = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+        std::fclose(statm);
+    }
+    return static_cast<size_t>(pages) * sysconf(_SC_PAGESIZE);
+}
+
+// Runs fn(i) for every i below entries, split over threads
+template <typename Fn>
+double in_parallel(size_t entries, size_t threads, Fn fn) {
+    auto start = Clock::now();
+    {
+        std::vector<std::jthread> writers;
+        for (size_t t = 0; t < threads; ++t) {
+            writers.emplace_back([&, t]() {
+                for (size_t i = t; i < entries; i += threads)
+                    fn(i);
+            });
+        }
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+void run(size_t value_bytes, size_t entries, size_t threads) {
+    double per_million = 1e6 / static_cast<double>(entries);
+    size_t rss_before = rss_bytes();
+    kv::KvStore store;
+    std::string value(value_bytes, 'v');
+    std::string larger(value_bytes * 2, 'w');
+
+    double set_ns = in_parallel(entries, threads, [&](size_t i) {
+        store.set("key:" + std::to_string(i), value);
+    });
+    size_t filled = rss_bytes() - rss_before;
+
+    in_parallel(entries, threads, [&](size_t i) {
+        if (i % 2 == 0) {
+            store.del("key:" + std::to_string(i));
+            store.set("key:" + std::to_string(i), larger);
+        }
+    });
+    size_t churned = rss_bytes() - rss_before;
+    size_t expected = filled + entries / 2 * value_bytes;
+
+    std::printf("%5zu B | %8.0f MB | %6.0f | %8.0f MB | %12.2fx\n", value_bytes, filled / 1e6 * per_million,
+                set_ns / static_cast<double>(entries), churned / 1e6 * per_million,
+                static_cast<double>(churned) / static_cast<double>(expected));
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1'000'000;
+    size_t threads = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+
+    std::printf("%zu entries from %zu threads, RSS scaled to 1M entries\n\n", entries, threads);
+    std::printf("%7s | %11s | %6s | %11s | %s\n", "value", "RSS", "SET ns", "RSS churned", "fragmentation");
+    for (size_t value_bytes : {16, 64, 1024}) {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            run(value_bytes, entries, threads);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        waitpid(child, nullptr, 0);
+    }
+}
@@ -0,0 +1,95 @@
+#include "kv/command_dispatcher.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/protocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/*
+ * What the ordered index costs writers and what a page of SCAN costs the
+ * worker: SET of new keys and overwrites with the index off and on, then
+ * SCAN prefix pages through CommandDispatcher over the whole keyspace.
+ *
+ * Usage: ordered_index_bench [keys]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 3;
+
+double ns_per_op(Clock::time_point start, size_t ops) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(ops);
+}
+
+struct Result {
+    double insert_ns = 0;
+    double overwrite_ns = 0;
+    double page_us = 0;
+};
+
+Result run(bool ordered_index, const std::vector<std::string>& keys) {
+    kv::KvStore store{kv::StoreOptions{.ordered_index = ordered_index}};
+    Result result;
+
+    auto start = Clock::now();
+    for (const std::string& key : keys)
+        store.set(key, "v");
+    result.insert_ns = ns_per_op(start, keys.size());
+
+    start = Clock::now();
+    for (const std::string& key : keys)
+        store.set(key, "w");
+    result.overwrite_ns = ns_per_op(start, keys.size());
+
+    if (!ordered_index)
+        return result;
+    // Walk every key a page at a time, the way a client resumes with FROM
+    size_t pages = 0;
+    kv::Scan scan{"key:", 0, ""};
+    start = Clock::now();
+    do {
+        std::string reply = kv::CommandDispatcher::execute(kv::Command{scan}, store);
+        // The reply leads with "*count\n$next\n"
+        size_t next = reply.find('\n') + 2;
+        scan.from = reply.substr(next, reply.find('\n', next) - next);
+        ++pages;
+    } while (!scan.from.empty());
+    result.page_us = ns_per_op(start, pages) / 1000;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+        keys.push_back("key:" + std::to_string((i * 2654435761u) % count));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    // Inserted in a scattered order, like real keys
+    for (size_t i = keys.size(); i > 1; --i)
+        std::swap(keys[i - 1], keys[(i * 40503u) % i]);
+
+    std::printf("%zu keys, best of %d runs, %zu keys per SCAN page\n", keys.size(), RUNS, kv::Protocol::MAX_SCAN_KEYS);
+    std::printf("index | new key SET | overwrite SET | SCAN page\n");
+    for (bool ordered_index : {false, true}) {
+        Result best{1e18, 1e18, 1e18};
+        for (int r = 0; r < RUNS; ++r) {
+            Result result = run(ordered_index, keys);
+            best.insert_ns = std::min(best.insert_ns, result.insert_ns);
+            best.overwrite_ns = std::min(best.overwrite_ns, result.overwrite_ns);
+            best.page_us = std::min(best.page_us, result.page_us);
+        }
+        if (ordered_index)
+            std::printf("on    | %8.0f ns | %10.0f ns | %6.0f us\n", best.insert_ns, best.overwrite_ns, best.page_us);
+        else
+            std::printf("off   | %8.0f ns | %10.0f ns |       -\n", best.insert_ns, best.overwrite_ns);
+    }
+}
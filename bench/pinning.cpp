@@ -0,0 +1,141 @@
+#include "kv_client.hpp"
+#include "tcp_server.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <unistd.h>
+
+/*
+ * Unpinned against pinned threads. Pinned runs put the reactor on the first
+ * CPU this process may use and spread the workers over the others (or over
+ * that same CPU when it is the only one). `clients` clients each pipeline
+ * GETs and 4 KB SETs in batches of 50 for a few seconds per run.
+ *
+ * Usage: pinning_bench [clients] [seconds]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+constexpr int RUNS = 3;
+constexpr size_t BATCH = 50;
+constexpr size_t KEYS = 10'000;
+
+class Server {
+public:
+    explicit Server(kv::ServerOptions options) : server_(std::move(options)), reactor_([this]() { server_.start(); }) {}
+    ~Server() {
+        server_.stop();
+        reactor_.join();
+    }
+
+private:
+    kv::TcpServer<kv::KvStore> server_;
+    std::jthread reactor_;
+};
+
+std::unique_ptr<kv::NodeClient> connect(uint16_t port) {
+    for (int attempt = 0;; ++attempt) {
+        std::this_thread::sleep_for(10ms);
+        try {
+            return std::make_unique<kv::NodeClient>(kv::ClusterNode{"127.0.0.1", port});
+        } catch (const kv::ClientError&) {
+            if (attempt == 200)
+                throw;
+        }
+    }
+}
+
+std::vector<int> allowed_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::vector<int> cpus;
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Requests per second over all clients, GETs of 100-byte values or SETs of 4 KB ones
+double measure(uint16_t port, size_t clients, std::chrono::duration<double> duration, bool sets) {
+    std::atomic<size_t> requests{0};
+    std::vector<std::unique_ptr<kv::NodeClient>> connections;
+    for (size_t c = 0; c < clients; ++c)
+        connections.push_back(connect(port));
+
+    auto start = Clock::now();
+    auto until = start + std::chrono::duration_cast<Clock::duration>(duration);
+    {
+        std::vector<std::jthread> threads;
+        for (size_t c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c]() {
+                std::string value(4096, 'v');
+                size_t done = 0;
+                for (size_t n = c * 7919; Clock::now() < until;) {
+                    for (size_t i = 0; i < BATCH; ++i, ++n) {
+                        std::string key = "key:" + std::to_string(n % KEYS);
+                        connections[c]->send_line(sets ? "SET " + key + " " + value : "GET " + key);
+                    }
+                    for (size_t i = 0; i < BATCH; ++i)
+                        connections[c]->receive();
+                    done += BATCH;
+                }
+                requests += done;
+            });
+        }
+    }
+    return static_cast<double>(requests) / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t clients = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 8;
+    double seconds = argc > 2 ? std::strtod(argv[2], nullptr) : 2;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    // Picks ports nobody is likely to use, the bench is not run in parallel with itself
+    uint16_t base = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    std::vector<int> cpus = allowed_cpus();
+    std::printf("%zu CPUs, %zu clients pipelining %zu at a time, %.1f s per run, best of %d runs\n", cpus.size(),
+                clients, BATCH, seconds, RUNS);
+    if (cpus.size() < 2)
+        std::printf("only one CPU: every thread shares it pinned or not, so expect no difference\n");
+
+    for (bool pinned : {false, true}) {
+        kv::ServerOptions options;
+        options.address = "127.0.0.1";
+        options.port = static_cast<uint16_t>(base + pinned);
+        if (pinned && !cpus.empty()) {
+            options.reactor_cpu = cpus.front();
+            options.worker_cpus.assign(cpus.size() > 1 ? cpus.begin() + 1 : cpus.begin(), cpus.end());
+        }
+        Server server{options};
+
+        auto loader = connect(options.port);
+        for (size_t i = 0; i < KEYS; ++i)
+            loader->call("SET key:" + std::to_string(i) + " " + std::string(100, 'v'));
+
+        double gets = 0;
+        double sets = 0;
+        for (int run = 0; run < RUNS; ++run) {
+            gets = std::max(gets, measure(options.port, clients, std::chrono::duration<double>{seconds}, false));
+            sets = std::max(sets, measure(options.port, clients, std::chrono::duration<double>{seconds}, true));
+        }
+        std::printf("%-8s %9.0f GET/s  %9.0f SET/s (4 KB)\n", pinned ? "pinned" : "unpinned", gets, sets);
+    }
+}
@@ -0,0 +1,53 @@
+#include "kv/protocol.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/*
+ * Protocol::parse() on single-threaded request lines: GET and SET, which
+ * are the bulk of real traffic, PING, which builds nothing and so shows
+ * the cost of splitting the line and finding its verb, and verbs that sat
+ * at the end of the old chain of comparisons.
+ *
+ * Usage: protocol_bench [lines]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 5;
+
+double ns_per_parse(const std::vector<std::string>& lines, size_t count) {
+    double best = 1e18;
+    for (int run = 0; run < RUNS; ++run) {
+        size_t kinds = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i)
+            kinds += kv::Protocol::parse(lines[i % lines.size()]).index() + 1;
+        double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+        best = std::min(best, ns);
+        if (kinds == 0)
+            std::abort();
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2'000'000;
+
+    std::vector<std::pair<const char*, std::vector<std::string>>> mixes = {
+        {"GET", {"GET user:1000", "get user:1001", "GET user:1002"}},
+        {"SET", {"SET user:1000 v", "set user:1001 v", "SET user:1002 v"}},
+        {"PING", {"PING", "ping"}},
+        {"HOTKEYS / CLUSTER", {"HOTKEYS 5", "CLUSTER SLOTS"}},
+    };
+    std::printf("%zu parses per mix, best of %d runs\n", count, RUNS);
+    for (const auto& [label, lines] : mixes)
+        std::printf("%-20s %6.1f ns/line\n", label, ns_per_parse(lines, count));
+}
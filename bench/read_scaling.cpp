@@ -0,0 +1,84 @@
+#include "kv/kv_store.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * GET throughput of the shared_mutex read path vs. the lock-free one,
+ * for 1 to 64 reader threads over a preloaded keyspace.
+ *
+ * Usage: read_scaling_bench [seconds_per_run] [num_keys]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double run(const kv::KvStore& store, const std::vector<std::string>& keys,
+           size_t num_threads, std::chrono::duration<double> duration) {
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> total_ops{0};
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.emplace_back([&, t]() {
+            size_t ops = 0;
+            size_t index = t * 7919;
+            while (!start.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                // Check the clock flag only every 64 GETs
+                for (int i = 0; i < 64; ++i) {
+                    index = (index + 104729) % keys.size();
+                    if (!store.get(keys[index]))
+                        std::abort();
+                }
+                ops += 64;
+            }
+            total_ops.fetch_add(ops, std::memory_order_relaxed);
+        });
+    }
+
+    auto began = Clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop.store(true, std::memory_order_relaxed);
+    for (auto& thread : threads)
+        thread.join();
+    std::chrono::duration<double> elapsed = Clock::now() - began;
+    return total_ops.load() / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 1.0;
+    size_t num_keys = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+    std::chrono::duration<double> duration{seconds};
+
+    std::vector<std::string> keys;
+    keys.reserve(num_keys);
+    for (size_t i = 0; i < num_keys; ++i)
+        keys.push_back("key:" + std::to_string(i));
+
+    kv::KvStore locked;
+    kv::KvStore lock_free{kv::StoreOptions{.lock_free_reads = true}};
+    for (const auto& key : keys) {
+        locked.set(key, "value-of-16-bytes");
+        lock_free.set(key, "value-of-16-bytes");
+    }
+
+    std::printf("%-8s | %-18s | %-18s | %s\n", "Threads", "shared_mutex GET/s", "lock-free GET/s", "Speedup");
+    for (size_t threads : {1, 2, 4, 8, 16, 32, 64}) {
+        double locked_rate = run(locked, keys, threads, duration);
+        double lock_free_rate = run(lock_free, keys, threads, duration);
+        std::printf("%-8zu | %18.0f | %18.0f | %.2fx\n",
+                    threads, locked_rate, lock_free_rate, lock_free_rate / locked_rate);
+    }
+}
@@ -0,0 +1,181 @@
+#include "tcp_server.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * The same server over loopback TCP and over a Unix domain socket: one
+ * client sends request/response GETs (latency) and then pipelines GETs in
+ * batches (throughput). The server runs in this process on its own threads,
+ * with the default worker count.
+ *
+ * Usage: transport_bench [round_trips] [pipelined_gets] [batch]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int RUNS = 3;
+constexpr size_t KEYS = 1000;
+
+kv::Socket connect_to(const sockaddr* addr, socklen_t size) {
+    kv::Socket socket{::socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (!socket.valid() || ::connect(socket.fd(), addr, size) == -1)
+        return kv::Socket{};
+    if (addr->sa_family == AF_INET) {
+        int one = 1;
+        ::setsockopt(socket.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return socket;
+}
+
+kv::Socket connect_tcp(uint16_t port) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return connect_to(reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+kv::Socket connect_unix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+    return connect_to(reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+}
+
+class Client {
+public:
+    explicit Client(kv::Socket socket) : socket_(std::move(socket)) {}
+
+    void send(std::string_view data) {
+        while (!data.empty()) {
+            ssize_t sent = ::write(socket_.fd(), data.data(), data.size());
+            if (sent <= 0)
+                throw std::runtime_error("write failed");
+            data.remove_prefix(static_cast<size_t>(sent));
+        }
+    }
+
+    // Reads until `count` more replies (lines) have arrived
+    void await_replies(size_t count) {
+        while (count > 0) {
+            ssize_t got = ::read(socket_.fd(), buffer_, sizeof(buffer_));
+            if (got <= 0)
+                throw std::runtime_error("server closed the connection");
+            count -= static_cast<size_t>(std::count(buffer_, buffer_ + got, '\n'));
+        }
+    }
+
+private:
+    kv::Socket socket_;
+    char buffer_[64 * 1024];
+};
+
+struct Result {
+    double p50_us = 1e9;
+    double p99_us = 1e9;
+    double round_trips_per_sec = 0;
+    double pipelined_per_sec = 0;
+};
+
+void measure(Client& client, size_t round_trips, size_t pipelined, size_t batch, Result& best) {
+    std::vector<std::string> gets;
+    for (size_t i = 0; i < KEYS; ++i)
+        gets.push_back("GET key:" + std::to_string(i) + "\n");
+
+    std::vector<double> latencies;
+    auto start = Clock::now();
+    for (size_t i = 0; i < round_trips; ++i) {
+        auto sent = Clock::now();
+        client.send(gets[i % KEYS]);
+        client.await_replies(1);
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    best.p50_us = std::min(best.p50_us, latencies[latencies.size() / 2]);
+    best.p99_us = std::min(best.p99_us, latencies[latencies.size() * 99 / 100]);
+    best.round_trips_per_sec = std::max(best.round_trips_per_sec, static_cast<double>(round_trips) / seconds);
+
+    std::string requests;
+    for (size_t i = 0; i < batch; ++i)
+        requests += gets[i % KEYS];
+    start = Clock::now();
+    for (size_t done = 0; done < pipelined; done += batch) {
+        client.send(requests);
+        client.await_replies(batch);
+    }
+    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    best.pipelined_per_sec = std::max(best.pipelined_per_sec, static_cast<double>(pipelined) / seconds);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t round_trips = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20'000;
+    size_t pipelined = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 500'000;
+    size_t batch = argc > 3 ? std::max<size_t>(std::strtoull(argv[3], nullptr, 10), 1) : 100;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    kv::ServerOptions options;
+    options.address = "127.0.0.1";
+    // Picks a port nobody is likely to use, the bench is not run in parallel with itself
+    options.port = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    options.unix_socket = (std::filesystem::temp_directory_path() / ("kv_transport_" + std::to_string(::getpid()) + ".sock")).string();
+
+    kv::TcpServer<kv::KvStore> server{options};
+    std::thread reactor([&server]() { server.start(); });
+
+    kv::Socket tcp_socket, unix_socket;
+    for (int attempt = 0; attempt < 200 && !(tcp_socket.valid() && unix_socket.valid()); ++attempt) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!tcp_socket.valid())
+            tcp_socket = connect_tcp(options.port);
+        if (!unix_socket.valid())
+            unix_socket = connect_unix(options.unix_socket);
+    }
+    if (!tcp_socket.valid() || !unix_socket.valid()) {
+        std::fprintf(stderr, "server did not come up\n");
+        std::abort();
+    }
+    Client tcp{std::move(tcp_socket)}, unix_client{std::move(unix_socket)};
+
+    std::string sets;
+    for (size_t i = 0; i < KEYS; ++i)
+        sets += "SET key:" + std::to_string(i) + " " + std::string(32, 'v') + "\n";
+    tcp.send(sets);
+    tcp.await_replies(KEYS);
+
+    std::printf("%zu request/response GETs, %zu GETs pipelined %zu at a time, best of %d runs\n", round_trips,
+                pipelined, batch, RUNS);
+    // Runs alternate between the transports, so noise from the machine hits both alike
+    Result tcp_best, unix_best;
+    for (int run = 0; run < RUNS; ++run) {
+        measure(tcp, round_trips, pipelined, batch, tcp_best);
+        measure(unix_client, round_trips, pipelined, batch, unix_best);
+    }
+    for (auto [label, result] : {std::pair{"loopback TCP", &tcp_best}, std::pair{"Unix socket", &unix_best}}) {
+        std::printf("%-13s  p50 %6.1f us  p99 %6.1f us  %8.0f round trips/s  %9.0f pipelined GET/s\n", label,
+                    result->p50_us, result->p99_us, result->round_trips_per_sec, result->pipelined_per_sec);
+    }
+
+    server.stop();
+    reactor.join();
+}
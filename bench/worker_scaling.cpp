@@ -0,0 +1,172 @@
+#include "kv_client.hpp"
+#include "tcp_server.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+/*
+ * A bursty load against fixed and elastic worker pools. One client sends a
+ * GET every millisecond throughout. In every burst, `burst_clients` more
+ * send DUMPs of the whole store back to back, each of which keeps a worker
+ * busy for tens of milliseconds, then go quiet again. Prints the GET
+ * latency in bursts and in quiet phases, and what WORKERS said at the end
+ * of each.
+ *
+ * Usage: worker_scaling_bench [keys] [burst_clients] [cycles]
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using namespace std::chrono_literals;
+constexpr auto BURST = 1500ms;
+constexpr auto QUIET = 2500ms;
+
+class Server {
+public:
+    explicit Server(kv::ServerOptions options) : server_(std::move(options)), reactor_([this]() { server_.start(); }) {}
+    ~Server() {
+        server_.stop();
+        reactor_.join();
+    }
+
+private:
+    kv::TcpServer<kv::KvStore> server_;
+    std::jthread reactor_;
+};
+
+std::unique_ptr<kv::NodeClient> connect(uint16_t port) {
+    for (int attempt = 0;; ++attempt) {
+        std::this_thread::sleep_for(10ms);
+        try {
+            return std::make_unique<kv::NodeClient>(kv::ClusterNode{"127.0.0.1", port});
+        } catch (const kv::ClientError&) {
+            if (attempt == 200)
+                throw;
+        }
+    }
+}
+
+std::map<std::string, std::string> workers(kv::NodeClient& client) {
+    kv::Reply reply = client.call("WORKERS");
+    std::map<std::string, std::string> stats;
+    for (size_t i = 0; i + 1 < reply.elements.size(); i += 2)
+        stats[*reply.elements[i]] = *reply.elements[i + 1];
+    return stats;
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty())
+        return 0;
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<size_t>(p * samples.size()))];
+}
+
+struct Profile {
+    const char* label;
+    size_t min_workers;
+    size_t max_workers;
+};
+
+void run(const Profile& profile, uint16_t port, size_t keys, size_t burst_clients, int cycles) {
+    kv::ServerOptions options;
+    options.address = "127.0.0.1";
+    options.port = port;
+    options.workers = profile.min_workers;
+    options.max_workers = profile.max_workers;
+    options.worker_scaling.shrink_idle = 250ms;
+    Server server{options};
+
+    auto control = connect(port);
+    for (size_t i = 0; i < keys; i += 1000) {
+        std::string mset = "MSET";
+        for (size_t j = i; j < std::min(keys, i + 1000); ++j)
+            mset += " key:" + std::to_string(j) + " " + std::string(32, 'v');
+        control->call(mset);
+    }
+
+    std::atomic<bool> bursting{false};
+    std::atomic<bool> done{false};
+    std::vector<double> burst_us, quiet_us;
+    std::mutex samples_mutex;
+    std::jthread probe([&]() {
+        auto client = connect(port);
+        while (!done) {
+            bool in_burst = bursting;
+            auto start = Clock::now();
+            client->call("GET key:1");
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            {
+                std::lock_guard lock(samples_mutex);
+                (in_burst ? burst_us : quiet_us).push_back(us);
+            }
+            std::this_thread::sleep_for(1ms);
+        }
+    });
+
+    std::vector<std::unique_ptr<kv::NodeClient>> dumpers;
+    for (size_t i = 0; i < burst_clients; ++i)
+        dumpers.push_back(connect(port));
+
+    std::printf("%s\n", profile.label);
+    for (int cycle = 0; cycle < cycles; ++cycle) {
+        bursting = true;
+        auto until = Clock::now() + BURST;
+        {
+            std::vector<std::jthread> burst;
+            for (auto& dumper : dumpers) {
+                burst.emplace_back([&dumper, until]() {
+                    while (Clock::now() < until)
+                        dumper->call("DUMP");
+                });
+            }
+        }
+        auto after_burst = workers(*control);
+        bursting = false;
+        std::this_thread::sleep_for(QUIET);
+        auto after_quiet = workers(*control);
+        std::printf("  cycle %d: %s threads after the burst (peak %s), %s after the quiet phase\n", cycle + 1,
+                    after_burst["running"].c_str(), after_burst["peak"].c_str(), after_quiet["running"].c_str());
+    }
+    done = true;
+    probe.join();
+
+    auto stats = workers(*control);
+    std::printf("  GET in bursts: p50 %7.0f us  p99 %7.0f us   quiet: p50 %5.0f us  p99 %5.0f us\n",
+                percentile(burst_us, 0.5), percentile(burst_us, 0.99), percentile(quiet_us, 0.5),
+                percentile(quiet_us, 0.99));
+    std::printf("  grown %s times, shrunk %s times\n", stats["grown"].c_str(), stats["shrunk"].c_str());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100'000;
+    size_t burst_clients = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4;
+    int cycles = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    kv::Logger::set_level(kv::LogLevel::Off);
+    // Picks ports nobody is likely to use, the bench is not run in parallel with itself
+    uint16_t base = static_cast<uint16_t>(20000 + ::getpid() % 20000);
+    std::printf("%zu keys, %zu DUMP clients in bursts of %lld ms, %lld ms quiet in between\n\n", keys, burst_clients,
+                static_cast<long long>(BURST.count()), static_cast<long long>(QUIET.count()));
+
+    const Profile profiles[] = {
+        {"fixed, 2 workers", 2, 2},
+        {"fixed, 8 workers", 8, 8},
+        {"elastic, 2 to 8 workers", 2, 8},
+    };
+    for (size_t i = 0; i < std::size(profiles); ++i)
+        run(profiles[i], static_cast<uint16_t>(base + i), keys, burst_clients, cycles);
+}
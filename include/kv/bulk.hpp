@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace kv {
+
+// Raised for a bulk stream that is cut short, malformed or too large to send,
+// or a bulk file that can't be used
+class BulkError : public std::runtime_error {
+public:
+    explicit BulkError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+// One key and value of a bulk stream, pointing into the bytes it was decoded from
+struct BulkRecord {
+    std::string_view key;
+    std::string_view value;
+};
+
+/*
+ * The format of LOAD and DUMP: records back to back, each
+ * [key size][value size][key][value] with 32-bit little-endian sizes and
+ * no separators, so keys and values may hold any bytes. Keys are not empty.
+ * A key that appears more than once ends up with its last value.
+ */
+class BulkFormat {
+public:
+    static constexpr size_t HEADER_BYTES = 2 * sizeof(uint32_t);
+
+    static void append(std::string& out, std::string_view key, std::string_view value);
+    // Finds the records of a whole stream, without copying them. Throws BulkError.
+    static std::vector<BulkRecord> decode(std::string_view stream);
+};
+
+/*
+ * A file mapped read-only for decoding in place. Throws BulkError if it
+ * can't be opened.
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view bytes() const noexcept { return {data_, size_}; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/*
+ * Writes a file under a temporary name and renames it into place on commit(),
+ * so nobody sees half of it. Dropped without commit(), the temporary file is
+ * removed. Throws BulkError.
+ */
+class BulkFileWriter {
+public:
+    explicit BulkFileWriter(std::string path);
+    ~BulkFileWriter();
+
+    BulkFileWriter(const BulkFileWriter&) = delete;
+    BulkFileWriter& operator=(const BulkFileWriter&) = delete;
+
+    void write(std::string_view bytes);
+    void commit();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    int fd_ = -1;
+};
+
+// Calls fn(begin, end) for slices of [0, count) on up to one thread per core,
+// each slice at least min_slice long. Returns once all are done, rethrowing
+// the first exception any slice threw.
+template <typename Fn>
+void parallel_slices(size_t count, size_t min_slice, Fn&& fn) {
+    size_t threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                      std::max<size_t>(1, count / std::max<size_t>(1, min_slice)));
+    if (threads <= 1) {
+        fn(size_t{0}, count);
+        return;
+    }
+    size_t slice = (count + threads - 1) / threads;
+    std::vector<std::exception_ptr> errors(threads);
+    {
+        std::vector<std::jthread> helpers;
+        for (size_t begin = slice, index = 1; begin < count; begin += slice, ++index) {
+            helpers.emplace_back([&fn, &error = errors[index], begin, end = std::min(count, begin + slice)]() {
+                try {
+                    fn(begin, end);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+            });
+        }
+        // The first slice on the calling thread
+        try {
+            fn(size_t{0}, slice);
+        } catch (...) {
+            errors[0] = std::current_exception();
+        }
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+} // namespace kv
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "kv/protocol.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace kv {
+
+// Raised for a node address or slot range that can't be used
+class ClusterError : public std::runtime_error {
+public:
+    explicit ClusterError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+struct ClusterNode {
+    std::string host;
+    uint16_t port = 0;
+
+    // "host:port"
+    std::string address() const { return host + ":" + std::to_string(port); }
+    // Parses "host:port". Throws ClusterError.
+    static ClusterNode parse(std::string_view address);
+
+    bool operator==(const ClusterNode&) const = default;
+};
+
+/*
+ * Which node serves each of the SLOTS hash slots.
+ *
+ * A key's slot is CRC16 (XMODEM) of the key modulo SLOTS, as in Redis
+ * Cluster. If the key has a non-empty `{tag}`, only the tag is hashed, so
+ * "{user:1}:name" and "{user:1}:email" share a slot and a node.
+ */
+class SlotMap {
+public:
+    static constexpr uint16_t SLOTS = 16384;
+
+    static uint16_t slot_of(std::string_view key) noexcept;
+
+    // Gives slots like "0-5460,9000" to the node. Throws ClusterError for a
+    // malformed range or a slot that already has a node.
+    void assign(const ClusterNode& node, std::string_view ranges);
+    // Moves one slot to the node, e.g. after a MOVED redirect
+    void reassign(uint16_t slot, const ClusterNode& node);
+
+    // nullptr while the slot has no node
+    const ClusterNode* owner(uint16_t slot) const noexcept;
+    const ClusterNode* owner_of(std::string_view key) const noexcept { return owner(slot_of(key)); }
+    const std::vector<ClusterNode>& nodes() const noexcept { return nodes_; }
+    bool empty() const noexcept { return nodes_.empty(); }
+    // Slots that have no node, as ranges like assign() takes, empty if there are none
+    std::string unassigned() const;
+
+    // "start-end host:port" for each run of slots served by one node, in slot order
+    std::vector<std::string> describe() const;
+    // The map describe() came from. Throws ClusterError.
+    static SlotMap from_description(const std::vector<std::string>& lines);
+
+private:
+    static constexpr uint16_t NO_NODE = UINT16_MAX;
+
+    uint16_t index_of(const ClusterNode& node);
+
+    std::vector<ClusterNode> nodes_;
+    std::vector<uint16_t> owners_ = std::vector<uint16_t>(SLOTS, NO_NODE);
+};
+
+// Calls fn(std::string_view) for every key the command reads or writes.
+// Commands without keys (PING, SCAN, ...) call it for none, and so does
+// LOAD, whose keys are in a stream only a worker decodes.
+template <typename Fn>
+void for_each_key(const Command& command, Fn&& fn) {
+    std::visit([&fn](const auto& cmd) {
+        using T = std::decay_t<decltype(cmd)>;
+        if constexpr (std::is_same_v<T, MGet>) {
+            for (const std::string& key : cmd.keys)
+                fn(std::string_view{key});
+        } else if constexpr (std::is_same_v<T, MSet>) {
+            for (const auto& pair : cmd.pairs)
+                fn(std::string_view{pair.first});
+        } else if constexpr (requires { cmd.key; }) {
+            fn(std::string_view{cmd.key});
+        }
+    }, command);
+}
+
+} // namespace kv
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "kv/kv_store.hpp"
+#include "kv/log_store.hpp"
 #include "kv/protocol.hpp"
+#include "kv/storage_engine.hpp"
 
 #include <string>
 
@@ -9,7 +11,16 @@ namespace kv {
 
 class CommandDispatcher {
 public:
-    static std::string execute(const Command& command, KvStore& store);
+    template <StorageEngine Engine>
+    static std::string execute(const Command& command, Engine& store);
+
+private:
+    template <StorageEngine Engine>
+    static std::string dispatch(const Command& command, Engine& store);
 };
 
+// Compiled once in command_dispatcher.cpp for every engine the server ships
+extern template std::string CommandDispatcher::execute(const Command&, KvStore&);
+extern template std::string CommandDispatcher::execute(const Command&, LogStore&);
+
 } // namespace kv
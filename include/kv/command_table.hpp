@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace kv {
+
+constexpr char fold_ascii(char c) noexcept {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// `a` in any case against `lower`, which is already lowercase
+constexpr bool equals_folded(std::string_view a, std::string_view lower) noexcept {
+    return a.size() == lower.size() &&
+           std::equal(a.begin(), a.end(), lower.begin(), [](char x, char y) { return fold_ascii(x) == y; });
+}
+
+/*
+ * Command verbs looked up by a perfect hash built at compile time.
+ *
+ * Entry is any literal type with a lowercase `name`. The constructor tries
+ * seeds until every name hashes to a slot of its own, so find() hashes the
+ * verb once, folding ASCII case as it goes, and compares it with the one
+ * entry in that slot. Nothing is allocated and the cost doesn't grow with
+ * the number of entries. A duplicate or non-lowercase name fails to compile.
+ */
+template <typename Entry, size_t N>
+class CommandTable {
+public:
+    // Four slots per entry keep the seed search to a few tries
+    static constexpr size_t SLOTS = std::bit_ceil(N) * 4;
+
+    static_assert(N > 0 && N < UINT8_MAX, "a command table holds 1 to 254 entries");
+
+    consteval explicit CommandTable(const std::array<Entry, N>& entries) : entries_(entries) {
+        for (size_t i = 0; i < N; ++i) {
+            std::string_view name = entries_[i].name;
+            if (name.empty() || !std::ranges::all_of(name, [](char c) { return fold_ascii(c) == c; }))
+                throw "command names must be lowercase";
+            for (size_t j = 0; j < i; ++j) {
+                if (entries_[j].name == name)
+                    throw "duplicate command name";
+            }
+            longest_ = std::max(longest_, name.size());
+        }
+        while (!place()) {
+            if (++seed_ == MAX_SEED)
+                throw "no perfect hash found, raise SLOTS";
+        }
+    }
+
+    // The entry for the verb in any case, nullptr for an unknown verb
+    constexpr const Entry* find(std::string_view verb) const noexcept {
+        if (verb.size() > longest_)
+            return nullptr;
+        uint8_t index = slots_[slot_of(verb, seed_)];
+        if (index == EMPTY_SLOT || !equals_folded(verb, entries_[index].name))
+            return nullptr;
+        return &entries_[index];
+    }
+
+    constexpr const std::array<Entry, N>& entries() const noexcept { return entries_; }
+
+private:
+    static constexpr uint8_t EMPTY_SLOT = UINT8_MAX;
+    static constexpr uint32_t MAX_SEED = 1u << 16;
+
+    // FNV-1a over the folded bytes, the seed mixed into the offset basis
+    static constexpr size_t slot_of(std::string_view verb, uint32_t seed) noexcept {
+        uint32_t hash = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (char c : verb) {
+            hash ^= static_cast<unsigned char>(fold_ascii(c));
+            hash *= 16777619u;
+        }
+        return (hash ^ (hash >> 16)) & (SLOTS - 1);
+    }
+
+    // Fills slots_ under seed_, false on a collision
+    constexpr bool place() {
+        slots_.fill(EMPTY_SLOT);
+        for (size_t i = 0; i < N; ++i) {
+            uint8_t& slot = slots_[slot_of(entries_[i].name, seed_)];
+            if (slot != EMPTY_SLOT)
+                return false;
+            slot = static_cast<uint8_t>(i);
+        }
+        return true;
+    }
+
+    std::array<Entry, N> entries_;
+    std::array<uint8_t, SLOTS> slots_{};
+    uint32_t seed_ = 0;
+    size_t longest_ = 0;
+};
+
+} // namespace kv
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kv {
+
+/*
+ * Epoch-based reclamation for readers that take no lock.
+ *
+ * A reader wraps its lookup in an EpochGuard, which copies the global epoch
+ * into a cache line owned by its thread. Entering and leaving are plain
+ * stores to that line, so readers never write to shared memory.
+ *
+ * Writers unlink an object and hand it to retire() instead of freeing it.
+ * It is freed once every reader that was active at that point has left.
+ *
+ * One process-wide domain, like SlabAllocator.
+ */
+class Epoch {
+public:
+    using Deleter = void (*)(void*);
+
+    // Frees `ptr` with `deleter` once no reader can still hold it.
+    // Every RECLAIM_INTERVAL calls also run reclaim().
+    static void retire(void* ptr, Deleter deleter);
+
+    // Frees everything that is safe to free now, returns how many objects were freed
+    static size_t reclaim();
+
+    // Objects retired but not freed yet
+    static size_t pending() noexcept;
+
+    static constexpr size_t RECLAIM_INTERVAL = 64;
+};
+
+// Marks the calling thread as reading for its lifetime, may be nested
+class EpochGuard {
+public:
+    EpochGuard();
+    ~EpochGuard();
+
+    // Non-copyable
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} // namespace kv
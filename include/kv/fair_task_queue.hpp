@@ -0,0 +1,169 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+
+namespace kv {
+
+/*
+ * Task queue that is fair between flows (one flow per client connection).
+ *
+ * Every flow has its own FIFO and flows take turns by deficit round-robin:
+ * per turn a flow may spend QUANTUM bytes of task cost. A client pipelining
+ * thousands of large SETs therefore gets the same share of the workers as
+ * one sending a single PING, and the PING waits for at most one quantum per
+ * busy client instead of the whole backlog.
+ */
+template <typename Key, typename T>
+class FairTaskQueue {
+public:
+    static constexpr size_t QUANTUM = 16 * 1024;
+    using Clock = std::chrono::steady_clock;
+
+    // Reactor calls this to drop off a task, cost is roughly its size in bytes
+    void push(const Key& key, T task, size_t cost) {
+        auto queued = Clock::now();
+        {
+            std::lock_guard lock(mutex_);
+            auto it = flows_.find(key);
+            if (it == flows_.end()) {
+                // Empty flows are erased, so this one is new
+                it = spare_flows_.empty() ? flows_.try_emplace(key).first : reuse_flow(key);
+                ring_.push_back(key);
+            }
+            it->second.tasks.push_back({std::move(task), cost, queued});
+            ++size_;
+        }
+        cv_.notify_one();
+    }
+
+    // Pop the next task in fair order (blocks if the queue is empty)
+    // Returns std::nullopt if the thread is requested to stop
+    std::optional<T> wait_and_pop(std::stop_token stop_token) {
+        std::unique_lock lock(mutex_);
+        bool success = cv_.wait(lock, stop_token, [this]() {
+            return size_ > 0;
+        });
+
+        if (!success || size_ == 0) {
+            return std::nullopt;
+        }
+        return pop_locked(nullptr);
+    }
+
+    // What a pop saw, for a pool that sizes itself by it
+    struct PopStats {
+        Clock::duration waited{}; // how long the task was queued
+        size_t remaining = 0;     // tasks still queued after it
+    };
+
+    // Like wait_and_pop(), but also gives up after `timeout`
+    std::optional<T> wait_and_pop_for(std::stop_token stop_token, Clock::duration timeout, PopStats& stats) {
+        std::unique_lock lock(mutex_);
+        bool success = cv_.wait_for(lock, stop_token, timeout, [this]() {
+            return size_ > 0;
+        });
+
+        if (!success || size_ == 0) {
+            return std::nullopt;
+        }
+        return pop_locked(&stats);
+    }
+
+    size_t size() const {
+        std::lock_guard lock(mutex_);
+        return size_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Item {
+        T task;
+        size_t cost;
+        Clock::time_point queued;
+    };
+
+    std::optional<T> pop_locked(PopStats* stats) {
+        while (true) {
+            Key key = ring_.front();
+            Flow& flow = flows_.find(key)->second;
+            if (!flow.has_turn) {
+                flow.deficit += QUANTUM;
+                flow.has_turn = true;
+            }
+
+            Item& next = flow.tasks.front();
+            // A lone flow has nobody to be fair to
+            if (ring_.size() == 1 && flow.deficit < next.cost)
+                flow.deficit = next.cost;
+
+            if (next.cost <= flow.deficit) {
+                flow.deficit -= next.cost;
+                if (stats)
+                    stats->waited = Clock::now() - next.queued;
+                T task = std::move(next.task);
+                flow.tasks.pop_front();
+                --size_;
+                if (stats)
+                    stats->remaining = size_;
+                if (flow.tasks.empty()) {
+                    // Idle flows don't bank credit
+                    retire_flow(key);
+                    ring_.pop_front();
+                }
+                return task;
+            }
+
+            // Turn is over, the unused deficit carries over to the next round
+            flow.has_turn = false;
+            ring_.pop_front();
+            ring_.push_back(key);
+        }
+    }
+
+    struct Flow {
+        std::deque<Item> tasks;
+        size_t deficit = 0;
+        bool has_turn = false;
+    };
+
+    // Erased flows, kept with their (empty) task deque so a client that
+    // keeps draining its flow doesn't allocate a new one for every task
+    static constexpr size_t SPARE_FLOWS = 64;
+
+    using Flows = std::unordered_map<Key, Flow>;
+
+    typename Flows::iterator reuse_flow(const Key& key) {
+        auto node = std::move(spare_flows_.back());
+        spare_flows_.pop_back();
+        node.key() = key;
+        return flows_.insert(std::move(node)).position;
+    }
+
+    void retire_flow(const Key& key) {
+        auto node = flows_.extract(key);
+        if (spare_flows_.size() == SPARE_FLOWS)
+            return;
+        node.mapped().deficit = 0;
+        node.mapped().has_turn = false;
+        spare_flows_.push_back(std::move(node));
+    }
+
+    Flows flows_;
+    std::vector<typename Flows::node_type> spare_flows_;
+    std::deque<Key> ring_; // flows with queued tasks, in round-robin order
+    size_t size_{0};
+    mutable std::mutex mutex_;
+    std::condition_variable_any cv_;
+};
+
+} // namespace kv
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace kv {
+
+/*
+ * Approximate per-key access counts in a fixed amount of memory (count-min).
+ *
+ * Keys are identified by a 32-bit hash the caller already has (the store
+ * passes its hash table's), so counting a read costs no second pass over
+ * the key. Every hash maps to one 64-byte block and to one 8-bit counter in
+ * each of the block's four rows, so recording an access touches a single
+ * cache line. The estimate is the smallest of the four counters, which can
+ * overcount (hash collisions) but never undercounts. Counters saturate at
+ * MAX_COUNT, a byte each only so they can be atomics of their own, and are
+ * only written while below it, so keys that are hot anyway cost readers a
+ * load and no cache line ping-pong. decay() halves everything, so the counts
+ * describe recent traffic instead of all time.
+ *
+ * record() and estimate() may run concurrently with each other and with
+ * decay(); lost updates between racing increments are acceptable here.
+ */
+class FrequencySketch {
+public:
+    static constexpr uint8_t MAX_COUNT = 15;
+
+    // Room for `blocks` blocks of 64 counters, rounded up to a power of two
+    explicit FrequencySketch(size_t blocks);
+
+    void record(uint32_t key_hash) noexcept;
+    uint32_t estimate(uint32_t key_hash) const noexcept;
+    // Halves all counters
+    void decay() noexcept;
+
+private:
+    static constexpr size_t ROWS = 4;
+    static constexpr size_t BLOCK_COUNTERS = 64;
+    static constexpr size_t ROW_COUNTERS = BLOCK_COUNTERS / ROWS;
+
+    struct alignas(64) Block {
+        std::atomic<uint8_t> counters[BLOCK_COUNTERS];
+    };
+
+    std::unique_ptr<Block[]> blocks_;
+    size_t mask_;
+
+    // Positions of the key's counters: counters[i] of its block is row i's counter
+    struct Slots {
+        Block* block;
+        size_t counters[ROWS];
+    };
+    Slots slots_of(uint32_t key_hash) const noexcept;
+};
+
+} // namespace kv
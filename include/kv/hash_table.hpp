@@ -0,0 +1,345 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "kv/slab_allocator.hpp"
+#include "kv/epoch.hpp"
+
+namespace kv {
+
+/*
+ * Chained hash table with power-of-two bucket counts.
+ *
+ * The bucket layout is owned by us (unlike std::unordered_map) so the
+ * keyspace can be walked with a stateless reverse-binary cursor:
+ * a key that lives in bucket b of a table with 2^n buckets can only move to
+ * buckets that share the low n bits of b after a resize, and incrementing the
+ * cursor from the high bit visits those before moving on. Every key present
+ * for the whole scan is therefore returned, even across rehashes.
+ *
+ * Each node is a single slab allocation holding the links, the value and
+ * the key bytes right behind it.
+ *
+ * Not thread-safe, callers provide the locking. The one exception is
+ * find_concurrent() on a table built with concurrent_reads: links are atomic,
+ * unlinked nodes and old bucket arrays are retired through Epoch instead of
+ * freed, and a rehash bumps layout_version_ so readers that may have been
+ * led into the wrong chain retry. Nodes are relinked in place, so there is
+ * no old table to fall back on: readers wait out a rehash, which takes
+ * about 70 ns per key.
+ */
+template <typename Mapped>
+class HashTable {
+public:
+    explicit HashTable(bool concurrent_reads = false)
+        : buckets_(Buckets::create(MIN_BUCKETS)), concurrent_reads_(concurrent_reads) {}
+
+    ~HashTable() {
+        clear();
+        Buckets::destroy(buckets_.load(std::memory_order_relaxed));
+    }
+
+    // Non-copyable
+    HashTable(const HashTable&) = delete;
+    HashTable& operator=(const HashTable&) = delete;
+
+    // 32 bits are plenty for bucket selection and keep the node header small
+    static uint32_t hash_of(std::string_view key) noexcept {
+        return static_cast<uint32_t>(std::hash<std::string_view>{}(key));
+    }
+
+    Mapped* find(std::string_view key) noexcept {
+        Node* node = find_node(key, hash_of(key));
+        return node ? &node->value : nullptr;
+    }
+
+    const Mapped* find(std::string_view key) const noexcept {
+        return find(key, hash_of(key));
+    }
+
+    // Lookup with a hash_of(key) the caller already has
+    const Mapped* find(std::string_view key, uint32_t hash) const noexcept {
+        Node* node = find_node(key, hash);
+        return node ? &node->value : nullptr;
+    }
+
+    // Lookup without the caller's lock. Needs concurrent_reads and an active
+    // EpochGuard, and only the Mapped's atomic members may be read.
+    const Mapped* find_concurrent(std::string_view key) const noexcept {
+        return find_concurrent(key, hash_of(key));
+    }
+
+    const Mapped* find_concurrent(std::string_view key, uint32_t hash) const noexcept {
+        while (true) {
+            uint64_t layout = layout_version_.load(std::memory_order_acquire);
+            if (layout & 1) {
+                std::this_thread::yield(); // rehash in progress
+                continue;
+            }
+
+            const Buckets* buckets = buckets_.load(std::memory_order_acquire);
+            Node* node = buckets->heads[hash & (buckets->count - 1)].load(std::memory_order_acquire);
+            size_t hops = 0;
+            while (node) {
+                if (node->hash == hash && node->key() == key)
+                    return &node->value;
+                node = node->next.load(std::memory_order_acquire);
+                // A chain relinked under us may even loop, so don't trust long walks
+                if (++hops % CHAIN_RECHECK_HOPS == 0 && layout_version_.load(std::memory_order_relaxed) != layout)
+                    break;
+            }
+
+            // A miss only counts if no rehash moved nodes around meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!node && layout_version_.load(std::memory_order_relaxed) == layout)
+                return nullptr;
+        }
+    }
+
+    // Returns the stored value and whether a new key was inserted
+    template <typename V>
+    std::pair<Mapped*, bool> insert_or_assign(std::string_view key, V&& value) {
+        auto [slot, inserted] = try_emplace(key);
+        *slot = std::forward<V>(value);
+        return {slot, inserted};
+    }
+
+    // Inserts a default-constructed value if the key is missing
+    std::pair<Mapped*, bool> try_emplace(std::string_view key) {
+        return try_emplace(key, hash_of(key));
+    }
+
+    // Same, with a hash_of(key) the caller already has
+    std::pair<Mapped*, bool> try_emplace(std::string_view key, uint32_t hash) {
+        if (Node* node = find_node(key, hash))
+            return {&node->value, false};
+
+        if (size_ + 1 > bucket_count()) // max load factor 1.0
+            rehash(bucket_count() * 2);
+
+        std::atomic<Node*>& head = bucket(hash);
+        Node* node = Node::create(head.load(std::memory_order_relaxed), hash, key);
+        head.store(node, std::memory_order_release);
+        ++size_;
+        return {&node->value, true};
+    }
+
+    bool erase(std::string_view key) {
+        return extract(key).has_value();
+    }
+
+    // Removes the key and hands its value to the caller
+    std::optional<Mapped> extract(std::string_view key) {
+        uint32_t hash = hash_of(key);
+        std::atomic<Node*>* link = &bucket(hash);
+        while (Node* node = link->load(std::memory_order_relaxed)) {
+            if (node->hash == hash && node->key() == key) {
+                std::optional<Mapped> value{std::move(node->value)};
+                // The node keeps its own link, so readers standing on it can move on
+                link->store(node->next.load(std::memory_order_relaxed), std::memory_order_release);
+                dispose_node(node);
+                --size_;
+                shrink_if_sparse();
+                return value;
+            }
+            link = &node->next;
+        }
+        return std::nullopt;
+    }
+
+    // Make room for `count` keys without further rehashing
+    void reserve(size_t count) {
+        size_t target = bucket_count();
+        while (target < count)
+            target *= 2;
+        if (target != bucket_count())
+            rehash(target);
+    }
+
+    // Frees nodes right away, must not race with find_concurrent()
+    void clear() noexcept {
+        Buckets& buckets = *buckets_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < buckets.count; ++i) {
+            Node* head = buckets.heads[i].exchange(nullptr, std::memory_order_relaxed);
+            while (head) {
+                Node* next = head->next.load(std::memory_order_relaxed);
+                Node::destroy(head);
+                head = next;
+            }
+        }
+        size_ = 0;
+    }
+
+    size_t size() const noexcept {
+        return size_;
+    }
+
+    size_t bucket_count() const noexcept {
+        return buckets_.load(std::memory_order_relaxed)->count;
+    }
+
+    // Visit the buckets starting at `cursor` until `max_keys` keys were reported
+    // or `max_buckets` buckets were touched. Returns the cursor to resume from,
+    // 0 once the whole table has been visited.
+    size_t scan(size_t cursor, size_t max_keys, size_t max_buckets,
+                const std::function<void(std::string_view, const Mapped&)>& fn) const {
+        const size_t m = mask();
+        size_t visited_keys = 0;
+        size_t visited_buckets = 0;
+        const Buckets& buckets = *buckets_.load(std::memory_order_relaxed);
+        do {
+            for (Node* node = buckets.heads[cursor & m].load(std::memory_order_relaxed); node;
+                 node = node->next.load(std::memory_order_relaxed)) {
+                fn(node->key(), node->value);
+                ++visited_keys;
+            }
+            ++visited_buckets;
+
+            // Increment the reversed cursor: set the bits above the mask so
+            // the carry propagates into the masked part from its high end
+            cursor |= ~m;
+            cursor = reverse_bits(cursor);
+            ++cursor;
+            cursor = reverse_bits(cursor);
+        } while (cursor != 0 && visited_keys < max_keys && visited_buckets < max_buckets);
+        return cursor;
+    }
+
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        const Buckets& buckets = *buckets_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < buckets.count; ++i)
+            for (Node* node = buckets.heads[i].load(std::memory_order_relaxed); node;
+                 node = node->next.load(std::memory_order_relaxed))
+                fn(node->key(), node->value);
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next;
+        uint32_t hash;
+        uint32_t key_size;
+        Mapped value;
+        // key bytes follow the struct
+
+        static Node* create(Node* next, uint32_t hash, std::string_view key) {
+            void* memory = SlabAllocator::allocate(sizeof(Node) + key.size());
+            Node* node = new (memory) Node{next, hash, static_cast<uint32_t>(key.size()), Mapped{}};
+            std::memcpy(reinterpret_cast<char*>(node + 1), key.data(), key.size());
+            return node;
+        }
+
+        static void destroy(Node* node) noexcept {
+            size_t bytes = sizeof(Node) + node->key_size;
+            node->~Node();
+            SlabAllocator::deallocate(node, bytes);
+        }
+
+        std::string_view key() const noexcept {
+            return {reinterpret_cast<const char*>(this + 1), key_size};
+        }
+    };
+
+    struct Buckets {
+        size_t count;
+        std::unique_ptr<std::atomic<Node*>[]> heads;
+
+        static Buckets* create(size_t count) {
+            return new Buckets{count, std::make_unique<std::atomic<Node*>[]>(count)};
+        }
+
+        static void destroy(void* buckets) {
+            delete static_cast<Buckets*>(buckets);
+        }
+    };
+
+    static constexpr size_t MIN_BUCKETS = 16;
+    static constexpr size_t CHAIN_RECHECK_HOPS = 16;
+
+    std::atomic<Buckets*> buckets_;
+    size_t size_{0};
+    const bool concurrent_reads_;
+    // Odd while a rehash relinks nodes
+    std::atomic<uint64_t> layout_version_{0};
+
+    static size_t reverse_bits(size_t v) noexcept {
+        size_t width = sizeof(v) * 8;
+        size_t swap_mask = ~size_t{0};
+        while ((width >>= 1) > 0) {
+            swap_mask ^= swap_mask << width;
+            v = ((v >> width) & swap_mask) | ((v << width) & ~swap_mask);
+        }
+        return v;
+    }
+
+    size_t mask() const noexcept {
+        return bucket_count() - 1;
+    }
+
+    std::atomic<Node*>& bucket(uint32_t hash) const noexcept {
+        const Buckets& buckets = *buckets_.load(std::memory_order_relaxed);
+        return buckets.heads[hash & (buckets.count - 1)];
+    }
+
+    Node* find_node(std::string_view key, uint32_t hash) const noexcept {
+        for (Node* node = bucket(hash).load(std::memory_order_relaxed); node;
+             node = node->next.load(std::memory_order_relaxed)) {
+            if (node->hash == hash && node->key() == key)
+                return node;
+        }
+        return nullptr;
+    }
+
+    void shrink_if_sparse() {
+        // Shrink below 1/8 load, leaving headroom so we don't bounce
+        if (bucket_count() > MIN_BUCKETS && size_ * 8 < bucket_count())
+            rehash(bucket_count() / 2);
+    }
+
+    void dispose_node(Node* node) {
+        if (concurrent_reads_)
+            Epoch::retire(node, [](void* retired) { Node::destroy(static_cast<Node*>(retired)); });
+        else
+            Node::destroy(node);
+    }
+
+    void rehash(size_t new_bucket_count) {
+        Buckets* old_buckets = buckets_.load(std::memory_order_relaxed);
+        Buckets* new_buckets = Buckets::create(new_bucket_count);
+        const size_t new_mask = new_bucket_count - 1;
+
+        layout_version_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < old_buckets->count; ++i) {
+            Node* head = old_buckets->heads[i].load(std::memory_order_relaxed);
+            while (head) {
+                Node* next = head->next.load(std::memory_order_relaxed);
+                std::atomic<Node*>& slot = new_buckets->heads[head->hash & new_mask];
+                head->next.store(slot.load(std::memory_order_relaxed), std::memory_order_release);
+                slot.store(head, std::memory_order_relaxed);
+                head = next;
+            }
+        }
+        buckets_.store(new_buckets, std::memory_order_release);
+        layout_version_.fetch_add(1, std::memory_order_release);
+
+        if (concurrent_reads_)
+            Epoch::retire(old_buckets, &Buckets::destroy);
+        else
+            Buckets::destroy(old_buckets);
+    }
+};
+
+} // namespace kv
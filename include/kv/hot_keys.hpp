@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace kv {
+
+struct HotKey {
+    std::string key;
+    uint64_t count; // recent accesses, decayed
+};
+
+/*
+ * Finds the most read keys without adding shared writes to the read path.
+ *
+ * Every thread that records gets its own count-min sketch (32-bit counters,
+ * conservative update) and its own short list of candidate keys, so an
+ * access only writes memory no other thread writes. A key whose estimate
+ * beats the smallest candidate of its thread replaces it; only that swap
+ * takes the thread's own (otherwise uncontended) mutex, which readers of
+ * the candidates share with it.
+ *
+ * Only one in `sample` reads is counted (a power of two, picked at random
+ * by a per-thread generator), the others cost a TLS load and a few shifts.
+ * Reported counts are scaled back up, so they stay in reads.
+ *
+ * Counts halve every `half_life`. Time is cut into epochs of that length
+ * and each thread halves its own counters when it notices a new one (it
+ * checks the clock every CLOCK_CHECK records). Threads that went quiet are
+ * scaled down by whoever reads them instead.
+ *
+ * top() merges all candidate lists into a top-K heap, summing the counts of
+ * keys seen by several threads. estimate() sums the sketches, for any key.
+ * Both may run at any time from any thread; they read counters the owners
+ * keep writing, so results are approximate by a few accesses.
+ */
+class HotKeyTracker {
+public:
+    // Candidate keys kept per thread (at most 32)
+    static constexpr size_t CANDIDATES = 32;
+    static constexpr uint32_t CLOCK_CHECK = 256;
+
+    explicit HotKeyTracker(std::chrono::milliseconds half_life, uint32_t sample = 1);
+    ~HotKeyTracker();
+
+    HotKeyTracker(const HotKeyTracker&) = delete;
+    HotKeyTracker& operator=(const HotKeyTracker&) = delete;
+
+    // One access to `key`, whose hash the caller already has (e.g. HashTable::hash_of)
+    void record(std::string_view key, uint32_t key_hash);
+
+    // The `count` keys with the most recent accesses, most accessed first
+    std::vector<HotKey> top(size_t count) const;
+    // Recent accesses to any key, can overcount on hash collisions
+    uint64_t estimate(uint32_t key_hash) const;
+
+    std::chrono::milliseconds half_life() const noexcept { return half_life_; }
+    uint32_t sample() const noexcept { return sample_; }
+
+private:
+    static constexpr size_t ROWS = 4;
+    static constexpr size_t ROW_COUNTERS = 4096;
+
+    struct ThreadState;
+
+    std::chrono::milliseconds half_life_;
+    uint32_t sample_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t id_; // never reused, tells apart the trackers a thread has cached
+
+    mutable std::mutex registry_mutex_;
+    std::vector<std::unique_ptr<ThreadState>> states_;
+
+    ThreadState& local_state();
+    uint32_t current_epoch() const noexcept;
+};
+
+} // namespace kv
@@ -2,27 +2,262 @@
 
 #include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <set>
+#include <vector>
+#include <functional>
 #include <shared_mutex>
+#include <stdexcept>
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "kv/bulk.hpp"
+#include "kv/hash_table.hpp"
+#include "kv/value.hpp"
+#include "kv/lazy_freer.hpp"
+#include "kv/frequency_sketch.hpp"
+#include "kv/hot_keys.hpp"
+#include "kv/value_log.hpp"
+#include "kv/storage_engine.hpp"
+#include "kv/trace.hpp"
 
 
 namespace kv {
 
+struct StoreOptions {
+    // Keep a sorted copy of all keys so prefix and range scans are possible.
+    // Costs one extra tree insert per new key on SET.
+    bool ordered_index = false;
+
+    // Release overwritten or deleted values of at least lazy_free_threshold
+    // bytes on a background thread instead of the calling worker.
+    // UNLINK always does this, regardless of the flag.
+    bool lazy_free = false;
+    size_t lazy_free_threshold = 64 * 1024;
+
+    // Serve GET and EXISTS without touching the store lock. Every write also
+    // publishes an immutable copy of the value, so values are stored twice.
+    bool lock_free_reads = false;
+
+    // LZ4-compress string values of at least compression_threshold bytes on the
+    // writing worker, before the store lock is taken. GETs decompress them again.
+    bool compression = false;
+    size_t compression_threshold = 4096;
+
+    // Tiered storage, off while cold_directory is empty. Once values in memory
+    // take more than memory_limit bytes, the least read ones of at least
+    // cold_min_size bytes move to an append-only log in cold_directory and only
+    // their key and log position stay in memory. Reading one loads it back.
+    std::string cold_directory{};
+    size_t memory_limit = 0;
+    size_t cold_min_size = 4096;
+    // How often a background thread runs tier(). 0 starts no thread and
+    // leaves tier() to the caller, as tests do.
+    std::chrono::milliseconds tiering_interval{250};
+
+    // Count reads per key for HOTKEYS, halving the counts every
+    // hot_key_half_life. 0 turns the tracking off. Only one in hot_key_sample
+    // reads (rounded up to a power of two) is counted, which keeps the cost
+    // to a GET at a few ns. The hottest keys are never moved to the cold log.
+    std::chrono::milliseconds hot_key_half_life{5000};
+    uint32_t hot_key_sample = 8;
+};
+
 /*
- * Thread-safe in-memory key–value store.
+ * Thread-safe in-memory key–value store, the default StorageEngine.
  * Defines the storage API.
  */
 class KvStore {
 public:
+    using Options = StoreOptions;
+    using PageCallback = kv::PageCallback;
+
+    // Number of keys collected per lock acquisition during ordered scans
+    static constexpr size_t SCAN_PAGE_SIZE = 128;
+
+    // Upper bound on buckets touched by one cursor scan call, per requested key
+    static constexpr size_t SCAN_BUCKETS_PER_KEY = 10;
+    // Larger counts asked of one cursor scan call are cut down to this
+    static constexpr size_t SCAN_MAX_COUNT = 1000;
+
+    // Records inserted per unique lock acquisition by load(), and keys per
+    // shared lock acquisition by dump()
+    static constexpr size_t LOAD_BATCH = 1024;
+    static constexpr size_t DUMP_PAGE_SIZE = 1024;
+
+    KvStore() : KvStore(StoreOptions{}) {}
+    explicit KvStore(StoreOptions options);
+
     void set(const std::string& key, const std::string& value);
+    // Stores an already built value without copying it
+    void set(const std::string& key, Value value);
     std::optional<std::string> get(const std::string& key) const;
+    // Calls reader with the value while it can't be freed, so a large value can be
+    // copied straight into a reply. Returns false if the key does not exist.
+    bool read(const std::string& key, const std::function<void(std::string_view)>& reader) const;
+    // Like read, but compressed values are passed as stored. `uncompressed_size`
+    // is 0 if `bytes` are not compressed. Those are copied out first and passed
+    // after the lock is released, so decompressing them holds up no writer.
+    bool read_stored(const std::string& key,
+                     const std::function<void(std::string_view bytes, size_t uncompressed_size)>& reader) const;
     bool del(const std::string& key);
+    // Like del, but large values are always freed in the background
+    bool unlink(const std::string& key);
     bool exists(const std::string& key) const;
     size_t size() const;
 
+    // Atomic read-modify-write operations, each runs under one lock acquisition.
+    // Every write stamps the key with a new store-wide version, used by compare_and_set.
+
+    // Adds delta to an integer value (missing keys count as 0) and returns the result.
+    // Throws StoreError if the value is not an integer or the result would overflow.
+    int64_t incr_by(const std::string& key, int64_t delta);
+    // Appends to the value (missing keys count as empty) and returns the new length
+    size_t append(const std::string& key, const std::string& suffix);
+    // Sets the value and returns the previous one
+    std::optional<std::string> getset(const std::string& key, const std::string& value);
+    // Sets the value only if the key does not exist yet
+    bool setnx(const std::string& key, const std::string& value);
+    std::optional<VersionedValue> get_versioned(const std::string& key) const;
+    // Sets the value only if the key's version still equals expected_version.
+    // expected_version 0 means the key must not exist.
+    bool compare_and_set(const std::string& key, uint64_t expected_version, const std::string& value);
+
+    bool has_ordered_index() const noexcept;
+
+    // Values released by the background freer so far
+    size_t lazily_freed() const noexcept;
+
+    // One tiering pass: moves the least read values to the log until memory_limit
+    // is met again and compacts log segments that are mostly dead. Runs on a
+    // background thread every tiering_interval, no-op without cold_directory.
+    void tier();
+    // Values currently held in the log instead of memory
+    size_t cold_values() const noexcept;
+    // Bytes the log takes on disk, including dead records not compacted yet
+    size_t cold_log_bytes() const noexcept;
+    // Heap bytes of the values held in memory and of their lock-free read
+    // snapshots, what memory_limit is compared with
+    size_t resident_bytes() const noexcept;
+
+    // Visit keys starting with `prefix` in sorted order, at most `limit` (0 = no limit),
+    // none before `from`. Requires the ordered index.
+    void scan_prefix(std::string_view prefix, size_t limit, const PageCallback& on_page,
+                     std::string_view from = {}) const;
+
+    // Visit keys in [start, end) in sorted order, at most `limit` (0 = no limit).
+    // Requires the ordered index.
+    void scan_range(std::string_view start, std::string_view end, size_t limit,
+                    const PageCallback& on_page) const;
+
+    // Stateless keyspace walk, start with cursor 0 and stop when 0 is returned.
+    // Appends roughly `count` keys per call, SCAN_MAX_COUNT at most; keys
+    // present for the whole walk are returned at least once, even if the
+    // table is resized in between.
+    size_t scan(size_t cursor, size_t count, std::vector<std::string>& keys) const;
+
+    // Sets every record, later records winning over earlier ones with the same
+    // key, and returns how many there were. Values (compressed and snapshotted
+    // as the options ask) are built on all cores first, then the table is grown
+    // once and the records are inserted LOAD_BATCH per lock acquisition.
+    size_t load(const std::vector<BulkRecord>& records);
+    // Calls on_chunk with every key and value as BulkFormat records, a page of
+    // keys at a time and without the lock held. Keys written meanwhile may be
+    // missed, and a key may come twice if the table shrinks during the walk.
+    void dump(const std::function<void(std::string_view records)>& on_chunk) const;
+
+    // The `count` most read keys of the last few hot_key_half_life, most read
+    // first. Empty with tracking off.
+    std::vector<HotKey> hot_keys(size_t count) const;
+    // For callers that want estimates of any key, nullptr with tracking off
+    const HotKeyTracker* hot_key_tracker() const noexcept;
+
 private:
-    std::unordered_map<std::string, std::string> data_;
-    mutable std::shared_mutex mutex_;
+    // Immutable text of one value version, read by lock-free GETs
+    struct Snapshot;
+
+    // Values touched by INCR are kept as integers so counters never reparse text,
+    // short strings live inline in the entry
+    struct Entry {
+        Value value;
+        uint64_t version = 0;
+        // Only set with lock_free_reads, swapped on every write and retired through Epoch
+        std::atomic<Snapshot*> snapshot{nullptr};
+
+        Entry() = default;
+        Entry(Entry&& other) noexcept;
+        Entry& operator=(Entry&& other) noexcept;
+        ~Entry();
+    };
+
+    StoreOptions options_{};
+    LazyFreer freer_;
+    HashTable<Entry> data_;
+    uint64_t last_version_{0}; // guarded by the unique lock
+    std::set<std::string, std::less<>> index_;
+    mutable TracedSharedMutex mutex_;
+
+    std::unique_ptr<HotKeyTracker> hot_keys_;
+
+    // Tiered storage, only set up with a cold_directory
+    std::unique_ptr<FrequencySketch> sketch_;
+    std::unique_ptr<ValueLog> cold_log_;
+    mutable std::atomic<size_t> cold_values_{0};
+    // Changed under the unique lock by every write, spill and promote
+    mutable std::atomic<size_t> resident_bytes_{0};
+    mutable std::mutex tiering_mutex_; // one pass at a time, dump() holds it to read cold values
+    size_t tiering_passes_{0}; // guarded by tiering_mutex_
+    std::jthread tiering_thread_; // declared last: stopped before the rest is destroyed
+
+    // Find or create the entry for key and stamp it with a new version.
+    // Caller holds the unique lock.
+    Entry& write_entry(const std::string& key);
+    Entry& write_entry(std::string_view key, uint32_t hash);
+    // Value as stored, compressed if the options ask for it. Runs outside the lock.
+    Value make_value(std::string_view text) const;
+    // Copy of the value for lock-free readers, nullptr unless lock_free_reads is on
+    Snapshot* make_snapshot(const Value& value) const;
+    // Installs `snapshot` on the entry and returns the one it replaces, whose
+    // bytes stop counting as resident. Caller holds the unique lock.
+    Snapshot* publish(Entry& entry, Snapshot* snapshot) const noexcept;
+    static void retire(Snapshot* snapshot);
+    // Current snapshot of key, or nullptr. Caller holds an EpochGuard.
+    const Snapshot* find_snapshot(std::string_view key, uint32_t hash) const noexcept;
+    bool remove(const std::string& key, bool lazy);
+    // Feeds a read of key to the tiering sketch and the hot key tracker
+    void count_read(std::string_view key, uint32_t hash) const;
+    // Drops a value taken out of the store, called after the lock is released
+    void dispose(Value value, bool lazy);
+    // Account for a value in memory changing from `before` to `after` heap bytes.
+    // Caller holds the unique lock.
+    void resize_resident(size_t before, size_t after) const noexcept;
+    void replace_resident(const Value& before, const Value& after) const noexcept;
+
+    // Text of any value, cold ones are read from the log. Caller holds a lock.
+    std::string text_of(const Value& value) const;
+    // In-memory copy of the cold value at `location`. Caller holds a lock.
+    Value load_cold(uint64_t location) const;
+    // Swaps a loaded copy back in if key still refers to `location`.
+    // Only the representation changes, so this is fine from const readers.
+    void promote(std::string_view key, uint64_t location, Value loaded) const;
+    // Moves key's value to the log, false if it changed in between
+    bool spill(const std::string& key);
+    // Spill the least read values until memory_limit is met. Caller holds tiering_mutex_.
+    void spill_cold_values();
+    // Rewrite the live records of mostly dead segments. Caller holds tiering_mutex_.
+    void compact_cold_log();
+    void tiering_loop(std::stop_token stop_token);
+
+    // Shared page loop: walks the index from `start` while `in_bounds` holds
+    void scan_index(std::string_view start, size_t limit,
+                    const std::function<bool(const std::string&)>& in_bounds,
+                    const PageCallback& on_page) const;
 };
 
+static_assert(StorageEngine<KvStore>);
+
 } // namespace kv
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "kv/value.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kv {
+
+/*
+ * Background reclamation thread for large values.
+ *
+ * Freeing a multi-hundred-KB buffer (and the munmap behind it) is handed off
+ * here so it never runs inside the store's critical section or on the
+ * worker that has to send the reply. The thread is started on first use.
+ */
+class LazyFreer {
+public:
+    LazyFreer() = default;
+    // Frees everything still queued
+    ~LazyFreer() = default;
+
+    LazyFreer(const LazyFreer&) = delete;
+    LazyFreer& operator=(const LazyFreer&) = delete;
+
+    // Takes ownership of the value's buffer, cheap (a 24 byte move)
+    void submit(Value value);
+
+    // Number of values released so far
+    size_t freed() const noexcept;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::vector<Value> queue_;
+    std::atomic<size_t> freed_{0};
+    std::jthread thread_; // declared last: joined before the queue is destroyed
+
+    void run(std::stop_token stop_token);
+};
+
+} // namespace kv
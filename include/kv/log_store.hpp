@@ -0,0 +1,186 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "kv/bulk.hpp"
+#include "kv/hash_table.hpp"
+#include "kv/hot_keys.hpp"
+#include "kv/storage_engine.hpp"
+#include "kv/trace.hpp"
+#include "kv/value.hpp"
+
+namespace kv {
+
+struct LogStoreOptions {
+    // Holds the log file, created if missing. Its contents survive restarts.
+    std::string directory = "kv-data";
+
+    // Keep a sorted copy of all keys so prefix and range scans are possible
+    bool ordered_index = false;
+
+    // fdatasync after every write. Without it a write survives a crash of the
+    // server but not of the machine.
+    bool sync_writes = false;
+
+    // Rewrite the log once dead records take compaction_dead_ratio of it,
+    // but not before it has grown to compaction_min_bytes
+    double compaction_dead_ratio = 0.5;
+    size_t compaction_min_bytes = 64 * 1024 * 1024;
+
+    // Count reads per key for HOTKEYS, 0 turns it off. See StoreOptions.
+    std::chrono::milliseconds hot_key_half_life{5000};
+    uint32_t hot_key_sample = 8;
+};
+
+/*
+ * Persistent StorageEngine: every write is appended to a single log file and
+ * only the keys and the file positions of their values are kept in memory.
+ *
+ * A record is [crc32][key size][value size][key][value], a delete is a
+ * record with value size TOMBSTONE. Opening the store replays the log to
+ * rebuild the key map. A record whose checksum doesn't match is a write
+ * torn by a crash, the log is cut off before it.
+ *
+ * Records are checksummed before the unique lock is taken, which is then
+ * held for one pwritev(). Reads pread() the value under the shared lock. Overwrites and
+ * deletes leave the old record dead in the log; once enough of it is dead
+ * the writer that notices rewrites the live records into a new file and
+ * renames it over the old one, blocking everyone while it does.
+ *
+ * Versions for compare_and_set are not stored. They are handed out again,
+ * in log order, when the log is replayed.
+ */
+class LogStore {
+public:
+    using Options = LogStoreOptions;
+    using PageCallback = kv::PageCallback;
+
+    static constexpr size_t SCAN_PAGE_SIZE = 128;
+    static constexpr size_t SCAN_BUCKETS_PER_KEY = 10;
+    static constexpr size_t SCAN_MAX_COUNT = 1000;
+    static constexpr uint32_t TOMBSTONE = UINT32_MAX;
+    // Records written per unique lock acquisition (and pwrite) by load(),
+    // and keys per shared lock acquisition by dump()
+    static constexpr size_t LOAD_BATCH = 1024;
+    static constexpr size_t DUMP_PAGE_SIZE = 1024;
+
+    // Opens or creates the log in options.directory.
+    // Throws std::system_error if it can't be opened.
+    explicit LogStore(Options options);
+    ~LogStore();
+
+    LogStore(const LogStore&) = delete;
+    LogStore& operator=(const LogStore&) = delete;
+
+    // Writes throw StoreError if the log can't be written to (e.g. the disk is full)
+    void set(const std::string& key, const std::string& value);
+    void set(const std::string& key, Value value);
+    std::optional<std::string> get(const std::string& key) const;
+    // The value is read from disk first, the reader runs without the lock held
+    bool read(const std::string& key, const std::function<void(std::string_view)>& reader) const;
+    // Values are never compressed, `uncompressed_size` is always 0
+    bool read_stored(const std::string& key,
+                     const std::function<void(std::string_view bytes, size_t uncompressed_size)>& reader) const;
+    bool del(const std::string& key);
+    // Same as del, values aren't held in memory
+    bool unlink(const std::string& key);
+    bool exists(const std::string& key) const;
+    size_t size() const;
+
+    int64_t incr_by(const std::string& key, int64_t delta);
+    size_t append(const std::string& key, const std::string& suffix);
+    std::optional<std::string> getset(const std::string& key, const std::string& value);
+    bool setnx(const std::string& key, const std::string& value);
+    std::optional<VersionedValue> get_versioned(const std::string& key) const;
+    bool compare_and_set(const std::string& key, uint64_t expected_version, const std::string& value);
+
+    bool has_ordered_index() const noexcept;
+    void scan_prefix(std::string_view prefix, size_t limit, const PageCallback& on_page,
+                     std::string_view from = {}) const;
+    void scan_range(std::string_view start, std::string_view end, size_t limit,
+                    const PageCallback& on_page) const;
+    size_t scan(size_t cursor, size_t count, std::vector<std::string>& keys) const;
+    std::vector<HotKey> hot_keys(size_t count) const;
+
+    // Appends every record to the log, LOAD_BATCH of them per pwrite() and lock
+    // acquisition, and returns how many there were. The batches are encoded on
+    // all cores first. See KvStore::load.
+    size_t load(const std::vector<BulkRecord>& records);
+    // Calls on_chunk with every key and value as BulkFormat records, a page of
+    // keys at a time and without the lock held. See KvStore::dump.
+    void dump(const std::function<void(std::string_view records)>& on_chunk) const;
+
+    // Rewrites the log with only its live records. Throws StoreError on failure.
+    void compact();
+    // Bytes of the log file, and of the records in it that are still live
+    size_t log_bytes() const;
+    size_t live_bytes() const;
+
+private:
+    static constexpr size_t HEADER_BYTES = 3 * sizeof(uint32_t);
+    // Batches load() encodes before writing them out
+    static constexpr size_t LOAD_GROUP = 64;
+    using Header = std::array<char, HEADER_BYTES>;
+
+    struct Entry {
+        uint64_t offset = 0; // of the record
+        uint32_t key_size = 0;
+        uint32_t value_size = 0;
+        uint64_t version = 0;
+
+        size_t record_bytes() const noexcept {
+            return HEADER_BYTES + key_size + value_size;
+        }
+    };
+
+    Options options_;
+    std::string path_;
+    int fd_ = -1;
+    uint64_t end_ = 0;      // guarded by the unique lock, as are the other members below
+    size_t dead_bytes_ = 0;
+    uint64_t last_version_{0};
+    size_t retry_compaction_at_ = 0; // log size to reach before trying again after a failure
+    HashTable<Entry> data_;
+    std::set<std::string, std::less<>> index_;
+    mutable TracedSharedMutex mutex_;
+    std::unique_ptr<HotKeyTracker> hot_keys_;
+
+    // Rebuilds data_ from the log, truncating a torn tail
+    void replay();
+    // Checksummed record header, built before the lock is taken. nullopt is a delete.
+    static Header encode(std::string_view key, std::optional<std::string_view> value);
+    // Appends a record and points key at it. Caller holds the unique lock.
+    void write_record(const std::string& key, Header header, std::optional<std::string_view> value);
+    // Writes `bytes` of whole records at the end of the log, end_ is left to the caller.
+    // Caller holds the unique lock.
+    void write_out(iovec* parts, int count, size_t bytes);
+    // Points key at a record just written. Caller holds the unique lock.
+    void point_to(std::string_view key, const Entry& entry);
+    // Value bytes of an entry. Caller holds a lock.
+    std::string read_value(const Entry& entry) const;
+    // Compacts if enough of the log is dead, a failure is logged and retried later.
+    // Caller holds the unique lock.
+    void compact_if_needed();
+    void compact_locked();
+
+    void scan_index(std::string_view start, size_t limit,
+                    const std::function<bool(const std::string&)>& in_bounds,
+                    const PageCallback& on_page) const;
+};
+
+static_assert(StorageEngine<LogStore>);
+
+} // namespace kv
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Calls below this level are removed at compile time (0 = Debug ... 4 = Off)
+#ifndef KV_LOG_MIN_LEVEL
+#define KV_LOG_MIN_LEVEL 0
+#endif
+
+namespace kv {
+
+enum class LogLevel : uint8_t {
+    Debug,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+/*
+ * Asynchronous logger for the request path.
+ *
+ * Each thread writes its messages into a ring buffer of its own, a slot per
+ * message, with no lock and no syscall. A background thread collects the
+ * rings every few milliseconds, adds timestamps, level and thread in front,
+ * and writes the batch with one write(). A message that finds its thread's
+ * ring full is dropped and counted rather than making the caller wait.
+ *
+ * Use the KV_LOG macro: a level disabled at runtime costs one relaxed load
+ * and a branch, one below KV_LOG_MIN_LEVEL is not compiled at all.
+ * Arguments are strings, integers or floating point values, concatenated
+ * into at most MESSAGE_BYTES, the rest is cut off.
+ */
+class Logger {
+public:
+    static constexpr size_t MESSAGE_BYTES = 240;
+
+    struct Record {
+        uint64_t timestamp_ns; // since the epoch
+        uint32_t thread;       // small id in registration order
+        LogLevel level;
+        uint16_t size;
+        char text[MESSAGE_BYTES];
+    };
+
+    static constexpr bool compiled_in(LogLevel level) noexcept {
+        return level >= static_cast<LogLevel>(KV_LOG_MIN_LEVEL);
+    }
+
+    static bool enabled(LogLevel level) noexcept {
+        return level >= s_level.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    static void log(LogLevel level, const Args&... args) {
+        Record* record = begin_record();
+        if (!record)
+            return;
+        size_t size = 0;
+        (append(*record, size, args), ...);
+        commit_record(level, size);
+    }
+
+    static void set_level(LogLevel level) noexcept;
+    static LogLevel level() noexcept;
+    // "debug", "info", "warn", "error" or "off"
+    static std::optional<LogLevel> parse_level(std::string_view name) noexcept;
+    static std::string_view level_name(LogLevel level) noexcept;
+
+    // Where records are written, stdout by default. The fd is not closed.
+    static void set_output(int fd);
+    // Blocks until everything logged before the call has been written
+    static void flush();
+    // Messages lost to full rings since startup
+    static uint64_t dropped() noexcept;
+
+private:
+    inline static std::atomic<LogLevel> s_level{LogLevel::Info};
+
+    // Next free slot of this thread's ring, nullptr if the ring is full
+    static Record* begin_record() noexcept;
+    // Publishes the slot returned by begin_record
+    static void commit_record(LogLevel level, size_t size) noexcept;
+
+    static void append(Record& record, size_t& size, std::string_view text) noexcept {
+        size_t n = std::min(text.size(), MESSAGE_BYTES - size);
+        text.copy(record.text + size, n);
+        size += n;
+    }
+
+    static void append(Record& record, size_t& size, char c) noexcept {
+        if (size < MESSAGE_BYTES)
+            record.text[size++] = c;
+    }
+
+    template <typename Number>
+        requires((std::integral<Number> && !std::same_as<Number, bool>) || std::floating_point<Number>)
+    static void append(Record& record, size_t& size, Number value) noexcept {
+        auto [end, ec] = std::to_chars(record.text + size, record.text + MESSAGE_BYTES, value);
+        if (ec == std::errc{})
+            size = static_cast<size_t>(end - record.text);
+    }
+};
+
+} // namespace kv
+
+#define KV_LOG(level, ...)                                                                  \
+    do {                                                                                    \
+        if constexpr (::kv::Logger::compiled_in(::kv::LogLevel::level)) {                   \
+            if (::kv::Logger::enabled(::kv::LogLevel::level))                               \
+                ::kv::Logger::log(::kv::LogLevel::level, __VA_ARGS__);                      \
+        }                                                                                   \
+    } while (false)
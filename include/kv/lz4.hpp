@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace kv {
+
+/*
+ * Built-in codec for the LZ4 block format (no frame header or checksum).
+ *
+ * Greedy single-probe matcher, so it is fast rather than tight. The output is
+ * plain LZ4, so clients that fetch compressed values can decode them with any
+ * LZ4 library (LZ4_decompress_safe).
+ */
+class Lz4 {
+public:
+    // Worst case output size of compress() for `size` input bytes
+    static size_t max_compressed_size(size_t size) noexcept;
+
+    // Compresses `src` into `dst`, which must hold max_compressed_size(src.size()) bytes.
+    // Returns the number of bytes written.
+    static size_t compress(std::string_view src, char* dst) noexcept;
+
+    // Decompresses into exactly `dst_size` bytes, returns false on malformed input
+    static bool decompress(std::string_view src, char* dst, size_t dst_size) noexcept;
+};
+
+} // namespace kv
@@ -1,10 +1,16 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <string_view>
 #include <vector>
+#include <utility>
 #include <variant>
 #include <stdexcept>
+#include <cstdint>
+#include <memory>
+
+#include "kv/value.hpp"
 
 namespace kv {
 
@@ -13,6 +19,15 @@ public:
     explicit ProtocolError(const std::string& msg) : std::runtime_error(msg) {}
 };
 
+// A command announced a payload of `size` bytes it may not send. The bytes
+// follow the line anyway, so nothing after it can be read as commands.
+class PayloadError : public ProtocolError {
+public:
+    PayloadError(const std::string& msg, size_t size) : ProtocolError(msg), size(size) {}
+
+    size_t size;
+};
+
 struct Get {
     std::string key;
 };
@@ -26,13 +41,140 @@ struct Del {
     std::string key;
 };
 
+// UNLINK key, DEL that frees large values in the background
+struct Unlink {
+    std::string key;
+};
+
 struct Ping {
 };
 
+// INCR, DECR and INCRBY all map to an increment
+struct Incr {
+    std::string key;
+    int64_t delta = 1;
+};
+
+struct Append {
+    std::string key;
+    std::string value;
+};
+
+struct GetSet {
+    std::string key;
+    std::string value;
+};
+
+struct SetNx {
+    std::string key;
+    std::string value;
+};
+
+// GETS key, returns the value and its version
+struct Gets {
+    std::string key;
+};
+
+// CAS key version value
+struct Cas {
+    std::string key;
+    uint64_t version = 0;
+    std::string value;
+};
+
+// MGET key [key ...], replies with an array of the values, `_` for missing keys
+struct MGet {
+    std::vector<std::string> keys;
+};
+
+// MSET key value [key value ...], sets all of them as one batch
+struct MSet {
+    std::vector<std::pair<std::string, std::string>> pairs;
+};
+
+// SCAN prefix [LIMIT n] [FROM key], replies with one page of sorted keys,
+// led by the key to continue FROM ("" once there are no more)
+struct Scan {
+    std::string prefix;
+    size_t limit = 0; // 0 = up to Protocol::MAX_SCAN_KEYS
+    std::string from;
+};
+
+// SCAN cursor COUNT n, walks the whole keyspace
+struct CursorScan {
+    size_t cursor = 0;
+    size_t count = 0;
+};
+
+// RANGE start end [LIMIT n], end is exclusive. Replies like SCAN prefix,
+// the next page starts at the key the reply leads with.
+struct Range {
+    std::string start;
+    std::string end;
+    size_t limit = 0; // 0 = up to Protocol::MAX_SCAN_KEYS
+};
+
+// SETBLOB key size, followed by exactly `size` raw bytes
+struct SetBlob {
+    std::string key;
+    size_t size = 0;
+    // Filled in by the connection once all bytes have arrived
+    std::shared_ptr<Value> payload;
+};
+
+// GETBLOB key [COMPRESSED], replies with the value length-prefixed.
+// With COMPRESSED, values stored compressed are sent as is.
+struct GetBlob {
+    std::string key;
+    bool compressed = false;
+};
+
+// LOAD size, followed by exactly `size` bytes of BulkFormat records, or
+// LOAD FILE name, a file of them in the server's bulk directory
+struct Load {
+    std::string file;
+    size_t size = 0;
+    // Filled in by the connection once all bytes have arrived
+    std::shared_ptr<Value> payload;
+    // Set by the server in cluster mode, the keys this node serves. A stream
+    // with any other key is refused as a whole.
+    std::function<bool(std::string_view key)> accepts{};
+};
+
+// DUMP replies with every key and value as BulkFormat records, length-prefixed
+// like GETBLOB. DUMP FILE name writes them to a file in the bulk directory.
+struct Dump {
+    std::string file;
+    // Largest stream the reply may carry, 0 for any. Set by the server, a
+    // larger store fails without building all of it.
+    size_t max_size = 0;
+};
+
+// SLOWLOG GET [n] | SLOWLOG LEN | SLOWLOG RESET, answered by the server, not the store
+struct SlowLog {
+    enum class Action { Get, Len, Reset };
+    Action action = Action::Get;
+    size_t count = 10; // entries for GET
+};
+
+// HOTKEYS [n], the n most read keys lately, each followed by its count
+struct HotKeys {
+    size_t count = 10;
+};
+
+// CLUSTER SLOTS, which node serves which hash slots, answered by the server
+struct ClusterSlots {
+};
+
+// WORKERS, the worker pool's size and how it scaled, answered by the server
+struct Workers {
+};
+
 struct NoOp {
 };
 
-using Command = std::variant<Get, Set, Del, Ping, NoOp>;
+using Command = std::variant<Get, Set, Del, Unlink, Ping, Incr, Append, GetSet, SetNx, Gets, Cas, MGet, MSet, Scan,
+                             CursorScan, Range, SetBlob, GetBlob, Load, Dump, SlowLog, HotKeys, ClusterSlots, Workers, NoOp>;
 
 /*
  * Parses and formats protocol messages.
@@ -41,14 +183,29 @@ using Command = std::variant<Get, Set, Del, Ping, NoOp>;
  */
 class Protocol {
 public:
+    // Most keys in one SCAN prefix or RANGE reply, whatever its LIMIT
+    static constexpr size_t MAX_SCAN_KEYS = 1000;
+    // Largest SETBLOB payload
+    static constexpr size_t MAX_BLOB_SIZE = 512 * 1024 * 1024;
+    // Largest LOAD stream sent over the connection, bigger ones go through LOAD FILE
+    static constexpr size_t MAX_LOAD_SIZE = 2048ull * 1024 * 1024;
+
     static Command parse(std::string_view line);
 
     static std::string format_ok();
     static std::string format_error(std::string_view message);
+    // "-MOVED <slot> <host:port>", the key's hash slot is served by another node
+    static std::string format_moved(uint16_t slot, std::string_view node);
     static std::string format_value(std::string_view value);
-
-private:
-    static Command parse_tokens(const std::vector<std::string_view>& tokens);
+    static std::string format_integer(int64_t value);
+    // Reply for "no value", e.g. GETSET on a key that didn't exist
+    static std::string format_nil();
+    // "*<n>" header line followed by one value line per element
+    static std::string format_array(const std::vector<std::string>& values);
+    // "=<size>" line, followed by `size` raw bytes and a \n
+    static std::string format_blob_header(size_t size);
+    // "~<size> <uncompressed size>" line, followed by `size` LZ4 block bytes and a \n
+    static std::string format_compressed_blob_header(size_t size, size_t uncompressed_size);
 };
 
 } // namespace kv
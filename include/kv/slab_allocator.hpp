@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+namespace kv {
+
+/*
+ * Size-class slab allocator for store keys, nodes and values.
+ *
+ * Small blocks are carved out of large slabs, so millions of entries don't
+ * each pay malloc's per-chunk header and fragmentation. Every thread keeps a
+ * private free list per size class and only touches the shared (locked) depot
+ * to move whole batches, so workers don't contend with each other.
+ *
+ * Slab memory is recycled within its size class but never returned to the OS.
+ * Requests above MAX_SMALL_SIZE go straight to operator new.
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t MAX_SMALL_SIZE = 4096;
+
+    // `size` must be passed again on deallocate
+    static void* allocate(size_t size);
+    static void deallocate(void* ptr, size_t size) noexcept;
+
+    // Size actually reserved for a request of `size` bytes
+    static size_t block_size(size_t size) noexcept;
+
+    // Bytes currently reserved in slabs (all size classes, all threads)
+    static size_t reserved_bytes() noexcept;
+};
+
+} // namespace kv
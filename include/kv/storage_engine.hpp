@@ -0,0 +1,78 @@
+#pragma once
+
+#include "kv/bulk.hpp"
+#include "kv/hot_keys.hpp"
+#include "kv/value.hpp"
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kv {
+
+// Raised when a read-modify-write command can't be applied to the stored value
+class StoreError : public std::runtime_error {
+public:
+    explicit StoreError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+struct VersionedValue {
+    std::string value;
+    uint64_t version;
+};
+
+// Receives one page of keys at a time, called without the engine's lock held
+using PageCallback = std::function<void(const std::vector<std::string>&)>;
+
+/*
+ * What CommandDispatcher and TcpServer need from a storage backend.
+ *
+ * Engines are plugged in as a template parameter, so every command is a
+ * direct (and inlinable) call, no virtual dispatch. Each engine is
+ * constructed from its own `Options` and must be safe to call from all
+ * workers at once. See KvStore for the semantics of each operation.
+ */
+template <typename Engine>
+concept StorageEngine = requires(Engine& engine, const Engine& reader, const std::string& key,
+                                 std::string_view bytes, std::vector<std::string>& keys,
+                                 const PageCallback& on_page, const std::vector<BulkRecord>& records,
+                                 const std::function<void(std::string_view)>& on_value,
+                                 const std::function<void(std::string_view, size_t)>& on_stored) {
+    typename Engine::Options;
+    requires std::constructible_from<Engine, typename Engine::Options>;
+
+    engine.set(key, key);
+    engine.set(key, Value{bytes});
+    { reader.get(key) } -> std::same_as<std::optional<std::string>>;
+    { reader.read(key, on_value) } -> std::same_as<bool>;
+    { reader.read_stored(key, on_stored) } -> std::same_as<bool>;
+    { engine.del(key) } -> std::same_as<bool>;
+    { engine.unlink(key) } -> std::same_as<bool>;
+    { reader.exists(key) } -> std::same_as<bool>;
+    { reader.size() } -> std::same_as<size_t>;
+
+    { engine.incr_by(key, int64_t{1}) } -> std::same_as<int64_t>;
+    { engine.append(key, key) } -> std::same_as<size_t>;
+    { engine.getset(key, key) } -> std::same_as<std::optional<std::string>>;
+    { engine.setnx(key, key) } -> std::same_as<bool>;
+    { reader.get_versioned(key) } -> std::same_as<std::optional<VersionedValue>>;
+    { engine.compare_and_set(key, uint64_t{0}, key) } -> std::same_as<bool>;
+
+    { reader.has_ordered_index() } -> std::same_as<bool>;
+    reader.scan_prefix(bytes, size_t{0}, on_page, bytes);
+    reader.scan_range(bytes, bytes, size_t{0}, on_page);
+    { reader.scan(size_t{0}, size_t{0}, keys) } -> std::same_as<size_t>;
+
+    { reader.hot_keys(size_t{0}) } -> std::same_as<std::vector<HotKey>>;
+
+    { engine.load(records) } -> std::same_as<size_t>;
+    reader.dump(on_value);
+};
+
+} // namespace kv
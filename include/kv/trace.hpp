@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define KV_HAVE_RDTSC 1
+#endif
+
+namespace kv {
+
+/*
+ * Cycle counter for stage timestamps, a few ns per read instead of a
+ * clock_gettime(). Ticks are converted to ns with a rate measured once
+ * against steady_clock. Falls back to steady_clock without rdtsc.
+ */
+class Tsc {
+public:
+    static uint64_t now() noexcept {
+#ifdef KV_HAVE_RDTSC
+        return __rdtsc();
+#else
+        return steady_ns();
+#endif
+    }
+
+    static double ns_per_tick() noexcept;
+    static double to_ns(uint64_t ticks) noexcept { return static_cast<double>(ticks) * ns_per_tick(); }
+
+private:
+    static uint64_t steady_ns() noexcept;
+};
+
+// Points in a request's life, in order
+enum class TraceStage : uint8_t {
+    ReadComplete, // the read that completed the line returned
+    Parsed,
+    Enqueued,     // in the worker queue
+    Dequeued,     // a worker picked it up
+    LockAcquired, // first store lock taken, missing for lock-free paths
+    Executed,     // response built
+    Flushed,      // last byte of the response handed to the socket
+};
+inline constexpr size_t TRACE_STAGES = 7;
+
+/*
+ * Timestamps of one sampled request. Created by the reactor, travels with
+ * the task to a worker and with the response back to the reactor.
+ */
+struct RequestTrace {
+    static constexpr size_t COMMAND_BYTES = 64;
+
+    std::array<uint64_t, TRACE_STAGES> ticks{}; // 0 = stage not reached
+    std::string command; // the first COMMAND_BYTES of the command line
+
+    void mark(TraceStage stage) noexcept {
+        uint64_t& slot = ticks[static_cast<size_t>(stage)];
+        if (slot == 0)
+            slot = Tsc::now();
+    }
+
+    // From the first stage reached to the last
+    uint64_t total_ticks() const noexcept;
+};
+
+/*
+ * The request the calling thread is executing, if it is traced, so code
+ * far from the worker loop (the store's lock) can stamp it.
+ * One TLS load and a branch when nothing is traced.
+ */
+class ActiveTrace {
+public:
+    explicit ActiveTrace(RequestTrace* trace) noexcept : previous_(s_current) { s_current = trace; }
+    ~ActiveTrace() { s_current = previous_; }
+
+    ActiveTrace(const ActiveTrace&) = delete;
+    ActiveTrace& operator=(const ActiveTrace&) = delete;
+
+    static void mark(TraceStage stage) noexcept {
+        if (s_current) [[unlikely]]
+            s_current->mark(stage);
+    }
+
+private:
+    inline static constinit thread_local RequestTrace* s_current = nullptr;
+    RequestTrace* previous_;
+};
+
+/*
+ * std::shared_mutex that stamps TraceStage::LockAcquired on the active trace.
+ * A drop-in for the stores' lock, works with unique_lock and shared_lock.
+ */
+class TracedSharedMutex {
+public:
+    void lock() {
+        mutex_.lock();
+        ActiveTrace::mark(TraceStage::LockAcquired);
+    }
+    bool try_lock() {
+        bool locked = mutex_.try_lock();
+        if (locked)
+            ActiveTrace::mark(TraceStage::LockAcquired);
+        return locked;
+    }
+    void unlock() { mutex_.unlock(); }
+
+    void lock_shared() {
+        mutex_.lock_shared();
+        ActiveTrace::mark(TraceStage::LockAcquired);
+    }
+    bool try_lock_shared() {
+        bool locked = mutex_.try_lock_shared();
+        if (locked)
+            ActiveTrace::mark(TraceStage::LockAcquired);
+        return locked;
+    }
+    void unlock_shared() { mutex_.unlock_shared(); }
+
+private:
+    std::shared_mutex mutex_;
+};
+
+/*
+ * The slowest traced requests since the last reset, with their stage breakdown.
+ * A fixed-capacity min-heap on total time: a request slower than the
+ * fastest one kept replaces it. Used only by the reactor thread, which both
+ * completes traces and answers SLOWLOG, so it needs no lock.
+ */
+class SlowRequestLog {
+public:
+    struct Entry {
+        uint64_t id;
+        int64_t unix_time;
+        double total_us;
+        // Time from the previous stage reached to each stage, -1 if not reached
+        std::array<double, TRACE_STAGES> stage_us;
+        std::string command;
+    };
+
+    explicit SlowRequestLog(size_t capacity) : capacity_(capacity) {}
+
+    void record(const RequestTrace& trace);
+    // Up to `count` entries, slowest first
+    std::vector<Entry> slowest(size_t count) const;
+    void reset() noexcept { heap_.clear(); }
+
+    size_t size() const noexcept { return heap_.size(); }
+    size_t capacity() const noexcept { return capacity_; }
+
+    // "id=3 time=1760812345 total_us=523.1 parse=2.1 ... command=SET key"
+    static std::string format(const Entry& entry);
+    static std::string_view stage_name(TraceStage stage) noexcept;
+
+private:
+    size_t capacity_;
+    uint64_t next_id_{0};
+    std::vector<Entry> heap_; // fastest entry on top
+};
+
+} // namespace kv
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace kv {
+
+/*
+ * Compact stored value, 24 bytes.
+ *
+ * Holds one of:
+ *  - a short string (up to INLINE_CAPACITY bytes) inline, no allocation
+ *  - a longer string in a slab-allocated buffer
+ *  - a 64-bit integer (counters written by INCR)
+ *  - a longer string LZ4-compressed in a slab-allocated buffer
+ *  - the location of a value moved to the store's ValueLog, nothing else
+ * Move-only.
+ */
+class Value {
+public:
+    static constexpr size_t INLINE_CAPACITY = 22;
+
+    Value() noexcept;
+    explicit Value(std::string_view text);
+    explicit Value(int64_t number) noexcept;
+    ~Value();
+
+    // String of `size` bytes with unspecified contents, filled through data().
+    // Lets large payloads be read straight into the buffer that gets stored.
+    static Value with_size(size_t size);
+    // Compressed copy of text, or a plain one if compressing doesn't save at least 1/8
+    static Value compress(std::string_view text);
+    // Value from bytes that are already LZ4-compressed
+    static Value from_compressed(std::string_view bytes, size_t uncompressed_size);
+    // Stand-in for a value kept in a ValueLog at `location`
+    static Value cold(uint64_t location) noexcept;
+
+    // Non-copyable
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    // Movable
+    Value(Value&& other) noexcept;
+    Value& operator=(Value&& other) noexcept;
+
+    void assign(std::string_view text);
+    void assign(int64_t number) noexcept;
+    // Appends text, turning an integer into its decimal string first
+    void append(std::string_view text);
+
+    bool is_integer() const noexcept;
+    int64_t integer() const noexcept;
+    bool is_compressed() const noexcept;
+    // Only valid for plain strings (!is_integer() && !is_compressed())
+    std::string_view text() const noexcept;
+    // Writable bytes of text(), same restriction
+    char* data() noexcept;
+    // Only valid if is_compressed()
+    std::string_view compressed() const noexcept;
+    size_t uncompressed_size() const noexcept;
+    bool is_cold() const noexcept;
+    // Only valid if is_cold()
+    uint64_t cold_location() const noexcept;
+    // Text form of any representation but cold, decompressing if needed
+    std::string to_string() const;
+    // Size of the separately allocated buffer, 0 for inline strings, integers and cold values
+    size_t heap_bytes() const noexcept;
+
+private:
+    enum class Kind : uint8_t { Inline, Heap, Integer, Compressed, Cold };
+
+    struct HeapBuffer {
+        char* data;
+        uint32_t size;
+        uint32_t capacity;
+    };
+
+    // Payload in bytes [0, 22), inline length at byte 22, kind at byte 23.
+    // HeapBuffer and int64_t (or a cold location) are memcpy'd in and out of the first 16/8 bytes,
+    // a compressed value keeps its uncompressed size in bytes [16, 20).
+    alignas(8) char raw_[24];
+
+    static_assert(sizeof(HeapBuffer) + sizeof(uint32_t) <= INLINE_CAPACITY);
+
+    Kind kind() const noexcept;
+    void set_kind(Kind kind) noexcept;
+    HeapBuffer heap() const noexcept;
+    void set_heap(const HeapBuffer& heap) noexcept;
+    void release() noexcept;
+};
+
+static_assert(sizeof(Value) == 24);
+
+} // namespace kv
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kv {
+
+/*
+ * Append-only log for values moved out of memory, split into segment files.
+ *
+ * A record is [key size][value size][uncompressed size][key][value], copied
+ * into a memory-mapped segment with a plain memcpy. Reads return views into
+ * the mapping, so the kernel pages a cold value back in on access and can
+ * drop it again under memory pressure. A location is the segment id in the
+ * high bits and the record's offset in the low ones.
+ *
+ * Records never change. Overwrites and promotions release the old record,
+ * and compaction copies the live records of a mostly dead segment to the
+ * end of the log before deleting its file.
+ *
+ * append(), for_each_record() and drop_if_empty() must not run concurrently
+ * with each other (the store calls them from its tiering pass); read() and
+ * release() are safe from any thread. A view from read() stays valid until
+ * its segment is dropped, which needs every record in it to be released.
+ */
+class ValueLog {
+public:
+    static constexpr size_t SEGMENT_BYTES = 64 * 1024 * 1024;
+
+    struct Record {
+        std::string_view key;
+        std::string_view bytes;
+        size_t uncompressed_size; // 0 unless bytes are LZ4-compressed
+    };
+
+    // Segment files are created in `directory`, which must exist.
+    // Larger records get a segment of their own.
+    explicit ValueLog(std::string directory, size_t segment_bytes = SEGMENT_BYTES);
+    // Unmaps and deletes all segment files, the log is not meant to outlive the store
+    ~ValueLog();
+
+    ValueLog(const ValueLog&) = delete;
+    ValueLog& operator=(const ValueLog&) = delete;
+
+    // Returns the new record's location. Throws std::system_error if the disk is full.
+    uint64_t append(std::string_view key, std::string_view bytes, size_t uncompressed_size);
+    Record read(uint64_t location) const;
+    // Marks the record dead, its space is reclaimed by compaction
+    void release(uint64_t location) noexcept;
+
+    // Full segments with at least `dead_ratio` of their bytes dead, most dead first
+    std::vector<uint32_t> compaction_candidates(double dead_ratio) const;
+    // Calls fn(location, record) for every record of the segment, live or dead
+    void for_each_record(uint32_t segment, const std::function<void(uint64_t, const Record&)>& fn) const;
+    // Deletes the segment file once none of its records is live
+    bool drop_if_empty(uint32_t segment);
+    // Unmaps the written pages of the active segment from the process, they stay in the page cache
+    void trim() noexcept;
+
+    // Bytes of all records on disk, and of the live ones
+    size_t disk_bytes() const noexcept;
+    size_t live_bytes() const noexcept;
+
+private:
+    static constexpr int OFFSET_BITS = 40;
+    static constexpr uint64_t OFFSET_MASK = (uint64_t{1} << OFFSET_BITS) - 1;
+    static constexpr size_t HEADER_BYTES = 3 * sizeof(uint32_t);
+
+    struct Segment {
+        uint32_t id;
+        int fd;
+        char* base;
+        size_t capacity;
+        size_t written = 0; // only touched by the appending thread
+        std::atomic<size_t> live{0};
+        std::string path;
+    };
+
+    std::string directory_;
+    size_t segment_bytes_;
+    std::map<uint32_t, std::unique_ptr<Segment>> segments_;
+    Segment* active_ = nullptr;
+    uint32_t next_id_ = 1;
+    std::atomic<size_t> disk_bytes_{0};
+    std::atomic<size_t> live_bytes_{0};
+    // Guards the segments_ map, not the segment contents
+    mutable std::shared_mutex mutex_;
+
+    Segment& open_segment(size_t capacity);
+    Segment& segment_of(uint64_t location) const;
+    static Record parse(const char* record) noexcept;
+    static void close(Segment& segment) noexcept;
+};
+
+} // namespace kv
@@ -4,7 +4,15 @@
 # The location it is ran from is only relevant if you wish to save current results
 # or load previous results bench_results.json
 # Saving and loading happens in the cwd.
-
+#
+# Other workloads can be picked with --workload, e.g.
+#   python3 benchmark.py --workload large-overwrite
+# which measures small GET latency while other clients keep overwriting large
+# values (compare a server started with and without --lazy-free).
+#   python3 benchmark.py --workload bulk-load
+# measures PING latency while one client pipelines large SETs as fast as it can.
+
+import argparse
 import socket
 import time
 import statistics
@@ -97,8 +105,98 @@ def run_concurrent_test(host, port, name, command, num_clients=10, req_per_clien
     }
 
 
+def run_large_overwrite_test(host, port, value_size=256 * 1024, num_writers=2, num_readers=8, req_per_reader=2000):
+    print(f"Running: small GETs with {num_writers} clients overwriting {value_size // 1024}KB values...")
+    single_client_task(host, port, "SET small v\n", 1)
+    stop = False
+
+    def writer(idx):
+        command = f"SET big_{idx} {'v' * value_size}\n".encode()
+        with socket.create_connection((host, port), timeout=5) as s:
+            while not stop:
+                s.sendall(command)
+                s.recv(1024)
+
+    with ThreadPoolExecutor(max_workers=num_writers + num_readers) as executor:
+        writers = [executor.submit(writer, i) for i in range(num_writers)]
+        time.sleep(0.5) # let the writers fill the keys so every SET is an overwrite
+        start_time = time.perf_counter()
+        readers = [
+            executor.submit(single_client_task, host, port, "GET small\n", req_per_reader)
+            for _ in range(num_readers)
+        ]
+        all_latencies = []
+        for f in readers:
+            all_latencies.extend(f.result())
+        total_duration = time.perf_counter() - start_time
+        stop = True
+        for f in writers:
+            f.result()
+
+    return {
+        "Test": "GET under large overwrites",
+        "Clients": num_readers,
+        "Total Req": len(all_latencies),
+        "Throughput (req/s)": f"{len(all_latencies) / total_duration:.2f}",
+        "Avg Latency (ms)": f"{statistics.mean(all_latencies)*1000:.3f}",
+        "P99 Latency (ms)": f"{statistics.quantiles(all_latencies, n=100)[98]*1000:.3f}"
+    }
+
+
+def run_bulk_load_test(host, port, value_size=200 * 1024, pipeline_depth=64, num_clients=8, req_per_client=2000):
+    print(f"Running: PINGs with one client pipelining {value_size // 1024}KB SETs...")
+    stop = False
+
+    def bulk_loader():
+        command = f"SET bulk {'v' * value_size}\n".encode()
+        with socket.create_connection((host, port), timeout=5) as s:
+            in_flight = 0
+            while not stop:
+                # Keep pipeline_depth SETs queued, read replies only to make room
+                while in_flight < pipeline_depth:
+                    s.sendall(command)
+                    in_flight += 1
+                in_flight -= s.recv(65536).count(b"\n")
+
+    with ThreadPoolExecutor(max_workers=num_clients + 1) as executor:
+        loader = executor.submit(bulk_loader)
+        time.sleep(0.5) # let the loader build up its backlog
+        start_time = time.perf_counter()
+        clients = [
+            executor.submit(single_client_task, host, port, "PING\n", req_per_client)
+            for _ in range(num_clients)
+        ]
+        all_latencies = []
+        for f in clients:
+            all_latencies.extend(f.result())
+        total_duration = time.perf_counter() - start_time
+        stop = True
+        loader.result()
+
+    return {
+        "Test": "PING next to bulk loader",
+        "Clients": num_clients,
+        "Total Req": len(all_latencies),
+        "Throughput (req/s)": f"{len(all_latencies) / total_duration:.2f}",
+        "Avg Latency (ms)": f"{statistics.mean(all_latencies)*1000:.3f}",
+        "P99 Latency (ms)": f"{statistics.quantiles(all_latencies, n=100)[98]*1000:.3f}"
+    }
+
+
 if __name__ == "__main__":
-    HOST, PORT = "127.0.0.1", 12345
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=12345)
+    parser.add_argument("--workload", choices=["default", "large-overwrite", "bulk-load"], default="default")
+    args = parser.parse_args()
+    HOST, PORT = args.host, args.port
+
+    if args.workload == "large-overwrite":
+        print_results([run_large_overwrite_test(HOST, PORT)])
+        raise SystemExit(0)
+    if args.workload == "bulk-load":
+        print_results([run_bulk_load_test(HOST, PORT)])
+        raise SystemExit(0)
 
     previous_results = load_baseline()
 
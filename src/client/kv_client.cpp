@@ -1,2 +1,366 @@
-// Simple CLI client to talk to the server.
-// Client logic will be implemented here
+#include "kv_client.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+size_t parse_count(std::string_view text, std::string_view reply) {
+    size_t count = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), count);
+    if (ec != std::errc{})
+        throw ClientError{"malformed reply '" + std::string{reply} + "'"};
+    return count;
+}
+
+} // namespace
+
+NodeClient::NodeClient(const ClusterNode& node) : node_(node) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* found = nullptr;
+    if (int err = ::getaddrinfo(node.host.c_str(), std::to_string(node.port).c_str(), &hints, &found); err != 0)
+        throw ClientError{"can't resolve " + node.host + ": " + ::gai_strerror(err)};
+    int err = 0;
+    for (addrinfo* address = found; address && !socket_.valid(); address = address->ai_next) {
+        Socket socket{::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol)};
+        if (socket.valid() && ::connect(socket.fd(), address->ai_addr, address->ai_addrlen) == 0)
+            socket_ = std::move(socket);
+        else
+            err = errno;
+    }
+    ::freeaddrinfo(found);
+    if (!socket_.valid())
+        throw ClientError{"can't connect to " + node.address() + ": " + std::strerror(err)};
+    // One small request at a time, don't let it wait for an ACK
+    int one = 1;
+    ::setsockopt(socket_.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+void NodeClient::send_line(std::string_view line) {
+    std::string request;
+    request.reserve(line.size() + 1);
+    request += line;
+    request += '\n';
+    send(request);
+}
+
+Reply NodeClient::receive() {
+    std::string line = read_line();
+    if (line.empty())
+        throw ClientError{"empty reply from " + node_.address()};
+    Reply reply{line[0], line.substr(1), {}};
+    switch (reply.type) {
+    case '+': case '-': case '$': case ':': case '_':
+        break;
+    case '*': {
+        size_t count = parse_count(reply.text, line);
+        reply.elements.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            std::string element = read_line();
+            if (element == "_")
+                reply.elements.emplace_back(std::nullopt);
+            else if (!element.empty() && element[0] == '$')
+                reply.elements.emplace_back(element.substr(1));
+            else
+                throw ClientError{"malformed array element '" + element + "'"};
+        }
+        reply.text.clear();
+        break;
+    }
+    case '=': case '~': {
+        // "~size uncompressed_size" for a compressed blob, the bytes are kept as sent
+        reply.text = read_bytes(parse_count(reply.text, line));
+        read_bytes(1);
+        break;
+    }
+    default:
+        throw ClientError{"unexpected reply '" + line + "' from " + node_.address()};
+    }
+    return reply;
+}
+
+void NodeClient::send(std::string_view bytes) {
+    while (!bytes.empty()) {
+        ssize_t sent = ::send(socket_.fd(), bytes.data(), bytes.size(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0)
+            throw ClientError{"can't send to " + node_.address() + ": " + std::strerror(errno)};
+        bytes.remove_prefix(static_cast<size_t>(sent));
+    }
+}
+
+std::string NodeClient::read_line() {
+    size_t end;
+    while ((end = buffer_.find('\n', consumed_)) == std::string::npos)
+        fill();
+    std::string line = buffer_.substr(consumed_, end - consumed_);
+    consumed_ = end + 1;
+    return line;
+}
+
+std::string NodeClient::read_bytes(size_t size) {
+    while (buffer_.size() - consumed_ < size)
+        fill();
+    std::string bytes = buffer_.substr(consumed_, size);
+    consumed_ += size;
+    return bytes;
+}
+
+void NodeClient::fill() {
+    // Drop what was consumed before growing the buffer
+    buffer_.erase(0, consumed_);
+    consumed_ = 0;
+    size_t used = buffer_.size();
+    buffer_.resize(used + 64 * 1024);
+    ssize_t got;
+    do {
+        got = ::recv(socket_.fd(), buffer_.data() + used, buffer_.size() - used, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) {
+        buffer_.resize(used);
+        throw ClientError{got == 0 ? node_.address() + " closed the connection" :
+                                     "can't read from " + node_.address() + ": " + std::strerror(errno)};
+    }
+    buffer_.resize(used + static_cast<size_t>(got));
+}
+
+ClusterClient::ClusterClient(std::vector<ClusterNode> seeds) : seeds_(std::move(seeds)) {
+    if (seeds_.empty())
+        throw ClientError{"no cluster nodes given"};
+    refresh_slots();
+}
+
+Reply ClusterClient::execute(std::string_view line) {
+    Command command = Protocol::parse(line);
+    if (auto* mget_command = std::get_if<MGet>(&command)) {
+        Reply reply{'*', "", mget(mget_command->keys)};
+        return reply;
+    }
+    if (auto* mset_command = std::get_if<MSet>(&command)) {
+        mset(mset_command->pairs);
+        return {'+', "OK", {}};
+    }
+    if (std::holds_alternative<NoOp>(command))
+        return {'_', "", {}};
+    if (std::holds_alternative<SetBlob>(command) || std::holds_alternative<Load>(command))
+        throw ClientError{"commands with a payload can't be sent as a line"};
+
+    std::optional<uint16_t> slot;
+    for_each_key(command, [&slot](std::string_view key) {
+        if (!slot)
+            slot = SlotMap::slot_of(key);
+    });
+    if (slot)
+        return call(*slot, line);
+    ClusterNode first = slots_.nodes().front();
+    try {
+        return connection(first).call(line);
+    } catch (const ClientError&) {
+        forget(first);
+        throw;
+    }
+}
+
+std::optional<std::string> ClusterClient::get(std::string_view key) {
+    Reply reply = call(SlotMap::slot_of(key), "GET " + std::string{key});
+    if (reply.type == '$')
+        return std::move(reply.text);
+    if (reply.is_error() && reply.text == "ERR key not found")
+        return std::nullopt;
+    throw ClientError{"GET " + std::string{key} + ": " + reply.text};
+}
+
+void ClusterClient::set(std::string_view key, std::string_view value) {
+    Reply reply = call(SlotMap::slot_of(key), "SET " + std::string{key} + " " + std::string{value});
+    if (reply.is_error())
+        throw ClientError{"SET " + std::string{key} + ": " + reply.text};
+}
+
+std::vector<std::optional<std::string>> ClusterClient::mget(const std::vector<std::string>& keys) {
+    std::vector<std::optional<std::string>> values(keys.size());
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+    std::vector<size_t> indexes(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+        indexes[i] = i;
+    fan_out(views, std::move(indexes),
+        [&keys](const std::vector<size_t>& batch) {
+            std::string line = "MGET";
+            for (size_t i : batch)
+                line += " " + keys[i];
+            return line;
+        },
+        [&values](const std::vector<size_t>& batch, Reply& reply) {
+            if (reply.type != '*' || reply.elements.size() != batch.size())
+                throw ClientError{"MGET: " + (reply.is_error() ? reply.text : "unexpected reply")};
+            for (size_t i = 0; i < batch.size(); ++i)
+                values[batch[i]] = std::move(reply.elements[i]);
+        });
+    return values;
+}
+
+void ClusterClient::mset(const std::vector<std::pair<std::string, std::string>>& pairs) {
+    std::vector<std::string_view> keys;
+    std::vector<size_t> indexes(pairs.size());
+    keys.reserve(pairs.size());
+    for (size_t i = 0; i < pairs.size(); ++i) {
+        keys.push_back(pairs[i].first);
+        indexes[i] = i;
+    }
+    fan_out(keys, std::move(indexes),
+        [&pairs](const std::vector<size_t>& batch) {
+            std::string line = "MSET";
+            for (size_t i : batch)
+                line += " " + pairs[i].first + " " + pairs[i].second;
+            return line;
+        },
+        [](const std::vector<size_t>&, const Reply& reply) {
+            if (reply.is_error())
+                throw ClientError{"MSET: " + reply.text};
+        });
+}
+
+void ClusterClient::refresh_slots() {
+    // The nodes we know of first, then the seeds
+    std::vector<ClusterNode> candidates = slots_.nodes();
+    candidates.insert(candidates.end(), seeds_.begin(), seeds_.end());
+    std::string last_error;
+    for (const ClusterNode& node : candidates) {
+        try {
+            Reply reply = connection(node).call("CLUSTER SLOTS");
+            if (reply.type != '*') {
+                last_error = node.address() + ": " + reply.text;
+                continue;
+            }
+            std::vector<std::string> lines;
+            for (auto& element : reply.elements)
+                lines.push_back(element.value_or(""));
+            slots_ = SlotMap::from_description(lines);
+            return;
+        } catch (const ClientError& e) {
+            forget(node);
+            last_error = e.what();
+        } catch (const ClusterError& e) {
+            last_error = node.address() + ": " + e.what();
+        }
+    }
+    throw ClientError{"no cluster node sent its slot map, last error: " + last_error};
+}
+
+Reply ClusterClient::call(uint16_t slot, std::string_view line) {
+    for (int redirects = 0;; ++redirects) {
+        const ClusterNode* owner = slots_.owner(slot);
+        if (!owner) {
+            refresh_slots();
+            owner = slots_.owner(slot);
+            if (!owner)
+                throw ClientError{"slot " + std::to_string(slot) + " has no node"};
+        }
+        ClusterNode node = *owner;
+        Reply reply;
+        try {
+            reply = connection(node).call(line);
+        } catch (const ClientError&) {
+            forget(node);
+            throw;
+        }
+        if (redirects == MAX_REDIRECTS || !follow(reply))
+            return reply;
+    }
+}
+
+NodeClient& ClusterClient::connection(const ClusterNode& node) {
+    std::unique_ptr<NodeClient>& client = connections_[node.address()];
+    if (!client)
+        client = std::make_unique<NodeClient>(node);
+    return *client;
+}
+
+bool ClusterClient::follow(const Reply& reply) {
+    // "MOVED <slot> <host:port>"
+    if (!reply.is_error() || !reply.text.starts_with("MOVED "))
+        return false;
+    std::string_view rest = std::string_view{reply.text}.substr(6);
+    size_t space = rest.find(' ');
+    if (space == std::string_view::npos)
+        throw ClientError{"malformed redirect '" + reply.text + "'"};
+    slots_.reassign(static_cast<uint16_t>(parse_count(rest.substr(0, space), reply.text)),
+                    ClusterNode::parse(rest.substr(space + 1)));
+    // A moved slot means the map we have is stale, most likely not just for this slot
+    refresh_slots();
+    return true;
+}
+
+template <typename MakeLine, typename OnReply>
+void ClusterClient::fan_out(const std::vector<std::string_view>& keys, std::vector<size_t> indexes,
+                            MakeLine make_line, OnReply on_reply) {
+    for (int redirects = 0; !indexes.empty(); ++redirects) {
+        if (redirects > MAX_REDIRECTS)
+            throw ClientError{"too many redirects"};
+        // The indexes of the keys each node serves
+        std::map<std::string, std::pair<ClusterNode, std::vector<size_t>>> by_node;
+        for (size_t i : indexes) {
+            const ClusterNode* owner = slots_.owner_of(keys[i]);
+            if (!owner) {
+                refresh_slots();
+                owner = slots_.owner_of(keys[i]);
+                if (!owner)
+                    throw ClientError{"slot " + std::to_string(SlotMap::slot_of(keys[i])) + " has no node"};
+            }
+            auto& entry = by_node[owner->address()];
+            entry.first = *owner;
+            entry.second.push_back(i);
+        }
+
+        // One request per node and round is out at a time, as replies on one
+        // connection may be reordered. Each round the nodes work in parallel.
+        std::vector<size_t> moved;
+        for (size_t offset = 0;; offset += BATCH_KEYS) {
+            std::vector<std::pair<NodeClient*, std::vector<size_t>>> pending;
+            std::vector<Reply> replies;
+            try {
+                for (auto& [address, entry] : by_node) {
+                    std::vector<size_t>& mine = entry.second;
+                    if (offset >= mine.size())
+                        continue;
+                    auto first = mine.begin() + static_cast<ptrdiff_t>(offset);
+                    std::vector<size_t> batch(first, first + static_cast<ptrdiff_t>(std::min(BATCH_KEYS, mine.size() - offset)));
+                    NodeClient& client = connection(entry.first);
+                    client.send_line(make_line(batch));
+                    pending.emplace_back(&client, std::move(batch));
+                }
+                for (auto& [client, batch] : pending)
+                    replies.push_back(client->receive());
+            } catch (const ClientError&) {
+                // Other connections may have replies coming that nobody will read
+                connections_.clear();
+                throw;
+            }
+            if (pending.empty())
+                break;
+            for (size_t i = 0; i < pending.size(); ++i) {
+                std::vector<size_t>& batch = pending[i].second;
+                if (replies[i].is_error() && replies[i].text.starts_with("MOVED "))
+                    moved.insert(moved.end(), batch.begin(), batch.end());
+                else
+                    on_reply(batch, replies[i]);
+            }
+        }
+        if (!moved.empty())
+            refresh_slots();
+        indexes = std::move(moved);
+    }
+}
+
+} // namespace kv
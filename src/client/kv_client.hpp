@@ -0,0 +1,119 @@
+#pragma once
+
+#include "kv/cluster.hpp"
+#include "kv/socket.hpp"
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace kv {
+
+// Raised when a node can't be reached or sends something that is not a reply
+class ClientError : public std::runtime_error {
+public:
+    explicit ClientError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+// One reply, as the server sent it
+struct Reply {
+    // The reply's first byte: + - $ : _ * = ~
+    char type = '_';
+    // The rest of the line, or the bytes of a = / ~ blob
+    std::string text;
+    // The values of a * array, nullopt for _
+    std::vector<std::optional<std::string>> elements;
+
+    bool is_error() const noexcept { return type == '-'; }
+};
+
+/*
+ * A blocking connection to one server. Sends one request at a time and
+ * waits for its reply: with shared workers, replies to pipelined requests
+ * may come back in any order.
+ */
+class NodeClient {
+public:
+    // Throws ClientError
+    explicit NodeClient(const ClusterNode& node);
+
+    // A command line without the \n. Throws ClientError.
+    Reply call(std::string_view line) {
+        send_line(line);
+        return receive();
+    }
+    // The two halves of call(), to have requests to several nodes out at once
+    void send_line(std::string_view line);
+    Reply receive();
+
+private:
+    void send(std::string_view bytes);
+    std::string read_line();
+    std::string read_bytes(size_t size);
+    // Reads more into buffer_, throws if the server closed the connection
+    void fill();
+
+    ClusterNode node_;
+    Socket socket_;
+    std::string buffer_;
+    size_t consumed_ = 0;
+};
+
+/*
+ * Client for a cluster of kv_server nodes.
+ *
+ * Keeps the slot map from CLUSTER SLOTS and sends each command straight to
+ * the node serving its key. A MOVED reply updates the map and the command
+ * is retried. MGET and MSET are split into one command per node, sent to
+ * all of them before any reply is read, so the nodes work in parallel.
+ */
+class ClusterClient {
+public:
+    static constexpr int MAX_REDIRECTS = 5;
+    // Keys per MGET or MSET sent to one node
+    static constexpr size_t BATCH_KEYS = 1000;
+
+    // Learns the slot map from the first seed that answers. Throws ClientError.
+    explicit ClusterClient(std::vector<ClusterNode> seeds);
+
+    // A command line, routed by its keys. Keyless commands go to the first node.
+    // Throws ProtocolError for a line the server would not parse, ClientError.
+    Reply execute(std::string_view line);
+
+    std::optional<std::string> get(std::string_view key);
+    void set(std::string_view key, std::string_view value);
+    // Values in the order of the keys, nullopt for missing ones
+    std::vector<std::optional<std::string>> mget(const std::vector<std::string>& keys);
+    void mset(const std::vector<std::pair<std::string, std::string>>& pairs);
+
+    // Asks the cluster for the current slot map
+    void refresh_slots();
+    const SlotMap& slots() const noexcept { return slots_; }
+
+private:
+    // Sends the line to the node serving the slot and follows MOVED redirects
+    Reply call(uint16_t slot, std::string_view line);
+    NodeClient& connection(const ClusterNode& node);
+    // The slot map update for a MOVED reply, false if the reply is something else
+    bool follow(const Reply& reply);
+    // Sends one command per node for the keys at `indexes` it serves, then
+    // reads every reply. make_line(indexes) builds a node's command from the
+    // indexes of its keys, on_reply(indexes, reply) takes the reply. Keys of
+    // a MOVED reply are sent again once the map is refreshed.
+    template <typename MakeLine, typename OnReply>
+    void fan_out(const std::vector<std::string_view>& keys, std::vector<size_t> indexes, MakeLine make_line,
+                 OnReply on_reply);
+    void forget(const ClusterNode& node) { connections_.erase(node.address()); }
+
+    std::vector<ClusterNode> seeds_;
+    SlotMap slots_;
+    std::map<std::string, std::unique_ptr<NodeClient>> connections_; // by "host:port"
+};
+
+} // namespace kv
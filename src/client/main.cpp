@@ -1,6 +1,93 @@
+#include "kv_client.hpp"
 
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
-// Client entry point.
-int main() {
-    return 0;
+/*
+ * Command line client.
+ *
+ * Usage: kv_client [--cluster] host:port[,host:port...] [command args...]
+ *
+ * Runs the command given after the address, or one command per line read
+ * from stdin. With --cluster the addresses are seed nodes of a cluster and
+ * every command goes to the node serving its keys. Exits with 1 if a
+ * command failed.
+ */
+
+namespace {
+
+void print(const kv::Reply& reply) {
+    switch (reply.type) {
+    case '-':
+        std::cout << "(error) " << reply.text << "\n";
+        break;
+    case '_':
+        std::cout << "(nil)\n";
+        break;
+    case '*':
+        for (const auto& element : reply.elements)
+            std::cout << (element ? *element : "(nil)") << "\n";
+        break;
+    default:
+        std::cout << reply.text << "\n";
+        break;
+    }
+}
+
+std::vector<kv::ClusterNode> parse_nodes(std::string_view list) {
+    std::vector<kv::ClusterNode> nodes;
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        nodes.push_back(kv::ClusterNode::parse(list.substr(0, comma)));
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+    return nodes;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    bool cluster = !args.empty() && args.front() == "--cluster";
+    if (cluster)
+        args.erase(args.begin());
+    if (args.empty()) {
+        std::cerr << "Usage: kv_client [--cluster] host:port[,host:port...] [command args...]\n";
+        return 2;
+    }
+
+    try {
+        std::vector<kv::ClusterNode> nodes = parse_nodes(args.front());
+        std::unique_ptr<kv::ClusterClient> cluster_client;
+        std::unique_ptr<kv::NodeClient> node_client;
+        if (cluster)
+            cluster_client = std::make_unique<kv::ClusterClient>(nodes);
+        else
+            node_client = std::make_unique<kv::NodeClient>(nodes.front());
+
+        bool failed = false;
+        auto run = [&](std::string_view line) {
+            kv::Reply reply = cluster_client ? cluster_client->execute(line) : node_client->call(line);
+            print(reply);
+            failed |= reply.is_error();
+        };
+        if (args.size() > 1) {
+            std::string line{args[1]};
+            for (size_t i = 2; i < args.size(); ++i)
+                line += " " + std::string{args[i]};
+            run(line);
+        } else {
+            for (std::string line; std::getline(std::cin, line);) {
+                if (!line.empty())
+                    run(line);
+            }
+        }
+        return failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
 }
@@ -0,0 +1,125 @@
+#include "kv/bulk.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+uint32_t read32(const char* p) noexcept {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void write32(char* p, uint32_t value) noexcept {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+std::string error_text(const std::string& what, int err) {
+    return what + ": " + std::strerror(err);
+}
+
+} // namespace
+
+void BulkFormat::append(std::string& out, std::string_view key, std::string_view value) {
+    if (key.empty() || key.size() > UINT32_MAX || value.size() > UINT32_MAX)
+        throw BulkError{"key or value can't be written as a bulk record"};
+    char header[HEADER_BYTES];
+    write32(header, static_cast<uint32_t>(key.size()));
+    write32(header + sizeof(uint32_t), static_cast<uint32_t>(value.size()));
+    out.append(header, HEADER_BYTES);
+    out += key;
+    out += value;
+}
+
+std::vector<BulkRecord> BulkFormat::decode(std::string_view stream) {
+    std::vector<BulkRecord> records;
+    // Most streams are many small records, don't regrow from 1
+    records.reserve(std::min<size_t>(stream.size() / (HEADER_BYTES + 16) + 1, size_t{1} << 20));
+    const char* pos = stream.data();
+    const char* end = stream.data() + stream.size();
+    while (pos != end) {
+        if (static_cast<size_t>(end - pos) < HEADER_BYTES)
+            throw BulkError{"bulk stream cut short"};
+        size_t key_size = read32(pos);
+        size_t value_size = read32(pos + sizeof(uint32_t));
+        pos += HEADER_BYTES;
+        if (key_size == 0)
+            throw BulkError{"empty key in bulk stream"};
+        if (static_cast<size_t>(end - pos) < key_size + value_size)
+            throw BulkError{"bulk stream cut short"};
+        records.push_back({{pos, key_size}, {pos + key_size, value_size}});
+        pos += key_size + value_size;
+    }
+    return records;
+}
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw BulkError{error_text("can't open " + path, errno)};
+    struct stat info{};
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        throw BulkError{path + " is not a regular file"};
+    }
+    size_ = static_cast<size_t>(info.st_size);
+    if (size_ > 0) {
+        void* mapped = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw BulkError{error_text("can't map " + path, err)};
+        }
+        ::madvise(mapped, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(mapped);
+    }
+    ::close(fd); // the mapping stays valid
+}
+
+MappedFile::~MappedFile() {
+    if (data_)
+        ::munmap(const_cast<char*>(data_), size_);
+}
+
+BulkFileWriter::BulkFileWriter(std::string path)
+    : path_(std::move(path)), temporary_path_(path_ + ".tmp") {
+    fd_ = ::open(temporary_path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd_ < 0)
+        throw BulkError{error_text("can't create " + temporary_path_, errno)};
+}
+
+BulkFileWriter::~BulkFileWriter() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        ::unlink(temporary_path_.c_str());
+    }
+}
+
+void BulkFileWriter::write(std::string_view bytes) {
+    while (!bytes.empty()) {
+        ssize_t n = ::write(fd_, bytes.data(), bytes.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw BulkError{error_text("can't write " + temporary_path_, errno)};
+        bytes.remove_prefix(static_cast<size_t>(n));
+    }
+}
+
+void BulkFileWriter::commit() {
+    // On disk before it replaces an older dump
+    if (::fsync(fd_) != 0 || ::rename(temporary_path_.c_str(), path_.c_str()) != 0)
+        throw BulkError{error_text("can't write " + path_, errno)};
+    ::close(fd_);
+    fd_ = -1;
+}
+
+} // namespace kv
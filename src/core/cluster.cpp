@@ -0,0 +1,148 @@
+#include "kv/cluster.hpp"
+
+#include <array>
+#include <charconv>
+
+namespace kv {
+
+namespace {
+
+// CRC16-CCITT (XMODEM): polynomial 0x1021, initial value 0, as Redis Cluster uses
+constexpr std::array<uint16_t, 256> make_crc16_table() {
+    std::array<uint16_t, 256> table{};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint16_t crc = static_cast<uint16_t>(byte << 8);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+        table[byte] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint16_t, 256> CRC16_TABLE = make_crc16_table();
+
+uint16_t crc16(std::string_view bytes) noexcept {
+    uint16_t crc = 0;
+    for (unsigned char byte : bytes)
+        crc = static_cast<uint16_t>((crc << 8) ^ CRC16_TABLE[((crc >> 8) ^ byte) & 0xff]);
+    return crc;
+}
+
+uint16_t parse_slot(std::string_view text) {
+    uint32_t slot = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), slot);
+    if (text.empty() || ec != std::errc{} || ptr != text.data() + text.size() || slot >= SlotMap::SLOTS)
+        throw ClusterError{"invalid slot '" + std::string{text} + "', slots are 0-" + std::to_string(SlotMap::SLOTS - 1)};
+    return static_cast<uint16_t>(slot);
+}
+
+std::string format_range(size_t first, size_t last) {
+    return first == last ? std::to_string(first) : std::to_string(first) + "-" + std::to_string(last);
+}
+
+} // namespace
+
+ClusterNode ClusterNode::parse(std::string_view address) {
+    size_t colon = address.rfind(':');
+    uint16_t port = 0;
+    if (colon == 0 || colon == std::string_view::npos)
+        throw ClusterError{"expected host:port, got '" + std::string{address} + "'"};
+    std::string_view digits = address.substr(colon + 1);
+    auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), port);
+    if (digits.empty() || ec != std::errc{} || ptr != digits.data() + digits.size() || port == 0)
+        throw ClusterError{"invalid port in '" + std::string{address} + "'"};
+    return {std::string{address.substr(0, colon)}, port};
+}
+
+uint16_t SlotMap::slot_of(std::string_view key) noexcept {
+    // Only the first {...} counts, and only if something is between the braces
+    size_t open = key.find('{');
+    if (open != std::string_view::npos) {
+        size_t close = key.find('}', open + 1);
+        if (close != std::string_view::npos && close > open + 1)
+            key = key.substr(open + 1, close - open - 1);
+    }
+    return crc16(key) % SLOTS;
+}
+
+void SlotMap::assign(const ClusterNode& node, std::string_view ranges) {
+    uint16_t index = index_of(node);
+    while (!ranges.empty()) {
+        size_t comma = ranges.find(',');
+        std::string_view range = ranges.substr(0, comma);
+        ranges = comma == std::string_view::npos ? std::string_view{} : ranges.substr(comma + 1);
+
+        size_t dash = range.find('-');
+        uint16_t first = parse_slot(range.substr(0, dash));
+        uint16_t last = dash == std::string_view::npos ? first : parse_slot(range.substr(dash + 1));
+        if (last < first)
+            throw ClusterError{"invalid slot range '" + std::string{range} + "'"};
+        for (size_t slot = first; slot <= last; ++slot) {
+            if (owners_[slot] != NO_NODE && owners_[slot] != index)
+                throw ClusterError{"slot " + std::to_string(slot) + " is given to both " +
+                                   nodes_[owners_[slot]].address() + " and " + node.address()};
+            owners_[slot] = index;
+        }
+    }
+}
+
+void SlotMap::reassign(uint16_t slot, const ClusterNode& node) {
+    owners_[slot % SLOTS] = index_of(node);
+}
+
+const ClusterNode* SlotMap::owner(uint16_t slot) const noexcept {
+    uint16_t index = owners_[slot % SLOTS];
+    return index == NO_NODE ? nullptr : &nodes_[index];
+}
+
+std::string SlotMap::unassigned() const {
+    std::string ranges;
+    for (size_t slot = 0; slot < SLOTS; ++slot) {
+        if (owners_[slot] != NO_NODE)
+            continue;
+        size_t last = slot;
+        while (last + 1 < SLOTS && owners_[last + 1] == NO_NODE)
+            ++last;
+        if (!ranges.empty())
+            ranges += ',';
+        ranges += format_range(slot, last);
+        slot = last;
+    }
+    return ranges;
+}
+
+std::vector<std::string> SlotMap::describe() const {
+    std::vector<std::string> lines;
+    for (size_t slot = 0; slot < SLOTS; ++slot) {
+        uint16_t index = owners_[slot];
+        size_t last = slot;
+        while (last + 1 < SLOTS && owners_[last + 1] == index)
+            ++last;
+        if (index != NO_NODE)
+            lines.push_back(std::to_string(slot) + "-" + std::to_string(last) + " " + nodes_[index].address());
+        slot = last;
+    }
+    return lines;
+}
+
+SlotMap SlotMap::from_description(const std::vector<std::string>& lines) {
+    SlotMap map;
+    for (const std::string& line : lines) {
+        size_t space = line.find(' ');
+        if (space == std::string::npos)
+            throw ClusterError{"expected 'slots host:port', got '" + line + "'"};
+        map.assign(ClusterNode::parse(std::string_view{line}.substr(space + 1)), std::string_view{line}.substr(0, space));
+    }
+    return map;
+}
+
+uint16_t SlotMap::index_of(const ClusterNode& node) {
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        if (nodes_[i] == node)
+            return static_cast<uint16_t>(i);
+    }
+    nodes_.push_back(node);
+    return static_cast<uint16_t>(nodes_.size() - 1);
+}
+
+} // namespace kv
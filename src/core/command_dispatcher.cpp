@@ -1,9 +1,23 @@
 
 #include "kv/command_dispatcher.hpp"
 
+#include <algorithm>
+
 namespace kv {
 
-std::string CommandDispatcher::execute(const Command& command, KvStore& store) {
+template <StorageEngine Engine>
+std::string CommandDispatcher::execute(const Command& command, Engine& store) {
+    try {
+        return dispatch(command, store);
+    } catch (const StoreError& e) {
+        return Protocol::format_error(e.what());
+    } catch (const BulkError& e) {
+        return Protocol::format_error(e.what());
+    }
+}
+
+template <StorageEngine Engine>
+std::string CommandDispatcher::dispatch(const Command& command, Engine& store) {
     return std::visit([&](const auto& cmd) -> std::string {
         using T = std::decay_t<decltype(cmd)>;
 
@@ -22,12 +36,180 @@ std::string CommandDispatcher::execute(const Command& command, KvStore& store) {
             return success ?
                 Protocol::format_ok() :
                 Protocol::format_error("key not found");
+        } else if constexpr (std::is_same_v<T, Unlink>) {
+            bool success = store.unlink(cmd.key);
+            return success ?
+                Protocol::format_ok() :
+                Protocol::format_error("key not found");
         } else if constexpr (std::is_same_v<T, Ping>) {
             return Protocol::format_value("Pong");
+
+        } else if constexpr (std::is_same_v<T, Incr>) {
+            return Protocol::format_integer(store.incr_by(cmd.key, cmd.delta));
+
+        } else if constexpr (std::is_same_v<T, Append>) {
+            return Protocol::format_integer(static_cast<int64_t>(store.append(cmd.key, cmd.value)));
+
+        } else if constexpr (std::is_same_v<T, GetSet>) {
+            auto previous = store.getset(cmd.key, cmd.value);
+            return previous ? Protocol::format_value(*previous) : Protocol::format_nil();
+
+        } else if constexpr (std::is_same_v<T, SetNx>) {
+            return Protocol::format_integer(store.setnx(cmd.key, cmd.value) ? 1 : 0);
+
+        } else if constexpr (std::is_same_v<T, Gets>) {
+            auto versioned = store.get_versioned(cmd.key);
+            return versioned ?
+                Protocol::format_array({versioned->value, std::to_string(versioned->version)}) :
+                Protocol::format_error("key not found");
+
+        } else if constexpr (std::is_same_v<T, Cas>) {
+            return store.compare_and_set(cmd.key, cmd.version, cmd.value) ?
+                Protocol::format_ok() :
+                Protocol::format_error("version mismatch");
+
+        } else if constexpr (std::is_same_v<T, MGet>) {
+            std::string reply = "*" + std::to_string(cmd.keys.size()) + "\n";
+            for (const std::string& key : cmd.keys) {
+                auto value = store.get(key);
+                reply += value ? Protocol::format_value(*value) : Protocol::format_nil();
+            }
+            return reply;
+
+        } else if constexpr (std::is_same_v<T, MSet>) {
+            // The bulk path: values are built outside the lock, then stored in one batch
+            std::vector<BulkRecord> records;
+            records.reserve(cmd.pairs.size());
+            for (const auto& [key, value] : cmd.pairs)
+                records.push_back({key, value});
+            store.load(records);
+            return Protocol::format_ok();
+
+        } else if constexpr (std::is_same_v<T, Scan> || std::is_same_v<T, Range>) {
+            if (!store.has_ordered_index())
+                return Protocol::format_error("ordered index disabled");
+
+            // One page, however many keys match. The key after it leads the
+            // reply, "" if there is none, and is where the next call starts.
+            size_t page_size = std::min(cmd.limit == 0 ? Protocol::MAX_SCAN_KEYS : cmd.limit, Protocol::MAX_SCAN_KEYS);
+            std::vector<std::string> reply{""};
+            auto collect = [&reply](const std::vector<std::string>& page) {
+                reply.insert(reply.end(), page.begin(), page.end());
+            };
+            if constexpr (std::is_same_v<T, Scan>)
+                store.scan_prefix(cmd.prefix, page_size + 1, collect, cmd.from);
+            else
+                store.scan_range(cmd.start, cmd.end, page_size + 1, collect);
+            if (reply.size() > page_size + 1) {
+                reply.front() = std::move(reply.back());
+                reply.pop_back();
+            }
+            return Protocol::format_array(reply);
+
+        } else if constexpr (std::is_same_v<T, CursorScan>) {
+            // First element is the cursor to continue from, the rest are keys
+            std::vector<std::string> reply{""};
+            reply.front() = std::to_string(store.scan(cmd.cursor, cmd.count, reply));
+            return Protocol::format_array(reply);
+
+        } else if constexpr (std::is_same_v<T, SetBlob>) {
+            if (!cmd.payload)
+                return Protocol::format_error("missing payload");
+            store.set(cmd.key, std::move(*cmd.payload));
+            return Protocol::format_ok();
+
+        } else if constexpr (std::is_same_v<T, GetBlob>) {
+            // Copy the value once, straight into the reply, which is then moved
+            // into the outbox and sent from there
+            std::string reply;
+            auto write_reply = [&reply](std::string_view header, std::string_view bytes) {
+                reply.reserve(header.size() + bytes.size() + 1);
+                reply += header;
+                reply += bytes;
+                reply += '\n';
+            };
+            bool found;
+            if (cmd.compressed) {
+                // The client decompresses, the worker only copies the smaller form
+                found = store.read_stored(cmd.key, [&](std::string_view bytes, size_t uncompressed_size) {
+                    write_reply(uncompressed_size > 0 ?
+                        Protocol::format_compressed_blob_header(bytes.size(), uncompressed_size) :
+                        Protocol::format_blob_header(bytes.size()), bytes);
+                });
+            } else {
+                found = store.read(cmd.key, [&](std::string_view value) {
+                    write_reply(Protocol::format_blob_header(value.size()), value);
+                });
+            }
+            if (!found)
+                return Protocol::format_error("key not found");
+            return reply;
+
+        } else if constexpr (std::is_same_v<T, Load>) {
+            auto load = [&](std::string_view stream) {
+                std::vector<BulkRecord> records = BulkFormat::decode(stream);
+                if (cmd.accepts) {
+                    auto foreign = std::ranges::count_if(records, [&](const BulkRecord& r) { return !cmd.accepts(r.key); });
+                    if (foreign > 0)
+                        return Protocol::format_error(std::to_string(foreign) + " of " + std::to_string(records.size()) +
+                                                      " records are in slots of other nodes, nothing loaded");
+                }
+                return Protocol::format_integer(static_cast<int64_t>(store.load(records)));
+            };
+            if (!cmd.file.empty()) {
+                // Decoded in place, the records point into the mapping
+                MappedFile file{cmd.file};
+                return load(file.bytes());
+            }
+            if (!cmd.payload)
+                return Protocol::format_error("missing payload");
+            return load(cmd.payload->text());
+
+        } else if constexpr (std::is_same_v<T, Dump>) {
+            if (!cmd.file.empty()) {
+                BulkFileWriter file{cmd.file};
+                store.dump([&file](std::string_view records) {
+                    file.write(records);
+                });
+                file.commit();
+                return Protocol::format_ok();
+            }
+            std::string reply;
+            store.dump([&](std::string_view records) {
+                if (cmd.max_size > 0 && reply.size() + records.size() > cmd.max_size)
+                    throw BulkError{"store too large for DUMP, use DUMP FILE"};
+                reply += records;
+            });
+            reply.insert(0, Protocol::format_blob_header(reply.size()));
+            reply += '\n';
+            return reply;
+
+        } else if constexpr (std::is_same_v<T, SlowLog>) {
+            // The reactor answers it, the store has no slow log
+            return Protocol::format_error("SLOWLOG is not available here");
+
+        } else if constexpr (std::is_same_v<T, ClusterSlots>) {
+            // Like SLOWLOG, the server knows the cluster, the store doesn't
+            return Protocol::format_error("CLUSTER is not available here");
+
+        } else if constexpr (std::is_same_v<T, Workers>) {
+            return Protocol::format_error("WORKERS is not available here");
+
+        } else if constexpr (std::is_same_v<T, HotKeys>) {
+            std::vector<std::string> reply;
+            for (const HotKey& hot : store.hot_keys(cmd.count)) {
+                reply.push_back(hot.key);
+                reply.push_back(std::to_string(hot.count));
+            }
+            return Protocol::format_array(reply);
+
         } else if constexpr (std::is_same_v<T, NoOp>) {
             return "";
         }
     }, command);
 }
 
+template std::string CommandDispatcher::execute(const Command&, KvStore&);
+template std::string CommandDispatcher::execute(const Command&, LogStore&);
+
 } // namespace kv
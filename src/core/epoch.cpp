@@ -0,0 +1,169 @@
+#include "kv/epoch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kv {
+
+namespace {
+
+// Announced by threads that are not inside an EpochGuard
+constexpr uint64_t IDLE = 0;
+
+// One per reader thread, on its own cache line so announcing never bounces
+struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch{IDLE};
+    std::atomic<bool> in_use{true};
+    ReaderSlot* next = nullptr; // fixed once the slot is published
+};
+
+struct RetiredObject {
+    void* ptr;
+    Epoch::Deleter deleter;
+    uint64_t epoch;
+};
+
+class Domain {
+public:
+    ReaderSlot& acquire_slot() {
+        // Reuse a slot left behind by an exited thread
+        for (ReaderSlot* slot = slots_.load(std::memory_order_acquire); slot; slot = slot->next) {
+            bool expected = false;
+            if (slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return *slot;
+        }
+
+        auto* slot = new ReaderSlot;
+        std::lock_guard lock(mutex_);
+        slot->next = slots_.load(std::memory_order_relaxed);
+        slots_.store(slot, std::memory_order_release);
+        return *slot;
+    }
+
+    void enter(ReaderSlot& slot) noexcept {
+        slot.epoch.store(global_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        // Pairs with the fence in reclaim(): either the writer sees this slot,
+        // or our following loads see everything it unlinked before retiring
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void leave(ReaderSlot& slot) noexcept {
+        slot.epoch.store(IDLE, std::memory_order_release);
+    }
+
+    void retire(void* ptr, Epoch::Deleter deleter) {
+        bool due = false;
+        {
+            std::lock_guard lock(mutex_);
+            retired_.push_back({ptr, deleter, global_.load(std::memory_order_relaxed)});
+            pending_.store(retired_.size(), std::memory_order_relaxed);
+            if (++since_reclaim_ >= Epoch::RECLAIM_INTERVAL) {
+                since_reclaim_ = 0;
+                due = true;
+            }
+        }
+        if (due)
+            reclaim();
+    }
+
+    size_t reclaim() {
+        std::vector<RetiredObject> ready;
+        {
+            std::lock_guard lock(mutex_);
+            uint64_t oldest = global_.fetch_add(1, std::memory_order_seq_cst) + 1;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for (ReaderSlot* slot = slots_.load(std::memory_order_acquire); slot; slot = slot->next) {
+                uint64_t announced = slot->epoch.load(std::memory_order_acquire);
+                if (announced != IDLE)
+                    oldest = std::min(oldest, announced);
+            }
+
+            // Readers that announced a later epoch started after the object was unlinked
+            auto still_visible = std::partition(retired_.begin(), retired_.end(),
+                [oldest](const RetiredObject& object) { return object.epoch >= oldest; });
+            ready.assign(still_visible, retired_.end());
+            retired_.erase(still_visible, retired_.end());
+            pending_.store(retired_.size(), std::memory_order_relaxed);
+        }
+
+        // Deleters may retire more objects, so run them without the lock
+        for (const RetiredObject& object : ready)
+            object.deleter(object.ptr);
+        return ready.size();
+    }
+
+    size_t pending() const noexcept {
+        return pending_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> global_{IDLE + 1};
+    std::atomic<ReaderSlot*> slots_{nullptr}; // push-only, slots are never freed
+    std::mutex mutex_; // guards retired_ and slot registration
+    std::vector<RetiredObject> retired_;
+    size_t since_reclaim_ = 0;
+    std::atomic<size_t> pending_{0};
+};
+
+Domain& domain() {
+    // Leaked on purpose: detached threads may still retire or read during exit
+    static Domain* instance = new Domain;
+    return *instance;
+}
+
+// This thread's slot, handed back for reuse when the thread exits
+class ReaderHandle {
+public:
+    ReaderHandle() : slot_(domain().acquire_slot()) {}
+
+    ~ReaderHandle() {
+        domain().leave(slot_);
+        slot_.in_use.store(false, std::memory_order_release);
+    }
+
+    void enter() noexcept {
+        if (depth_++ == 0)
+            domain().enter(slot_);
+    }
+
+    void leave() noexcept {
+        if (--depth_ == 0)
+            domain().leave(slot_);
+    }
+
+private:
+    ReaderSlot& slot_;
+    size_t depth_ = 0;
+};
+
+ReaderHandle& reader() {
+    thread_local ReaderHandle handle;
+    return handle;
+}
+
+} // namespace
+
+void Epoch::retire(void* ptr, Deleter deleter) {
+    domain().retire(ptr, deleter);
+}
+
+size_t Epoch::reclaim() {
+    return domain().reclaim();
+}
+
+size_t Epoch::pending() noexcept {
+    return domain().pending();
+}
+
+EpochGuard::EpochGuard() {
+    reader().enter();
+}
+
+EpochGuard::~EpochGuard() {
+    reader().leave();
+}
+
+} // namespace kv
@@ -0,0 +1,48 @@
+#include "kv/frequency_sketch.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace kv {
+
+FrequencySketch::FrequencySketch(size_t blocks)
+    : blocks_(std::make_unique<Block[]>(std::bit_ceil(std::max<size_t>(blocks, 1)))),
+      mask_(std::bit_ceil(std::max<size_t>(blocks, 1)) - 1) {}
+
+FrequencySketch::Slots FrequencySketch::slots_of(uint32_t key_hash) const noexcept {
+    // Spread the 32 bits over 64, the table only needed its low ones to be good
+    uint64_t hash = key_hash * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+
+    Slots slots{&blocks_[(hash >> 16) & mask_], {}};
+    // The top 16 bits pick one counter per row, the block comes from the ones below
+    for (size_t row = 0; row < ROWS; ++row)
+        slots.counters[row] = row * ROW_COUNTERS + ((hash >> (48 + 4 * row)) & (ROW_COUNTERS - 1));
+    return slots;
+}
+
+void FrequencySketch::record(uint32_t key_hash) noexcept {
+    Slots slots = slots_of(key_hash);
+    for (size_t counter : slots.counters) {
+        std::atomic<uint8_t>& count = slots.block->counters[counter];
+        uint8_t current = count.load(std::memory_order_relaxed);
+        if (current < MAX_COUNT)
+            count.store(current + 1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t FrequencySketch::estimate(uint32_t key_hash) const noexcept {
+    Slots slots = slots_of(key_hash);
+    uint8_t smallest = MAX_COUNT;
+    for (size_t counter : slots.counters)
+        smallest = std::min(smallest, slots.block->counters[counter].load(std::memory_order_relaxed));
+    return smallest;
+}
+
+void FrequencySketch::decay() noexcept {
+    for (size_t i = 0; i <= mask_; ++i)
+        for (std::atomic<uint8_t>& count : blocks_[i].counters)
+            count.store(count.load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+}
+
+} // namespace kv
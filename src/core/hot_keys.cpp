@@ -0,0 +1,252 @@
+#include "kv/hot_keys.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <unordered_map>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace kv {
+
+struct HotKeyTracker::ThreadState {
+    ThreadState(std::thread::id owner, uint32_t epoch) : owner(owner), epoch(epoch) {}
+
+    const std::thread::id owner;
+    std::atomic<uint32_t> epoch; // the counters were last halved for this one
+    uint32_t until_clock_check = CLOCK_CHECK; // owner only
+    alignas(64) std::array<std::atomic<uint32_t>, ROWS * ROW_COUNTERS> counters{};
+
+    // Candidates. The owner changes keys and size only under the mutex, so
+    // readers holding it see whole strings. Counts are updated without it.
+    std::mutex mutex;
+    size_t size = 0;
+    size_t smallest = 0; // owner only: index of the smallest count once full
+    std::array<uint32_t, CANDIDATES> hashes{}; // owner only
+    std::array<std::string, CANDIDATES> keys;
+    std::array<std::atomic<uint32_t>, CANDIDATES> counts{};
+};
+
+namespace {
+
+constinit std::atomic<uint64_t> next_tracker_id{1};
+
+// The tracker the calling thread recorded into last, its state there, and
+// the thread's generator for sampling, shared by all trackers
+struct ThreadCache {
+    uint64_t tracker = 0;
+    void* state = nullptr;
+    uint64_t random = 0;
+};
+constinit thread_local ThreadCache thread_cache;
+
+// xorshift64, seeded from the thread's own address so threads differ
+uint64_t next_random() noexcept {
+    uint64_t x = thread_cache.random;
+    if (x == 0)
+        x = reinterpret_cast<uintptr_t>(&thread_cache) | 1;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    thread_cache.random = x;
+    return x;
+}
+
+template <size_t ROWS, size_t ROW_COUNTERS>
+std::array<size_t, ROWS> slots_of(uint32_t key_hash) noexcept {
+    // Spread the 32 bits over 64, the low ones pick a 64-byte block of
+    // ROWS x BLOCK_ROW counters and the top ones a counter in each row,
+    // so one access touches one cache line
+    constexpr size_t BLOCK_ROW = 64 / sizeof(uint32_t) / ROWS;
+    constexpr size_t BLOCKS = ROW_COUNTERS / BLOCK_ROW;
+    uint64_t hash = key_hash * 0x9E3779B97F4A7C15ULL;
+    hash ^= hash >> 29;
+    size_t block = ((hash >> 16) & (BLOCKS - 1)) * ROWS * BLOCK_ROW;
+    std::array<size_t, ROWS> slots{};
+    for (size_t row = 0; row < ROWS; ++row)
+        slots[row] = block + row * BLOCK_ROW + ((hash >> (48 + 4 * row)) & (BLOCK_ROW - 1));
+    return slots;
+}
+
+// Bit i set if hashes[i] == key_hash
+template <size_t N>
+uint32_t hash_matches(const std::array<uint32_t, N>& hashes, uint32_t key_hash) noexcept {
+    static_assert(N <= 32 && N % 4 == 0);
+    uint32_t matches = 0;
+#ifdef __SSE2__
+    __m128i wanted = _mm_set1_epi32(static_cast<int>(key_hash));
+    for (size_t i = 0; i < N; i += 4) {
+        __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hashes.data() + i));
+        matches |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(four, wanted)))) << i;
+    }
+#else
+    for (size_t i = 0; i < N; ++i)
+        matches |= static_cast<uint32_t>(hashes[i] == key_hash) << i;
+#endif
+    return matches;
+}
+
+// A count from a state `epochs` halvings behind
+uint64_t scaled(uint32_t count, uint32_t epochs) noexcept {
+    return epochs >= 32 ? 0 : count >> epochs;
+}
+
+// The owner may have moved on to a newer epoch since the reader looked at the clock
+uint32_t epochs_behind(uint32_t now, const std::atomic<uint32_t>& epoch) noexcept {
+    uint32_t then = epoch.load(std::memory_order_relaxed);
+    return now > then ? now - then : 0;
+}
+
+} // namespace
+
+HotKeyTracker::HotKeyTracker(std::chrono::milliseconds half_life, uint32_t sample)
+    : half_life_(std::max(half_life, std::chrono::milliseconds{1})),
+      sample_(std::bit_ceil(std::max(sample, 1u))),
+      start_(std::chrono::steady_clock::now()),
+      id_(next_tracker_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+HotKeyTracker::~HotKeyTracker() = default;
+
+uint32_t HotKeyTracker::current_epoch() const noexcept {
+    return static_cast<uint32_t>((std::chrono::steady_clock::now() - start_) / half_life_);
+}
+
+HotKeyTracker::ThreadState& HotKeyTracker::local_state() {
+    if (thread_cache.tracker == id_)
+        return *static_cast<ThreadState*>(thread_cache.state);
+
+    // Once per thread, or after the thread used another tracker in between
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard lock(registry_mutex_);
+    auto it = std::find_if(states_.begin(), states_.end(), [self](const auto& state) {
+        return state->owner == self;
+    });
+    ThreadState* state = it != states_.end() ? it->get() :
+        states_.emplace_back(std::make_unique<ThreadState>(self, current_epoch())).get();
+    thread_cache.tracker = id_;
+    thread_cache.state = state;
+    return *state;
+}
+
+void HotKeyTracker::record(std::string_view key, uint32_t key_hash) {
+    if (sample_ > 1 && (next_random() & (sample_ - 1)) != 0)
+        return;
+    ThreadState& state = local_state();
+
+    if (--state.until_clock_check == 0) {
+        state.until_clock_check = CLOCK_CHECK;
+        uint32_t epoch = current_epoch();
+        uint32_t behind = epochs_behind(epoch, state.epoch);
+        if (behind > 0) {
+            for (auto& counter : state.counters)
+                counter.store(static_cast<uint32_t>(scaled(counter.load(std::memory_order_relaxed), behind)),
+                              std::memory_order_relaxed);
+            for (size_t i = 0; i < state.size; ++i)
+                state.counts[i].store(static_cast<uint32_t>(scaled(state.counts[i].load(std::memory_order_relaxed), behind)),
+                                      std::memory_order_relaxed);
+            state.epoch.store(epoch, std::memory_order_relaxed);
+        }
+    }
+
+    // Conservative update: only the counters at the minimum grow, which keeps
+    // keys that share some counters with a hot one from inheriting its count
+    auto slots = slots_of<ROWS, ROW_COUNTERS>(key_hash);
+    uint32_t smallest = std::numeric_limits<uint32_t>::max();
+    for (size_t slot : slots)
+        smallest = std::min(smallest, state.counters[slot].load(std::memory_order_relaxed));
+    if (smallest == std::numeric_limits<uint32_t>::max())
+        return;
+    uint32_t estimate = smallest + 1;
+    for (size_t slot : slots) {
+        if (state.counters[slot].load(std::memory_order_relaxed) == smallest)
+            state.counters[slot].store(estimate, std::memory_order_relaxed);
+    }
+
+    bool full = state.size == CANDIDATES;
+    if (full && estimate <= state.counts[state.smallest].load(std::memory_order_relaxed))
+        return;
+
+    auto find_smallest = [&state]() {
+        state.smallest = 0;
+        for (size_t i = 1; i < CANDIDATES; ++i) {
+            if (state.counts[i].load(std::memory_order_relaxed) <
+                state.counts[state.smallest].load(std::memory_order_relaxed))
+                state.smallest = i;
+        }
+    };
+
+    // Compare all hashes at once, then the keys of the matches
+    uint32_t matches = hash_matches(state.hashes, key_hash) & static_cast<uint32_t>((uint64_t{1} << state.size) - 1);
+    for (; matches != 0; matches &= matches - 1) {
+        size_t i = static_cast<size_t>(std::countr_zero(matches));
+        if (state.keys[i] != key)
+            continue;
+        state.counts[i].store(estimate, std::memory_order_relaxed);
+        if (full && i == state.smallest)
+            find_smallest();
+        return;
+    }
+
+    // A new candidate, in a free slot or over the smallest one
+    std::lock_guard lock(state.mutex);
+    size_t slot = full ? state.smallest : state.size++;
+    state.hashes[slot] = key_hash;
+    state.keys[slot].assign(key);
+    state.counts[slot].store(estimate, std::memory_order_relaxed);
+    if (state.size == CANDIDATES)
+        find_smallest();
+}
+
+std::vector<HotKey> HotKeyTracker::top(size_t count) const {
+    uint32_t epoch = current_epoch();
+    std::unordered_map<std::string, uint64_t> totals;
+    {
+        std::lock_guard registry(registry_mutex_);
+        for (const auto& state : states_) {
+            std::lock_guard lock(state->mutex);
+            uint32_t behind = epochs_behind(epoch, state->epoch);
+            for (size_t i = 0; i < state->size; ++i) {
+                uint64_t recent = scaled(state->counts[i].load(std::memory_order_relaxed), behind);
+                if (recent > 0)
+                    totals[state->keys[i]] += recent * sample_;
+            }
+        }
+    }
+
+    // Min-heap of the `count` largest totals, the least accessed on top
+    auto more = [](const HotKey& a, const HotKey& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    };
+    std::vector<HotKey> heap;
+    heap.reserve(std::min(count, totals.size()));
+    for (auto& [key, total] : totals) {
+        if (heap.size() < count) {
+            heap.push_back({key, total});
+            std::push_heap(heap.begin(), heap.end(), more);
+        } else if (count > 0 && more(HotKey{key, total}, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), more);
+            heap.back() = {key, total};
+            std::push_heap(heap.begin(), heap.end(), more);
+        }
+    }
+    std::sort_heap(heap.begin(), heap.end(), more);
+    return heap;
+}
+
+uint64_t HotKeyTracker::estimate(uint32_t key_hash) const {
+    uint32_t epoch = current_epoch();
+    auto slots = slots_of<ROWS, ROW_COUNTERS>(key_hash);
+    uint64_t total = 0;
+    std::lock_guard registry(registry_mutex_);
+    for (const auto& state : states_) {
+        uint32_t smallest = std::numeric_limits<uint32_t>::max();
+        for (size_t slot : slots)
+            smallest = std::min(smallest, state->counters[slot].load(std::memory_order_relaxed));
+        total += scaled(smallest, epochs_behind(epoch, state->epoch));
+    }
+    return total * sample_;
+}
+
+} // namespace kv
@@ -1,27 +1,324 @@
 #include "kv/kv_store.hpp"
+#include "kv/epoch.hpp"
+#include "kv/slab_allocator.hpp"
+#include "kv/lz4.hpp"
+#include "kv/logger.hpp"
 #include <mutex>
+#include <limits>
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <new>
+#include <utility>
 
 namespace kv {
 
+struct KvStore::Snapshot {
+    size_t size;
+    size_t uncompressed_size; // 0 unless the bytes are LZ4-compressed
+    // value bytes follow the struct
+
+    static Snapshot* create(std::string_view bytes, size_t uncompressed_size = 0) {
+        void* memory = SlabAllocator::allocate(sizeof(Snapshot) + bytes.size());
+        auto* snapshot = new (memory) Snapshot{bytes.size(), uncompressed_size};
+        std::memcpy(reinterpret_cast<char*>(snapshot + 1), bytes.data(), bytes.size());
+        return snapshot;
+    }
+
+    static void destroy(void* ptr) {
+        auto* snapshot = static_cast<Snapshot*>(ptr);
+        if (snapshot)
+            SlabAllocator::deallocate(snapshot, sizeof(Snapshot) + snapshot->size);
+    }
+
+    std::string_view text() const noexcept {
+        return {reinterpret_cast<const char*>(this + 1), size};
+    }
+
+    static size_t bytes(const Snapshot* snapshot) noexcept {
+        return snapshot ? sizeof(Snapshot) + snapshot->size : 0;
+    }
+};
+
+KvStore::Entry::Entry(Entry&& other) noexcept
+    : value(std::move(other.value)),
+      version(other.version),
+      snapshot(other.snapshot.exchange(nullptr, std::memory_order_acq_rel)) {}
+
+KvStore::Entry& KvStore::Entry::operator=(Entry&& other) noexcept {
+    if (this != &other) {
+        value = std::move(other.value);
+        version = other.version;
+        retire(snapshot.exchange(other.snapshot.exchange(nullptr, std::memory_order_acq_rel),
+                                 std::memory_order_acq_rel));
+    }
+    return *this;
+}
+
+KvStore::Entry::~Entry() {
+    // A reader may have loaded it just before the entry was removed
+    retire(snapshot.load(std::memory_order_relaxed));
+}
+
+Value KvStore::make_value(std::string_view text) const {
+    if (options_.compression && text.size() >= options_.compression_threshold)
+        return Value::compress(text);
+    return Value{text};
+}
+
+KvStore::Snapshot* KvStore::make_snapshot(const Value& value) const {
+    if (!options_.lock_free_reads)
+        return nullptr;
+    if (value.is_integer())
+        return Snapshot::create(value.to_string());
+    if (value.is_compressed())
+        return Snapshot::create(value.compressed(), value.uncompressed_size());
+    return Snapshot::create(value.text());
+}
+
+namespace {
+
+// 1MB of counters, enough to tell a few hundred thousand keys apart
+constexpr size_t SKETCH_BLOCKS = 16 * 1024;
+// Halve the access counts about once a second
+constexpr size_t SKETCH_DECAY_PASSES = 4;
+// Spill down to 90% of the limit so the next few writes don't trigger another pass
+constexpr size_t SPILL_TARGET_PERCENT = 90;
+// Buckets walked per shared lock acquisition while collecting candidates
+constexpr size_t TIERING_SCAN_BUCKETS = 1024;
+// Rewrite a log segment once half of it is dead
+constexpr double COMPACTION_DEAD_RATIO = 0.5;
+
+// Plain text of a value stored LZ4-compressed
+std::string decompress(std::string_view bytes, size_t uncompressed_size) {
+    std::string text(uncompressed_size, '\0');
+    if (!Lz4::decompress(bytes, text.data(), text.size()))
+        throw std::runtime_error{"corrupt compressed value"};
+    return text;
+}
+
+} // namespace
+
+KvStore::KvStore(StoreOptions options) : options_(std::move(options)), data_(options_.lock_free_reads) {
+    if (options_.hot_key_half_life.count() > 0)
+        hot_keys_ = std::make_unique<HotKeyTracker>(options_.hot_key_half_life, options_.hot_key_sample);
+    if (options_.cold_directory.empty())
+        return;
+    sketch_ = std::make_unique<FrequencySketch>(SKETCH_BLOCKS);
+    cold_log_ = std::make_unique<ValueLog>(options_.cold_directory);
+    if (options_.tiering_interval.count() == 0)
+        return;
+    tiering_thread_ = std::jthread([this](std::stop_token stop_token) {
+        tiering_loop(stop_token);
+    });
+}
+
+KvStore::Snapshot* KvStore::publish(Entry& entry, Snapshot* snapshot) const noexcept {
+    Snapshot* replaced = entry.snapshot.exchange(snapshot, std::memory_order_acq_rel);
+    // A second copy of the value, as much memory as the value itself
+    resize_resident(Snapshot::bytes(replaced), Snapshot::bytes(snapshot));
+    return replaced;
+}
+
+void KvStore::retire(Snapshot* snapshot) {
+    if (snapshot)
+        Epoch::retire(snapshot, &Snapshot::destroy);
+}
+
+const KvStore::Snapshot* KvStore::find_snapshot(std::string_view key, uint32_t hash) const noexcept {
+    const Entry* entry = data_.find_concurrent(key, hash);
+    // Null while a new key is still being written or once it was removed
+    return entry ? entry->snapshot.load(std::memory_order_acquire) : nullptr;
+}
+
+void KvStore::count_read(std::string_view key, uint32_t hash) const {
+    if (sketch_)
+        sketch_->record(hash);
+    if (hot_keys_)
+        hot_keys_->record(key, hash);
+}
+
+KvStore::Entry& KvStore::write_entry(const std::string& key) {
+    return write_entry(key, HashTable<Entry>::hash_of(key));
+}
+
+KvStore::Entry& KvStore::write_entry(std::string_view key, uint32_t hash) {
+    auto [entry, inserted] = data_.try_emplace(key, hash);
+    if (inserted && options_.ordered_index)
+        index_.emplace(key);
+    if (sketch_)
+        sketch_->record(hash);
+    entry->version = ++last_version_;
+    return *entry;
+}
+
+void KvStore::dispose(Value value, bool lazy) {
+    if (value.is_cold()) {
+        cold_log_->release(value.cold_location());
+        cold_values_.fetch_sub(1, std::memory_order_relaxed);
+        return;
+    }
+    if (lazy && value.heap_bytes() >= options_.lazy_free_threshold)
+        freer_.submit(std::move(value));
+    // otherwise it is freed right here, still outside the store lock
+}
+
 void KvStore::set(const std::string& key, const std::string& value) {
-    std::unique_lock lock(mutex_);
-    data_[key] = value;
+    // Copy the payload before taking the lock, the critical section only swaps buffers
+    set(key, make_value(value));
+}
+
+void KvStore::set(const std::string& key, Value fresh) {
+    if (options_.compression && !fresh.is_integer() && !fresh.is_compressed() &&
+        fresh.text().size() >= options_.compression_threshold)
+        fresh = Value::compress(fresh.text());
+    Snapshot* snapshot = make_snapshot(fresh);
+    {
+        std::unique_lock lock(mutex_);
+        Entry& entry = write_entry(key);
+        std::swap(entry.value, fresh);
+        replace_resident(fresh, entry.value);
+        snapshot = publish(entry, snapshot);
+    }
+    retire(snapshot);
+    dispose(std::move(fresh), options_.lazy_free);
 }
 
 std::optional<std::string> KvStore::get(const std::string& key) const {
+    // Hashed once, for the lookup and the access count
+    const uint32_t hash = HashTable<Entry>::hash_of(key);
+    if (options_.lock_free_reads) {
+        EpochGuard guard;
+        const Snapshot* snapshot = find_snapshot(key, hash);
+        if (snapshot) {
+            count_read(key, hash);
+            if (snapshot->uncompressed_size > 0)
+                return decompress(snapshot->text(), snapshot->uncompressed_size);
+            return std::string{snapshot->text()};
+        }
+        if (!cold_log_)
+            return std::nullopt;
+        // Cold values have no snapshot, look under the lock
+    }
+
+    {
+        std::shared_lock lock(mutex_);
+        const Entry* entry = data_.find(key, hash);
+        if (!entry)
+            return std::nullopt;
+        if (entry->value.is_compressed()) {
+            // Only the copy of the block is made under the lock, writers don't wait for LZ4
+            count_read(key, hash);
+            std::string compressed{entry->value.compressed()};
+            size_t uncompressed_size = entry->value.uncompressed_size();
+            lock.unlock();
+            return decompress(compressed, uncompressed_size);
+        }
+        if (!entry->value.is_cold()) {
+            count_read(key, hash);
+            return entry->value.to_string();
+        }
+    }
+    // Loads the value back into memory on the way
+    std::optional<std::string> text;
+    read(key, [&text](std::string_view value) {
+        text.emplace(value);
+    });
+    return text;
+}
+
+bool KvStore::read(const std::string& key, const std::function<void(std::string_view)>& reader) const {
+    return read_stored(key, [&reader](std::string_view bytes, size_t uncompressed_size) {
+        if (uncompressed_size > 0)
+            reader(decompress(bytes, uncompressed_size));
+        else
+            reader(bytes);
+    });
+}
+
+bool KvStore::read_stored(const std::string& key,
+                          const std::function<void(std::string_view, size_t)>& reader) const {
+    const uint32_t hash = HashTable<Entry>::hash_of(key);
+    if (options_.lock_free_reads) {
+        EpochGuard guard;
+        const Snapshot* snapshot = find_snapshot(key, hash);
+        if (snapshot) {
+            count_read(key, hash);
+            reader(snapshot->text(), snapshot->uncompressed_size);
+            return true;
+        }
+        if (!cold_log_)
+            return false;
+        // Cold values have no snapshot, look under the lock
+    }
+
     std::shared_lock lock(mutex_);
-    auto it = data_.find(key);
-    return it != data_.end() ? std::make_optional(it->second) : std::nullopt;
+    const Entry* entry = data_.find(key, hash);
+    if (!entry)
+        return false;
+    count_read(key, hash);
+    // The reader decompresses (see read()), so compressed values are copied
+    // out and handed over after the lock is released
+    if (entry->value.is_cold()) {
+        uint64_t location = entry->value.cold_location();
+        Value loaded = load_cold(location);
+        lock.unlock();
+        if (loaded.is_compressed())
+            reader(loaded.compressed(), loaded.uncompressed_size());
+        else
+            reader(loaded.text(), 0);
+        promote(key, location, std::move(loaded));
+    } else if (entry->value.is_compressed()) {
+        std::string compressed{entry->value.compressed()};
+        size_t uncompressed_size = entry->value.uncompressed_size();
+        lock.unlock();
+        reader(compressed, uncompressed_size);
+    } else if (entry->value.is_integer())
+        reader(entry->value.to_string(), 0);
+    else
+        reader(entry->value.text(), 0);
+    return true;
 }
 
 bool KvStore::del(const std::string& key) {
-    std::unique_lock lock(mutex_);
-    return data_.erase(key) > 0;
+    return remove(key, options_.lazy_free);
+}
+
+bool KvStore::unlink(const std::string& key) {
+    return remove(key, true);
+}
+
+bool KvStore::remove(const std::string& key, bool lazy) {
+    std::optional<Entry> removed;
+    Snapshot* replaced = nullptr;
+    {
+        std::unique_lock lock(mutex_);
+        removed = data_.extract(key);
+        if (!removed)
+            return false;
+        resize_resident(removed->value.heap_bytes(), 0);
+        replaced = publish(*removed, nullptr);
+        if (options_.ordered_index)
+            index_.erase(key);
+    }
+    retire(replaced);
+    dispose(std::move(removed->value), lazy);
+    return true;
 }
 
 bool KvStore::exists(const std::string& key) const {
+    if (options_.lock_free_reads) {
+        EpochGuard guard;
+        if (find_snapshot(key, HashTable<Entry>::hash_of(key)))
+            return true;
+        if (!cold_log_)
+            return false;
+        // Cold values have no snapshot, look under the lock
+    }
+
     std::shared_lock lock(mutex_);
-    return data_.find(key) != data_.end();
+    return data_.find(key) != nullptr;
 }
 
 size_t KvStore::size() const {
@@ -29,4 +326,543 @@ size_t KvStore::size() const {
     return data_.size();
 }
 
+size_t KvStore::scan(size_t cursor, size_t count, std::vector<std::string>& keys) const {
+    // Clamped first, so a huge COUNT neither overflows the bucket budget nor walks the whole table
+    count = std::min(count, SCAN_MAX_COUNT);
+    std::shared_lock lock(mutex_);
+    return data_.scan(cursor, count, count * SCAN_BUCKETS_PER_KEY,
+        [&keys](std::string_view key, const Entry&) {
+            keys.emplace_back(key);
+        });
+}
+
+size_t KvStore::load(const std::vector<BulkRecord>& records) {
+    struct Prepared {
+        Value value;
+        Snapshot* snapshot = nullptr;
+        uint32_t hash = 0;
+
+        ~Prepared() { Snapshot::destroy(snapshot); } // never published
+    };
+    // Everything that doesn't need the lock, on all cores
+    std::vector<Prepared> prepared(records.size());
+    parallel_slices(records.size(), LOAD_BATCH, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            prepared[i].value = make_value(records[i].value);
+            prepared[i].snapshot = make_snapshot(prepared[i].value);
+            prepared[i].hash = HashTable<Entry>::hash_of(records[i].key);
+        }
+    });
+
+    {
+        // Assumes all keys are new, so the batches below never rehash
+        std::unique_lock lock(mutex_);
+        data_.reserve(data_.size() + records.size());
+    }
+    for (size_t begin = 0; begin < records.size(); begin += LOAD_BATCH) {
+        size_t end = std::min(records.size(), begin + LOAD_BATCH);
+        {
+            std::unique_lock lock(mutex_);
+            for (size_t i = begin; i < end; ++i) {
+                Entry& entry = write_entry(records[i].key, prepared[i].hash);
+                std::swap(entry.value, prepared[i].value);
+                replace_resident(prepared[i].value, entry.value);
+                prepared[i].snapshot = publish(entry, prepared[i].snapshot);
+            }
+        }
+        // What the batch replaced is released outside the lock, as in set()
+        for (size_t i = begin; i < end; ++i) {
+            retire(std::exchange(prepared[i].snapshot, nullptr));
+            dispose(std::move(prepared[i].value), options_.lazy_free);
+        }
+    }
+    return records.size();
+}
+
+void KvStore::dump(const std::function<void(std::string_view)>& on_chunk) const {
+    // Values that need LZ4 or the log, turned into text after the store lock is released
+    struct Deferred {
+        std::string key;
+        std::string compressed;
+        size_t uncompressed_size = 0;
+        uint64_t cold_location = 0; // 0 for an in-memory value
+    };
+    std::string chunk;
+    std::vector<Deferred> deferred;
+    size_t cursor = 0;
+    do {
+        chunk.clear();
+        deferred.clear();
+        // Only tiering drops log segments, so the cold locations stay readable while it waits
+        std::unique_lock<std::mutex> pass;
+        if (cold_log_)
+            pass = std::unique_lock{tiering_mutex_};
+        {
+            std::shared_lock lock(mutex_);
+            cursor = data_.scan(cursor, DUMP_PAGE_SIZE, DUMP_PAGE_SIZE * SCAN_BUCKETS_PER_KEY,
+                [&chunk, &deferred](std::string_view key, const Entry& entry) {
+                    const Value& value = entry.value;
+                    if (value.is_cold())
+                        deferred.push_back({std::string{key}, {}, 0, value.cold_location()});
+                    else if (value.is_compressed())
+                        deferred.push_back({std::string{key}, std::string{value.compressed()}, value.uncompressed_size()});
+                    else if (value.is_integer())
+                        BulkFormat::append(chunk, key, value.to_string());
+                    else
+                        BulkFormat::append(chunk, key, value.text());
+                });
+        }
+        for (const Deferred& value : deferred) {
+            if (value.cold_location == 0) {
+                BulkFormat::append(chunk, value.key, decompress(value.compressed, value.uncompressed_size));
+                continue;
+            }
+            // A value overwritten meanwhile still has its record, it is only released
+            ValueLog::Record record = cold_log_->read(value.cold_location);
+            BulkFormat::append(chunk, value.key, record.uncompressed_size > 0 ?
+                decompress(record.bytes, record.uncompressed_size) : std::string{record.bytes});
+        }
+        if (pass)
+            pass.unlock();
+        if (!chunk.empty())
+            on_chunk(chunk);
+    } while (cursor != 0);
+}
+
+int64_t KvStore::incr_by(const std::string& key, int64_t delta) {
+    int64_t result = 0;
+    Snapshot* replaced = nullptr;
+    {
+        std::unique_lock lock(mutex_);
+        Entry* existing = data_.find(key);
+
+        int64_t current = 0;
+        if (existing) {
+            if (existing->value.is_integer()) {
+                current = existing->value.integer();
+            } else if (existing->value.is_compressed() || existing->value.is_cold()) {
+                throw StoreError{"value is not an integer"}; // far too long to be one
+            } else {
+                // Only convert strings that round-trip, so GET keeps returning the same text
+                std::string_view text = existing->value.text();
+                auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), current);
+                if (ec != std::errc{} || ptr != text.data() + text.size() || std::to_string(current) != text)
+                    throw StoreError{"value is not an integer"};
+            }
+        }
+
+        // Checked against the limits before adding, signed overflow is undefined
+        if (delta > 0 ? current > std::numeric_limits<int64_t>::max() - delta
+                      : current < std::numeric_limits<int64_t>::min() - delta)
+            throw StoreError{"increment would overflow"};
+        result = current + delta;
+
+        Entry& entry = write_entry(key);
+        size_t before = entry.value.heap_bytes();
+        entry.value.assign(result);
+        resize_resident(before, entry.value.heap_bytes());
+        replaced = publish(entry, make_snapshot(entry.value));
+    }
+    retire(replaced);
+    return result;
+}
+
+size_t KvStore::append(const std::string& key, const std::string& suffix) {
+    while (true) {
+        std::string stored;
+        size_t uncompressed_size = 0;
+        uint64_t version = 0;
+        {
+            std::unique_lock lock(mutex_);
+            const Entry* existing = data_.find(key);
+            if (existing && existing->value.is_cold()) {
+                ValueLog::Record record = cold_log_->read(existing->value.cold_location());
+                stored = record.bytes;
+                uncompressed_size = record.uncompressed_size;
+                version = existing->version;
+            } else if (existing && existing->value.is_compressed()) {
+                stored = existing->value.compressed();
+                uncompressed_size = existing->value.uncompressed_size();
+                version = existing->version;
+            } else {
+                Entry& entry = write_entry(key);
+                size_t before = entry.value.heap_bytes();
+                entry.value.append(suffix);
+                resize_resident(before, entry.value.heap_bytes());
+                size_t length = entry.value.text().size();
+                Snapshot* replaced = publish(entry, make_snapshot(entry.value));
+                lock.unlock();
+                retire(replaced);
+                return length;
+            }
+        }
+
+        // Compressed or cold: rebuilt without the lock and stored the way set() would
+        std::string text = uncompressed_size > 0 ? decompress(stored, uncompressed_size) : std::move(stored);
+        text += suffix;
+        Value fresh = make_value(text);
+        Snapshot* snapshot = make_snapshot(fresh);
+        {
+            std::unique_lock lock(mutex_);
+            const Entry* current = data_.find(key);
+            if (!current || current->version != version) {
+                // Written meanwhile, start over from what is there now
+                lock.unlock();
+                Snapshot::destroy(snapshot);
+                continue;
+            }
+            Entry& entry = write_entry(key);
+            std::swap(entry.value, fresh);
+            replace_resident(fresh, entry.value);
+            snapshot = publish(entry, snapshot);
+        }
+        retire(snapshot);
+        dispose(std::move(fresh), options_.lazy_free);
+        return text.size();
+    }
+}
+
+std::optional<std::string> KvStore::getset(const std::string& key, const std::string& value) {
+    Value fresh = make_value(value);
+    Snapshot* snapshot = make_snapshot(fresh);
+    bool existed = false;
+    {
+        std::unique_lock lock(mutex_);
+        existed = data_.find(key) != nullptr;
+        Entry& entry = write_entry(key);
+        std::swap(entry.value, fresh);
+        replace_resident(fresh, entry.value);
+        snapshot = publish(entry, snapshot);
+    }
+    retire(snapshot);
+    // `fresh` now holds the previous value, copied out without the lock.
+    // A cold one stays in the log until dispose() releases it.
+    std::optional<std::string> previous;
+    if (existed)
+        previous = text_of(fresh);
+    dispose(std::move(fresh), options_.lazy_free);
+    return previous;
+}
+
+bool KvStore::setnx(const std::string& key, const std::string& value) {
+    Value fresh = make_value(value);
+    Snapshot* snapshot = make_snapshot(fresh);
+    std::unique_lock lock(mutex_);
+    if (data_.find(key)) {
+        Snapshot::destroy(snapshot); // never published
+        return false;
+    }
+    Entry& entry = write_entry(key);
+    entry.value = std::move(fresh);
+    resize_resident(0, entry.value.heap_bytes());
+    publish(entry, snapshot);
+    return true;
+}
+
+std::optional<VersionedValue> KvStore::get_versioned(const std::string& key) const {
+    const uint32_t hash = HashTable<Entry>::hash_of(key);
+    std::string compressed;
+    size_t uncompressed_size = 0;
+    uint64_t version = 0;
+    {
+        std::shared_lock lock(mutex_);
+        const Entry* entry = data_.find(key, hash);
+        if (!entry)
+            return std::nullopt;
+        count_read(key, hash);
+        version = entry->version;
+        const Value& value = entry->value;
+        if (value.is_cold()) {
+            ValueLog::Record record = cold_log_->read(value.cold_location());
+            if (record.uncompressed_size == 0)
+                return VersionedValue{std::string{record.bytes}, version};
+            compressed = record.bytes;
+            uncompressed_size = record.uncompressed_size;
+        } else if (value.is_compressed()) {
+            // Copied out like in get(), decompressed without the lock
+            compressed = value.compressed();
+            uncompressed_size = value.uncompressed_size();
+        } else {
+            return VersionedValue{value.to_string(), version};
+        }
+    }
+    return VersionedValue{decompress(compressed, uncompressed_size), version};
+}
+
+bool KvStore::compare_and_set(const std::string& key, uint64_t expected_version, const std::string& value) {
+    Value fresh = make_value(value);
+    Snapshot* snapshot = make_snapshot(fresh);
+    {
+        std::unique_lock lock(mutex_);
+        const Entry* existing = data_.find(key);
+        uint64_t current_version = existing ? existing->version : 0;
+        if (current_version != expected_version) {
+            lock.unlock();
+            Snapshot::destroy(snapshot); // never published
+            return false;
+        }
+        Entry& entry = write_entry(key);
+        std::swap(entry.value, fresh);
+        replace_resident(fresh, entry.value);
+        snapshot = publish(entry, snapshot);
+    }
+    retire(snapshot);
+    dispose(std::move(fresh), options_.lazy_free);
+    return true;
+}
+
+bool KvStore::has_ordered_index() const noexcept {
+    return options_.ordered_index;
+}
+
+size_t KvStore::lazily_freed() const noexcept {
+    return freer_.freed();
+}
+
+std::string KvStore::text_of(const Value& value) const {
+    if (!value.is_cold())
+        return value.to_string();
+    ValueLog::Record record = cold_log_->read(value.cold_location());
+    if (record.uncompressed_size > 0)
+        return decompress(record.bytes, record.uncompressed_size);
+    return std::string{record.bytes};
+}
+
+Value KvStore::load_cold(uint64_t location) const {
+    ValueLog::Record record = cold_log_->read(location);
+    if (record.uncompressed_size > 0)
+        return Value::from_compressed(record.bytes, record.uncompressed_size);
+    return Value{record.bytes};
+}
+
+void KvStore::promote(std::string_view key, uint64_t location, Value loaded) const {
+    Snapshot* snapshot = make_snapshot(loaded);
+    {
+        std::unique_lock lock(mutex_);
+        Entry* entry = const_cast<HashTable<Entry>&>(data_).find(key);
+        if (!entry || !entry->value.is_cold() || entry->value.cold_location() != location) {
+            // Overwritten or promoted by another reader meanwhile
+            lock.unlock();
+            Snapshot::destroy(snapshot);
+            return;
+        }
+        entry->value = std::move(loaded);
+        resize_resident(0, entry->value.heap_bytes());
+        publish(*entry, snapshot); // cold entries have none to replace
+        cold_log_->release(location);
+    }
+    cold_values_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool KvStore::spill(const std::string& key) {
+    uint64_t location = 0;
+    uint64_t version = 0;
+    {
+        // Readers can go on while the value is copied out, writers wait
+        std::shared_lock lock(mutex_);
+        const Entry* entry = data_.find(key);
+        if (!entry || entry->value.heap_bytes() == 0 || entry->value.heap_bytes() < options_.cold_min_size)
+            return false; // removed, or rewritten as a small value meanwhile
+        const Value& value = entry->value;
+        location = value.is_compressed() ? cold_log_->append(key, value.compressed(), value.uncompressed_size())
+                                         : cold_log_->append(key, value.text(), 0);
+        version = entry->version;
+    }
+
+    Value evicted;
+    Snapshot* replaced = nullptr;
+    {
+        std::unique_lock lock(mutex_);
+        Entry* entry = data_.find(key);
+        if (!entry || entry->version != version) {
+            lock.unlock();
+            cold_log_->release(location);
+            return false;
+        }
+        evicted = std::exchange(entry->value, Value::cold(location));
+        resize_resident(evicted.heap_bytes(), 0);
+        replaced = publish(*entry, nullptr);
+    }
+    cold_values_.fetch_add(1, std::memory_order_relaxed);
+    retire(replaced);
+    dispose(std::move(evicted), options_.lazy_free);
+    return true;
+}
+
+void KvStore::spill_cold_values() {
+    // Kept up to date by every write, so a store within its limit isn't walked at all
+    if (resident_bytes() <= options_.memory_limit)
+        return;
+
+    struct Candidate {
+        std::string key;
+        uint32_t frequency;
+        size_t bytes;
+    };
+    std::vector<Candidate> candidates;
+    // Keys read most right now stay in memory, however old their sketch counts
+    std::set<std::string, std::less<>> hot;
+    if (hot_keys_) {
+        for (HotKey& hot_key : hot_keys_->top(HotKeyTracker::CANDIDATES))
+            hot.insert(std::move(hot_key.key));
+    }
+
+    size_t cursor = 0;
+    do {
+        std::shared_lock lock(mutex_);
+        cursor = data_.scan(cursor, std::numeric_limits<size_t>::max(), TIERING_SCAN_BUCKETS,
+            [&](std::string_view key, const Entry& entry) {
+                size_t bytes = entry.value.heap_bytes();
+                if (bytes > 0 && bytes >= options_.cold_min_size && !hot.contains(key))
+                    candidates.push_back({std::string{key}, sketch_->estimate(HashTable<Entry>::hash_of(key)), bytes});
+            });
+    } while (cursor != 0);
+
+    // Least read first, and of those the largest, so few values free a lot
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.frequency != b.frequency ? a.frequency < b.frequency : a.bytes > b.bytes;
+    });
+    size_t target = options_.memory_limit / 100 * SPILL_TARGET_PERCENT;
+    for (const Candidate& candidate : candidates) {
+        // Writes during the pass count too
+        if (resident_bytes() <= target)
+            break;
+        spill(candidate.key);
+    }
+}
+
+void KvStore::compact_cold_log() {
+    for (uint32_t segment : cold_log_->compaction_candidates(COMPACTION_DEAD_RATIO)) {
+        cold_log_->for_each_record(segment, [this](uint64_t location, const ValueLog::Record& record) {
+            auto holds = [&](const Entry* entry) {
+                return entry && entry->value.is_cold() && entry->value.cold_location() == location;
+            };
+            {
+                std::shared_lock lock(mutex_);
+                if (!holds(data_.find(record.key)))
+                    return; // dead record
+            }
+            // The segment can't go away under us, only this pass drops segments
+            uint64_t moved = cold_log_->append(record.key, record.bytes, record.uncompressed_size);
+            std::unique_lock lock(mutex_);
+            Entry* entry = data_.find(record.key);
+            if (holds(entry)) {
+                entry->value = Value::cold(moved);
+                cold_log_->release(location);
+            } else {
+                cold_log_->release(moved);
+            }
+        });
+        cold_log_->drop_if_empty(segment);
+    }
+}
+
+void KvStore::tier() {
+    if (!cold_log_)
+        return;
+    std::lock_guard pass(tiering_mutex_);
+    spill_cold_values();
+    compact_cold_log();
+    cold_log_->trim();
+    if (++tiering_passes_ % SKETCH_DECAY_PASSES == 0)
+        sketch_->decay();
+}
+
+void KvStore::tiering_loop(std::stop_token stop_token) {
+    std::mutex mutex;
+    std::condition_variable_any wakeup;
+    std::unique_lock lock(mutex);
+    while (true) {
+        // Only a stop request wakes us early
+        wakeup.wait_for(lock, stop_token, options_.tiering_interval, []() { return false; });
+        if (stop_token.stop_requested())
+            return;
+        try {
+            tier();
+        } catch (const std::exception& e) {
+            // e.g. the disk is full, values simply stay in memory
+            KV_LOG(Error, "Tiering pass failed: ", e.what());
+        }
+    }
+}
+
+std::vector<HotKey> KvStore::hot_keys(size_t count) const {
+    return hot_keys_ ? hot_keys_->top(count) : std::vector<HotKey>{};
+}
+
+const HotKeyTracker* KvStore::hot_key_tracker() const noexcept {
+    return hot_keys_.get();
+}
+
+size_t KvStore::cold_values() const noexcept {
+    return cold_values_.load(std::memory_order_relaxed);
+}
+
+size_t KvStore::cold_log_bytes() const noexcept {
+    return cold_log_ ? cold_log_->disk_bytes() : 0;
+}
+
+size_t KvStore::resident_bytes() const noexcept {
+    return resident_bytes_.load(std::memory_order_relaxed);
+}
+
+void KvStore::resize_resident(size_t before, size_t after) const noexcept {
+    // Wraps around for a shrink, which the unsigned sum undoes
+    resident_bytes_.fetch_add(after - before, std::memory_order_relaxed);
+}
+
+void KvStore::replace_resident(const Value& before, const Value& after) const noexcept {
+    resize_resident(before.heap_bytes(), after.heap_bytes());
+}
+
+void KvStore::scan_prefix(std::string_view prefix, size_t limit, const PageCallback& on_page,
+                          std::string_view from) const {
+    scan_index(std::max(prefix, from), limit, [prefix](const std::string& key) {
+        return key.starts_with(prefix);
+    }, on_page);
+}
+
+void KvStore::scan_range(std::string_view start, std::string_view end, size_t limit,
+                         const PageCallback& on_page) const {
+    scan_index(start, limit, [end](const std::string& key) {
+        return key < end;
+    }, on_page);
+}
+
+void KvStore::scan_index(std::string_view start, size_t limit,
+                         const std::function<bool(const std::string&)>& in_bounds,
+                         const PageCallback& on_page) const {
+    size_t remaining = limit == 0 ? std::numeric_limits<size_t>::max() : limit;
+    std::string resume_key{start};
+    bool first_page = true;
+    std::vector<std::string> page;
+
+    while (remaining > 0) {
+        page.clear();
+        bool exhausted = false;
+        {
+            // Only hold the lock while copying one page, so writers can get in between pages
+            std::shared_lock lock(mutex_);
+            auto it = first_page ? index_.lower_bound(resume_key) : index_.upper_bound(resume_key);
+            size_t page_limit = std::min(SCAN_PAGE_SIZE, remaining);
+            while (it != index_.end() && page.size() < page_limit && in_bounds(*it)) {
+                page.push_back(*it);
+                ++it;
+            }
+            exhausted = it == index_.end() || !in_bounds(*it);
+        }
+
+        if (page.empty())
+            break;
+
+        remaining -= page.size();
+        resume_key = page.back();
+        first_page = false;
+        on_page(page);
+
+        if (exhausted)
+            break;
+    }
+}
+
 } // namespace kv
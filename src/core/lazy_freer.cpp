@@ -0,0 +1,37 @@
+#include "kv/lazy_freer.hpp"
+
+namespace kv {
+
+void LazyFreer::submit(Value value) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(value));
+        if (!thread_.joinable()) {
+            thread_ = std::jthread([this](std::stop_token stop_token) {
+                run(stop_token);
+            });
+        }
+    }
+    cv_.notify_one();
+}
+
+size_t LazyFreer::freed() const noexcept {
+    return freed_.load(std::memory_order_relaxed);
+}
+
+void LazyFreer::run(std::stop_token stop_token) {
+    std::vector<Value> batch;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            if (!cv_.wait(lock, stop_token, [this]() { return !queue_.empty(); }))
+                return; // stop requested, the destructor frees what is left
+            batch.swap(queue_);
+        }
+        size_t count = batch.size();
+        batch.clear(); // the actual free happens here, outside any lock
+        freed_.fetch_add(count, std::memory_order_relaxed);
+    }
+}
+
+} // namespace kv
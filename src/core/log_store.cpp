@@ -0,0 +1,577 @@
+#include "kv/log_store.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+constexpr std::array<uint32_t, 256> make_crc_table() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320u : 0);
+        table[i] = crc;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC_TABLE = make_crc_table();
+
+// CRC-32 (zlib's), continued from `crc` so a record can be summed in pieces
+uint32_t crc32(uint32_t crc, std::string_view bytes) noexcept {
+    crc = ~crc;
+    for (unsigned char byte : bytes)
+        crc = CRC_TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t read32(const char* p) noexcept {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void write32(char* p, uint32_t value) noexcept {
+    std::memcpy(p, &value, sizeof(value));
+}
+
+// Checksum of everything in a record after the checksum itself
+uint32_t record_crc(const char* sizes, std::string_view key, std::string_view value) noexcept {
+    uint32_t crc = crc32(0, {sizes, 2 * sizeof(uint32_t)});
+    crc = crc32(crc, key);
+    return crc32(crc, value);
+}
+
+std::string error_text(const char* what, int err) {
+    return std::string{what} + ": " + std::strerror(err);
+}
+
+} // namespace
+
+LogStore::LogStore(Options options) : options_(std::move(options)) {
+    if (options_.hot_key_half_life.count() > 0)
+        hot_keys_ = std::make_unique<HotKeyTracker>(options_.hot_key_half_life, options_.hot_key_sample);
+    std::filesystem::create_directories(options_.directory);
+    path_ = options_.directory + "/data.log";
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + path_);
+    try {
+        replay();
+    } catch (...) {
+        ::close(fd_);
+        throw;
+    }
+}
+
+LogStore::~LogStore() {
+    ::close(fd_);
+}
+
+void LogStore::replay() {
+    struct stat info{};
+    if (::fstat(fd_, &info) != 0)
+        throw std::system_error(errno, std::generic_category(), "fstat " + path_);
+    auto file_size = static_cast<size_t>(info.st_size);
+    if (file_size == 0)
+        return;
+
+    void* mapped = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (mapped == MAP_FAILED)
+        throw std::system_error(errno, std::generic_category(), "mmap " + path_);
+    ::madvise(mapped, file_size, MADV_SEQUENTIAL);
+    const char* log = static_cast<const char*>(mapped);
+
+    size_t offset = 0;
+    while (file_size - offset >= HEADER_BYTES) {
+        const char* record = log + offset;
+        uint32_t key_size = read32(record + 4);
+        uint32_t value_size = read32(record + 8);
+        size_t value_bytes = value_size == TOMBSTONE ? 0 : value_size;
+        if (file_size - offset - HEADER_BYTES < size_t{key_size} + value_bytes)
+            break; // cut short
+        std::string_view key{record + HEADER_BYTES, key_size};
+        std::string_view value{key.data() + key_size, value_bytes};
+        if (read32(record) != record_crc(record + 4, key, value))
+            break; // torn write
+
+        Entry entry{offset, key_size, static_cast<uint32_t>(value_bytes), ++last_version_};
+        if (std::optional<Entry> old = data_.extract(key))
+            dead_bytes_ += old->record_bytes();
+        if (value_size == TOMBSTONE) {
+            dead_bytes_ += entry.record_bytes();
+            if (options_.ordered_index)
+                index_.erase(std::string{key});
+        } else {
+            data_.insert_or_assign(key, entry);
+            if (options_.ordered_index)
+                index_.emplace(key);
+        }
+        offset += entry.record_bytes();
+    }
+    ::munmap(mapped, file_size);
+
+    end_ = offset;
+    if (end_ < file_size && ::ftruncate(fd_, static_cast<off_t>(end_)) != 0)
+        throw std::system_error(errno, std::generic_category(), "truncate " + path_);
+}
+
+LogStore::Header LogStore::encode(std::string_view key, std::optional<std::string_view> value) {
+    if (value && value->size() >= TOMBSTONE)
+        throw StoreError{"value too large"};
+
+    Header header;
+    std::string_view bytes = value.value_or(std::string_view{});
+    write32(header.data() + 4, static_cast<uint32_t>(key.size()));
+    write32(header.data() + 8, value ? static_cast<uint32_t>(bytes.size()) : TOMBSTONE);
+    write32(header.data(), record_crc(header.data() + 4, key, bytes));
+    return header;
+}
+
+void LogStore::write_record(const std::string& key, Header header, std::optional<std::string_view> value) {
+    std::string_view bytes = value.value_or(std::string_view{});
+    iovec parts[3] = {
+        {header.data(), HEADER_BYTES},
+        {const_cast<char*>(key.data()), key.size()},
+        {const_cast<char*>(bytes.data()), bytes.size()},
+    };
+    size_t record_bytes = HEADER_BYTES + key.size() + bytes.size();
+    write_out(parts, 3, record_bytes);
+
+    Entry entry{end_, static_cast<uint32_t>(key.size()), static_cast<uint32_t>(bytes.size()), ++last_version_};
+    end_ += record_bytes;
+    if (!value) {
+        if (Entry* existing = data_.find(key))
+            dead_bytes_ += existing->record_bytes();
+        dead_bytes_ += record_bytes;
+        data_.extract(key);
+        if (options_.ordered_index)
+            index_.erase(key);
+    } else {
+        point_to(key, entry);
+    }
+}
+
+void LogStore::write_out(iovec* parts, int count, size_t bytes) {
+    size_t written = 0;
+    while (written < bytes) {
+        // A partial write is simply written over by the next record
+        ssize_t n = ::pwritev(fd_, parts, count, static_cast<off_t>(end_ + written));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            throw StoreError{error_text("log write failed", errno)};
+        }
+        written += static_cast<size_t>(n);
+        // Skip what was written, only happens for short writes
+        size_t skip = static_cast<size_t>(n);
+        for (int i = 0; i < count; ++i) {
+            size_t taken = std::min(skip, parts[i].iov_len);
+            parts[i].iov_base = static_cast<char*>(parts[i].iov_base) + taken;
+            parts[i].iov_len -= taken;
+            skip -= taken;
+        }
+    }
+    if (options_.sync_writes && ::fdatasync(fd_) != 0)
+        throw StoreError{error_text("log sync failed", errno)};
+}
+
+void LogStore::point_to(std::string_view key, const Entry& entry) {
+    auto [slot, inserted] = data_.try_emplace(key);
+    if (inserted) {
+        if (options_.ordered_index)
+            index_.emplace(key);
+    } else {
+        dead_bytes_ += slot->record_bytes();
+    }
+    *slot = entry;
+}
+
+size_t LogStore::load(const std::vector<BulkRecord>& records) {
+    {
+        // Assumes all keys are new, so the batches below never rehash
+        std::unique_lock lock(mutex_);
+        data_.reserve(data_.size() + records.size());
+    }
+    // Batches are encoded and checksummed on all cores, a group of them at a
+    // time so the copy of the stream doesn't have to fit in memory all at once
+    size_t batches = (records.size() + LOAD_BATCH - 1) / LOAD_BATCH;
+    std::vector<std::string> encoded;
+    for (size_t group = 0; group < batches; group += LOAD_GROUP) {
+        encoded.assign(std::min(LOAD_GROUP, batches - group), std::string{});
+        parallel_slices(encoded.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                size_t first = (group + b) * LOAD_BATCH;
+                size_t last = std::min(records.size(), first + LOAD_BATCH);
+                size_t bytes = 0;
+                for (size_t i = first; i < last; ++i)
+                    bytes += HEADER_BYTES + records[i].key.size() + records[i].value.size();
+                encoded[b].reserve(bytes);
+                for (size_t i = first; i < last; ++i) {
+                    Header header = encode(records[i].key, records[i].value);
+                    encoded[b].append(header.data(), HEADER_BYTES);
+                    encoded[b] += records[i].key;
+                    encoded[b] += records[i].value;
+                }
+            }
+        });
+
+        for (size_t b = 0; b < encoded.size(); ++b) {
+            size_t first = (group + b) * LOAD_BATCH;
+            size_t last = std::min(records.size(), first + LOAD_BATCH);
+            std::unique_lock lock(mutex_);
+            iovec part{encoded[b].data(), encoded[b].size()};
+            write_out(&part, 1, encoded[b].size());
+            for (size_t i = first; i < last; ++i) {
+                const BulkRecord& record = records[i];
+                Entry entry{end_, static_cast<uint32_t>(record.key.size()), static_cast<uint32_t>(record.value.size()),
+                            ++last_version_};
+                end_ += entry.record_bytes();
+                point_to(record.key, entry);
+            }
+            compact_if_needed();
+        }
+    }
+    return records.size();
+}
+
+void LogStore::dump(const std::function<void(std::string_view)>& on_chunk) const {
+    std::string chunk;
+    size_t cursor = 0;
+    do {
+        chunk.clear();
+        {
+            // Values are read under the lock, compaction may move them
+            std::shared_lock lock(mutex_);
+            cursor = data_.scan(cursor, DUMP_PAGE_SIZE, DUMP_PAGE_SIZE * SCAN_BUCKETS_PER_KEY,
+                [this, &chunk](std::string_view key, const Entry& entry) {
+                    BulkFormat::append(chunk, key, read_value(entry));
+                });
+        }
+        if (!chunk.empty())
+            on_chunk(chunk);
+    } while (cursor != 0);
+}
+
+std::string LogStore::read_value(const Entry& entry) const {
+    std::string value(entry.value_size, '\0');
+    off_t offset = static_cast<off_t>(entry.offset + HEADER_BYTES + entry.key_size);
+    size_t done = 0;
+    while (done < value.size()) {
+        ssize_t n = ::pread(fd_, value.data() + done, value.size() - done, offset + static_cast<off_t>(done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw StoreError{error_text("log read failed", n < 0 ? errno : EIO)};
+        done += static_cast<size_t>(n);
+    }
+    return value;
+}
+
+void LogStore::set(const std::string& key, const std::string& value) {
+    // Checksum the value before taking the lock, the critical section only writes it out
+    Header header = encode(key, value);
+    std::unique_lock lock(mutex_);
+    write_record(key, header, value);
+    compact_if_needed();
+}
+
+void LogStore::set(const std::string& key, Value value) {
+    if (value.is_integer() || value.is_compressed()) {
+        set(key, value.to_string());
+        return;
+    }
+    // The buffer a SETBLOB was read into goes to the file as is
+    Header header = encode(key, value.text());
+    std::unique_lock lock(mutex_);
+    write_record(key, header, value.text());
+    compact_if_needed();
+}
+
+std::optional<std::string> LogStore::get(const std::string& key) const {
+    const uint32_t hash = HashTable<Entry>::hash_of(key);
+    std::shared_lock lock(mutex_);
+    const Entry* entry = data_.find(key, hash);
+    if (!entry)
+        return std::nullopt;
+    if (hot_keys_)
+        hot_keys_->record(key, hash);
+    return read_value(*entry);
+}
+
+bool LogStore::read(const std::string& key, const std::function<void(std::string_view)>& reader) const {
+    std::optional<std::string> value = get(key);
+    if (value)
+        reader(*value);
+    return value.has_value();
+}
+
+bool LogStore::read_stored(const std::string& key,
+                           const std::function<void(std::string_view, size_t)>& reader) const {
+    return read(key, [&reader](std::string_view value) {
+        reader(value, 0);
+    });
+}
+
+bool LogStore::del(const std::string& key) {
+    std::unique_lock lock(mutex_);
+    if (!data_.find(key))
+        return false;
+    write_record(key, encode(key, std::nullopt), std::nullopt);
+    compact_if_needed();
+    return true;
+}
+
+bool LogStore::unlink(const std::string& key) {
+    return del(key);
+}
+
+bool LogStore::exists(const std::string& key) const {
+    std::shared_lock lock(mutex_);
+    return data_.find(key) != nullptr;
+}
+
+size_t LogStore::size() const {
+    std::shared_lock lock(mutex_);
+    return data_.size();
+}
+
+int64_t LogStore::incr_by(const std::string& key, int64_t delta) {
+    std::unique_lock lock(mutex_);
+    int64_t current = 0;
+    if (const Entry* existing = data_.find(key)) {
+        // Same rule as KvStore: only strings that round-trip are integers
+        std::string text = read_value(*existing);
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), current);
+        if (ec != std::errc{} || ptr != text.data() + text.size() || std::to_string(current) != text)
+            throw StoreError{"value is not an integer"};
+    }
+
+    // Same check as KvStore, portable to compilers without overflow builtins
+    if (delta > 0 ? current > std::numeric_limits<int64_t>::max() - delta
+                  : current < std::numeric_limits<int64_t>::min() - delta)
+        throw StoreError{"increment would overflow"};
+    int64_t result = current + delta;
+    std::string text = std::to_string(result);
+    write_record(key, encode(key, text), text);
+    compact_if_needed();
+    return result;
+}
+
+size_t LogStore::append(const std::string& key, const std::string& suffix) {
+    std::unique_lock lock(mutex_);
+    const Entry* existing = data_.find(key);
+    std::string value = existing ? read_value(*existing) : std::string{};
+    value += suffix;
+    write_record(key, encode(key, value), value);
+    compact_if_needed();
+    return value.size();
+}
+
+std::optional<std::string> LogStore::getset(const std::string& key, const std::string& value) {
+    Header header = encode(key, value);
+    std::unique_lock lock(mutex_);
+    const Entry* existing = data_.find(key);
+    std::optional<std::string> previous;
+    if (existing)
+        previous = read_value(*existing);
+    write_record(key, header, value);
+    compact_if_needed();
+    return previous;
+}
+
+bool LogStore::setnx(const std::string& key, const std::string& value) {
+    Header header = encode(key, value);
+    std::unique_lock lock(mutex_);
+    if (data_.find(key))
+        return false;
+    write_record(key, header, value);
+    compact_if_needed();
+    return true;
+}
+
+std::optional<VersionedValue> LogStore::get_versioned(const std::string& key) const {
+    const uint32_t hash = HashTable<Entry>::hash_of(key);
+    std::shared_lock lock(mutex_);
+    const Entry* entry = data_.find(key, hash);
+    if (!entry)
+        return std::nullopt;
+    if (hot_keys_)
+        hot_keys_->record(key, hash);
+    return VersionedValue{read_value(*entry), entry->version};
+}
+
+bool LogStore::compare_and_set(const std::string& key, uint64_t expected_version, const std::string& value) {
+    Header header = encode(key, value);
+    std::unique_lock lock(mutex_);
+    const Entry* existing = data_.find(key);
+    if ((existing ? existing->version : 0) != expected_version)
+        return false;
+    write_record(key, header, value);
+    compact_if_needed();
+    return true;
+}
+
+bool LogStore::has_ordered_index() const noexcept {
+    return options_.ordered_index;
+}
+
+size_t LogStore::scan(size_t cursor, size_t count, std::vector<std::string>& keys) const {
+    // Clamped first, so a huge COUNT neither overflows the bucket budget nor walks the whole table
+    count = std::min(count, SCAN_MAX_COUNT);
+    std::shared_lock lock(mutex_);
+    return data_.scan(cursor, count, count * SCAN_BUCKETS_PER_KEY,
+        [&keys](std::string_view key, const Entry&) {
+            keys.emplace_back(key);
+        });
+}
+
+std::vector<HotKey> LogStore::hot_keys(size_t count) const {
+    return hot_keys_ ? hot_keys_->top(count) : std::vector<HotKey>{};
+}
+
+void LogStore::compact_if_needed() {
+    if (end_ < std::max(options_.compaction_min_bytes, retry_compaction_at_) ||
+        static_cast<double>(dead_bytes_) < options_.compaction_dead_ratio * static_cast<double>(end_))
+        return;
+    try {
+        compact_locked();
+    } catch (const StoreError& e) {
+        // The write itself went through. Try again once the log has grown some more.
+        KV_LOG(Error, "Log compaction failed: ", e.what());
+        retry_compaction_at_ = end_ + options_.compaction_min_bytes;
+    }
+}
+
+void LogStore::compact() {
+    std::unique_lock lock(mutex_);
+    compact_locked();
+}
+
+void LogStore::compact_locked() {
+    std::string compact_path = path_ + ".compact";
+    int fd = ::open(compact_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0)
+        throw StoreError{error_text("log compaction failed", errno)};
+
+    // Copy every live record as is, checksum included, and remember where it went
+    std::vector<std::pair<std::string, uint64_t>> moved;
+    moved.reserve(data_.size());
+    uint64_t end = 0;
+    int err = 0;
+    std::string record;
+    data_.for_each([&](std::string_view key, const Entry& entry) {
+        if (err != 0)
+            return;
+        record.resize(entry.record_bytes());
+        auto size = static_cast<ssize_t>(record.size());
+        ssize_t n = ::pread(fd_, record.data(), record.size(), static_cast<off_t>(entry.offset));
+        if (n == size)
+            n = ::pwrite(fd, record.data(), record.size(), static_cast<off_t>(end));
+        if (n != size) {
+            err = n < 0 ? errno : EIO;
+            return;
+        }
+        moved.emplace_back(key, end);
+        end += record.size();
+    });
+    // The new file must be complete on disk before it replaces the old one
+    if (err == 0 && ::fsync(fd) != 0)
+        err = errno;
+    if (err == 0 && ::rename(compact_path.c_str(), path_.c_str()) != 0)
+        err = errno;
+    if (err != 0) {
+        ::close(fd);
+        ::unlink(compact_path.c_str());
+        throw StoreError{error_text("log compaction failed", err)};
+    }
+    if (int dir = ::open(options_.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); dir >= 0) {
+        ::fsync(dir); // makes the rename durable
+        ::close(dir);
+    }
+
+    ::close(fd_);
+    fd_ = fd;
+    end_ = end;
+    dead_bytes_ = 0;
+    retry_compaction_at_ = 0;
+    for (const auto& [key, offset] : moved)
+        data_.find(key)->offset = offset;
+}
+
+size_t LogStore::log_bytes() const {
+    std::shared_lock lock(mutex_);
+    return end_;
+}
+
+size_t LogStore::live_bytes() const {
+    std::shared_lock lock(mutex_);
+    return end_ - dead_bytes_;
+}
+
+void LogStore::scan_prefix(std::string_view prefix, size_t limit, const PageCallback& on_page,
+                           std::string_view from) const {
+    scan_index(std::max(prefix, from), limit, [prefix](const std::string& key) {
+        return key.starts_with(prefix);
+    }, on_page);
+}
+
+void LogStore::scan_range(std::string_view start, std::string_view end, size_t limit,
+                          const PageCallback& on_page) const {
+    scan_index(start, limit, [end](const std::string& key) {
+        return key < end;
+    }, on_page);
+}
+
+void LogStore::scan_index(std::string_view start, size_t limit,
+                          const std::function<bool(const std::string&)>& in_bounds,
+                          const PageCallback& on_page) const {
+    size_t remaining = limit == 0 ? std::numeric_limits<size_t>::max() : limit;
+    std::string resume_key{start};
+    bool first_page = true;
+    std::vector<std::string> page;
+
+    while (remaining > 0) {
+        page.clear();
+        bool exhausted = false;
+        {
+            std::shared_lock lock(mutex_);
+            auto it = first_page ? index_.lower_bound(resume_key) : index_.upper_bound(resume_key);
+            size_t page_limit = std::min(SCAN_PAGE_SIZE, remaining);
+            while (it != index_.end() && page.size() < page_limit && in_bounds(*it)) {
+                page.push_back(*it);
+                ++it;
+            }
+            exhausted = it == index_.end() || !in_bounds(*it);
+        }
+
+        if (page.empty())
+            break;
+
+        remaining -= page.size();
+        resume_key = page.back();
+        first_page = false;
+        on_page(page);
+
+        if (exhausted)
+            break;
+    }
+}
+
+} // namespace kv
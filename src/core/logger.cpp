@@ -0,0 +1,249 @@
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+constexpr auto COLLECT_INTERVAL = std::chrono::milliseconds(20);
+
+/*
+ * One producer (its thread), one consumer (the background thread).
+ * head and tail only grow, a slot is head % SLOTS.
+ */
+struct Ring {
+    static constexpr size_t SLOTS = 512;
+
+    explicit Ring(uint32_t thread) : thread(thread) {}
+
+    std::array<Logger::Record, SLOTS> records;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+    std::atomic<bool> retired{false}; // its thread exited
+    const uint32_t thread;
+};
+
+class Backend {
+public:
+    Backend() : thread_([this](std::stop_token stop_token) { run(stop_token); }) {}
+
+    ~Backend() {
+        thread_.request_stop();
+        wakeup_.notify_all();
+        thread_.join();
+    }
+
+    std::shared_ptr<Ring> register_thread() {
+        std::lock_guard lock(mutex_);
+        auto ring = std::make_shared<Ring>(next_thread_++);
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    void set_output(int fd) {
+        std::lock_guard lock(mutex_);
+        output_ = fd;
+    }
+
+    void flush() {
+        std::unique_lock lock(mutex_);
+        uint64_t ticket = ++flush_requested_;
+        wakeup_.notify_all();
+        flushed_.wait(lock, [&]() { return flushed_up_to_ >= ticket; });
+    }
+
+    std::atomic<uint64_t> dropped{0};
+
+private:
+    std::mutex mutex_; // rings_, output_ and the flush counters, never taken by a logging thread once registered
+    std::condition_variable_any wakeup_;
+    std::condition_variable flushed_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+    uint32_t next_thread_{1};
+    int output_{STDOUT_FILENO};
+    uint64_t flush_requested_{0};
+    uint64_t flushed_up_to_{0};
+    uint64_t dropped_reported_{0};
+    std::vector<Logger::Record> batch_;
+    std::string text_;
+    std::jthread thread_; // last, so it starts after everything above exists
+
+    void run(std::stop_token stop_token) {
+        std::unique_lock lock(mutex_);
+        while (true) {
+            wakeup_.wait_for(lock, stop_token, COLLECT_INTERVAL,
+                             [&]() { return flush_requested_ > flushed_up_to_; });
+            uint64_t ticket = flush_requested_;
+            collect();
+            int output = output_;
+            lock.unlock();
+            write_batch(output);
+            lock.lock();
+            flushed_up_to_ = ticket;
+            flushed_.notify_all();
+            if (stop_token.stop_requested())
+                return;
+        }
+    }
+
+    // Caller holds mutex_
+    void collect() {
+        for (auto& ring : rings_) {
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail)
+                batch_.push_back(ring->records[tail % Ring::SLOTS]);
+            ring->tail.store(tail, std::memory_order_release);
+        }
+        std::erase_if(rings_, [](const std::shared_ptr<Ring>& ring) {
+            return ring->retired.load(std::memory_order_acquire) &&
+                   ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+        });
+    }
+
+    void write_batch(int output) {
+        // Rings are collected one after another, restore the order across threads
+        std::stable_sort(batch_.begin(), batch_.end(), [](const Logger::Record& a, const Logger::Record& b) {
+            return a.timestamp_ns < b.timestamp_ns;
+        });
+
+        time_t cached_second = -1;
+        char date[32] = {};
+        for (const Logger::Record& record : batch_) {
+            time_t second = static_cast<time_t>(record.timestamp_ns / 1'000'000'000);
+            if (second != cached_second) {
+                tm utc{};
+                gmtime_r(&second, &utc);
+                strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &utc);
+                cached_second = second;
+            }
+            char prefix[96];
+            int n = snprintf(prefix, sizeof(prefix), "%s.%06uZ %-5.*s [%u] ", date,
+                             static_cast<unsigned>(record.timestamp_ns / 1000 % 1'000'000),
+                             static_cast<int>(Logger::level_name(record.level).size()),
+                             Logger::level_name(record.level).data(), record.thread);
+            text_.append(prefix, static_cast<size_t>(n));
+            text_.append(record.text, record.size);
+            text_.push_back('\n');
+        }
+        batch_.clear();
+
+        uint64_t dropped_now = dropped.load(std::memory_order_relaxed);
+        if (dropped_now != dropped_reported_) {
+            text_ += "[logger] " + std::to_string(dropped_now - dropped_reported_) + " messages dropped\n";
+            dropped_reported_ = dropped_now;
+        }
+
+        size_t written = 0;
+        while (written < text_.size()) {
+            ssize_t n = ::write(output, text_.data() + written, text_.size() - written);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                break; // nowhere to report it
+            }
+            written += static_cast<size_t>(n);
+        }
+        text_.clear();
+    }
+};
+
+Backend& backend() {
+    static Backend instance;
+    return instance;
+}
+
+// Marks the thread's ring retired when the thread exits, the background thread frees it once drained
+struct ThreadRing {
+    std::shared_ptr<Ring> ring = backend().register_thread();
+    ~ThreadRing() { ring->retired.store(true, std::memory_order_release); }
+};
+
+Ring& thread_ring() {
+    thread_local ThreadRing holder;
+    return *holder.ring;
+}
+
+} // namespace
+
+
+Logger::Record* Logger::begin_record() noexcept {
+    Ring& ring = thread_ring();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == Ring::SLOTS) {
+        backend().dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Record& record = ring.records[head % Ring::SLOTS];
+    record.timestamp_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    return &record;
+}
+
+void Logger::commit_record(LogLevel level, size_t size) noexcept {
+    Ring& ring = thread_ring();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    Record& record = ring.records[head % Ring::SLOTS];
+    record.thread = ring.thread;
+    record.level = level;
+    record.size = static_cast<uint16_t>(size);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Logger::set_level(LogLevel level) noexcept {
+    s_level.store(level, std::memory_order_relaxed);
+}
+
+LogLevel Logger::level() noexcept {
+    return s_level.load(std::memory_order_relaxed);
+}
+
+std::optional<LogLevel> Logger::parse_level(std::string_view name) noexcept {
+    for (auto level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warn, LogLevel::Error, LogLevel::Off}) {
+        std::string_view candidate = level_name(level);
+        if (std::equal(name.begin(), name.end(), candidate.begin(), candidate.end(),
+                       [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == b; }))
+            return level;
+    }
+    return std::nullopt;
+}
+
+std::string_view Logger::level_name(LogLevel level) noexcept {
+    switch (level) {
+    case LogLevel::Debug: return "DEBUG";
+    case LogLevel::Info: return "INFO";
+    case LogLevel::Warn: return "WARN";
+    case LogLevel::Error: return "ERROR";
+    case LogLevel::Off: return "OFF";
+    }
+    return "?";
+}
+
+void Logger::set_output(int fd) {
+    backend().flush();
+    backend().set_output(fd);
+}
+
+void Logger::flush() {
+    backend().flush();
+}
+
+uint64_t Logger::dropped() noexcept {
+    return backend().dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace kv
@@ -0,0 +1,192 @@
+#include "kv/lz4.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+
+namespace kv {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+// Format rules: the last 5 bytes are literals, the last match starts 12 bytes before the end
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_FIND_LIMIT = 12;
+constexpr int HASH_LOG = 14;
+// Step further ahead the longer nothing matched, so incompressible data stays cheap
+constexpr int SKIP_TRIGGER = 6;
+
+uint32_t read32(const uint8_t* p) noexcept {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint64_t read64(const uint8_t* p) noexcept {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+// Length of the common prefix of a and b, stopping at a_end
+size_t common_length(const uint8_t* a, const uint8_t* b, const uint8_t* a_end) noexcept {
+    const uint8_t* start = a;
+    while (a_end - a >= 8) {
+        // Little-endian: the lowest differing byte is the first mismatch
+        uint64_t diff = read64(a) ^ read64(b);
+        if (diff)
+            return a - start + __builtin_ctzll(diff) / 8;
+        a += 8;
+        b += 8;
+    }
+    while (a < a_end && *a == *b) {
+        ++a;
+        ++b;
+    }
+    return a - start;
+}
+
+uint32_t hash(uint32_t sequence) noexcept {
+    return (sequence * 2654435761U) >> (32 - HASH_LOG);
+}
+
+uint8_t* write_length(uint8_t* out, size_t length) noexcept {
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+uint8_t* write_sequence(uint8_t* out, const uint8_t* literals, size_t literal_length,
+                        size_t offset, size_t match_length) noexcept {
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4);
+    if (literal_length >= 15)
+        out = write_length(out, literal_length - 15);
+    std::memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length == 0)
+        return out; // last sequence, literals only
+
+    *out++ = static_cast<uint8_t>(offset);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+    size_t extra = match_length - MIN_MATCH;
+    *token |= static_cast<uint8_t>(std::min<size_t>(extra, 15));
+    if (extra >= 15)
+        out = write_length(out, extra - 15);
+    return out;
+}
+
+// Reads the 255-continued part of a length, returns false past the end of input
+bool read_length(const uint8_t*& in, const uint8_t* end, size_t& length) noexcept {
+    uint8_t byte;
+    do {
+        if (in == end)
+            return false;
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+size_t Lz4::max_compressed_size(size_t size) noexcept {
+    return size + size / 255 + 16;
+}
+
+size_t Lz4::compress(std::string_view src, char* dst) noexcept {
+    const auto* in = reinterpret_cast<const uint8_t*>(src.data());
+    auto* out = reinterpret_cast<uint8_t*>(dst);
+    size_t size = src.size();
+    size_t anchor = 0;
+
+    if (size > MATCH_FIND_LIMIT) {
+        // Last position seen for each hashed 4-byte sequence
+        auto table = std::make_unique<uint32_t[]>(size_t{1} << HASH_LOG);
+        size_t match_limit = size - LAST_LITERALS;
+        size_t pos = 1;
+        size_t misses = 0;
+
+        while (pos < size - MATCH_FIND_LIMIT) {
+            uint32_t sequence = read32(in + pos);
+            uint32_t& slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos);
+
+            if (pos - candidate > MAX_OFFSET || read32(in + candidate) != sequence) {
+                pos += 1 + (misses++ >> SKIP_TRIGGER);
+                continue;
+            }
+            misses = 0;
+
+            size_t length = MIN_MATCH + common_length(in + pos + MIN_MATCH, in + candidate + MIN_MATCH,
+                                                      in + match_limit);
+            // The bytes before may match too
+            while (pos > anchor && candidate > 0 && in[pos - 1] == in[candidate - 1]) {
+                --pos;
+                --candidate;
+                ++length;
+            }
+
+            out = write_sequence(out, in + anchor, pos - anchor, pos - candidate, length);
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    out = write_sequence(out, in + anchor, size - anchor, 0, 0);
+    return out - reinterpret_cast<uint8_t*>(dst);
+}
+
+bool Lz4::decompress(std::string_view src, char* dst, size_t dst_size) noexcept {
+    const auto* in = reinterpret_cast<const uint8_t*>(src.data());
+    const uint8_t* in_end = in + src.size();
+    auto* out = reinterpret_cast<uint8_t*>(dst);
+    uint8_t* out_end = out + dst_size;
+
+    while (in < in_end) {
+        uint8_t token = *in++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(in, in_end, literal_length))
+            return false;
+        if (literal_length > static_cast<size_t>(in_end - in) ||
+            literal_length > static_cast<size_t>(out_end - out))
+            return false;
+        std::memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        if (in == in_end)
+            break; // the last sequence has no match
+
+        if (in_end - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - reinterpret_cast<uint8_t*>(dst)))
+            return false;
+
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length(in, in_end, match_length))
+            return false;
+        match_length += MIN_MATCH;
+        if (match_length > static_cast<size_t>(out_end - out))
+            return false;
+
+        const uint8_t* match = out - offset;
+        if (offset >= match_length) {
+            std::memcpy(out, match, match_length);
+            out += match_length;
+        } else {
+            // Overlapping copy repeats the last `offset` bytes
+            for (size_t i = 0; i < match_length; ++i)
+                *out++ = match[i];
+        }
+    }
+    return out == out_end;
+}
+
+} // namespace kv
@@ -1,9 +1,194 @@
 #include "kv/protocol.hpp"
+#include "kv/command_table.hpp"
 #include <stdexcept>
-#include <algorithm>
+#include <charconv>
+#include <limits>
 
 namespace kv {
 
+namespace {
+
+using Tokens = std::vector<std::string_view>;
+
+size_t parse_number(std::string_view token, std::string_view what) {
+    size_t number = 0;
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), number);
+    if (ec != std::errc{} || ptr != token.data() + token.size())
+        throw ProtocolError{std::string{what} + " must be a non-negative integer"};
+    return number;
+}
+
+int64_t parse_signed(std::string_view token, std::string_view what) {
+    int64_t number = 0;
+    auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), number);
+    if (ec != std::errc{} || ptr != token.data() + token.size())
+        throw ProtocolError{std::string{what} + " must be an integer"};
+    return number;
+}
+
+// The size of a payload that follows the command line. Throws PayloadError
+// above `limit`, the connection is out of step with the client from there.
+size_t parse_payload_size(std::string_view token, size_t limit, const char* too_large) {
+    size_t size = parse_number(token, "size");
+    if (size > limit)
+        throw PayloadError{too_large, size};
+    return size;
+}
+
+// LIMIT n from `idx` on, and FROM key too where `from` is given, in any order
+size_t parse_limit(const Tokens& tokens, size_t idx, std::string* from = nullptr) {
+    const char* expected = from ? "expected LIMIT <n> or FROM <key>" : "expected LIMIT <n>";
+    size_t limit = 0;
+    for (; idx < tokens.size(); idx += 2) {
+        if (idx + 1 == tokens.size())
+            throw ProtocolError{expected};
+        if (limit == 0 && equals_folded(tokens[idx], "limit")) {
+            limit = parse_number(tokens[idx + 1], "LIMIT");
+            if (limit == 0)
+                throw ProtocolError{"LIMIT must be a positive integer"};
+        } else if (from && from->empty() && equals_folded(tokens[idx], "from")) {
+            *from = tokens[idx + 1];
+        } else {
+            throw ProtocolError{expected};
+        }
+    }
+    return limit;
+}
+
+/*
+ * One command verb. parse() is only called with min_tokens to max_tokens
+ * tokens, the verb included, otherwise arity_error is thrown. Commands
+ * whose forms differ by more than a count check the rest themselves.
+ */
+struct CommandSpec {
+    std::string_view name;
+    size_t min_tokens;
+    size_t max_tokens;
+    std::string_view arity_error;
+    Command (*parse)(const Tokens& tokens);
+};
+
+constexpr size_t ANY = std::numeric_limits<size_t>::max();
+
+// Adding a command takes one entry here, in lowercase
+constexpr CommandTable COMMANDS{std::array{
+    CommandSpec{"get", 2, 2, "GET requires exactly one argument", [](const Tokens& t) -> Command {
+        return Get{ std::string{t[1]} };
+    }},
+    CommandSpec{"set", 3, 3, "SET requires exactly two arguments", [](const Tokens& t) -> Command {
+        return Set{ std::string{t[1]}, std::string{t[2]} };
+    }},
+    CommandSpec{"del", 2, 2, "DEL requires exactly one argument", [](const Tokens& t) -> Command {
+        return Del{ std::string{t[1]} };
+    }},
+    CommandSpec{"unlink", 2, 2, "UNLINK requires exactly one argument", [](const Tokens& t) -> Command {
+        return Unlink{ std::string{t[1]} };
+    }},
+    CommandSpec{"ping", 1, 1, "PING requires exactly zero argument", [](const Tokens&) -> Command {
+        return Ping{ };
+    }},
+    CommandSpec{"incr", 2, 2, "INCR/DECR require exactly one argument", [](const Tokens& t) -> Command {
+        return Incr{ std::string{t[1]}, 1 };
+    }},
+    CommandSpec{"decr", 2, 2, "INCR/DECR require exactly one argument", [](const Tokens& t) -> Command {
+        return Incr{ std::string{t[1]}, -1 };
+    }},
+    CommandSpec{"incrby", 3, 3, "INCRBY requires exactly two arguments", [](const Tokens& t) -> Command {
+        return Incr{ std::string{t[1]}, parse_signed(t[2], "increment") };
+    }},
+    CommandSpec{"append", 3, 3, "APPEND requires exactly two arguments", [](const Tokens& t) -> Command {
+        return Append{ std::string{t[1]}, std::string{t[2]} };
+    }},
+    CommandSpec{"getset", 3, 3, "GETSET requires exactly two arguments", [](const Tokens& t) -> Command {
+        return GetSet{ std::string{t[1]}, std::string{t[2]} };
+    }},
+    CommandSpec{"setnx", 3, 3, "SETNX requires exactly two arguments", [](const Tokens& t) -> Command {
+        return SetNx{ std::string{t[1]}, std::string{t[2]} };
+    }},
+    CommandSpec{"gets", 2, 2, "GETS requires exactly one argument", [](const Tokens& t) -> Command {
+        return Gets{ std::string{t[1]} };
+    }},
+    CommandSpec{"cas", 4, 4, "CAS requires exactly three arguments", [](const Tokens& t) -> Command {
+        return Cas{ std::string{t[1]}, parse_number(t[2], "version"), std::string{t[3]} };
+    }},
+    CommandSpec{"mget", 2, ANY, "MGET requires at least one key", [](const Tokens& t) -> Command {
+        MGet mget;
+        mget.keys.assign(t.begin() + 1, t.end());
+        return mget;
+    }},
+    CommandSpec{"mset", 3, ANY, "MSET requires key value pairs", [](const Tokens& t) -> Command {
+        if (t.size() % 2 == 0)
+            throw ProtocolError{"MSET requires key value pairs"};
+        MSet mset;
+        mset.pairs.reserve(t.size() / 2);
+        for (size_t i = 1; i < t.size(); i += 2)
+            mset.pairs.emplace_back(t[i], t[i + 1]);
+        return mset;
+    }},
+    CommandSpec{"scan", 2, 6, "SCAN requires a prefix, an optional LIMIT and FROM", [](const Tokens& t) -> Command {
+        // SCAN cursor COUNT n, told apart from the prefix form by the COUNT keyword
+        if (t.size() == 4 && equals_folded(t[2], "count")) {
+            size_t count = parse_number(t[3], "COUNT");
+            if (count == 0)
+                throw ProtocolError{"COUNT must be a positive integer"};
+            return CursorScan{ parse_number(t[1], "cursor"), count };
+        }
+        Scan scan{ std::string{t[1]}, 0, "" };
+        scan.limit = parse_limit(t, 2, &scan.from);
+        return scan;
+    }},
+    CommandSpec{"range", 3, 5, "RANGE requires start, end and an optional LIMIT", [](const Tokens& t) -> Command {
+        if (t.size() == 4)
+            throw ProtocolError{"RANGE requires start, end and an optional LIMIT"};
+        return Range{ std::string{t[1]}, std::string{t[2]}, parse_limit(t, 3) };
+    }},
+    CommandSpec{"setblob", 3, 3, "SETBLOB requires exactly two arguments", [](const Tokens& t) -> Command {
+        return SetBlob{ std::string{t[1]}, parse_payload_size(t[2], Protocol::MAX_BLOB_SIZE, "blob too large"), nullptr };
+    }},
+    CommandSpec{"getblob", 2, 3, "GETBLOB requires a key and an optional COMPRESSED", [](const Tokens& t) -> Command {
+        if (t.size() == 3 && !equals_folded(t[2], "compressed"))
+            throw ProtocolError{"GETBLOB requires a key and an optional COMPRESSED"};
+        return GetBlob{ std::string{t[1]}, t.size() == 3 };
+    }},
+    CommandSpec{"load", 2, 3, "LOAD requires a size or FILE name", [](const Tokens& t) -> Command {
+        if (t.size() == 3 && equals_folded(t[1], "file"))
+            return Load{ std::string{t[2]}, 0, nullptr };
+        if (t.size() != 2)
+            throw ProtocolError{"LOAD requires a size or FILE name"};
+        return Load{ "", parse_payload_size(t[1], Protocol::MAX_LOAD_SIZE, "bulk stream too large, use LOAD FILE"),
+                     nullptr };
+    }},
+    CommandSpec{"dump", 1, 3, "DUMP takes no arguments or FILE name", [](const Tokens& t) -> Command {
+        if (t.size() == 3 && equals_folded(t[1], "file"))
+            return Dump{ std::string{t[2]} };
+        if (t.size() != 1)
+            throw ProtocolError{"DUMP takes no arguments or FILE name"};
+        return Dump{ };
+    }},
+    CommandSpec{"slowlog", 2, 3, "SLOWLOG requires GET [count], LEN or RESET", [](const Tokens& t) -> Command {
+        if (equals_folded(t[1], "get"))
+            return SlowLog{ SlowLog::Action::Get, t.size() == 3 ? parse_number(t[2], "count") : 10 };
+        if (t.size() == 2 && equals_folded(t[1], "len"))
+            return SlowLog{ SlowLog::Action::Len };
+        if (t.size() == 2 && equals_folded(t[1], "reset"))
+            return SlowLog{ SlowLog::Action::Reset };
+        throw ProtocolError{"SLOWLOG requires GET [count], LEN or RESET"};
+    }},
+    CommandSpec{"hotkeys", 1, 2, "HOTKEYS takes at most one argument", [](const Tokens& t) -> Command {
+        return HotKeys{ t.size() == 2 ? parse_number(t[1], "count") : 10 };
+    }},
+    CommandSpec{"cluster", 2, 2, "CLUSTER requires SLOTS", [](const Tokens& t) -> Command {
+        if (!equals_folded(t[1], "slots"))
+            throw ProtocolError{"CLUSTER requires SLOTS"};
+        return ClusterSlots{ };
+    }},
+    CommandSpec{"workers", 1, 1, "WORKERS takes no arguments", [](const Tokens&) -> Command {
+        return Workers{ };
+    }},
+}};
+
+} // namespace
+
 
 Command Protocol::parse(std::string_view line) {
     // CRLF tolerance (windows, telnet, netcat)
@@ -35,58 +220,54 @@ Command Protocol::parse(std::string_view line) {
         return NoOp{ };
     }
 
-    return parse_tokens(tokens);
+    const CommandSpec* spec = COMMANDS.find(tokens[0]);
+    if (!spec)
+        throw ProtocolError{"unknown command"};
+    if (tokens.size() < spec->min_tokens || tokens.size() > spec->max_tokens)
+        throw ProtocolError{std::string{spec->arity_error}};
+    return spec->parse(tokens);
 }
 
-Command Protocol::parse_tokens(const std::vector<std::string_view>& tokens) {
-    std::string cmd{tokens[0]};
-    std::transform(cmd.begin(), cmd.end(), cmd.begin(), [](unsigned char c) {
-        return std::tolower(c);
-    });
-
-    if (cmd == "get") {
-        if (tokens.size() != 2)
-            throw ProtocolError{"GET requires exactly one argument"};
-
-        return Get{ std::string{tokens[1]} };
-    }
-
-    if (cmd == "set") {
-        if (tokens.size() != 3)
-            throw ProtocolError{"SET requires exactly two arguments"};
+std::string Protocol::format_ok() {
+    return "+OK\n";
+}
 
-        return Set{
-            std::string{tokens[1]},
-            std::string{tokens[2]}
-        };
-    }
+std::string Protocol::format_error(std::string_view message) {
+    return "-ERR " + std::string{message} + "\n";
+}
 
-    if (cmd == "del") {
-        if (tokens.size() != 2)
-            throw ProtocolError{"DEL requires exactly one argument"};
+std::string Protocol::format_moved(uint16_t slot, std::string_view node) {
+    return "-MOVED " + std::to_string(slot) + " " + std::string{node} + "\n";
+}
 
-        return Del{ std::string{tokens[1]} };
-    }
+std::string Protocol::format_value(std::string_view value) {
+    return "$" + std::string{value} + "\n";
+}
 
-    if (cmd == "ping") {
-        if (tokens.size() != 1)
-            throw ProtocolError{"PING requires exactly zero argument"};
-        return Ping{ };
-    }
+std::string Protocol::format_integer(int64_t value) {
+    return ":" + std::to_string(value) + "\n";
+}
 
-    throw ProtocolError{"unknown command"};
+std::string Protocol::format_nil() {
+    return "_\n";
 }
 
-std::string Protocol::format_ok() {
-    return "+OK\n";
+std::string Protocol::format_blob_header(size_t size) {
+    return "=" + std::to_string(size) + "\n";
 }
 
-std::string Protocol::format_error(std::string_view message) {
-    return "-ERR " + std::string{message} + "\n";
+std::string Protocol::format_compressed_blob_header(size_t size, size_t uncompressed_size) {
+    return "~" + std::to_string(size) + " " + std::to_string(uncompressed_size) + "\n";
 }
 
-std::string Protocol::format_value(std::string_view value) {
-    return "$" + std::string{value} + "\n";
+std::string Protocol::format_array(const std::vector<std::string>& values) {
+    std::string out = "*" + std::to_string(values.size()) + "\n";
+    for (const auto& value : values) {
+        out += '$';
+        out += value;
+        out += '\n';
+    }
+    return out;
 }
 
 } // namespace kv
@@ -0,0 +1,230 @@
+#include "kv/slab_allocator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace kv {
+
+namespace {
+
+// 16 byte steps up to 128, then four classes per power of two up to 4096
+constexpr std::array<size_t, 28> CLASS_SIZES = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+};
+constexpr size_t NUM_CLASSES = CLASS_SIZES.size();
+
+static_assert(CLASS_SIZES.back() == SlabAllocator::MAX_SMALL_SIZE);
+
+// Maps (size + 15) / 16 to its size class
+constexpr auto CLASS_LOOKUP = [] {
+    std::array<uint8_t, SlabAllocator::MAX_SMALL_SIZE / 16 + 1> lookup{};
+    size_t cls = 0;
+    for (size_t i = 0; i < lookup.size(); ++i) {
+        while (CLASS_SIZES[cls] < i * 16)
+            ++cls;
+        lookup[i] = static_cast<uint8_t>(cls);
+    }
+    return lookup;
+}();
+
+constexpr size_t class_of(size_t size) noexcept {
+    return CLASS_LOOKUP[(size + 15) / 16];
+}
+
+constexpr size_t SLAB_BYTES = 64 * 1024;
+constexpr size_t MIN_BLOCKS_PER_SLAB = 16;
+// Blocks moved between a thread cache and the depot at once
+constexpr size_t BATCH_SIZE = 32;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+// Shared per-class free lists, refilled from fresh slabs when empty
+class Depot {
+public:
+    ~Depot() {
+        for (auto& cls : classes_)
+            for (void* slab : cls.slabs)
+                ::operator delete(slab);
+    }
+
+    // Moves up to BATCH_SIZE blocks into `head`, returns how many
+    size_t take_batch(size_t cls_idx, FreeBlock*& head) {
+        auto& cls = classes_[cls_idx];
+        std::lock_guard lock(cls.mutex);
+        if (!cls.free_list)
+            grow(cls, CLASS_SIZES[cls_idx]);
+
+        size_t taken = 0;
+        while (cls.free_list && taken < BATCH_SIZE) {
+            FreeBlock* block = cls.free_list;
+            cls.free_list = block->next;
+            block->next = head;
+            head = block;
+            ++taken;
+        }
+        return taken;
+    }
+
+    // Returns a chain of blocks ending in `tail`
+    void give_back(size_t cls_idx, FreeBlock* head, FreeBlock* tail) noexcept {
+        auto& cls = classes_[cls_idx];
+        std::lock_guard lock(cls.mutex);
+        tail->next = cls.free_list;
+        cls.free_list = head;
+    }
+
+    size_t reserved_bytes() const noexcept {
+        return reserved_bytes_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct SizeClass {
+        std::mutex mutex;
+        FreeBlock* free_list = nullptr;
+        std::vector<void*> slabs;
+    };
+
+    std::array<SizeClass, NUM_CLASSES> classes_;
+    std::atomic<size_t> reserved_bytes_{0};
+
+    void grow(SizeClass& cls, size_t block_size) {
+        size_t slab_size = std::max(SLAB_BYTES, block_size * MIN_BLOCKS_PER_SLAB);
+        auto* slab = static_cast<char*>(::operator new(slab_size));
+        cls.slabs.push_back(slab);
+        reserved_bytes_.fetch_add(slab_size, std::memory_order_relaxed);
+
+        for (size_t offset = 0; offset + block_size <= slab_size; offset += block_size) {
+            auto* block = reinterpret_cast<FreeBlock*>(slab + offset);
+            block->next = cls.free_list;
+            cls.free_list = block;
+        }
+    }
+};
+
+Depot& depot() {
+    static Depot instance;
+    return instance;
+}
+
+// Set once this thread's cache is gone, e.g. while statics are destroyed
+// after thread_locals at exit. Trivially destructible, so always readable.
+thread_local bool t_cache_destroyed = false;
+
+// Per-thread free lists, flushed back to the depot when the thread exits
+class ThreadCache {
+public:
+    ThreadCache() : depot_(depot()) {} // constructs the depot first so it outlives us
+
+    ~ThreadCache() {
+        t_cache_destroyed = true;
+        for (size_t cls = 0; cls < NUM_CLASSES; ++cls) {
+            if (lists_[cls].head)
+                flush(cls, lists_[cls].count);
+        }
+    }
+
+    void* allocate(size_t cls) {
+        auto& list = lists_[cls];
+        if (!list.head)
+            list.count += depot_.take_batch(cls, list.head);
+
+        FreeBlock* block = list.head;
+        list.head = block->next;
+        --list.count;
+        return block;
+    }
+
+    void deallocate(void* ptr, size_t cls) noexcept {
+        auto& list = lists_[cls];
+        auto* block = static_cast<FreeBlock*>(ptr);
+        block->next = list.head;
+        list.head = block;
+        if (++list.count > 2 * BATCH_SIZE)
+            flush(cls, BATCH_SIZE);
+    }
+
+private:
+    struct List {
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+    };
+
+    Depot& depot_;
+    std::array<List, NUM_CLASSES> lists_{};
+
+    void flush(size_t cls, size_t count) noexcept {
+        auto& list = lists_[cls];
+        FreeBlock* head = list.head;
+        FreeBlock* tail = head;
+        size_t moved = 1;
+        while (moved < count && tail->next) {
+            tail = tail->next;
+            ++moved;
+        }
+
+        list.head = tail->next;
+        list.count -= moved;
+        depot_.give_back(cls, head, tail);
+    }
+};
+
+ThreadCache& thread_cache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+} // namespace
+
+void* SlabAllocator::allocate(size_t size) {
+    if (size > MAX_SMALL_SIZE)
+        return ::operator new(size);
+    if (t_cache_destroyed) {
+        FreeBlock* block = nullptr;
+        depot().take_batch(class_of(size), block);
+        if (FreeBlock* rest = block->next) {
+            FreeBlock* tail = rest;
+            while (tail->next)
+                tail = tail->next;
+            depot().give_back(class_of(size), rest, tail);
+        }
+        return block;
+    }
+    return thread_cache().allocate(class_of(size));
+}
+
+void SlabAllocator::deallocate(void* ptr, size_t size) noexcept {
+    if (!ptr)
+        return;
+    if (size > MAX_SMALL_SIZE) {
+        ::operator delete(ptr);
+        return;
+    }
+    if (t_cache_destroyed) {
+        auto* block = static_cast<FreeBlock*>(ptr);
+        depot().give_back(class_of(size), block, block);
+        return;
+    }
+    thread_cache().deallocate(ptr, class_of(size));
+}
+
+size_t SlabAllocator::block_size(size_t size) noexcept {
+    return size > MAX_SMALL_SIZE ? size : CLASS_SIZES[class_of(size)];
+}
+
+size_t SlabAllocator::reserved_bytes() noexcept {
+    return depot().reserved_bytes();
+}
+
+} // namespace kv
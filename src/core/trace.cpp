@@ -0,0 +1,128 @@
+#include "kv/trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace kv {
+
+namespace {
+
+bool faster(const SlowRequestLog::Entry& a, const SlowRequestLog::Entry& b) {
+    return a.total_us > b.total_us; // min-heap: the fastest entry on top
+}
+
+} // namespace
+
+uint64_t Tsc::steady_ns() noexcept {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+double Tsc::ns_per_tick() noexcept {
+#ifdef KV_HAVE_RDTSC
+    // Measured once, on first use
+    static const double rate = []() {
+        uint64_t start_ns = steady_ns();
+        uint64_t start_ticks = now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        uint64_t ticks = now() - start_ticks;
+        uint64_t ns = steady_ns() - start_ns;
+        return ticks == 0 ? 1.0 : static_cast<double>(ns) / static_cast<double>(ticks);
+    }();
+    return rate;
+#else
+    return 1.0;
+#endif
+}
+
+uint64_t RequestTrace::total_ticks() const noexcept {
+    uint64_t first = 0;
+    uint64_t last = 0;
+    for (uint64_t tick : ticks) {
+        if (tick == 0)
+            continue;
+        if (first == 0)
+            first = tick;
+        last = tick;
+    }
+    return last - first;
+}
+
+void SlowRequestLog::record(const RequestTrace& trace) {
+    if (capacity_ == 0)
+        return;
+    double total_us = Tsc::to_ns(trace.total_ticks()) / 1000;
+    if (heap_.size() == capacity_ && total_us <= heap_.front().total_us)
+        return;
+
+    Entry entry{
+        .id = next_id_++,
+        .unix_time = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count(),
+        .total_us = total_us,
+        .stage_us = {},
+        .command = trace.command,
+    };
+    uint64_t previous = 0;
+    for (size_t i = 0; i < TRACE_STAGES; ++i) {
+        uint64_t tick = trace.ticks[i];
+        entry.stage_us[i] = tick == 0 ? -1 : previous == 0 ? 0 : Tsc::to_ns(tick - previous) / 1000;
+        if (tick != 0)
+            previous = tick;
+    }
+
+    if (heap_.size() == capacity_) {
+        std::pop_heap(heap_.begin(), heap_.end(), faster);
+        heap_.back() = std::move(entry);
+    } else {
+        heap_.push_back(std::move(entry));
+    }
+    std::push_heap(heap_.begin(), heap_.end(), faster);
+}
+
+std::vector<SlowRequestLog::Entry> SlowRequestLog::slowest(size_t count) const {
+    std::vector<Entry> entries = heap_;
+    std::sort(entries.begin(), entries.end(), faster);
+    if (entries.size() > count)
+        entries.resize(count);
+    return entries;
+}
+
+std::string SlowRequestLog::format(const Entry& entry) {
+    char number[64];
+    std::snprintf(number, sizeof(number), "id=%llu time=%lld total_us=%.1f",
+                  static_cast<unsigned long long>(entry.id), static_cast<long long>(entry.unix_time), entry.total_us);
+    std::string line = number;
+    // The first stage reached is where the clock starts, it shows 0
+    for (size_t i = 0; i < TRACE_STAGES; ++i) {
+        line += ' ';
+        line += stage_name(static_cast<TraceStage>(i));
+        if (entry.stage_us[i] < 0) {
+            line += "=-";
+            continue;
+        }
+        std::snprintf(number, sizeof(number), "=%.1f", entry.stage_us[i]);
+        line += number;
+    }
+    line += " command=";
+    line += entry.command;
+    return line;
+}
+
+std::string_view SlowRequestLog::stage_name(TraceStage stage) noexcept {
+    // Each names the time spent reaching that stage from the previous one
+    switch (stage) {
+    case TraceStage::ReadComplete: return "read";
+    case TraceStage::Parsed: return "parse";
+    case TraceStage::Enqueued: return "enqueue";
+    case TraceStage::Dequeued: return "queue";
+    case TraceStage::LockAcquired: return "lock";
+    case TraceStage::Executed: return "execute";
+    case TraceStage::Flushed: return "flush";
+    }
+    return "?";
+}
+
+} // namespace kv
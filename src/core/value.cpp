@@ -0,0 +1,263 @@
+#include "kv/value.hpp"
+#include "kv/slab_allocator.hpp"
+#include "kv/lz4.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace kv {
+
+namespace {
+
+constexpr size_t LENGTH_BYTE = Value::INLINE_CAPACITY;
+constexpr size_t KIND_BYTE = Value::INLINE_CAPACITY + 1;
+constexpr size_t UNCOMPRESSED_SIZE_BYTE = 16;
+
+} // namespace
+
+Value::Value() noexcept {
+    raw_[LENGTH_BYTE] = 0;
+    set_kind(Kind::Inline);
+}
+
+Value::Value(std::string_view text) : Value() {
+    assign(text);
+}
+
+Value::Value(int64_t number) noexcept : Value() {
+    assign(number);
+}
+
+Value::~Value() {
+    release();
+}
+
+Value::Value(Value&& other) noexcept {
+    std::memcpy(raw_, other.raw_, sizeof(raw_));
+    // The buffer (if any) now belongs to us
+    other.raw_[LENGTH_BYTE] = 0;
+    other.set_kind(Kind::Inline);
+}
+
+Value& Value::operator=(Value&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::memcpy(raw_, other.raw_, sizeof(raw_));
+        other.raw_[LENGTH_BYTE] = 0;
+        other.set_kind(Kind::Inline);
+    }
+    return *this;
+}
+
+Value Value::with_size(size_t size) {
+    Value value;
+    if (size <= INLINE_CAPACITY) {
+        value.raw_[LENGTH_BYTE] = static_cast<char>(size);
+        return value;
+    }
+    if (size > std::numeric_limits<uint32_t>::max())
+        throw std::length_error{"value too large"};
+
+    size_t capacity = SlabAllocator::block_size(size);
+    auto* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    value.set_heap({data, static_cast<uint32_t>(size), static_cast<uint32_t>(capacity)});
+    value.set_kind(Kind::Heap);
+    return value;
+}
+
+Value Value::compress(std::string_view text) {
+    if (text.size() <= INLINE_CAPACITY || text.size() > std::numeric_limits<uint32_t>::max())
+        return Value{text};
+
+    auto scratch = std::make_unique<char[]>(Lz4::max_compressed_size(text.size()));
+    size_t size = Lz4::compress(text, scratch.get());
+    if (size > text.size() - text.size() / 8)
+        return Value{text};
+
+    return from_compressed({scratch.get(), size}, text.size());
+}
+
+Value Value::from_compressed(std::string_view bytes, size_t uncompressed_size) {
+    size_t capacity = SlabAllocator::block_size(bytes.size());
+    auto* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    std::memcpy(data, bytes.data(), bytes.size());
+    Value value;
+    value.set_heap({data, static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(capacity)});
+    auto uncompressed = static_cast<uint32_t>(uncompressed_size);
+    std::memcpy(value.raw_ + UNCOMPRESSED_SIZE_BYTE, &uncompressed, sizeof(uncompressed));
+    value.set_kind(Kind::Compressed);
+    return value;
+}
+
+Value Value::cold(uint64_t location) noexcept {
+    Value value;
+    std::memcpy(value.raw_, &location, sizeof(location));
+    value.set_kind(Kind::Cold);
+    return value;
+}
+
+void Value::assign(std::string_view text) {
+    if (text.size() <= INLINE_CAPACITY) {
+        release();
+        std::memcpy(raw_, text.data(), text.size());
+        raw_[LENGTH_BYTE] = static_cast<char>(text.size());
+        set_kind(Kind::Inline);
+        return;
+    }
+
+    if (text.size() > std::numeric_limits<uint32_t>::max())
+        throw std::length_error{"value too large"};
+
+    // Reuse the current buffer if it is big enough
+    if (kind() == Kind::Heap && heap().capacity >= text.size()) {
+        HeapBuffer buffer = heap();
+        std::memcpy(buffer.data, text.data(), text.size());
+        buffer.size = static_cast<uint32_t>(text.size());
+        set_heap(buffer);
+        return;
+    }
+
+    size_t capacity = SlabAllocator::block_size(text.size());
+    auto* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    std::memcpy(data, text.data(), text.size());
+    release();
+    set_heap({data, static_cast<uint32_t>(text.size()), static_cast<uint32_t>(capacity)});
+    set_kind(Kind::Heap);
+}
+
+void Value::assign(int64_t number) noexcept {
+    release();
+    std::memcpy(raw_, &number, sizeof(number));
+    set_kind(Kind::Integer);
+}
+
+void Value::append(std::string_view text) {
+    if (kind() != Kind::Inline && kind() != Kind::Heap)
+        assign(to_string());
+
+    std::string_view current = this->text();
+    size_t new_size = current.size() + text.size();
+    if (new_size <= INLINE_CAPACITY) {
+        std::memcpy(raw_ + current.size(), text.data(), text.size());
+        raw_[LENGTH_BYTE] = static_cast<char>(new_size);
+        return;
+    }
+
+    if (new_size > std::numeric_limits<uint32_t>::max())
+        throw std::length_error{"value too large"};
+
+    if (kind() == Kind::Heap && heap().capacity >= new_size) {
+        HeapBuffer buffer = heap();
+        std::memcpy(buffer.data + buffer.size, text.data(), text.size());
+        buffer.size = static_cast<uint32_t>(new_size);
+        set_heap(buffer);
+        return;
+    }
+
+    // Grow geometrically so repeated APPENDs stay amortized O(1)
+    size_t capacity = SlabAllocator::block_size(std::max(new_size, current.size() * 2));
+    capacity = std::min<size_t>(capacity, std::numeric_limits<uint32_t>::max());
+    auto* data = static_cast<char*>(SlabAllocator::allocate(capacity));
+    std::memcpy(data, current.data(), current.size());
+    std::memcpy(data + current.size(), text.data(), text.size());
+    release();
+    set_heap({data, static_cast<uint32_t>(new_size), static_cast<uint32_t>(capacity)});
+    set_kind(Kind::Heap);
+}
+
+bool Value::is_integer() const noexcept {
+    return kind() == Kind::Integer;
+}
+
+int64_t Value::integer() const noexcept {
+    int64_t number;
+    std::memcpy(&number, raw_, sizeof(number));
+    return number;
+}
+
+std::string_view Value::text() const noexcept {
+    if (kind() == Kind::Heap) {
+        HeapBuffer buffer = heap();
+        return {buffer.data, buffer.size};
+    }
+    return {raw_, static_cast<size_t>(static_cast<unsigned char>(raw_[LENGTH_BYTE]))};
+}
+
+bool Value::is_compressed() const noexcept {
+    return kind() == Kind::Compressed;
+}
+
+std::string_view Value::compressed() const noexcept {
+    HeapBuffer buffer = heap();
+    return {buffer.data, buffer.size};
+}
+
+size_t Value::uncompressed_size() const noexcept {
+    uint32_t size;
+    std::memcpy(&size, raw_ + UNCOMPRESSED_SIZE_BYTE, sizeof(size));
+    return size;
+}
+
+bool Value::is_cold() const noexcept {
+    return kind() == Kind::Cold;
+}
+
+uint64_t Value::cold_location() const noexcept {
+    uint64_t location;
+    std::memcpy(&location, raw_, sizeof(location));
+    return location;
+}
+
+char* Value::data() noexcept {
+    return kind() == Kind::Heap ? heap().data : raw_;
+}
+
+std::string Value::to_string() const {
+    if (is_integer())
+        return std::to_string(integer());
+    if (is_cold())
+        throw std::logic_error{"cold value must be read from its log"};
+    if (is_compressed()) {
+        std::string text(uncompressed_size(), '\0');
+        if (!Lz4::decompress(compressed(), text.data(), text.size()))
+            throw std::runtime_error{"corrupt compressed value"};
+        return text;
+    }
+    return std::string{text()};
+}
+
+size_t Value::heap_bytes() const noexcept {
+    return kind() == Kind::Heap || kind() == Kind::Compressed ? heap().capacity : 0;
+}
+
+Value::Kind Value::kind() const noexcept {
+    return static_cast<Kind>(raw_[KIND_BYTE]);
+}
+
+void Value::set_kind(Kind kind) noexcept {
+    raw_[KIND_BYTE] = static_cast<char>(kind);
+}
+
+Value::HeapBuffer Value::heap() const noexcept {
+    HeapBuffer buffer;
+    std::memcpy(&buffer, raw_, sizeof(buffer));
+    return buffer;
+}
+
+void Value::set_heap(const HeapBuffer& buffer) noexcept {
+    std::memcpy(raw_, &buffer, sizeof(buffer));
+}
+
+void Value::release() noexcept {
+    if (kind() == Kind::Heap || kind() == Kind::Compressed) {
+        HeapBuffer buffer = heap();
+        SlabAllocator::deallocate(buffer.data, buffer.capacity);
+    }
+    raw_[LENGTH_BYTE] = 0;
+    set_kind(Kind::Inline);
+}
+
+} // namespace kv
@@ -0,0 +1,191 @@
+#include "kv/value_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace kv {
+
+namespace {
+
+size_t page_size() noexcept {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+uint32_t read32(const char* p) noexcept {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void write32(char* p, size_t value) noexcept {
+    auto narrowed = static_cast<uint32_t>(value);
+    std::memcpy(p, &narrowed, sizeof(narrowed));
+}
+
+} // namespace
+
+ValueLog::ValueLog(std::string directory, size_t segment_bytes)
+    : directory_(std::move(directory)), segment_bytes_(segment_bytes) {}
+
+ValueLog::~ValueLog() {
+    for (auto& [id, segment] : segments_)
+        close(*segment);
+}
+
+ValueLog::Segment& ValueLog::open_segment(size_t capacity) {
+    auto segment = std::make_unique<Segment>();
+    segment->id = next_id_++;
+    segment->capacity = capacity;
+    segment->path = directory_ + "/values-" + std::to_string(segment->id) + ".log";
+
+    segment->fd = ::open(segment->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (segment->fd < 0)
+        throw std::system_error(errno, std::generic_category(), "open " + segment->path);
+    // Reserve the blocks now: a full disk fails here instead of as SIGBUS on a store into the mapping
+    if (int err = ::posix_fallocate(segment->fd, 0, static_cast<off_t>(capacity)); err != 0) {
+        ::close(segment->fd);
+        ::unlink(segment->path.c_str());
+        throw std::system_error(err, std::generic_category(), "fallocate " + segment->path);
+    }
+    void* base = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, segment->fd, 0);
+    if (base == MAP_FAILED) {
+        int err = errno;
+        ::close(segment->fd);
+        ::unlink(segment->path.c_str());
+        throw std::system_error(err, std::generic_category(), "mmap " + segment->path);
+    }
+    segment->base = static_cast<char*>(base);
+
+    std::unique_lock lock(mutex_);
+    Segment& opened = *segment;
+    segments_.emplace(opened.id, std::move(segment));
+    return opened;
+}
+
+void ValueLog::close(Segment& segment) noexcept {
+    ::munmap(segment.base, segment.capacity);
+    ::close(segment.fd);
+    ::unlink(segment.path.c_str());
+}
+
+ValueLog::Segment& ValueLog::segment_of(uint64_t location) const {
+    std::shared_lock lock(mutex_);
+    return *segments_.find(static_cast<uint32_t>(location >> OFFSET_BITS))->second;
+}
+
+ValueLog::Record ValueLog::parse(const char* record) noexcept {
+    size_t key_size = read32(record);
+    size_t value_size = read32(record + 4);
+    size_t uncompressed_size = read32(record + 8);
+    const char* key = record + HEADER_BYTES;
+    return {{key, key_size}, {key + key_size, value_size}, uncompressed_size};
+}
+
+uint64_t ValueLog::append(std::string_view key, std::string_view bytes, size_t uncompressed_size) {
+    size_t size = HEADER_BYTES + key.size() + bytes.size();
+    if (!active_ || active_->capacity - active_->written < size) {
+        if (active_) {
+            // Sealed, only reads from here on
+            ::madvise(active_->base, active_->capacity, MADV_DONTNEED);
+        }
+        active_ = &open_segment(std::max(segment_bytes_, size));
+    }
+
+    char* record = active_->base + active_->written;
+    write32(record, key.size());
+    write32(record + 4, bytes.size());
+    write32(record + 8, uncompressed_size);
+    std::memcpy(record + HEADER_BYTES, key.data(), key.size());
+    std::memcpy(record + HEADER_BYTES + key.size(), bytes.data(), bytes.size());
+
+    uint64_t location = (uint64_t{active_->id} << OFFSET_BITS) | active_->written;
+    active_->written += size;
+    active_->live.fetch_add(size, std::memory_order_relaxed);
+    disk_bytes_.fetch_add(size, std::memory_order_relaxed);
+    live_bytes_.fetch_add(size, std::memory_order_relaxed);
+    return location;
+}
+
+ValueLog::Record ValueLog::read(uint64_t location) const {
+    const Segment& segment = segment_of(location);
+    return parse(segment.base + (location & OFFSET_MASK));
+}
+
+void ValueLog::release(uint64_t location) noexcept {
+    Segment& segment = segment_of(location);
+    Record record = parse(segment.base + (location & OFFSET_MASK));
+    size_t size = HEADER_BYTES + record.key.size() + record.bytes.size();
+    segment.live.fetch_sub(size, std::memory_order_relaxed);
+    live_bytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+std::vector<uint32_t> ValueLog::compaction_candidates(double dead_ratio) const {
+    std::vector<std::pair<size_t, uint32_t>> dead_bytes;
+    {
+        std::shared_lock lock(mutex_);
+        for (const auto& [id, segment] : segments_) {
+            if (segment.get() == active_)
+                continue; // still being filled
+            size_t dead = segment->written - segment->live.load(std::memory_order_relaxed);
+            if (dead >= dead_ratio * static_cast<double>(segment->written))
+                dead_bytes.emplace_back(dead, id);
+        }
+    }
+    std::sort(dead_bytes.begin(), dead_bytes.end(), std::greater<>{});
+
+    std::vector<uint32_t> candidates;
+    for (const auto& [dead, id] : dead_bytes)
+        candidates.push_back(id);
+    return candidates;
+}
+
+void ValueLog::for_each_record(uint32_t segment_id,
+                               const std::function<void(uint64_t, const Record&)>& fn) const {
+    const Segment& segment = segment_of(uint64_t{segment_id} << OFFSET_BITS);
+    for (size_t offset = 0; offset < segment.written;) {
+        Record record = parse(segment.base + offset);
+        fn((uint64_t{segment_id} << OFFSET_BITS) | offset, record);
+        offset += HEADER_BYTES + record.key.size() + record.bytes.size();
+    }
+}
+
+bool ValueLog::drop_if_empty(uint32_t segment_id) {
+    std::unique_ptr<Segment> dropped;
+    {
+        std::unique_lock lock(mutex_);
+        auto it = segments_.find(segment_id);
+        if (it == segments_.end() || it->second.get() == active_ ||
+            it->second->live.load(std::memory_order_relaxed) > 0)
+            return false;
+        dropped = std::move(it->second);
+        segments_.erase(it);
+    }
+    disk_bytes_.fetch_sub(dropped->written, std::memory_order_relaxed);
+    close(*dropped);
+    return true;
+}
+
+void ValueLog::trim() noexcept {
+    if (!active_)
+        return;
+    size_t written_pages = active_->written / page_size() * page_size();
+    if (written_pages > 0)
+        ::madvise(active_->base, written_pages, MADV_DONTNEED);
+}
+
+size_t ValueLog::disk_bytes() const noexcept {
+    return disk_bytes_.load(std::memory_order_relaxed);
+}
+
+size_t ValueLog::live_bytes() const noexcept {
+    return live_bytes_.load(std::memory_order_relaxed);
+}
+
+} // namespace kv
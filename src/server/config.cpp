@@ -0,0 +1,320 @@
+#include "config.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <limits>
+
+namespace kv {
+
+namespace {
+
+template <typename Number>
+Number parse_number(std::string_view key, std::string_view text) {
+    Number value{};
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || ptr != text.data() + text.size())
+        throw ConfigError{std::string{key} + ": invalid number '" + std::string{text} + "'"};
+    return value;
+}
+
+size_t parse_size(std::string_view key, std::string_view text) {
+    size_t multiplier = 1;
+    if (!text.empty()) {
+        switch (text.back()) {
+        case 'K': case 'k': multiplier = size_t{1} << 10; break;
+        case 'M': case 'm': multiplier = size_t{1} << 20; break;
+        case 'G': case 'g': multiplier = size_t{1} << 30; break;
+        default: break;
+        }
+    }
+    if (multiplier != 1)
+        text.remove_suffix(1);
+    size_t value = parse_number<size_t>(key, text);
+    if (value > std::numeric_limits<size_t>::max() / multiplier)
+        throw ConfigError{std::string{key} + ": size too large"};
+    return value * multiplier;
+}
+
+// Permission bits in octal, like chmod: "660"
+uint32_t parse_mode(std::string_view key, std::string_view text) {
+    uint32_t mode = 0;
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), mode, 8);
+    if (text.empty() || ec != std::errc{} || ptr != text.data() + text.size() || mode > 0777)
+        throw ConfigError{std::string{key} + ": expected octal permissions like 660, got '" + std::string{text} + "'"};
+    return mode;
+}
+
+bool parse_bool(std::string_view key, std::string_view text) {
+    if (text == "true" || text == "yes" || text == "on" || text == "1")
+        return true;
+    if (text == "false" || text == "no" || text == "off" || text == "0")
+        return false;
+    throw ConfigError{std::string{key} + ": expected true or false, got '" + std::string{text} + "'"};
+}
+
+// "0,2-5" -> {0, 2, 3, 4, 5}
+std::vector<int> parse_cpus(std::string_view key, std::string_view text) {
+    std::vector<int> cpus;
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        std::string_view item = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+
+        size_t dash = item.find('-');
+        int first = parse_number<int>(key, item.substr(0, dash));
+        int last = dash == std::string_view::npos ? first : parse_number<int>(key, item.substr(dash + 1));
+        if (first < 0 || last < first)
+            throw ConfigError{std::string{key} + ": invalid CPU range '" + std::string{item} + "'"};
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::string_view trim(std::string_view text) {
+    constexpr std::string_view SPACE = " \t\r";
+    size_t first = text.find_first_not_of(SPACE);
+    if (first == std::string_view::npos)
+        return {};
+    return text.substr(first, text.find_last_not_of(SPACE) - first + 1);
+}
+
+struct Option {
+    std::string_view key;
+    std::string_view value_name; // empty for switches
+    std::string_view help;
+    std::function<void(ServerConfig&, std::string_view key, std::string_view value)> set;
+};
+
+const std::vector<Option>& options() {
+    static const std::vector<Option> table = {
+        {"address", "ip", "IPv4 address to listen on (0.0.0.0)",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.server.address = v; }},
+        {"port", "n", "TCP port (12345), a bare number on the command line works too",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.port = parse_number<uint16_t>(k, v); }},
+        {"unix-socket", "path", "also listen on a Unix domain socket at this path",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.server.unix_socket = v; }},
+        {"unix-socket-mode", "mode", "octal permissions of the Unix socket (660)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.unix_socket_mode = parse_mode(k, v); }},
+        {"workers", "n", "worker threads (5)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.workers = parse_number<size_t>(k, v); }},
+        {"max-workers", "n", "let shared workers grow to n threads under load, --workers is the minimum",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.max_workers = parse_number<size_t>(k, v); }},
+        {"scale-up-wait", "us", "start a worker when a command was queued this long (2000)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.server.worker_scaling.grow_wait = std::chrono::microseconds{parse_number<uint32_t>(k, v)};
+         }},
+        {"scale-up-depth", "n", "start a worker when more commands per worker are queued (16)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.server.worker_scaling.grow_depth = parse_number<size_t>(k, v);
+         }},
+        {"scale-down-idle", "ms", "stop a worker after this long without all of them busy (5000)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.server.worker_scaling.shrink_idle = std::chrono::milliseconds{parse_number<uint32_t>(k, v)};
+         }},
+        {"affine-workers", "", "pin each client to one worker",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.server.scheduling = parse_bool(k, v) ? WorkerScheduling::Affine : WorkerScheduling::Shared;
+         }},
+        {"reactor-cpu", "cpu", "pin the reactor thread to this CPU",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.reactor_cpu = parse_number<int>(k, v); }},
+        {"worker-cpus", "list", "pin workers round-robin to these CPUs, e.g. 1-15",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.worker_cpus = parse_cpus(k, v); }},
+        {"lock-memory", "", "mlockall() all memory to avoid page-fault stalls",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.lock_memory = parse_bool(k, v); }},
+        {"read-buffer", "size", "bytes asked for by the first read() from a client, adapts from there (4K)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.inbox_limits.read_bytes = parse_size(k, v); }},
+        {"read-budget", "size", "bytes read from one client before serving the next (256K)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.inbox_limits.read_budget = parse_size(k, v); }},
+        {"max-inbox", "size", "longest command line accepted (2M)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.inbox_limits.max_size = parse_size(k, v); }},
+        {"outbox-high-watermark", "size", "stop reading from a client with this much unsent output (1M)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.outbox_limits.high_watermark = parse_size(k, v); }},
+        {"outbox-low-watermark", "size", "resume reading once it has drained to this (256K)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.outbox_limits.low_watermark = parse_size(k, v); }},
+        {"outbox-hard-limit", "size", "disconnect a client with more unsent output (64M)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.outbox_limits.hard_limit = parse_size(k, v); }},
+        {"outbox-total-limit", "size", "unsent output of all clients together (512M)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.outbox_limits.total_limit = parse_size(k, v); }},
+        {"log-level", "level", "debug, info, warn, error or off (info)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             auto level = Logger::parse_level(v);
+             if (!level)
+                 throw ConfigError{std::string{k} + ": unknown level '" + std::string{v} + "'"};
+             c.log_level = *level;
+         }},
+        {"bulk-dir", "dir", "directory for LOAD FILE and DUMP FILE, off if not set",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.server.bulk_directory = v; }},
+        {"cluster-node", "node", "a cluster node and its hash slots, e.g. '10.0.0.5:6000 0-5460,9000', once per node",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             size_t space = v.find(' ');
+             try {
+                 if (space == std::string_view::npos)
+                     throw ClusterError{"expected 'host:port slots', got '" + std::string{v} + "'"};
+                 c.server.cluster_slots.assign(ClusterNode::parse(v.substr(0, space)), trim(v.substr(space + 1)));
+             } catch (const ClusterError& e) {
+                 throw ConfigError{std::string{k} + ": " + e.what()};
+             }
+         }},
+        {"cluster-self", "host:port", "which cluster node this server is",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             try {
+                 c.server.cluster_self = ClusterNode::parse(v);
+             } catch (const ClusterError& e) {
+                 throw ConfigError{std::string{k} + ": " + e.what()};
+             }
+         }},
+        {"trace-sample", "n", "trace one in n commands through every stage for SLOWLOG (0 = off)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.trace_sample = parse_number<uint32_t>(k, v); }},
+        {"slowlog-size", "n", "slowest traced commands kept for SLOWLOG GET (128)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.server.slowlog_size = parse_number<size_t>(k, v); }},
+        {"hot-key-half-life", "ms", "halve the read counts behind HOTKEYS this often, 0 = no tracking (5000)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.store.hot_key_half_life = c.log.hot_key_half_life = std::chrono::milliseconds{parse_number<uint32_t>(k, v)};
+         }},
+        {"hot-key-sample", "n", "count one in n reads for HOTKEYS, a power of two (8)",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.store.hot_key_sample = c.log.hot_key_sample = parse_number<uint32_t>(k, v);
+         }},
+        {"engine", "map|log", "storage engine (map)",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.engine = v; }},
+        {"ordered-index", "", "keep keys sorted for SCAN prefix and RANGE",
+         [](ServerConfig& c, std::string_view k, std::string_view v) {
+             c.store.ordered_index = c.log.ordered_index = parse_bool(k, v);
+         }},
+        {"lazy-free", "", "map: free large values on a background thread",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.store.lazy_free = parse_bool(k, v); }},
+        {"lock-free-reads", "", "map: serve GET without the store lock",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.store.lock_free_reads = parse_bool(k, v); }},
+        {"compress", "", "map: LZ4-compress large values",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.store.compression = parse_bool(k, v); }},
+        {"cold-dir", "dir", "map: spill cold values to a log in this directory",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.store.cold_directory = v; }},
+        {"memory-limit", "size", "map: spill once values in memory exceed this",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.store.memory_limit = parse_size(k, v); }},
+        {"data-dir", "dir", "log: directory of the data file (kv-data)",
+         [](ServerConfig& c, std::string_view, std::string_view v) { c.log.directory = v; }},
+        {"sync-writes", "", "log: fdatasync after every write",
+         [](ServerConfig& c, std::string_view k, std::string_view v) { c.log.sync_writes = parse_bool(k, v); }},
+    };
+    return table;
+}
+
+const Option* find_option(std::string_view key) {
+    for (const Option& option : options()) {
+        if (option.key == key)
+            return &option;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void Config::apply(ServerConfig& config, std::string_view key, std::string_view value) {
+    const Option* option = find_option(key);
+    if (!option)
+        throw ConfigError{"unknown option '" + std::string{key} + "'"};
+    option->set(config, key, value);
+}
+
+ServerConfig Config::parse(const std::vector<std::string_view>& args) {
+    ServerConfig config;
+    // The file first, so the command line wins
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != "--config")
+            continue;
+        if (i + 1 == args.size())
+            throw ConfigError{"config: missing file name"};
+        load_file(std::string{args[i + 1]}, config);
+    }
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        std::string_view arg = args[i];
+        if (arg == "--config") {
+            ++i;
+            continue;
+        }
+        if (!arg.starts_with("--")) {
+            config.server.port = parse_number<uint16_t>("port", arg);
+            continue;
+        }
+        std::string_view key = arg.substr(2);
+        const Option* option = find_option(key);
+        if (!option)
+            throw ConfigError{"unknown option '" + std::string{arg} + "'"};
+        if (option->value_name.empty()) {
+            option->set(config, key, "true");
+            continue;
+        }
+        if (i + 1 == args.size())
+            throw ConfigError{std::string{key} + ": missing value"};
+        option->set(config, key, args[++i]);
+    }
+
+    validate(config);
+    return config;
+}
+
+void Config::load_file(const std::string& path, ServerConfig& config) {
+    std::ifstream file(path);
+    if (!file)
+        throw ConfigError{"config: can't open " + path};
+
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        std::string_view text = trim(std::string_view{line}.substr(0, line.find('#')));
+        if (text.empty())
+            continue;
+        size_t equals = text.find('=');
+        if (equals == std::string_view::npos)
+            throw ConfigError{path + ":" + std::to_string(number) + ": expected key = value"};
+        try {
+            apply(config, trim(text.substr(0, equals)), trim(text.substr(equals + 1)));
+        } catch (const ConfigError& e) {
+            throw ConfigError{path + ":" + std::to_string(number) + ": " + e.what()};
+        }
+    }
+}
+
+void Config::validate(const ServerConfig& config) {
+    if (config.engine != "map" && config.engine != "log")
+        throw ConfigError{"engine: expected map or log, got '" + config.engine + "'"};
+    if (config.server.workers == 0)
+        throw ConfigError{"workers: must be at least 1"};
+    if (config.server.max_workers > config.server.workers) {
+        if (config.server.scheduling == WorkerScheduling::Affine)
+            throw ConfigError{"max-workers: affine workers have a queue each and don't scale"};
+        if (config.server.worker_scaling.shrink_idle.count() == 0)
+            throw ConfigError{"scale-down-idle: must be at least 1 ms"};
+    }
+    if (config.server.inbox_limits.read_bytes == 0)
+        throw ConfigError{"read-buffer: must be at least 1 byte"};
+    if (config.server.inbox_limits.read_budget == 0)
+        throw ConfigError{"read-budget: must be at least 1 byte"};
+    if (config.server.outbox_limits.low_watermark > config.server.outbox_limits.high_watermark)
+        throw ConfigError{"outbox-low-watermark: must not exceed outbox-high-watermark"};
+    const SlotMap& slots = config.server.cluster_slots;
+    if (!slots.empty()) {
+        if (std::string missing = slots.unassigned(); !missing.empty())
+            throw ConfigError{"cluster-node: slots " + missing + " have no node"};
+        if (std::find(slots.nodes().begin(), slots.nodes().end(), config.server.cluster_self) == slots.nodes().end())
+            throw ConfigError{"cluster-self: must be one of the cluster nodes"};
+    }
+}
+
+std::string Config::usage() {
+    std::string text = "Usage: kv_server [port] [--config file] [--option value | --switch]...\n\nOptions:\n";
+    for (const Option& option : options()) {
+        std::string flag = "  --" + std::string{option.key};
+        if (!option.value_name.empty())
+            flag += " " + std::string{option.value_name};
+        flag.resize(std::max<size_t>(flag.size() + 2, 32), ' ');
+        text += flag + std::string{option.help} + "\n";
+    }
+    return text;
+}
+
+} // namespace kv
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "tcp_server.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/log_store.hpp"
+#include "kv/logger.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace kv {
+
+class ConfigError : public std::runtime_error {
+public:
+    explicit ConfigError(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+// Everything kv_server can be told at startup
+struct ServerConfig {
+    std::string engine = "map"; // "map" (KvStore) or "log" (LogStore)
+    LogLevel log_level = LogLevel::Info;
+    ServerOptions server{};
+    StoreOptions store{};
+    LogStoreOptions log{};
+};
+
+/*
+ * Startup configuration from the command line and an optional config file.
+ *
+ * Every option is a long flag (`--workers 32`) and a config file key of the
+ * same name (`workers = 32`). Switches take no value on the command line and
+ * true/false in the file. `--config path` is read first, wherever it appears,
+ * and the other flags override what it sets. A bare number is the port.
+ * Sizes take K, M and G suffixes (powers of 1024), CPU lists look like "0,2-5".
+ */
+class Config {
+public:
+    // Arguments without the program name. Throws ConfigError.
+    static ServerConfig parse(const std::vector<std::string_view>& args);
+    // Applies the `key = value` lines of a file, `#` starts a comment. Throws ConfigError.
+    static void load_file(const std::string& path, ServerConfig& config);
+    static std::string usage();
+
+private:
+    static void apply(ServerConfig& config, std::string_view key, std::string_view value);
+    static void validate(const ServerConfig& config);
+};
+
+} // namespace kv
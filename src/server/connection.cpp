@@ -1,65 +1,332 @@
 #include "connection.hpp"
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <cstring>
+#include <utility>
 
 namespace kv {
 
+Connection::~Connection() {
+    if (session_)
+        session_.destroy();
+    if (budget_)
+        budget_->release(outbox_bytes_.load(std::memory_order_relaxed));
+}
+
+
+std::span<char> InboxBuffer::prepare(size_t bytes) {
+    if (capacity_ - end_ < bytes) {
+        size_t used = size();
+        if (capacity_ - used >= bytes && begin_ >= used) {
+            // Moving the data to the front makes room and copies less than was consumed
+            std::memmove(buffer_.get(), buffer_.get() + begin_, used);
+        } else {
+            size_t capacity = std::max(capacity_ * 2, used + bytes);
+            auto buffer = std::make_unique_for_overwrite<char[]>(capacity);
+            if (used)
+                std::memcpy(buffer.get(), buffer_.get() + begin_, used);
+            buffer_ = std::move(buffer);
+            capacity_ = capacity;
+        }
+        begin_ = 0;
+        end_ = used;
+    }
+    return {buffer_.get() + end_, capacity_ - end_};
+}
+
+void InboxBuffer::append(const char* data, size_t bytes) {
+    std::memcpy(prepare(bytes).data(), data, bytes);
+    commit(bytes);
+}
+
+void InboxBuffer::consume(size_t bytes) noexcept {
+    begin_ += bytes;
+    if (begin_ == end_)
+        clear();
+}
+
+void InboxBuffer::shrink_to(size_t bytes) noexcept {
+    if (empty() && capacity_ > bytes) {
+        buffer_.reset();
+        capacity_ = 0;
+    }
+}
+
 
 bool Connection::read_to_inbox() {
-    char buffer[4096];
-    ssize_t n = ::read(socket_.fd(), buffer, sizeof(buffer));
+    // poll() is level-triggered, so input left behind by the budget is
+    // reported again on the next turn of the reactor
+    size_t total = 0;
+    while (total < inbox_limits_.read_budget) {
+        bool payload = receiving_payload();
+        size_t requested = 0;
+        ssize_t n = payload ? read_into_payload(inbox_limits_.read_budget - total, requested)
+                            : read_some(inbox_limits_.read_budget - total, requested);
+        if (n == 0) {
+            // Commands that came with the EOF are dispatched first, the socket stays readable
+            return total > 0;
+        }
+        if (n < 0)
+            break;
+        total += n;
+        // A short read means the socket is drained, asking again would only return EAGAIN
+        if (static_cast<size_t>(n) < requested)
+            break;
+        // The dispatcher takes a complete payload before anything after it is read
+        if (payload && !receiving_payload())
+            break;
+    }
 
-    if (n == 0)
-        return false;
+    if (total < read_size_ / 4)
+        read_size_ = std::max(read_size_ / 2, inbox_limits_.read_bytes);
+    server_inbox_.shrink_to(2 * read_size_);
+    return true;
+}
+
+ssize_t Connection::read_some(size_t limit, size_t& requested) {
+    // Shared by all connections, only the reactor thread reads
+    thread_local std::unique_ptr<char[]> overflow = std::make_unique_for_overwrite<char[]>(READ_OVERFLOW_BYTES);
+
+    // One byte past the limit is enough to tell the line is too long
+    limit = std::min(limit, inbox_limits_.max_size + 1 - server_inbox_.size());
+    std::span<char> space = server_inbox_.prepare(std::min(read_size_, limit));
+    iovec iov[2];
+    iov[0] = {space.data(), std::min(space.size(), limit)};
+    iov[1] = {overflow.get(), std::min(READ_OVERFLOW_BYTES, limit - iov[0].iov_len)};
+    requested = iov[0].iov_len + iov[1].iov_len;
+
+    ssize_t n = ::readv(socket_.fd(), iov, iov[1].iov_len ? 2 : 1);
     if (n < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK)
-            return true; // No data left to read
+            return -1; // No data left to read
         throw IOError{"read failed"};
     }
-    if (server_inbox_.size() + n > MAX_INBOX_SIZE) {
+
+    size_t bytes = static_cast<size_t>(n);
+    server_inbox_.commit(std::min(bytes, iov[0].iov_len));
+    if (bytes > iov[0].iov_len)
+        server_inbox_.append(overflow.get(), bytes - iov[0].iov_len);
+    // The client sends more than we ask for, ask for more next time
+    if (bytes == requested)
+        read_size_ = std::min(read_size_ * 2, std::max(inbox_limits_.read_budget, inbox_limits_.read_bytes));
+
+    if (server_inbox_.size() > inbox_limits_.max_size) {
         server_inbox_.clear();
+        line_scanned_ = 0;
         throw BufferOverflowError{"value too large"};
     }
+    return n;
+}
 
-    server_inbox_.append(buffer, n);
-    return true;
+ssize_t Connection::read_into_payload(size_t limit, size_t& requested) {
+    requested = std::min(limit, payload_->text().size() - payload_received_);
+    ssize_t n = ::read(socket_.fd(), payload_->data() + payload_received_, requested);
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return -1;
+        throw IOError{"read failed"};
+    }
+    payload_received_ += n;
+    return n;
+}
+
+size_t Connection::line_end() {
+    std::string_view inbox = server_inbox_.data();
+    // Don't rescan a long line that arrives in pieces
+    auto pos = inbox.find('\n', line_scanned_);
+    if (pos == std::string_view::npos)
+        line_scanned_ = inbox.size();
+    return pos;
 }
 
 std::optional<std::string> Connection::try_get_line() {
-    auto pos = server_inbox_.find('\n');
-    if (pos == std::string::npos) {
+    auto pos = line_end();
+    if (pos == std::string_view::npos)
         return std::nullopt; // No full line yet
-    }
+    std::string_view inbox = server_inbox_.data();
 
-    std::string line = server_inbox_.substr(0, pos);
-    server_inbox_.erase(0, pos + 1); // Remove the line and the \n from the buffer
+    std::string line{inbox.substr(0, pos)};
+    server_inbox_.consume(pos + 1); // Remove the line and the \n from the buffer
+    line_scanned_ = 0;
     return line;
 }
 
 
+void Connection::begin_payload(size_t size) {
+    payload_ = Value::with_size(size);
+    // Whatever arrived with the command line is the start of the payload
+    payload_received_ = std::min(size, server_inbox_.size());
+    std::memcpy(payload_->data(), server_inbox_.data().data(), payload_received_);
+    server_inbox_.consume(payload_received_);
+    line_scanned_ = 0;
+}
+
+bool Connection::receiving_payload() const noexcept {
+    return payload_ && payload_received_ < payload_->text().size();
+}
+
+std::optional<Value> Connection::take_payload() {
+    if (!payload_ || receiving_payload())
+        return std::nullopt;
+    std::optional<Value> payload = std::move(payload_);
+    payload_.reset();
+    payload_received_ = 0;
+    return payload;
+}
+
+
 void Connection::append_response(std::string data) {
     std::lock_guard lock(outbox_mutex_);
-    server_outbox_.append(data);
+    if (over_hard_limit_.load(std::memory_order_relaxed))
+        return; // about to be disconnected
+    size_t pending = outbox_bytes_.load(std::memory_order_relaxed);
+    if (pending > 0 && pending + data.size() > limits_.hard_limit) {
+        over_hard_limit_.store(true, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t size = data.size();
+    appended_total_ += size;
+    if (server_outbox_.empty() || size >= OUTBOX_SEGMENT_BYTES ||
+        server_outbox_.back().size() >= OUTBOX_SEGMENT_BYTES)
+        server_outbox_.push_back(std::move(data));
+    else
+        server_outbox_.back().append(data);
+    outbox_bytes_.store(pending + size, std::memory_order_relaxed);
+    if (budget_)
+        budget_->add(size);
+}
+
+size_t Connection::outbox_size() const noexcept {
+    return outbox_bytes_.load(std::memory_order_relaxed);
+}
+
+bool Connection::over_hard_limit() const noexcept {
+    return over_hard_limit_.load(std::memory_order_relaxed);
+}
+
+bool Connection::should_pause_reading() const noexcept {
+    if (over_hard_limit())
+        return true; // about to be disconnected
+    size_t pending = outbox_size();
+    return pending >= limits_.high_watermark || (pending > 0 && budget_ && budget_->exhausted());
+}
+
+bool Connection::can_resume_reading() const noexcept {
+    return outbox_size() <= limits_.low_watermark && !(budget_ && budget_->exhausted());
 }
 
 bool Connection::write_from_outbox() {
     std::lock_guard lock(outbox_mutex_);
-    if (server_outbox_.empty())
+    // Large responses go out in as many sends as the socket takes,
+    // straight from the segment they were moved into
+    while (!server_outbox_.empty()) {
+        const std::string& segment = server_outbox_.front();
+        // MSG_NOSIGNAL: don't SIGPIPE us if the socket is dead
+        ssize_t n = ::send(socket_.fd(), segment.data() + outbox_sent_,
+                           segment.size() - outbox_sent_, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+            throw IOError("write failed");
+        }
+
+        outbox_sent_ += n;
+        sent_total_ += n;
+        if (outbox_sent_ == segment.size()) {
+            server_outbox_.pop_front();
+            outbox_sent_ = 0;
+        }
+        outbox_bytes_.fetch_sub(n, std::memory_order_relaxed);
+        if (budget_)
+            budget_->release(n);
+    }
+    return false;
+}
+
+
+bool Connection::input_ready() {
+    if (should_pause_reading())
         return false;
+    if (payload_)
+        return !receiving_payload();
+    return line_end() != std::string_view::npos;
+}
 
-    // MSG_NOSIGNAL: don't SIGPIPE us if the socket is dead
-    ssize_t n = ::send(socket_.fd(), server_outbox_.data(), server_outbox_.size(), MSG_NOSIGNAL);
-    if (n >= 0) {
-        server_outbox_.erase(0, n); // Remove what was actually sent
-        return !server_outbox_.empty();
+void Connection::suspend_session(std::coroutine_handle<> session, SessionWait wait) noexcept {
+    session_ = session;
+    session_wait_ = wait;
+}
+
+void Connection::resume_session() {
+    session_wait_ = SessionWait::None;
+    turn_commands_ = 0;
+    std::exchange(session_, {}).resume();
+}
+
+Connection::FlushAwaiter Connection::flushed() {
+    std::lock_guard lock(outbox_mutex_);
+    return FlushAwaiter{*this, appended_total_};
+}
+
+bool Connection::FlushAwaiter::await_ready() noexcept {
+    if (connection_.closed() || connection_.over_hard_limit())
+        return true; // flushed_ stays false
+    std::lock_guard lock(connection_.outbox_mutex_);
+    flushed_ = connection_.sent_total_ >= end_;
+    return flushed_;
+}
+
+void Connection::FlushAwaiter::await_suspend(std::coroutine_handle<> waiter) noexcept {
+    waiter_ = waiter;
+    // Output is sent in order, so the waiters complete in the order they came
+    if (connection_.flush_tail_)
+        connection_.flush_tail_->next_ = this;
+    else
+        connection_.flush_head_ = this;
+    connection_.flush_tail_ = this;
+}
+
+void Connection::resume_flushed() {
+    uint64_t sent;
+    {
+        std::lock_guard lock(outbox_mutex_);
+        sent = sent_total_;
+    }
+    while (flush_head_ && flush_head_->end_ <= sent) {
+        FlushAwaiter* waiter = flush_head_;
+        flush_head_ = waiter->next_;
+        if (!flush_head_)
+            flush_tail_ = nullptr;
+        // The awaiter is gone once its coroutine runs on
+        waiter->flushed_ = true;
+        waiter->waiter_.resume();
+    }
+}
+
+void Connection::close() {
+    closed_.store(true, std::memory_order_release);
+    session_wait_ = SessionWait::None;
+    if (session_)
+        std::exchange(session_, {}).destroy();
+    while (flush_head_) {
+        FlushAwaiter* waiter = flush_head_;
+        flush_head_ = waiter->next_;
+        if (!flush_head_)
+            flush_tail_ = nullptr;
+        waiter->waiter_.resume();
     }
-    // n < 0
-    if (errno == EAGAIN || errno == EWOULDBLOCK)
-        return true;
-    throw IOError("write failed");
 }
 
+bool Connection::mark_dirty() noexcept {
+    return !dirty_.exchange(true, std::memory_order_acq_rel);
+}
 
+void Connection::clear_dirty() noexcept {
+    dirty_.store(false, std::memory_order_release);
+}
 
 bool Connection::inbox_has_data() const {
     return !server_inbox_.empty();
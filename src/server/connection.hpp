@@ -1,11 +1,21 @@
 #pragma once
 
 #include "kv/socket.hpp"
+#include "kv/value.hpp"
+#include "coroutine.hpp"
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
 #include <string_view>
 #include <stdexcept>
 #include <mutex>
 #include <optional>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <sys/types.h>
 
 namespace kv {
 
@@ -18,37 +28,315 @@ class BufferOverflowError : public IOError {
     using IOError::IOError;
 };
 
+struct InboxLimits {
+    // Bytes asked for by the first read() from the socket. Grows while reads
+    // come back full, up to read_budget, and shrinks back when they don't.
+    size_t read_bytes = 4096;
+    // Bytes read from one client per readiness event, so a fast sender can't
+    // starve the others. The rest is read on the next turn of the reactor.
+    size_t read_budget = 256 * 1024;
+    // Unparsed input past this is dropped with an error, a command line can't be longer
+    size_t max_size = 2 * 1024 * 1024;
+};
+
+struct OutboxLimits {
+    // Stop reading from a client once this much output is waiting for it,
+    // resume when it has drained to low_watermark
+    size_t high_watermark = 1024 * 1024;
+    size_t low_watermark = 256 * 1024;
+    // Clients whose outbox would grow past this are disconnected.
+    // A single larger response (e.g. GETBLOB) is still taken into an empty outbox.
+    size_t hard_limit = 64 * 1024 * 1024;
+    // All outboxes together, clients with pending output stop being read above it
+    size_t total_limit = 512 * 1024 * 1024;
+};
+
+/*
+ * Bytes waiting in all outboxes of a server, updated by workers and the reactor.
+ */
+class OutputBudget {
+public:
+    explicit OutputBudget(size_t limit) : limit_(limit) {}
+
+    void add(size_t bytes) noexcept {
+        used_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void release(size_t bytes) noexcept {
+        used_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    bool exhausted() const noexcept {
+        return used() >= limit_;
+    }
+
+    size_t used() const noexcept {
+        return used_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const size_t limit_;
+    std::atomic<size_t> used_{0};
+};
+
+/*
+ * Unparsed input of a connection. Reads land directly in the free space
+ * at the end, parsed lines are consumed from the front without moving the rest.
+ */
+class InboxBuffer {
+public:
+    std::string_view data() const noexcept { return {buffer_.get() + begin_, end_ - begin_}; }
+    size_t size() const noexcept { return end_ - begin_; }
+    bool empty() const noexcept { return begin_ == end_; }
+
+    // At least `bytes` of writable space after the data, valid until the next call
+    std::span<char> prepare(size_t bytes);
+    // The first `bytes` of the prepared space now hold data
+    void commit(size_t bytes) noexcept { end_ += bytes; }
+    void append(const char* data, size_t bytes);
+    void consume(size_t bytes) noexcept;
+    void clear() noexcept { begin_ = end_ = 0; }
+    // Frees the memory if empty and holding more than `bytes`
+    void shrink_to(size_t bytes) noexcept;
+
+private:
+    std::unique_ptr<char[]> buffer_;
+    size_t capacity_{0};
+    size_t begin_{0};
+    size_t end_{0};
+};
+
+// What the session coroutine of a connection is suspended on
+enum class SessionWait : uint8_t {
+    None,  // running, or not started
+    Input, // a command line or the rest of a payload, and room for its output
+    Turn,  // the next turn of the reactor, after taking its share of commands
+};
+
 /*
  * Represents a single client connection.
+ *
+ * The reactor drives it with two kinds of coroutines, both allocated from
+ * frames(): one session reading commands (read_line(), read_payload()) and
+ * one per request, which waits for its response to be sent (flushed()).
+ * All awaitables here are reactor only.
  */
 class Connection {
 public:
-    Connection(Socket socket) : socket_(std::move(socket)) {};
+    Connection(Socket socket, OutboxLimits limits = {}, OutputBudget* budget = nullptr,
+               InboxLimits inbox_limits = {})
+        : socket_(std::move(socket)), inbox_limits_(inbox_limits), read_size_(inbox_limits.read_bytes),
+          limits_(limits), budget_(budget) {};
+    ~Connection();
+
+    class LineAwaiter;
+    class PayloadAwaiter;
+    class TurnAwaiter;
+    class FlushAwaiter;
 
-    // append response to outbox
+    // append response to outbox. Dropped once the hard limit was hit.
     void append_response(std::string data);
 
+    // Bytes not sent yet, readable without the outbox lock
+    size_t outbox_size() const noexcept;
+    // The client stopped reading its responses, disconnect it
+    bool over_hard_limit() const noexcept;
+    // Too much output is waiting for this client (or for all clients), don't read more commands
+    bool should_pause_reading() const noexcept;
+    // Output has drained far enough to accept commands again
+    bool can_resume_reading() const noexcept;
+
 
     // Write to client. Return true if there is still data left to send
     bool write_from_outbox();
 
-    // returns false if client disconnected
+    // Reads until the socket is drained or the read budget is spent.
+    // Returns false if the client disconnected.
     bool read_to_inbox();
 
     // return line if we have a full one (ends in \n)
     std::optional<std::string> try_get_line();
 
+    // The next `size` bytes are a raw payload. They bypass the inbox and its
+    // size limit and are read straight into the buffer that will be stored.
+    void begin_payload(size_t size);
+    bool receiving_payload() const noexcept;
+    // The payload once all of it has arrived, std::nullopt while still reading
+    std::optional<Value> take_payload();
+
+    FramePool& frames() noexcept { return *frames_; }
+
+    // The next command line, once there is one and the output has room for its response
+    LineAwaiter read_line();
+    // The `size` bytes after the current line, as a value to store
+    PayloadAwaiter read_payload(size_t size);
+    // Gives the other clients a turn
+    TurnAwaiter next_turn() noexcept;
+    // Completes with true once everything appended so far has been sent,
+    // with false if the connection is closed (or will be) before that
+    FlushAwaiter flushed();
+
+    SessionWait session_wait() const noexcept { return session_wait_; }
+    // Commands the session took since the reactor last resumed it
+    size_t turn_commands() const noexcept { return turn_commands_; }
+    void count_command() noexcept { ++turn_commands_; }
+    // What the session waits for as Input has arrived
+    bool input_ready();
+    // Runs the suspended session until it suspends again
+    void resume_session();
+    // Completes the flushed() waiters whose output has been sent. The caller
+    // keeps the connection alive, the waiters may hold its last other reference.
+    void resume_flushed();
+    // Destroys the session and fails the flushed() waiters, requests still
+    // running find closed() set. The caller keeps the connection alive.
+    void close();
+    // Any thread
+    bool closed() const noexcept { return closed_.load(std::memory_order_acquire); }
+    // The client can't be understood any more, disconnect once its output is sent
+    void hang_up() noexcept { hang_up_ = true; }
+    bool hung_up() const noexcept { return hang_up_; }
+    // Requests handed to a worker whose reply isn't in the outbox yet
+    void request_queued() noexcept { ++requests_queued_; }
+    void request_answered() noexcept { --requests_queued_; }
+    size_t requests_queued() const noexcept { return requests_queued_; }
+
+    // Sets the "waiting for POLLOUT" bit, returns false if it was already set
+    bool mark_dirty() noexcept;
+    // Reactor: about to apply the pending POLLOUT
+    void clear_dirty() noexcept;
+
     // only used in tests to confirm partial reads/writes
     bool inbox_has_data() const;
     bool outbox_has_data() const;
 
 private:
-    static constexpr size_t MAX_INBOX_SIZE = 1024 * 1024 * 2; // 2MB limit
+    // One read of at most `limit` bytes. Returns the bytes read, 0 on EOF and -1
+    // on EAGAIN, and sets `requested` to what it asked for.
+    ssize_t read_some(size_t limit, size_t& requested);
+    ssize_t read_into_payload(size_t limit, size_t& requested);
+    // Position of the first '\n' in the inbox, npos if there is none yet
+    size_t line_end();
+    void suspend_session(std::coroutine_handle<> session, SessionWait wait) noexcept;
+    // Bytes past the reserved inbox space that one readv() may take in addition
+    static constexpr size_t READ_OVERFLOW_BYTES = 64 * 1024;
+
+    // Small responses are coalesced into segments of up to this size,
+    // larger ones are moved in as a segment of their own
+    static constexpr size_t OUTBOX_SEGMENT_BYTES = 64 * 1024;
     Socket socket_;
-    std::string server_inbox_;
-    std::string server_outbox_;
+    InboxLimits inbox_limits_;
+    InboxBuffer server_inbox_;
+    size_t line_scanned_{0}; // prefix of server_inbox_ known to hold no '\n'
+    size_t read_size_; // adapts to how much the client sends at once
+    std::optional<Value> payload_;
+    size_t payload_received_{0};
+    std::deque<std::string> server_outbox_;
+    size_t outbox_sent_{0}; // prefix of server_outbox_.front() already sent
+    uint64_t appended_total_{0}; // guarded by outbox_mutex_
+    uint64_t sent_total_{0};     // guarded by outbox_mutex_
     mutable std::mutex outbox_mutex_;
+    std::atomic<bool> dirty_{false};
+
+    OutboxLimits limits_;
+    OutputBudget* budget_;
+    std::atomic<size_t> outbox_bytes_{0}; // bytes in server_outbox_ not sent yet
+    std::atomic<bool> over_hard_limit_{false};
+
+    // Reactor only
+    std::unique_ptr<FramePool, FramePool::Release> frames_{new FramePool};
+    std::coroutine_handle<> session_;
+    SessionWait session_wait_{SessionWait::None};
+    size_t turn_commands_{0};
+    bool hang_up_{false};
+    size_t requests_queued_{0};
+    // flushed() waiters in appended order, linked through the awaiters
+    FlushAwaiter* flush_head_{nullptr};
+    FlushAwaiter* flush_tail_{nullptr};
+    std::atomic<bool> closed_{false};
+};
+
+class Connection::LineAwaiter {
+public:
+    explicit LineAwaiter(Connection& connection) noexcept : connection_(connection) {}
+
+    bool await_ready() {
+        if (!connection_.should_pause_reading())
+            line_ = connection_.try_get_line();
+        return line_.has_value();
+    }
+    void await_suspend(std::coroutine_handle<> session) noexcept {
+        connection_.suspend_session(session, SessionWait::Input);
+    }
+    // Resumed once input_ready()
+    std::string await_resume() {
+        if (!line_)
+            line_ = connection_.try_get_line();
+        return std::move(*line_);
+    }
 
+private:
+    Connection& connection_;
+    std::optional<std::string> line_;
+};
+
+class Connection::PayloadAwaiter {
+public:
+    PayloadAwaiter(Connection& connection, size_t size) : connection_(connection) {
+        connection_.begin_payload(size);
+    }
+
+    bool await_ready() const noexcept { return !connection_.receiving_payload(); }
+    void await_suspend(std::coroutine_handle<> session) noexcept {
+        connection_.suspend_session(session, SessionWait::Input);
+    }
+    Value await_resume() { return *connection_.take_payload(); }
+
+private:
+    Connection& connection_;
 };
 
+class Connection::TurnAwaiter {
+public:
+    explicit TurnAwaiter(Connection& connection) noexcept : connection_(connection) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> session) noexcept {
+        connection_.suspend_session(session, SessionWait::Turn);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    Connection& connection_;
+};
+
+class Connection::FlushAwaiter {
+public:
+    FlushAwaiter(Connection& connection, uint64_t end) noexcept : connection_(connection), end_(end) {}
+
+    bool await_ready() noexcept;
+    void await_suspend(std::coroutine_handle<> waiter) noexcept;
+    bool await_resume() const noexcept { return flushed_; }
+
+private:
+    friend class Connection;
+
+    Connection& connection_;
+    uint64_t end_; // appended_total_ once this output is sent
+    bool flushed_{false};
+    std::coroutine_handle<> waiter_;
+    FlushAwaiter* next_{nullptr};
+};
+
+inline Connection::LineAwaiter Connection::read_line() {
+    return LineAwaiter{*this};
+}
+
+inline Connection::PayloadAwaiter Connection::read_payload(size_t size) {
+    return PayloadAwaiter{*this, size};
+}
+
+inline Connection::TurnAwaiter Connection::next_turn() noexcept {
+    return TurnAwaiter{*this};
+}
+
 } // namespace kv
@@ -0,0 +1,86 @@
+#include "coroutine.hpp"
+
+#include <new>
+
+namespace kv {
+
+FramePool::~FramePool() {
+    for (FreeBlock* block : free_) {
+        while (block) {
+            FreeBlock* next = block->next;
+            ::operator delete(block);
+            block = next;
+        }
+    }
+}
+
+void* FramePool::allocate(size_t bytes) {
+    size_t index = size_index(bytes);
+    void* block;
+    if (index < SIZES && free_[index]) {
+        FreeBlock* reused = free_[index];
+        free_[index] = reused->next;
+        --pooled_;
+        block = reused;
+    } else {
+        block = ::operator new(index < SIZES ? (index + 1) * SIZE_STEP : bytes + sizeof(Header));
+    }
+    ++outstanding_;
+    return static_cast<Header*>(new (block) Header{this}) + 1;
+}
+
+void FramePool::deallocate(void* frame, size_t bytes) noexcept {
+    auto* header = static_cast<Header*>(frame) - 1;
+    FramePool* pool = header->pool;
+    size_t index = size_index(bytes);
+    --pool->outstanding_;
+    if (index < SIZES && pool->owned_) {
+        pool->free_[index] = new (header) FreeBlock{pool->free_[index]};
+        ++pool->pooled_;
+    } else {
+        ::operator delete(header);
+        if (!pool->owned_ && pool->outstanding_ == 0)
+            delete pool;
+    }
+}
+
+void FramePool::release() noexcept {
+    owned_ = false;
+    if (outstanding_ == 0)
+        delete this;
+}
+
+
+ReadyQueue::~ReadyQueue() {
+    // Left over at shutdown
+    for (promise_type* promise = take_all(); promise;) {
+        promise_type* next = promise->next_ready;
+        promise->self.destroy();
+        promise = next;
+    }
+}
+
+ReadyQueue::promise_type* ReadyQueue::take_all() noexcept {
+    promise_type* promise = head_.exchange(nullptr, std::memory_order_acquire);
+    promise_type* oldest = nullptr;
+    while (promise) {
+        promise_type* next = promise->next_ready;
+        promise->next_ready = oldest;
+        oldest = promise;
+        promise = next;
+    }
+    return oldest;
+}
+
+size_t ReadyQueue::resume_all() {
+    size_t count = 0;
+    for (promise_type* promise = take_all(); promise; ++count) {
+        // Read the link first, the job may finish and free its frame
+        promise_type* next = promise->next_ready;
+        promise->self.resume();
+        promise = next;
+    }
+    return count;
+}
+
+} // namespace kv
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "waker.hpp"
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace kv {
+
+/*
+ * Allocator for the coroutine frames of one connection.
+ *
+ * Frames are rounded up to SIZE_STEP bytes and freed ones are kept on a
+ * free list per size, so once a connection has had as many requests in
+ * flight as it is going to, serving another allocates nothing. Frames
+ * larger than the biggest size go to the heap.
+ *
+ * Reactor only: frames are created and destroyed on the reactor thread.
+ * The owner calls release() instead of deleting the pool, which goes away
+ * once the last of its frames has been returned too.
+ */
+class FramePool {
+public:
+    static constexpr size_t SIZE_STEP = 64;
+    static constexpr size_t SIZES = 16; // pooled frames up to 1 KiB, header included
+
+    FramePool() = default;
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void* allocate(size_t bytes);
+    // Returns a block from allocate() to the pool it came from
+    static void deallocate(void* frame, size_t bytes) noexcept;
+
+    // The owner is done with the pool
+    void release() noexcept;
+
+    size_t outstanding() const noexcept { return outstanding_; }
+    // Free blocks kept for reuse
+    size_t pooled() const noexcept { return pooled_; }
+
+    struct Release {
+        void operator()(FramePool* pool) const noexcept { pool->release(); }
+    };
+
+private:
+    // In front of every frame, keeps the frame aligned like operator new would
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+        FramePool* pool;
+    };
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    ~FramePool();
+
+    static size_t size_index(size_t bytes) noexcept { return (bytes + sizeof(Header) - 1) / SIZE_STEP; }
+
+    std::array<FreeBlock*, SIZES> free_{};
+    size_t outstanding_ = 0;
+    size_t pooled_ = 0;
+    bool owned_ = true;
+};
+
+template <typename First, typename... Rest>
+FramePool& pool_of(First& first, Rest&... rest) noexcept {
+    if constexpr (std::is_same_v<std::remove_cv_t<First>, FramePool>) {
+        return first;
+    } else {
+        static_assert(sizeof...(Rest) > 0, "a Job coroutine takes a FramePool& parameter");
+        return pool_of(rest...);
+    }
+}
+
+/*
+ * A coroutine nobody waits for. It runs as soon as it is called, up to its
+ * first suspension, and frees its frame when it finishes.
+ *
+ * The frame comes from the FramePool among its parameters (for member
+ * functions, after the object): `Job serve(FramePool&, ...)`.
+ */
+class Job {
+public:
+    // What the promise of every Job has, whatever its parameters
+    struct PromiseBase {
+        PromiseBase* next_ready = nullptr; // link in a ReadyQueue
+        std::coroutine_handle<> self;
+
+        Job get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        // Like an exception escaping a thread
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    // One per parameter list, so operator new is not a template: GCC only
+    // pairs a plain operator new with the operator delete next to it,
+    // anything else makes it warn about mismatched new and delete
+    template <typename... Args>
+    struct Promise : PromiseBase {
+        Promise() noexcept { self = std::coroutine_handle<Promise>::from_promise(*this); }
+
+        static void* operator new(size_t bytes, Args&... args) {
+            return pool_of(args...).allocate(bytes);
+        }
+        static void operator delete(void* frame, size_t bytes) noexcept {
+            FramePool::deallocate(frame, bytes);
+        }
+    };
+};
+
+/*
+ * A suspended Job handed to another thread. Destroyed along with the
+ * object unless it was resumed, so queues dropped at shutdown free theirs.
+ */
+class Resumable {
+public:
+    explicit Resumable(std::coroutine_handle<> job) noexcept : job_(job) {}
+    ~Resumable() {
+        if (job_)
+            job_.destroy();
+    }
+
+    Resumable(Resumable&& other) noexcept : job_(std::exchange(other.job_, {})) {}
+    Resumable& operator=(Resumable&& other) noexcept {
+        if (this != &other) {
+            if (job_)
+                job_.destroy();
+            job_ = std::exchange(other.job_, {});
+        }
+        return *this;
+    }
+
+    void resume() { std::exchange(job_, {}).resume(); }
+
+private:
+    std::coroutine_handle<> job_;
+};
+
+/*
+ * Jobs to resume on the reactor, pushed from any thread.
+ *
+ * Producers push onto a linked stack with a single CAS, and the reactor
+ * takes the whole stack with one exchange and resumes it oldest first. The
+ * link lives in the promise, so handing a job back allocates nothing.
+ */
+class ReadyQueue {
+public:
+    ReadyQueue() = default;
+    ~ReadyQueue();
+
+    ReadyQueue(const ReadyQueue&) = delete;
+    ReadyQueue& operator=(const ReadyQueue&) = delete;
+
+    // Any thread
+    void push(Job::PromiseBase& job) noexcept {
+        promise_type* promise = &job;
+        promise->next_ready = head_.load(std::memory_order_relaxed);
+        // seq_cst so a reactor that announces it is going to sleep and then
+        // checks empty() can't miss this push (see Waker)
+        while (!head_.compare_exchange_weak(promise->next_ready, promise, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed)) {
+        }
+    }
+
+    bool empty() const noexcept {
+        return head_.load(std::memory_order_seq_cst) == nullptr;
+    }
+
+    // Reactor only: resumes every queued job in push order, returns how many
+    size_t resume_all();
+
+private:
+    using promise_type = Job::PromiseBase;
+
+    // Takes the whole stack, oldest first
+    promise_type* take_all() noexcept;
+
+    std::atomic<promise_type*> head_{nullptr};
+};
+
+// co_await QueueHop{queue, key, cost}: continue on the thread that pops the job from `queue`
+template <typename Queue, typename Key>
+struct QueueHop {
+    Queue& queue;
+    Key key;
+    size_t cost;
+
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> job) {
+        // Nothing of the awaiter is used once the job can be popped, it lives in the frame
+        Key flow = key;
+        queue.push(flow, Resumable{job}, cost);
+    }
+    void await_resume() const noexcept {}
+};
+
+// co_await ReactorHop{ready, waker}: continue on the reactor, which drains `ready`
+struct ReactorHop {
+    ReadyQueue& ready;
+    Waker& waker;
+
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> job) noexcept {
+        // The reactor may resume and finish the job, frame and all, before push() returns
+        Waker& reactor = waker;
+        ready.push(job.promise());
+        reactor.notify();
+    }
+    void await_resume() const noexcept {}
+};
+
+} // namespace kv
+
+template <typename... Args>
+struct std::coroutine_traits<kv::Job, Args...> {
+    using promise_type = kv::Job::Promise<std::remove_reference_t<Args>...>;
+};
@@ -1,22 +1,56 @@
-
 #include "tcp_server.hpp"
 #include "connection.hpp"
+#include "config.hpp"
+#include <algorithm>
 #include <iostream>
+#include <string_view>
+#include <vector>
 
 
 /*
  * Entry point for the server executable.
- * parse CLI args
+ * parse CLI args and config file
  * start server
  * block until shutdown
+ *
+ * Usage: kv_server [port] [--config file] [--option value | --switch]...
+ * See Config::usage() (kv_server --help) for the options.
+ *
+ * --engine log keeps all data in an append-only file in --data-dir (default ./kv-data)
+ * that survives restarts. --lazy-free, --lock-free-reads, --compress and the cold tier
+ * only apply to the in-memory map engine.
  */
 
+template <kv::StorageEngine Engine>
+void serve(const kv::ServerOptions& options, typename Engine::Options store_options) {
+    kv::TcpServer<Engine> server{options, std::move(store_options)};
+    server.start();
+}
+
 int main(int argc, char* argv[]) {
-    uint16_t port = argc > 1 ? std::stoi(argv[1]) : 12345;
-    kv::TcpServer server{port};
+    std::vector<std::string_view> args(argv + 1, argv + argc);
+    if (std::find(args.begin(), args.end(), "--help") != args.end()) {
+        std::cout << kv::Config::usage();
+        return 0;
+    }
+
+    kv::ServerConfig config;
+    try {
+        config = kv::Config::parse(args);
+    } catch (const kv::ConfigError& e) {
+        std::cerr << "Error: " << e.what() << "\n\n" << kv::Config::usage();
+        return 1;
+    }
+
+    kv::Logger::set_level(config.log_level);
     try {
-        server.start();
+        if (config.engine == "log")
+            serve<kv::LogStore>(config.server, config.log);
+        else
+            serve<kv::KvStore>(config.server, config.store);
     } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << "\n";
+        KV_LOG(Error, e.what());
+        kv::Logger::flush();
+        return 1;
     }
 }
@@ -3,18 +3,66 @@
 #include <stdexcept>     // std::runtime_error
 #include <sys/socket.h>  // socket(), bind(), listen()
 #include <netinet/in.h>  // sockaddr_in
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <sys/un.h>      // sockaddr_un
+#include <sys/stat.h>    // lstat(), chmod()
 #include <arpa/inet.h>   // htons()
 #include <unistd.h>      // close()
+#include <pthread.h>     // pthread_setaffinity_np()
+#include <sched.h>       // cpu_set_t
+#include <sys/mman.h>    // mlockall()
 
 #include <string>
 #include <string_view>
-#include <iostream>
 #include <csignal>
+#include <cstring>
 
 namespace kv {
 
+namespace {
 
-void TcpServer::start() {
+void pin_to_cpu(pthread_t thread, int cpu) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (int err = ::pthread_setaffinity_np(thread, sizeof(cpus), &cpus); err != 0)
+        throw std::runtime_error("Pinning to CPU " + std::to_string(cpu) + " failed: " + std::strerror(err));
+}
+
+Socket listen_unix(const std::string& path, uint32_t mode) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Unix socket path too long: " + path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket file nobody accepts on is left over from a server that did not shut down
+    // cleanly. Anything else at the path is not ours to remove.
+    struct stat existing{};
+    if (::lstat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        Socket probe{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        if (probe.valid() && ::connect(probe.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0)
+            throw std::runtime_error("Unix socket " + path + " is in use by another server");
+        ::unlink(path.c_str());
+    }
+
+    Socket listener{::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)};
+    if (!listener.valid())
+        throw std::runtime_error("Failed to create Unix socket");
+    if (::bind(listener.fd(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1)
+        throw std::runtime_error("Bind to " + path + " failed: " + std::strerror(errno));
+    // Connecting needs write permission on the file. Set before listen(), no client gets in until then.
+    if (::chmod(path.c_str(), static_cast<mode_t>(mode)) == -1)
+        throw std::runtime_error("chmod of " + path + " failed: " + std::strerror(errno));
+    if (::listen(listener.fd(), SOMAXCONN) == -1)
+        throw std::runtime_error("Listen on " + path + " failed");
+    return listener;
+}
+
+} // namespace
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::start() {
     if (running_)
         throw std::runtime_error("Server is already listening");
 
@@ -26,8 +74,9 @@ void TcpServer::start() {
 
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = INADDR_ANY;
-    addr.sin_port = htons(port_); // Converts port to network byte order
+    if (::inet_pton(AF_INET, options_.address.c_str(), &addr.sin_addr) != 1)
+        throw std::runtime_error("Invalid listen address " + options_.address);
+    addr.sin_port = htons(options_.port); // Converts port to network byte order
 
     int opt = 1;
     setsockopt(listen_socket_.fd(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
@@ -38,25 +87,52 @@ void TcpServer::start() {
     if (::listen(listen_socket_.fd(), SOMAXCONN) == -1)
         throw std::runtime_error("Listen failed");
 
+    if (!options_.unix_socket.empty())
+        unix_socket_ = listen_unix(options_.unix_socket, options_.unix_socket_mode);
+
     std::signal(SIGPIPE, SIG_IGN); // ignore SIGPIPE
     s_this_server = this;
     // Register the signal handler (SIGINT)
     std::signal(SIGINT, signal_handler);
 
+    // Fault in everything now and every later allocation when it is made, not on first touch
+    if (options_.lock_memory && ::mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+        throw std::runtime_error(std::string{"mlockall failed: "} + std::strerror(errno));
+    // Calibrate the cycle counter now rather than on the first traced request
+    if (options_.trace_sample)
+        Tsc::ns_per_tick();
+    // The reactor runs on the calling thread
+    if (options_.reactor_cpu >= 0)
+        pin_to_cpu(::pthread_self(), options_.reactor_cpu);
+
     poll_fds_.push_back({listen_socket_.fd(), POLLIN, 0}); // The server listening socket
-    poll_fds_.push_back({waker_.read_fd(), POLLIN, 0}); // The read-end of the self-pipe
+    if (unix_socket_.valid())
+        poll_fds_.push_back({unix_socket_.fd(), POLLIN, 0});
+    poll_fds_.push_back({waker_.read_fd(), POLLIN, 0}); // The waker's eventfd
     running_ = true;
 
     setup_workers();
     run_reactor();
     s_this_server = nullptr;
     stop();
+    // Sessions and requests waiting for output keep their connections alive
+    for (auto& [fd, connection] : clients_)
+        connection->close();
+    if (!options_.unix_socket.empty())
+        ::unlink(options_.unix_socket.c_str());
 }
 
-void TcpServer::run_reactor() {
+template <StorageEngine Engine>
+void TcpServer<Engine>::run_reactor() {
     while (running_) {
+        ready_.resume_all();
         apply_dirty_updates();
-        int activity = poll(poll_fds_.data(), poll_fds_.size(), -1); // Block until a FD is ready
+        serve_backlog();
+        waker_.prepare_to_sleep();
+        // Producers that finished before the announcement did not signal, don't block on them
+        int timeout = (ready_.empty() && dirty_fds_.empty() && backlog_fds_.empty() && running_) ? -1 : 0;
+        int activity = poll(poll_fds_.data(), poll_fds_.size(), timeout); // Block until a FD is ready
+        waker_.woke_up();
         if (activity < 0) {
             if (errno == EINTR) // interrupted syscall, eg: SIGWINCH or SIGCONT
                 continue;
@@ -70,7 +146,9 @@ void TcpServer::run_reactor() {
 
             // Handle errors (Disconnects)
             if (poll_fds_[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
-                handle_client_dc(i);
+                // A listener closed by stop() on another thread shows up as POLLNVAL, it is no client
+                if (fd_idx_map_.contains(poll_fds_[i].fd))
+                    handle_client_dc(i);
                 continue;
             }
 
@@ -82,9 +160,9 @@ void TcpServer::run_reactor() {
             }
 
             // New client
-            if (poll_fds_[i].fd == listen_socket_.fd()) {
+            if (poll_fds_[i].fd == listen_socket_.fd() || poll_fds_[i].fd == unix_socket_.fd()) {
                 if (poll_fds_[i].revents & POLLIN)
-                    handle_new_connection();
+                    handle_new_connection(poll_fds_[i].fd == listen_socket_.fd() ? listen_socket_ : unix_socket_);
                 continue;
             }
 
@@ -102,46 +180,130 @@ void TcpServer::run_reactor() {
     }
 }
 
-void TcpServer::apply_dirty_updates() {
-    std::vector<int> local_dirty;
-    {
-        // Swap to a local vector to keep the lock time minimal
-        std::lock_guard lock(dirty_mutex_);
-        local_dirty.swap(dirty_fds_);
+template <StorageEngine Engine>
+void TcpServer<Engine>::apply_dirty_updates() {
+    // Sessions resumed below can queue more fds, those are applied in the same pass
+    for (size_t i = 0; i < dirty_fds_.size(); ++i) {
+        int fd = dirty_fds_[i];
+        auto it = fd_idx_map_.find(fd);
+        if (it == fd_idx_map_.end())
+            continue; // disconnected meanwhile
+        int poll_fds_idx = static_cast<int>(it->second);
+        auto& client_connection = clients_[fd];
+        // Clear before the write, so output appended after it queues the fd again
+        client_connection->clear_dirty();
+
+        if (client_connection->over_hard_limit()) {
+            KV_LOG(Warn, "Client [", fd, "] is not reading its responses, disconnecting");
+            handle_client_dc(poll_fds_idx);
+            continue;
+        }
+        poll_fds_[poll_fds_idx].events |= POLLOUT;
+        update_read_interest(poll_fds_idx);
+    }
+    dirty_fds_.clear();
+    resume_paused_clients();
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::update_read_interest(int poll_fds_idx) {
+    pollfd& entry = poll_fds_[poll_fds_idx];
+    auto& client_connection = clients_[entry.fd];
+    bool paused = paused_fds_.contains(entry.fd);
+
+    if (!paused && client_connection->should_pause_reading()) {
+        paused = true;
+        paused_fds_.insert(entry.fd);
+    } else if (paused && client_connection->can_resume_reading()) {
+        paused = false;
+        paused_fds_.erase(entry.fd);
+        // Commands that arrived before the pause are still in the inbox
+        wake_session(*client_connection);
     }
 
-    for (auto fd : local_dirty) {
+    // Only read more once the buffered commands have been handed out
+    if (client_connection->session_wait() == SessionWait::Turn)
+        backlog_fds_.insert(entry.fd);
+    if (paused || client_connection->session_wait() != SessionWait::Input)
+        entry.events &= ~POLLIN;
+    else
+        entry.events |= POLLIN;
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::serve_backlog() {
+    std::vector<int> waiting(backlog_fds_.begin(), backlog_fds_.end());
+    for (int fd : waiting) {
         auto it = fd_idx_map_.find(fd);
-        if (it != fd_idx_map_.end()) {
-            poll_fds_[it->second].events |= POLLOUT;
+        if (it == fd_idx_map_.end()) {
+            backlog_fds_.erase(fd);
+            continue;
         }
+        int poll_fds_idx = static_cast<int>(it->second);
+        backlog_fds_.erase(fd);
+        clients_[fd]->resume_session();
+        update_read_interest(poll_fds_idx);
     }
 }
 
-void TcpServer::mark_as_dirty(int fd) {
-    {
-        std::lock_guard lock(dirty_mutex_);
-        dirty_fds_.push_back(fd);
+template <StorageEngine Engine>
+void TcpServer<Engine>::resume_paused_clients() {
+    // Clients paused by the global limit may have nothing left to write,
+    // so no write event would ever re-check them
+    std::vector<int> paused(paused_fds_.begin(), paused_fds_.end());
+    for (int fd : paused) {
+        auto it = fd_idx_map_.find(fd);
+        if (it != fd_idx_map_.end())
+            update_read_interest(static_cast<int>(it->second));
     }
-    waker_.notify();
 }
 
-void TcpServer::handle_client_write(int& poll_fds_idx) {
+template <StorageEngine Engine>
+void TcpServer<Engine>::wake_session(Connection& connection) {
+    if (connection.session_wait() == SessionWait::Input && connection.input_ready())
+        connection.resume_session();
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::send(int fd, Connection& connection, std::string data) {
+    connection.append_response(std::move(data));
+    if (connection.mark_dirty())
+        dirty_fds_.push_back(fd); // otherwise the pending POLLOUT flushes this output too
+}
+
+template <StorageEngine Engine>
+Connection::FlushAwaiter TcpServer<Engine>::write_all(int fd, Connection& connection, std::string data) {
+    send(fd, connection, std::move(data));
+    return connection.flushed();
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::handle_client_write(int& poll_fds_idx) {
     int fd = poll_fds_[poll_fds_idx].fd;
     auto& client_connection = clients_[fd];
 
     try {
         if (!client_connection->write_from_outbox()) {  // if "everything has been written"
             poll_fds_[poll_fds_idx].events &= ~POLLOUT; // Outbox empty, turn off POLLOUT
+            if (client_connection->hung_up() && client_connection->requests_queued() == 0) {
+                handle_client_dc(poll_fds_idx);
+                return;
+            }
         }
+        client_connection->resume_flushed();
+        update_read_interest(poll_fds_idx);
     } catch (IOError&) {
         handle_client_dc(poll_fds_idx);
     }
 }
 
-void TcpServer::handle_client_dc(int& poll_fds_idx) {
+template <StorageEngine Engine>
+void TcpServer<Engine>::handle_client_dc(int& poll_fds_idx) {
     int moving_fd = poll_fds_.back().fd;
     int dead_fd = poll_fds_[poll_fds_idx].fd;
+    // Held until the coroutines that share it have let go
+    auto dead_connection = std::move(clients_[dead_fd]);
+    dead_connection->close();
 
     // swap & pop to remove dead connection in O(1)
     if (poll_fds_idx < static_cast<int>(poll_fds_.size()) - 1) {
@@ -149,59 +311,272 @@ void TcpServer::handle_client_dc(int& poll_fds_idx) {
         fd_idx_map_[moving_fd] = poll_fds_idx;
     }
     fd_idx_map_.erase(dead_fd);
+    queue_clients_[fd_queue_map_[dead_fd]]--;
+    fd_queue_map_.erase(dead_fd);
+    paused_fds_.erase(dead_fd);
+    backlog_fds_.erase(dead_fd);
     clients_.erase(dead_fd);
     poll_fds_.pop_back();
-    ::close(dead_fd);
-    std::cout << "Client [" << dead_fd << "] disconnected\n";
+    // The Socket owned by the Connection closes the fd once the last reference
+    // (possibly held by a request on a worker) is gone. Closing it here as well could close
+    // an unrelated client that was accepted on the reused fd in the meantime.
+    KV_LOG(Info, "Client [", dead_fd, "] disconnected");
 }
 
-void TcpServer::handle_new_connection() {
-    auto client = accept();
+template <StorageEngine Engine>
+void TcpServer<Engine>::handle_new_connection(const Socket& listener) {
+    auto client = accept(listener);
     if (!client)
         return;
-    std::cout << "Client [" << client->fd() << "] connected on port " << port_ << "\n";
+    if (&listener == &unix_socket_)
+        KV_LOG(Info, "Client [", client->fd(), "] connected on ", options_.unix_socket);
+    else
+        KV_LOG(Info, "Client [", client->fd(), "] connected on port ", options_.port);
     int current_fd = client->fd();
     poll_fds_.push_back({current_fd, POLLIN, 0});
     fd_idx_map_[current_fd] = poll_fds_.size() - 1;
-    clients_[current_fd] = std::make_shared<Connection>(std::move(*client));
+    fd_queue_map_[current_fd] = assign_queue();
+    auto connection = std::make_shared<Connection>(std::move(*client), options_.outbox_limits, &output_budget_,
+                                                   options_.inbox_limits);
+    clients_[current_fd] = connection;
+    // Runs until it waits for the first command
+    run_session(connection->frames(), current_fd, connection);
 }
 
-void TcpServer::handle_new_command(int& poll_fds_idx) {
+template <StorageEngine Engine>
+void TcpServer<Engine>::handle_new_command(int& poll_fds_idx) {
     int fd = poll_fds_[poll_fds_idx].fd;
-    auto client_connection = clients_[poll_fds_[poll_fds_idx].fd];
+    auto client_connection = clients_[fd];
     try {
         // Pull data from the OS into our buffer
         if (!client_connection->read_to_inbox()) {
             handle_client_dc(poll_fds_idx);
             return;
         }
+        read_ticks_ = options_.trace_sample ? Tsc::now() : 0;
+    } catch (const BufferOverflowError& e) {
+        send(fd, *client_connection, Protocol::format_error(e.what()));
+    } catch (const IOError& e) {
+        handle_client_dc(poll_fds_idx);
+        return;
+    }
 
-        // See if we have one (or more) full commands
-        while (auto line = client_connection->try_get_line()) {
-            try {
-                Command cmd = Protocol::parse(*line);
-                if (std::holds_alternative<NoOp>(cmd))
+    wake_session(*client_connection);
+    read_ticks_ = 0;
+    update_read_interest(poll_fds_idx);
+}
+
+template <StorageEngine Engine>
+Job TcpServer<Engine>::run_session(FramePool&, int fd, std::shared_ptr<Connection> connection) {
+    // Complete commands beyond a turn's share stay in the inbox until the
+    // next turn, and all of them while the client has too much output pending
+    while (true) {
+        if (connection->turn_commands() == COMMANDS_PER_TURN)
+            co_await connection->next_turn();
+        std::string line = co_await connection->read_line();
+        connection->count_command();
+        try {
+            size_t cost = line.size() + COMMAND_BASE_COST;
+            std::unique_ptr<RequestTrace> trace;
+            if (options_.trace_sample) [[unlikely]]
+                trace = sample_trace(line, read_ticks_);
+            Command cmd = Protocol::parse(line);
+            if (trace)
+                trace->mark(TraceStage::Parsed);
+            if (std::holds_alternative<NoOp>(cmd))
+                continue;
+            if (auto* slowlog = std::get_if<SlowLog>(&cmd)) {
+                // The slow log belongs to the reactor, answered right here
+                reply(fd, connection, execute_slowlog(*slowlog));
+                continue;
+            }
+            if (std::holds_alternative<ClusterSlots>(cmd)) {
+                reply(fd, connection, execute_cluster_slots());
+                continue;
+            }
+            if (std::holds_alternative<Workers>(cmd)) {
+                reply(fd, connection, execute_workers());
+                continue;
+            }
+            if (auto* blob = std::get_if<SetBlob>(&cmd)) {
+                // The rest of the value may still be on its way
+                blob->payload = std::make_shared<Value>(co_await connection->read_payload(blob->size));
+                cost = blob->size + COMMAND_BASE_COST;
+            } else if (auto* load = std::get_if<Load>(&cmd)) {
+                // Its keys are only known once a worker decodes the stream
+                if (self_node_) {
+                    load->accepts = [this](std::string_view key) {
+                        return options_.cluster_slots.owner_of(key) == self_node_;
+                    };
+                }
+                if (!load->file.empty()) {
+                    load->file = bulk_path(load->file);
+                } else {
+                    load->payload = std::make_shared<Value>(co_await connection->read_payload(load->size));
+                    cost = load->size + COMMAND_BASE_COST;
+                }
+            } else if (auto* dump = std::get_if<Dump>(&cmd)) {
+                if (!dump->file.empty())
+                    dump->file = bulk_path(dump->file);
+                else // leaves room for output the client may still have pending
+                    dump->max_size = options_.outbox_limits.hard_limit / 2;
+            }
+            // After the payload, so a redirected SETBLOB doesn't leave its bytes behind
+            if (self_node_) {
+                if (auto moved = redirect(cmd)) {
+                    reply(fd, connection, std::move(*moved));
                     continue;
-                // Push to worker pool
-                task_deque_.push_back(Task{
-                    .connection = client_connection,
-                    .cmd = cmd,
-                    .on_complete = [this, fd]() { mark_as_dirty(fd); }
-                });
-            } catch (const ProtocolError& e) {
-                client_connection->append_response(Protocol::format_error(e.what()));
-                mark_as_dirty(fd);
+                }
             }
+            // Not awaited: the next command is read while this one runs
+            serve(connection->frames(), fd, connection, std::move(cmd), cost, std::move(trace));
+        } catch (const PayloadError& e) {
+            // The refused payload follows the line, none of it may run as a command
+            KV_LOG(Warn, "Client [", fd, "] announced a payload of ", e.size, " bytes, disconnecting");
+            reply(fd, connection, Protocol::format_error(e.what()));
+            connection->hang_up();
+            co_return;
+        } catch (const ProtocolError& e) {
+            reply(fd, connection, Protocol::format_error(e.what()));
         }
-    } catch (const BufferOverflowError& e) {
-        client_connection->append_response(Protocol::format_error(e.what()));
-        mark_as_dirty(fd);
-    } catch (const IOError& e) {
-        handle_client_dc(poll_fds_idx);
     }
 }
 
-void TcpServer::stop() {
+template <StorageEngine Engine>
+Job TcpServer<Engine>::serve(FramePool&, int fd, std::shared_ptr<Connection> connection, Command cmd, size_t cost,
+                             std::unique_ptr<RequestTrace> trace) {
+    if (trace)
+        trace->mark(TraceStage::Enqueued);
+    connection->request_queued();
+    co_await QueueHop{*task_queues_[fd_queue_map_[fd]], fd, cost};
+
+    // On a worker
+    if (trace)
+        trace->mark(TraceStage::Dequeued);
+    std::string response;
+    if (connection->closed()) {
+        KV_LOG(Debug, "Skipping task, client already disconnected");
+    } else if (!connection->over_hard_limit()) { // its output would be dropped anyway
+        ActiveTrace active{trace.get()};
+        response = CommandDispatcher::execute(cmd, store_);
+    }
+    if (response.empty())
+        trace.reset();
+    else if (trace)
+        trace->mark(TraceStage::Executed);
+    co_await ReactorHop{ready_, waker_};
+
+    // On the reactor, where the fd can't have been reused unless the connection is closed
+    connection->request_answered();
+    if (response.empty() || connection->closed())
+        co_return;
+    bool flushed = co_await write_all(fd, *connection, std::move(response));
+    if (flushed && trace) {
+        trace->mark(TraceStage::Flushed);
+        slow_log_.record(*trace);
+    }
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::reply(int fd, const std::shared_ptr<Connection>& connection, std::string data) {
+    if (connection->requests_queued() == 0)
+        send(fd, *connection, std::move(data));
+    else
+        relay(connection->frames(), fd, connection, std::move(data));
+}
+
+template <StorageEngine Engine>
+Job TcpServer<Engine>::relay(FramePool&, int fd, std::shared_ptr<Connection> connection, std::string data) {
+    connection->request_queued();
+    co_await QueueHop{*task_queues_[fd_queue_map_[fd]], fd, COMMAND_BASE_COST};
+    // On a worker, with nothing to do but to have waited its turn
+    co_await ReactorHop{ready_, waker_};
+
+    connection->request_answered();
+    if (!connection->closed())
+        send(fd, *connection, std::move(data));
+}
+
+template <StorageEngine Engine>
+std::unique_ptr<RequestTrace> TcpServer<Engine>::sample_trace(std::string_view line, uint64_t read_ticks) {
+    if (++trace_countdown_ < options_.trace_sample)
+        return nullptr;
+    trace_countdown_ = 0;
+    auto trace = std::make_unique<RequestTrace>();
+    trace->ticks[static_cast<size_t>(TraceStage::ReadComplete)] = read_ticks;
+    trace->command = line.substr(0, RequestTrace::COMMAND_BYTES);
+    return trace;
+}
+
+template <StorageEngine Engine>
+const ClusterNode* TcpServer<Engine>::cluster_node_of(const ServerOptions& options) {
+    if (options.cluster_slots.empty())
+        return nullptr;
+    for (const ClusterNode& node : options.cluster_slots.nodes()) {
+        if (node == options.cluster_self)
+            return &node;
+    }
+    throw std::runtime_error("cluster node " + options.cluster_self.address() + " has no slots");
+}
+
+template <StorageEngine Engine>
+std::optional<std::string> TcpServer<Engine>::redirect(const Command& command) const {
+    const ClusterNode* target = nullptr;
+    uint16_t target_slot = 0;
+    bool split = false;
+    for_each_key(command, [&](std::string_view key) {
+        uint16_t slot = SlotMap::slot_of(key);
+        const ClusterNode* owner = options_.cluster_slots.owner(slot);
+        if (!target) {
+            target = owner;
+            target_slot = slot;
+        } else if (owner != target) {
+            split = true;
+        }
+    });
+    // Keyless commands run on whichever node gets them
+    if (split)
+        return Protocol::format_error("keys of one command must be on one node");
+    if (!target || target == self_node_)
+        return std::nullopt;
+    return Protocol::format_moved(target_slot, target->address());
+}
+
+template <StorageEngine Engine>
+std::string TcpServer<Engine>::execute_cluster_slots() const {
+    if (!self_node_)
+        return Protocol::format_error("cluster mode is off");
+    return Protocol::format_array(options_.cluster_slots.describe());
+}
+
+template <StorageEngine Engine>
+std::string TcpServer<Engine>::execute_slowlog(const SlowLog& command) {
+    switch (command.action) {
+    case SlowLog::Action::Len:
+        return Protocol::format_integer(static_cast<int64_t>(slow_log_.size()));
+    case SlowLog::Action::Reset:
+        slow_log_.reset();
+        return Protocol::format_ok();
+    case SlowLog::Action::Get:
+        break;
+    }
+    std::vector<std::string> lines;
+    for (const auto& entry : slow_log_.slowest(command.count))
+        lines.push_back(SlowRequestLog::format(entry));
+    return Protocol::format_array(lines);
+}
+
+template <StorageEngine Engine>
+std::string TcpServer<Engine>::bulk_path(std::string_view name) const {
+    if (options_.bulk_directory.empty())
+        throw ProtocolError{"bulk files are disabled, see --bulk-dir"};
+    if (name == "." || name == ".." || name.find('/') != std::string_view::npos)
+        throw ProtocolError{"bulk file must be a plain file name"};
+    return options_.bulk_directory + "/" + std::string{name};
+}
+
+template <StorageEngine Engine>
+void TcpServer<Engine>::stop() {
     // Compare and Swap (atomic transaction) to prevent double-shutdown logic
     bool expected = true;
     if (!running_.compare_exchange_strong(expected, false)) {
@@ -211,19 +586,21 @@ void TcpServer::stop() {
     // stop accepting new clients
     if (listen_socket_.valid())
         listen_socket_ = Socket{}; // destroy old socket, closes FD
+    if (unix_socket_.valid())
+        unix_socket_ = Socket{};
 
-    workers_.clear(); // jthread auto cleanup
+    // Joined but kept, the reactor may still ask them for WORKERS
+    for (auto& pool : worker_pools_)
+        pool->stop();
 }
 
-std::optional<Socket> TcpServer::accept() {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
-
-    // Create non-blocking client socket
+template <StorageEngine Engine>
+std::optional<Socket> TcpServer<Engine>::accept(const Socket& listener) {
+    // Create non-blocking client socket, the peer address is not used
     int client_fd = ::accept4(
-        listen_socket_.fd(),
-        reinterpret_cast<sockaddr*>(&client_addr),
-        &client_len,
+        listener.fd(),
+        nullptr,
+        nullptr,
         SOCK_NONBLOCK | SOCK_CLOEXEC
     );
 
@@ -232,36 +609,81 @@ std::optional<Socket> TcpServer::accept() {
             return std::nullopt;
         throw std::runtime_error("Accept failed");
     }
+    // Responses are written as they complete, often several small writes per batch of
+    // commands. Nagle would hold all but the first until the client ACKs, and a client
+    // waiting for the rest of its replies only ACKs after its delayed-ACK timer.
+    if (&listener == &listen_socket_) {
+        int one = 1;
+        ::setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
 
      return Socket{client_fd};
 }
 
-bool TcpServer::is_running() const noexcept {
+template <StorageEngine Engine>
+bool TcpServer<Engine>::is_running() const noexcept {
     return running_;
 }
 
-void TcpServer::worker_loop(std::stop_token stop_token) {
-    while(!stop_token.stop_requested()) {
-        auto task = task_deque_.wait_and_pop_front(stop_token);
-        if (task) {
-            try {
-                task->execute(store_);
-            } catch (const IOError& e) {
-                std::cout << e.what() << "\n";
-                continue;
-            }
-
+template <StorageEngine Engine>
+void TcpServer<Engine>::setup_workers() {
+    bool affine = options_.scheduling == WorkerScheduling::Affine;
+    size_t num_queues = affine ? options_.workers : 1;
+    for (size_t i = 0; i < num_queues; i++)
+        task_queues_.push_back(std::make_unique<FairTaskQueue<int, Resumable>>());
+    queue_clients_.assign(num_queues, 0);
+
+    for (size_t i = 0; i < num_queues; i++) {
+        // Affine queues have one worker each, the shared one all of them
+        size_t min_workers = affine ? 1 : options_.workers;
+        size_t max_workers = affine ? 1 : std::max(options_.workers, options_.max_workers);
+        WorkerPool<Resumable>::OnStart pin;
+        if (!options_.worker_cpus.empty()) {
+            pin = [this, first = i](std::jthread& thread, size_t number) {
+                pin_to_cpu(thread.native_handle(), options_.worker_cpus[(first + number) % options_.worker_cpus.size()]);
+            };
         }
+        worker_pools_.push_back(std::make_unique<WorkerPool<Resumable>>(*task_queues_[i], min_workers, max_workers,
+                                                                        options_.worker_scaling, std::move(pin)));
+    }
+}
+
+template <StorageEngine Engine>
+std::string TcpServer<Engine>::execute_workers() const {
+    // Name and value pairs like HOTKEYS, summed over the pools
+    WorkerPoolStats total;
+    for (const auto& pool : worker_pools_) {
+        WorkerPoolStats stats = pool->stats();
+        total.running += stats.running;
+        total.peak += stats.peak;
+        total.grown += stats.grown;
+        total.shrunk += stats.shrunk;
     }
+    size_t max_workers = options_.scheduling == WorkerScheduling::Affine ?
+        options_.workers : std::max(options_.workers, options_.max_workers);
+    return Protocol::format_array({
+        "running", std::to_string(total.running),
+        "min", std::to_string(options_.workers),
+        "max", std::to_string(max_workers),
+        "peak", std::to_string(total.peak),
+        "grown", std::to_string(total.grown),
+        "shrunk", std::to_string(total.shrunk),
+    });
 }
 
-void TcpServer::setup_workers() {
-    for (size_t i = 0; i < num_workers_; i++) {
-        workers_.emplace_back([this](std::stop_token stop_token) {
-            worker_loop(stop_token);
-        });
+template <StorageEngine Engine>
+size_t TcpServer<Engine>::assign_queue() {
+    // Least loaded by connection count, ties go to the lowest index
+    size_t best = 0;
+    for (size_t i = 1; i < queue_clients_.size(); i++) {
+        if (queue_clients_[i] < queue_clients_[best])
+            best = i;
     }
+    queue_clients_[best]++;
+    return best;
 }
 
+template class TcpServer<KvStore>;
+template class TcpServer<LogStore>;
 
 } // namespace kv
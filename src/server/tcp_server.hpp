@@ -2,50 +2,98 @@
 
 #include "kv/socket.hpp"
 #include "kv/kv_store.hpp"
+#include "kv/log_store.hpp"
+#include "kv/storage_engine.hpp"
 #include "waker.hpp"
-#include "kv/task_deque.hpp"
+#include "kv/fair_task_queue.hpp"
 #include "kv/protocol.hpp"
 #include "kv/command_dispatcher.hpp"
 #include "connection.hpp"
+#include "coroutine.hpp"
+#include "kv/logger.hpp"
+#include "kv/trace.hpp"
+#include "kv/cluster.hpp"
+#include "worker_pool.hpp"
 #include <cstdint>
 #include <thread>
 #include <deque>
 #include <mutex>
 #include <vector>
-#include <functional>
 #include <condition_variable>
 #include <optional>
 #include <atomic>
 #include <poll.h>
 #include <map>
+#include <unordered_set>
 
-#include <iostream>
 namespace kv {
 
-struct Task {
-    std::weak_ptr<Connection> connection;
-    Command cmd;
-    std::function<void()> on_complete; // Reactor poke callback
-    void execute(KvStore& store) {
-        if (auto client = connection.lock()) {
-            std::string response = CommandDispatcher::execute(cmd, store);
-            if (response.empty())
-                return;
-            client->append_response(response);
-            if (on_complete)
-                on_complete();
-        } else {
-            // The Reactor already deleted this connection
-            std::cout << "[Worker] Skipping task: Client already disconnected." << std::endl;
-        }
-    };
+enum class WorkerScheduling {
+    // Any worker runs any task, pipelined commands of one client may run concurrently
+    Shared,
+    // Each client is pinned to the least loaded worker on accept,
+    // its commands run one at a time and in order
+    Affine,
 };
 
+struct ServerOptions {
+    // IPv4 address to listen on, 0.0.0.0 for all interfaces
+    std::string address = "0.0.0.0";
+    uint16_t port = 12345;
+    // Also listen on a Unix domain socket at this path (empty = TCP only),
+    // with these permission bits. A stale socket file there is replaced.
+    std::string unix_socket{};
+    uint32_t unix_socket_mode = 0660;
+    size_t workers = 5;
+    // Above workers, shared workers scale between the two by queue depth and
+    // wait, as worker_scaling says (0 = a fixed pool of workers)
+    size_t max_workers = 0;
+    WorkerScaling worker_scaling{};
+    WorkerScheduling scheduling = WorkerScheduling::Shared;
+    InboxLimits inbox_limits{};
+    OutboxLimits outbox_limits{};
+
+    // Pin the reactor thread to one CPU (-1 = not pinned) and the workers to
+    // worker_cpus, spread round-robin (empty = not pinned)
+    int reactor_cpu = -1;
+    std::vector<int> worker_cpus{};
+
+    // mlockall() current and future memory, so no request stalls on a page
+    // fault or swap-in. Needs CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK.
+    bool lock_memory = false;
+
+    // Directory LOAD FILE and DUMP FILE read and write in (empty = those are refused).
+    // Clients name a file in it, never a path.
+    std::string bulk_directory{};
+
+    // Trace one in this many commands through every stage (0 = off) and
+    // keep the slowest slowlog_size of them for SLOWLOG GET
+    uint32_t trace_sample = 0;
+    size_t slowlog_size = 128;
+
+    // Cluster mode, off while cluster_slots is empty. This server is the node
+    // cluster_self and serves only that node's slots. Commands with keys in
+    // other slots get a MOVED redirect to the node that serves them.
+    SlotMap cluster_slots{};
+    ClusterNode cluster_self{};
+};
 
+/*
+ * The storage engine is a template parameter so workers call it directly.
+ * Instantiated in tcp_server.cpp for KvStore and LogStore.
+ *
+ * Every client gets a session coroutine on the reactor that reads and
+ * parses its commands, and every command a request coroutine that hops to
+ * a worker to execute and back to the reactor to write its response.
+ * Both live in frames from the connection's FramePool.
+ */
+template <StorageEngine Engine = KvStore>
 class TcpServer {
 public:
-    explicit TcpServer(uint16_t port, size_t num_workers = 5)
-        : port_(port), num_workers_(num_workers) {};
+    explicit TcpServer(ServerOptions options, typename Engine::Options store_options = {})
+        : store_(std::move(store_options)), options_(std::move(options)),
+          output_budget_(options_.outbox_limits.total_limit), slow_log_(options_.slowlog_size),
+          self_node_(cluster_node_of(options_)) {}
 
     ~TcpServer() = default;
 
@@ -55,41 +103,78 @@ public:
     TcpServer(TcpServer&&) = delete;
     TcpServer operator=(TcpServer&&) = delete;
 
-    // Bind to the given port and start listening.
+    // Bind to the configured address (and Unix socket, if any) and start listening.
     // Throws std::runtime_error on failure.
     void start();
 
     // Stop listening (closes socket), stop workers
     void stop();
 
-    // Accept a new client connection.
-    std::optional<Socket> accept();
+    // Accept a new client connection on one of the listening sockets.
+    std::optional<Socket> accept(const Socket& listener);
 
     // Returns true if the server is running.
     bool is_running() const noexcept;
 
 private:
-    KvStore store_;
+    Engine store_;
+    const ServerOptions options_;
+    OutputBudget output_budget_; // declared before clients_, connections report to it until destroyed
+    SlowRequestLog slow_log_; // reactor only
+    const ClusterNode* self_node_; // in options_.cluster_slots, nullptr unless in cluster mode
+    uint32_t trace_countdown_{0};
     Socket listen_socket_;
+    Socket unix_socket_; // invalid unless options_.unix_socket is set
     std::atomic<bool> running_{false};
-    uint16_t port_{0};
 
     // Reactor event loop
     void run_reactor();
-    void handle_new_connection();
+    void handle_new_connection(const Socket& listener);
     void handle_new_command(int& poll_fds_idx);
+    // Reads, parses and hands out the client's commands, for as long as it is connected
+    Job run_session(FramePool& frames, int fd, std::shared_ptr<Connection> connection);
+    // One command: executed on a worker, answered from the reactor
+    Job serve(FramePool& frames, int fd, std::shared_ptr<Connection> connection, Command cmd, size_t cost,
+              std::unique_ptr<RequestTrace> trace);
+    // A reply made on the reactor (errors, SLOWLOG, MOVED, ...). Sent at once if no
+    // request of the client is on a worker, otherwise relayed behind them.
+    void reply(int fd, const std::shared_ptr<Connection>& connection, std::string data);
+    // Takes `data` through the client's queue, so with affine workers it comes after
+    // the replies of the requests queued before it
+    Job relay(FramePool& frames, int fd, std::shared_ptr<Connection> connection, std::string data);
+    // Reactor only: queues output for the client, sent once the reactor sees it writable
+    void send(int fd, Connection& connection, std::string data);
+    Connection::FlushAwaiter write_all(int fd, Connection& connection, std::string data);
+    // Resumes the client's session if what it waits for is there
+    void wake_session(Connection& connection);
+    // When the read that woke the running session finished, 0 if not traced
+    uint64_t read_ticks_{0};
+    std::unique_ptr<RequestTrace> sample_trace(std::string_view line, uint64_t read_ticks);
+    std::string execute_slowlog(const SlowLog& command);
+    // This server's entry in the slot map, throws std::runtime_error if it has none
+    static const ClusterNode* cluster_node_of(const ServerOptions& options);
+    // Cluster mode: the reply for a command whose keys this node doesn't serve
+    std::optional<std::string> redirect(const Command& command) const;
+    std::string execute_cluster_slots() const;
+    // Path of a LOAD FILE / DUMP FILE name, throws ProtocolError if it isn't allowed
+    std::string bulk_path(std::string_view name) const;
+    void serve_backlog();
     void handle_client_write(int& poll_fds_idx);
     void handle_client_dc(int& poll_fds_idx);
 
     // Thread pool
-    size_t num_workers_{5};
-    std::deque<std::function<void()>> tasks_{};
-    TaskDeque<Task> task_deque_;
-    std::vector<std::jthread> workers_;
+    // One queue shared by all workers, or one per worker when affine.
+    // Each queue has one flow per client fd and holds suspended requests.
+    std::vector<std::unique_ptr<FairTaskQueue<int, Resumable>>> task_queues_;
+    std::unordered_map<int, size_t> fd_queue_map_;
+    std::vector<size_t> queue_clients_; // clients assigned to each queue
+    // One pool per queue, elastic if options_.max_workers asks for it
+    std::vector<std::unique_ptr<WorkerPool<Resumable>>> worker_pools_;
     std::vector<pollfd> poll_fds_;
     std::map<int, std::shared_ptr<Connection>> clients_; // fd -> connection map
     void setup_workers();
-    void worker_loop(std::stop_token stop_token);
+    size_t assign_queue();
+    std::string execute_workers() const;
 
     // Waker
     Waker waker_;
@@ -99,14 +184,28 @@ private:
             s_this_server->stop();
     }
 
-    // dirty list
-    std::mutex dirty_mutex_;
+    // Requests back from the workers
+    ReadyQueue ready_;
+    // Connections with new output, each queued at most once until the reactor drains it
     std::vector<int> dirty_fds_;
     std::unordered_map<int, size_t> fd_idx_map_;
 
-    void mark_as_dirty(int fd);
     void apply_dirty_updates();
 
+    // Backpressure: clients with too much unsent output are not read from
+    std::unordered_set<int> paused_fds_;
+    // Clients whose session has used up its turn, with complete commands
+    // left in the inbox. Not read from until those are dispatched.
+    std::unordered_set<int> backlog_fds_;
+    static constexpr size_t COMMANDS_PER_TURN = 32;
+    // Added to a command's length for its scheduling cost, so tiny commands aren't free
+    static constexpr size_t COMMAND_BASE_COST = 64;
+    void update_read_interest(int poll_fds_idx);
+    void resume_paused_clients();
+
 };
 
+extern template class TcpServer<KvStore>;
+extern template class TcpServer<LogStore>;
+
 } // namespace kv
@@ -1,34 +1,45 @@
-
 #include "waker.hpp"
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cstdint>
+
 
 namespace kv {
 
-Waker::Waker() {
-    if (pipe(pipe_fds_) == -1)
-        throw std::runtime_error("Failed to create self-pipe");
-    // Set both ends to non-blocking
-    fcntl(pipe_fds_[0], F_SETFL, O_NONBLOCK);
-    fcntl(pipe_fds_[1], F_SETFL, O_NONBLOCK);
+Waker::Waker() : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (event_fd_ == -1)
+        throw std::runtime_error("Failed to create eventfd");
 }
 
 Waker::~Waker() {
-    close(pipe_fds_[0]);
-    close(pipe_fds_[1]);
+    close(event_fd_);
 }
 
 int Waker::read_fd() const {
-    return pipe_fds_[0];
+    return event_fd_;
 }
 
 void Waker::notify() {
-    char c = 'x';
-    [[maybe_unused]] ssize_t _ = write(pipe_fds_[1], &c, 1);
+    // Only the first producer after the reactor went to sleep pays for the syscall
+    if (!sleeping_.exchange(false, std::memory_order_seq_cst))
+        return;
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t _ = write(event_fd_, &one, sizeof(one));
+}
+
+void Waker::prepare_to_sleep() noexcept {
+    sleeping_.store(true, std::memory_order_seq_cst);
+}
+
+void Waker::woke_up() noexcept {
+    sleeping_.store(false, std::memory_order_relaxed);
 }
 
 void Waker::clear() {
-    char buf[16];
-    while (read(pipe_fds_[0], buf, sizeof(buf)) > 0);
+    // A single read resets the eventfd counter
+    uint64_t count;
+    [[maybe_unused]] ssize_t _ = read(event_fd_, &count, sizeof(count));
 }
 
 } // namespace kv
@@ -1,25 +1,45 @@
 #pragma once
 
-#include <unistd.h>
-#include <fcntl.h>
+#include <atomic>
 #include <stdexcept>
 
 
 namespace kv {
 
+/*
+ * Wakes the reactor out of poll() through an eventfd.
+ *
+ * The reactor announces when it is about to block; notify() only touches the
+ * eventfd if it actually is, so a busy reactor costs producers one atomic
+ * exchange instead of a syscall. A reactor woken by one notify() also sees
+ * everything published before the later ones.
+ */
 class Waker {
 public:
     Waker();
     ~Waker();
+
+    // Non-copyable
+    Waker(const Waker&) = delete;
+    Waker& operator=(const Waker&) = delete;
+
     int read_fd() const;
 
-    // This is the self-pipe trigger called by the signal handler
+    // Called by workers and the signal handler, async-signal-safe
     void notify();
 
+    // Reactor: about to block. Re-check pending work afterwards, anything
+    // published before this call may not have signalled.
+    void prepare_to_sleep() noexcept;
+
+    // Reactor: back from poll(), producers can stop signalling
+    void woke_up() noexcept;
+
     void clear();
 
 private:
-    int pipe_fds_[2];
+    int event_fd_;
+    std::atomic<bool> sleeping_{false};
 };
 
 } // namespace kv
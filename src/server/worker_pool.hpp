@@ -0,0 +1,202 @@
+#pragma once
+
+#include "kv/fair_task_queue.hpp"
+#include "kv/logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+namespace kv {
+
+// When an elastic WorkerPool grows and shrinks
+struct WorkerScaling {
+    // Start one more worker when a task was queued longer than grow_wait, or
+    // more than grow_depth tasks per running worker are left queued...
+    std::chrono::microseconds grow_wait{2000};
+    size_t grow_depth = 16;
+    // ...but at most one per grow_interval
+    std::chrono::milliseconds grow_interval{5};
+    // Stop one worker once the pool went this long without all of its workers
+    // busy at the same time and without growing or shrinking
+    std::chrono::milliseconds shrink_idle{5000};
+};
+
+// What a WorkerPool did, for the WORKERS command
+struct WorkerPoolStats {
+    size_t running = 0;
+    size_t peak = 0;
+    uint64_t grown = 0;
+    uint64_t shrunk = 0;
+};
+
+/*
+ * Threads running the tasks of one FairTaskQueue: anything with resume().
+ *
+ * With min_workers == max_workers the pool is fixed and a worker does
+ * nothing but pop and resume. Otherwise the workers size the pool
+ * themselves. Each pop tells how long the task was queued and how many are
+ * left, and a worker that sees too much of either starts another before it
+ * runs its task. Once the pool went shrink_idle without all of its workers
+ * busy at the same time, the next worker to notice stops, one per
+ * shrink_idle. Growing takes milliseconds and shrinking seconds, so a pool
+ * between two bursts keeps its threads.
+ */
+template <typename Task>
+class WorkerPool {
+public:
+    using Queue = FairTaskQueue<int, Task>;
+    using Clock = typename Queue::Clock;
+    // Called for every started worker with its thread and how many were started before it
+    using OnStart = std::function<void(std::jthread& thread, size_t number)>;
+
+    WorkerPool(Queue& queue, size_t min_workers, size_t max_workers, WorkerScaling scaling = {},
+               OnStart on_start = {})
+        : queue_(queue), min_workers_(min_workers), max_workers_(std::max(min_workers, max_workers)),
+          scaling_(scaling), on_start_(std::move(on_start)) {
+        std::lock_guard lock(mutex_);
+        last_change_ = last_saturated_ = now();
+        for (size_t i = 0; i < min_workers_; ++i)
+            start_worker();
+    }
+
+    ~WorkerPool() { stop(); }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Stops and joins every worker, the tasks still queued stay in the queue
+    void stop() {
+        std::list<Worker> workers;
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+            workers.swap(workers_);
+        }
+        // jthreads request stop and join as they go
+    }
+
+    bool elastic() const noexcept { return max_workers_ > min_workers_; }
+
+    WorkerPoolStats stats() const noexcept {
+        return {running_.load(std::memory_order_relaxed), peak_.load(std::memory_order_relaxed),
+                grown_.load(std::memory_order_relaxed), shrunk_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    struct Worker {
+        std::jthread thread;
+        bool retired = false; // its loop has ended, under mutex_
+    };
+
+    static int64_t now() noexcept { return Clock::now().time_since_epoch().count(); }
+    static int64_t ticks(Clock::duration duration) noexcept { return duration.count(); }
+
+    void run(std::stop_token stop_token, Worker& self) {
+        if (!elastic()) {
+            while (!stop_token.stop_requested()) {
+                if (auto task = queue_.wait_and_pop(stop_token))
+                    task->resume();
+            }
+            return;
+        }
+        while (!stop_token.stop_requested()) {
+            typename Queue::PopStats popped;
+            if (auto task = queue_.wait_and_pop_for(stop_token, scaling_.shrink_idle, popped)) {
+                if (busy_.fetch_add(1, std::memory_order_relaxed) + 1 >= running_.load(std::memory_order_relaxed))
+                    last_saturated_.store(now(), std::memory_order_relaxed);
+                if (popped.waited > scaling_.grow_wait ||
+                    popped.remaining > scaling_.grow_depth * running_.load(std::memory_order_relaxed))
+                    grow();
+                task->resume(); // runs until it hops somewhere else
+                busy_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            if (spare() && retire(self))
+                return;
+        }
+    }
+
+    // No pressure for a whole shrink_idle and more workers than the minimum
+    bool spare() const noexcept {
+        int64_t idle = ticks(scaling_.shrink_idle);
+        int64_t at = now();
+        return running_.load(std::memory_order_relaxed) > min_workers_ &&
+               at - last_saturated_.load(std::memory_order_relaxed) >= idle &&
+               at - last_change_.load(std::memory_order_relaxed) >= idle;
+    }
+
+    void grow() {
+        // Checked once without the lock, every worker in a burst gets here
+        int64_t at = now();
+        auto due = [&]() {
+            return running_.load(std::memory_order_relaxed) < max_workers_ &&
+                   at - last_change_.load(std::memory_order_relaxed) >= ticks(scaling_.grow_interval);
+        };
+        if (!due())
+            return;
+        std::lock_guard lock(mutex_);
+        if (stopping_ || !due())
+            return;
+        // Workers that stopped since the last change are done, join them
+        workers_.remove_if([](const Worker& worker) { return worker.retired; });
+        start_worker();
+        grown_.fetch_add(1, std::memory_order_relaxed);
+        last_change_.store(at, std::memory_order_relaxed);
+        KV_LOG(Info, "Worker pool grown to ", running_.load(), " threads, queue depth or wait over limit");
+    }
+
+    // Ends the calling worker's loop, false if the pool changed in the meantime
+    bool retire(Worker& self) {
+        std::lock_guard lock(mutex_);
+        if (stopping_ || !spare())
+            return false;
+        self.retired = true;
+        running_.fetch_sub(1, std::memory_order_relaxed);
+        shrunk_.fetch_add(1, std::memory_order_relaxed);
+        last_change_.store(now(), std::memory_order_relaxed);
+        KV_LOG(Info, "Worker pool shrunk to ", running_.load(), " threads after ", scaling_.shrink_idle.count(),
+               " ms with spare workers");
+        return true;
+    }
+
+    // Under mutex_
+    void start_worker() {
+        Worker& worker = workers_.emplace_back();
+        // The worker can't touch `worker` before the lock is released
+        worker.thread = std::jthread([this, &worker](std::stop_token stop_token) { run(stop_token, worker); });
+        size_t running = running_.fetch_add(1, std::memory_order_relaxed) + 1;
+        peak_.store(std::max(peak_.load(std::memory_order_relaxed), running), std::memory_order_relaxed);
+        if (on_start_)
+            on_start_(worker.thread, started_);
+        ++started_;
+    }
+
+    Queue& queue_;
+    const size_t min_workers_;
+    const size_t max_workers_;
+    const WorkerScaling scaling_;
+    const OnStart on_start_;
+
+    std::mutex mutex_; // workers_, started_, stopping_ and any change to the worker count
+    std::list<Worker> workers_; // stable addresses, each thread holds its own entry
+    size_t started_ = 0;
+    bool stopping_ = false;
+
+    std::atomic<size_t> running_{0};
+    std::atomic<size_t> busy_{0};
+    std::atomic<size_t> peak_{0};
+    std::atomic<uint64_t> grown_{0};
+    std::atomic<uint64_t> shrunk_{0};
+    // Clock ticks of the last time every worker was busy, and of the last grow or shrink
+    std::atomic<int64_t> last_saturated_{0};
+    std::atomic<int64_t> last_change_{0};
+};
+
+} // namespace kv
@@ -38,8 +38,16 @@ def server_path():
 
 
 @pytest.fixture(scope="session")
-def kv_server(server_path, request):
-    port = get_free_port()
+def client_path():
+    path = os.getenv("KV_CLIENT_BIN")
+    if not path or not os.path.exists(path):
+        pytest.fail(f"Client binary not found at: {path}. "
+                    "Make sure KV_CLIENT_BIN is set correctly.")
+    return path
+
+
+def start_server(server_path, request, *flags, port=None):
+    port = port or get_free_port()
     show_logs = request.config.getoption("--show-logs")
     print("\n\nDEBUG: show_logs is", show_logs)
     print("\n")
@@ -52,7 +60,7 @@ def kv_server(server_path, request):
         stderr_pipe = subprocess.DEVNULL
 
     # Start the server process
-    proc = subprocess.Popen([server_path, str(port)],
+    proc = subprocess.Popen([server_path, str(port), *flags],
                             stdout=stdout_pipe,
                             stderr=stderr_pipe,
                             text=True)
@@ -79,8 +87,102 @@ def kv_server(server_path, request):
                 pytest.fail("Server failed to start within 2 seconds")
             time.sleep(0.1)
 
+    return proc, port
+
+
+@pytest.fixture(scope="session")
+def kv_server(server_path, request):
+    proc, port = start_server(server_path, request, "--ordered-index")
+    yield "127.0.0.1", port
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Server that pins every client to one worker
+@pytest.fixture(scope="session")
+def affine_kv_server(server_path, request):
+    proc, port = start_server(server_path, request, "--affine-workers")
+    yield "127.0.0.1", port
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Server that stores large values LZ4-compressed
+@pytest.fixture(scope="session")
+def compressed_kv_server(server_path, request):
+    proc, port = start_server(server_path, request, "--compress")
+    yield "127.0.0.1", port
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Server that traces every command and keeps the 5 slowest for SLOWLOG
+@pytest.fixture(scope="session")
+def traced_kv_server(server_path, request):
+    proc, port = start_server(server_path, request, "--trace-sample", "1", "--slowlog-size", "5")
     yield "127.0.0.1", port
 
     # Cleanup
     proc.terminate()
     proc.wait()
+
+
+# Server with one worker that may grow to 4 under load and shrinks back quickly
+@pytest.fixture(scope="session")
+def elastic_kv_server(server_path, request):
+    proc, port = start_server(server_path, request, "--workers", "1", "--max-workers", "4",
+                              "--scale-up-wait", "100", "--scale-down-idle", "100")
+    yield "127.0.0.1", port
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Server that also listens on a Unix domain socket, yields (host, port, socket path)
+@pytest.fixture(scope="session")
+def unix_kv_server(server_path, request, tmp_path_factory):
+    path = str(tmp_path_factory.mktemp("uds") / "kv.sock")
+    proc, port = start_server(server_path, request, "--unix-socket", path, "--unix-socket-mode", "600")
+    yield "127.0.0.1", port, path
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Server that reads and writes LOAD FILE / DUMP FILE in a temporary directory,
+# yields (host, port, bulk directory)
+@pytest.fixture(scope="session")
+def bulk_kv_server(server_path, request, tmp_path_factory):
+    directory = tmp_path_factory.mktemp("bulk")
+    proc, port = start_server(server_path, request, "--bulk-dir", str(directory))
+    yield "127.0.0.1", port, directory
+
+    # Cleanup
+    proc.terminate()
+    proc.wait()
+
+
+# Three nodes sharing the hash slots, yields the ports of the nodes in slot order
+@pytest.fixture(scope="session")
+def kv_cluster(server_path, request):
+    ports = [get_free_port() for _ in range(3)]
+    ranges = ["0-5460", "5461-10922", "10923-16383"]
+    nodes = []
+    for port, slots in zip(ports, ranges):
+        nodes += ["--cluster-node", f"127.0.0.1:{port} {slots}"]
+    procs = [start_server(server_path, request, *nodes, "--cluster-self", f"127.0.0.1:{port}", port=port)[0]
+             for port in ports]
+    yield ports
+
+    # Cleanup
+    for proc in procs:
+        proc.terminate()
+        proc.wait()
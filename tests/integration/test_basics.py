@@ -1,6 +1,13 @@
+import os
+import signal
 import socket
+import stat
+import struct
+import subprocess
 import time
 
+from conftest import start_server
+
 
 def send_cmd(addr, port, cmd):
     with socket.create_connection((addr, port)) as client:
@@ -66,6 +73,83 @@ def test_to_large_value(kv_server):
     assert "value too large" in resp
 
 
+def recv_exactly(s, size):
+    chunks = []
+    while size > 0:
+        chunk = s.recv(min(size, 1024 * 1024))
+        assert chunk, "server closed the connection"
+        chunks.append(chunk)
+        size -= len(chunk)
+    return b"".join(chunks)
+
+
+def test_blob_larger_than_inbox_limit(kv_server):
+    host, port = kv_server
+    # 50MB of binary data, newlines included
+    blob = bytes(range(256)) * (50 * 1024 * 1024 // 256)
+
+    with socket.create_connection((host, port)) as s:
+        s.sendall(f"SETBLOB blob {len(blob)}\n".encode() + blob + b"\n")
+        assert recv_exactly(s, 4) == b"+OK\n"
+
+        s.sendall(b"GETBLOB blob\n")
+        header = f"={len(blob)}\n".encode()
+        assert recv_exactly(s, len(header)) == header
+        assert recv_exactly(s, len(blob)) == blob
+        assert recv_exactly(s, 1) == b"\n"
+
+        # Back to the line protocol
+        s.sendall(b"PING\n")
+        assert recv_exactly(s, 6) == b"$Pong\n"
+
+        s.sendall(b"GETBLOB missing\n")
+        assert b"key not found" in s.recv(1024)
+
+
+def recv_until_closed(s):
+    data = b""
+    while chunk := s.recv(1024):
+        data += chunk
+    return data
+
+
+def test_refused_blob_payload_is_never_run(kv_server):
+    host, port = kv_server
+    assert send_cmd(host, port, "SET victim alive") == "+OK\n"
+
+    with socket.create_connection((host, port)) as s:
+        # The bytes after the header are the payload, even when they look like commands
+        s.sendall(b"SETBLOB k 999999999999\nDEL victim\n")
+        assert recv_until_closed(s) == b"-ERR blob too large\n"
+
+    assert send_cmd(host, port, "GET victim") == "$alive\n"
+
+
+def test_compressed_values(compressed_kv_server):
+    host, port = compressed_kv_server
+    # SET values can't contain spaces
+    page = "".join(f"<li><a\thref='/items/{i}'>Item_{i}</a></li>" for i in range(4000))
+
+    with socket.create_connection((host, port)) as s:
+        s.sendall(f"SET page {page}\n".encode())
+        assert recv_exactly(s, 4) == b"+OK\n"
+
+        # Plain GETs never see the compression
+        s.sendall(b"GET page\n")
+        assert recv_exactly(s, len(page) + 2) == f"${page}\n".encode()
+
+        # Clients that ask for it get the LZ4 block as stored
+        s.sendall(b"GETBLOB page COMPRESSED\n")
+        header = b""
+        while not header.endswith(b"\n"):
+            header += recv_exactly(s, 1)
+        size, uncompressed_size = map(int, header[1:].split())
+        assert header.startswith(b"~")
+        assert uncompressed_size == len(page)
+        assert size < len(page) // 4
+        recv_exactly(s, size + 1)
+
+
 def test_garbage_input(kv_server):
     host, port = kv_server
     with socket.create_connection((host, port)) as s:
@@ -76,3 +160,438 @@ def test_garbage_input(kv_server):
         # Connection still works after error
         s.sendall(b"SET recovery 1\n")
         assert b"OK" in s.recv(1024)
+
+
+def test_atomic_counter_and_cas(kv_server):
+    host, port = kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        for cmd, expected in [(b"INCR hits", b":1\n"), (b"INCRBY hits 9", b":10\n"), (b"DECR hits", b":9\n")]:
+            s.sendall(cmd + b"\n")
+            assert f.readline() == expected
+
+        s.sendall(b"GETS hits\n")
+        assert f.readline() == b"*2\n"
+        assert f.readline() == b"$9\n"
+        version = f.readline()[1:].strip().decode()
+
+        s.sendall(f"CAS hits {version} done\n".encode())
+        assert f.readline() == b"+OK\n"
+        s.sendall(f"CAS hits {version} again\n".encode())
+        assert b"version mismatch" in f.readline()
+
+
+def test_prefix_scan_and_range(kv_server):
+    host, port = kv_server
+    with socket.create_connection((host, port)) as s:
+        for key in ["scan:b", "scan:a", "scan:c", "scanx"]:
+            s.sendall(f"SET {key} 1\n".encode())
+            assert b"OK" in s.recv(1024)
+
+        # The first element is the key the next page starts at
+        s.sendall(b"SCAN scan: LIMIT 2\n")
+        assert s.recv(1024) == b"*3\n$scan:c\n$scan:a\n$scan:b\n"
+
+        s.sendall(b"SCAN scan: LIMIT 2 FROM scan:c\n")
+        assert s.recv(1024) == b"*2\n$\n$scan:c\n"
+
+        s.sendall(b"RANGE scan:b scanx\n")
+        assert s.recv(1024) == b"*3\n$\n$scan:b\n$scan:c\n"
+
+
+def test_cursor_scan(kv_server):
+    host, port = kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        for i in range(50):
+            s.sendall(f"SET cursor_key_{i} 1\n".encode())
+            assert b"OK" in f.readline()
+
+        seen = set()
+        cursor = "0"
+        while True:
+            s.sendall(f"SCAN {cursor} COUNT 10\n".encode())
+            count = int(f.readline()[1:])
+            cursor = f.readline()[1:].decode().strip()
+            for _ in range(count - 1):
+                seen.add(f.readline()[1:].decode().strip())
+            if cursor == "0":
+                break
+
+        assert {f"cursor_key_{i}" for i in range(50)} <= seen
+
+
+def test_client_that_never_reads_is_disconnected(kv_server):
+    host, port = kv_server
+    # Big enough that the GETs dispatched before reading pauses exceed the limit
+    huge = 8 * 1024 * 1024
+    assert "OK" in send_cmd(host, port, f"SETBLOB huge {huge}\n{'x' * huge}")
+
+    # Pipeline far more 8MB GETs than the 64MB output limit, never read a reply
+    greedy = socket.create_connection((host, port))
+    greedy.settimeout(0.5)
+    try:
+        for _ in range(50):
+            greedy.sendall(b"GET huge\n" * 100)
+    except (socket.timeout, ConnectionError):
+        pass # the server stopped reading from us
+
+    # Everyone else is still served
+    assert "Pong" in send_cmd(host, port, "PING")
+
+    # Draining the socket now ends in EOF or a reset instead of endless data
+    greedy.settimeout(10)
+    received = 0
+    try:
+        while chunk := greedy.recv(1024 * 1024):
+            received += len(chunk)
+    except ConnectionError:
+        pass
+    greedy.close()
+    assert received < 100 * 1024 * 1024
+
+
+def test_slowlog_keeps_slowest_traced_commands(traced_kv_server):
+    host, port = traced_kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        s.sendall(b"SLOWLOG RESET\n")
+        assert f.readline() == b"+OK\n"
+        for i in range(20):
+            s.sendall(f"SET slow_{i} {'v' * (1000 * i + 1)}\n".encode())
+            assert f.readline() == b"+OK\n"
+
+        s.sendall(b"SLOWLOG LEN\n")
+        assert f.readline() == b":5\n"
+
+        s.sendall(b"SLOWLOG GET 3\n")
+        assert f.readline() == b"*3\n"
+        entries = [f.readline()[1:].decode().strip() for _ in range(3)]
+        totals = [float(entry.split("total_us=")[1].split()[0]) for entry in entries]
+        assert totals == sorted(totals, reverse=True)
+        for entry in entries:
+            for stage in ["read=", "parse=", "enqueue=", "queue=", "lock=", "execute=", "flush="]:
+                assert f" {stage}" in entry
+            assert "command=SET slow_" in entry
+
+        s.sendall(b"SLOWLOG RESET\n")
+        assert f.readline() == b"+OK\n"
+        s.sendall(b"SLOWLOG GET\n")
+        assert f.readline() == b"*0\n"
+
+
+def test_hotkeys_reports_most_read_key(kv_server):
+    host, port = kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        s.sendall(b"SET hotkeys_test:hot value\n")
+        assert f.readline() == b"+OK\n"
+        # Pipelined, reads are sampled so the count is approximate
+        s.sendall(b"GET hotkeys_test:hot\n" * 5000)
+        for _ in range(5000):
+            assert f.readline() == b"$value\n"
+
+        s.sendall(b"HOTKEYS 5\n")
+        header = f.readline()
+        assert header.startswith(b"*")
+        reply = [f.readline()[1:].decode().strip() for _ in range(int(header[1:]))]
+        assert "hotkeys_test:hot" in reply[0::2]
+        count = int(reply[reply.index("hotkeys_test:hot") + 1])
+        assert 2500 < count < 10000
+
+        s.sendall(b"HOTKEYS many\n")
+        assert f.readline().startswith(b"-ERR")
+
+
+def test_unix_socket_shares_the_store_with_tcp(unix_kv_server):
+    host, port, path = unix_kv_server
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+        s.connect(path)
+        f = s.makefile("rb")
+        s.sendall(b"SET uds_test:key over-uds\nSETBLOB uds_test:blob 5\nab\ncd\n")
+        assert f.readline() == b"+OK\n"
+        assert f.readline() == b"+OK\n"
+        # Pipelined, answered in order like over TCP
+        s.sendall(b"GET uds_test:key\n" * 1000)
+        for _ in range(1000):
+            assert f.readline() == b"$over-uds\n"
+
+    assert "over-uds" in send_cmd(host, port, "GET uds_test:key")
+    with socket.create_connection((host, port)) as s:
+        s.sendall(b"GETBLOB uds_test:blob\n")
+        assert recv_exactly(s, 9) == b"=5\nab\ncd\n"
+
+
+def test_unix_socket_permissions(unix_kv_server):
+    _, _, path = unix_kv_server
+    mode = os.stat(path).st_mode
+    assert stat.S_ISSOCK(mode)
+    assert stat.S_IMODE(mode) == 0o600
+
+
+def test_unix_socket_file_lifecycle(server_path, request, tmp_path):
+    path = str(tmp_path / "kv.sock")
+    # Left behind by a server that was killed
+    stale = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    stale.bind(path)
+    stale.close()
+
+    proc, _ = start_server(server_path, request, "--unix-socket", path)
+    try:
+        with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+            s.connect(path)
+            s.sendall(b"PING\n")
+            assert s.recv(1024) == b"$Pong\n"
+        assert stat.S_IMODE(os.stat(path).st_mode) == 0o660
+
+        # A second server must not take over the path of a live one
+        other = subprocess.run([server_path, "0", "--unix-socket", path],
+                               stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=5)
+        assert other.returncode != 0
+        assert os.path.exists(path)
+    finally:
+        proc.send_signal(signal.SIGINT)
+        proc.wait(timeout=5)
+    # Removed on shutdown
+    assert not os.path.exists(path)
+
+    # Not a socket: left alone, the server refuses to start
+    with open(path, "w") as f:
+        f.write("not a socket")
+    other = subprocess.run([server_path, "0", "--unix-socket", path],
+                           stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, timeout=5)
+    assert other.returncode != 0
+    with open(path) as f:
+        assert f.read() == "not a socket"
+
+
+def bulk_stream(pairs):
+    return b"".join(struct.pack("<II", len(k), len(v)) + k + v for k, v in pairs)
+
+
+def test_load_and_dump_stream(bulk_kv_server):
+    host, port, _ = bulk_kv_server
+    pairs = [(b"bulk_test:%d" % i, b"value %d\n" % i) for i in range(5000)]
+    stream = bulk_stream(pairs)
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        # The stream follows the command line, a command after it is read as usual
+        s.sendall(b"LOAD %d\n" % len(stream) + stream)
+        assert f.readline() == b":5000\n"
+        s.sendall(b"GET bulk_test:4999\n")
+        assert f.readline() == b"$value 4999\n"  # the newline of the value ends the reply
+        assert f.readline() == b"\n"
+
+        s.sendall(b"LOAD 7\n" + stream[:7])
+        assert f.readline() == b"-ERR bulk stream cut short\n"
+
+        s.sendall(b"DUMP\n")
+        header = f.readline()
+        assert header.startswith(b"=")
+        body = f.read(int(header[1:]))
+        assert f.read(1) == b"\n"
+        records = {}
+        while body:
+            key_size, value_size = struct.unpack_from("<II", body)
+            key = body[8:8 + key_size]
+            records[key] = body[8 + key_size:8 + key_size + value_size]
+            body = body[8 + key_size + value_size:]
+        for key, value in pairs:
+            assert records[key] == value
+
+
+def test_refused_load_stream_is_never_run(bulk_kv_server):
+    host, port, _ = bulk_kv_server
+    assert send_cmd(host, port, "SET victim alive") == "+OK\n"
+
+    with socket.create_connection((host, port)) as s:
+        s.sendall(b"LOAD 99999999999\nDEL victim\n")
+        assert recv_until_closed(s) == b"-ERR bulk stream too large, use LOAD FILE\n"
+
+    assert send_cmd(host, port, "GET victim") == "$alive\n"
+
+
+def test_load_and_dump_files(bulk_kv_server):
+    host, port, directory = bulk_kv_server
+    (directory / "seed.kv").write_bytes(bulk_stream([(b"bulk_file:a", b"1"), (b"bulk_file:b", b"2")]))
+    assert send_cmd(host, port, "LOAD FILE seed.kv") == ":2\n"
+    assert send_cmd(host, port, "GET bulk_file:b") == "$2\n"
+
+    assert send_cmd(host, port, "DUMP FILE backup.kv") == "+OK\n"
+    assert bulk_stream([(b"bulk_file:a", b"1")]) in (directory / "backup.kv").read_bytes()
+    assert not (directory / "backup.kv.tmp").exists()
+
+    assert send_cmd(host, port, "LOAD FILE ../seed.kv").startswith("-ERR bulk file must be a plain file name")
+    assert send_cmd(host, port, "LOAD FILE missing.kv").startswith("-ERR can't open")
+
+
+def test_dump_over_the_socket_is_capped(server_path, request):
+    # Half the hard limit is the largest DUMP reply
+    proc, port = start_server(server_path, request, "--outbox-hard-limit", "128K")
+    try:
+        with socket.create_connection(("127.0.0.1", port)) as s:
+            f = s.makefile("rb")
+            for i in range(20):
+                s.sendall(b"SET dump_cap:%d %s\n" % (i, b"v" * 4096))
+                assert f.readline() == b"+OK\n"
+            s.sendall(b"DUMP\n")
+            assert f.readline() == b"-ERR store too large for DUMP, use DUMP FILE\n"
+            s.sendall(b"DEL dump_cap:0\n")
+            assert f.readline() == b"+OK\n"
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+def test_bulk_files_need_a_directory(kv_server):
+    host, port = kv_server
+    assert send_cmd(host, port, "DUMP FILE backup.kv") == "-ERR bulk files are disabled, see --bulk-dir\n"
+
+
+def key_slot(key):
+    # CRC16/XMODEM of the key (or its {tag}) modulo 16384, as the server computes it
+    start = key.find("{")
+    if start != -1:
+        end = key.find("}", start + 1)
+        if end > start + 1:
+            key = key[start + 1:end]
+    crc = 0
+    for byte in key.encode():
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc % 16384
+
+
+def owner_port(ports, key):
+    # The slot ranges of the kv_cluster fixture
+    slot = key_slot(key)
+    return ports[0] if slot <= 5460 else ports[1] if slot <= 10922 else ports[2]
+
+
+def test_cluster_redirects_to_the_owner(kv_cluster):
+    ports = kv_cluster
+    assert key_slot("foo") == 12182
+    assert send_cmd("127.0.0.1", ports[0], "SET foo bar") == f"-MOVED 12182 127.0.0.1:{ports[2]}\n"
+    assert send_cmd("127.0.0.1", ports[2], "SET foo bar") == "+OK\n"
+    assert send_cmd("127.0.0.1", ports[2], "GET foo") == "$bar\n"
+    # Keys sharing a {tag} share a node
+    owner = ports[2]
+    assert send_cmd("127.0.0.1", owner, "MSET {foo}:a 1 {foo}:b 2") == "+OK\n"
+    assert send_cmd("127.0.0.1", owner, "MGET {foo}:a {foo}:b {foo}:c") == "*3\n$1\n$2\n_\n"
+    # Keyless commands run wherever they are sent
+    assert send_cmd("127.0.0.1", ports[1], "PING") == "$Pong\n"
+
+
+def test_cluster_rejects_commands_split_across_nodes(kv_cluster):
+    ports = kv_cluster
+    # "a" and "b" hash to different thirds of the slots
+    assert owner_port(ports, "a") != owner_port(ports, "b")
+    assert send_cmd("127.0.0.1", ports[0], "MGET a b") == "-ERR keys of one command must be on one node\n"
+
+
+def test_cluster_load_refuses_keys_of_other_nodes(kv_cluster):
+    ports = kv_cluster
+    keys = [b"cluster_load:%d" % i for i in range(30)]
+    own = [key for key in keys if owner_port(ports, key.decode()) == ports[0]]
+    assert 0 < len(own) < len(keys)
+
+    with socket.create_connection(("127.0.0.1", ports[0])) as s:
+        f = s.makefile("rb")
+        stream = bulk_stream([(key, b"v") for key in keys])
+        s.sendall(b"LOAD %d\n" % len(stream) + stream)
+        assert f.readline() == b"-ERR %d of 30 records are in slots of other nodes, nothing loaded\n" % (
+            len(keys) - len(own))
+        s.sendall(b"GET " + own[0] + b"\n")
+        assert f.readline() == b"-ERR key not found\n"
+
+        stream = bulk_stream([(key, b"v") for key in own])
+        s.sendall(b"LOAD %d\n" % len(stream) + stream)
+        assert f.readline() == b":%d\n" % len(own)
+        s.sendall(b"GET " + own[0] + b"\n")
+        assert f.readline() == b"$v\n"
+
+
+def test_cluster_slots(kv_cluster):
+    ports = kv_cluster
+    expected = (f"*3\n$0-5460 127.0.0.1:{ports[0]}\n$5461-10922 127.0.0.1:{ports[1]}\n"
+                f"$10923-16383 127.0.0.1:{ports[2]}\n")
+    for port in ports:
+        assert send_cmd("127.0.0.1", port, "CLUSTER SLOTS") == expected
+
+
+def test_cluster_client_routes_by_slot(kv_cluster, client_path):
+    ports = kv_cluster
+    seed = f"127.0.0.1:{ports[1]}"
+    keys = [f"cluster_test:{i}" for i in range(300)]
+    mset = "MSET " + " ".join(f"{key} v{i}" for i, key in enumerate(keys))
+    commands = "\n".join([mset, "MGET " + " ".join(keys + ["cluster_test:missing"]), "GET cluster_test:7",
+                          "INCR cluster_test:counter", "PING"]) + "\n"
+    result = subprocess.run([client_path, "--cluster", seed], input=commands, capture_output=True, text=True,
+                            timeout=10)
+    assert result.returncode == 0, result.stderr
+    assert result.stdout.splitlines() == ["OK"] + [f"v{i}" for i in range(300)] + ["(nil)", "v7", "1", "Pong"]
+
+    # Each key is stored on its owner only
+    for key in keys[:30]:
+        owner = owner_port(ports, key)
+        for port in ports:
+            reply = send_cmd("127.0.0.1", port, f"GET {key}")
+            if port == owner:
+                assert reply.startswith("$v")
+            else:
+                assert reply == f"-MOVED {key_slot(key)} 127.0.0.1:{owner}\n"
+
+    # Without --cluster the redirect reaches the caller
+    result = subprocess.run([client_path, seed, "GET", "foo"], capture_output=True, text=True, timeout=10)
+    assert result.returncode == 1
+    assert result.stdout == f"(error) MOVED 12182 127.0.0.1:{ports[2]}\n"
+
+
+def workers_stats(f, s):
+    s.sendall(b"WORKERS\n")
+    header = f.readline()
+    assert header == b"*12\n"
+    reply = [f.readline()[1:].decode().strip() for _ in range(12)]
+    return {name: int(value) for name, value in zip(reply[0::2], reply[1::2])}
+
+
+def test_workers_scale_with_load(elastic_kv_server):
+    host, port = elastic_kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        stats = workers_stats(f, s)
+        assert (stats["running"], stats["min"], stats["max"]) == (1, 1, 4)
+
+        # Several clients pipelining at once queue far more than one worker keeps up with
+        clients = [socket.create_connection((host, port)) for _ in range(8)]
+        for i, c in enumerate(clients):
+            c.sendall(b"".join(f"SET workers_{i}_{j} {'v' * 100}\n".encode() for j in range(2000)))
+        for c in clients:
+            cf = c.makefile("rb")
+            for _ in range(2000):
+                assert cf.readline() == b"+OK\n"
+            c.close()
+
+        stats = workers_stats(f, s)
+        assert stats["grown"] >= 1
+        assert 1 < stats["peak"] <= 4
+
+        # Back to the minimum once the load is gone, one worker per 100 ms
+        deadline = time.time() + 5
+        while stats["running"] > 1 and time.time() < deadline:
+            time.sleep(0.1)
+            stats = workers_stats(f, s)
+        assert stats["running"] == 1
+        assert stats["shrunk"] == stats["grown"]
+
+
+def test_workers_on_fixed_pool(kv_server):
+    host, port = kv_server
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        stats = workers_stats(f, s)
+        assert stats == {"running": 5, "min": 5, "max": 5, "peak": 5, "grown": 0, "shrunk": 0}
+        s.sendall(b"WORKERS now\n")
+        assert f.readline().startswith(b"-ERR")
@@ -26,3 +26,62 @@ def test_concurrent_clients(kv_server):
 
     for t in threads:
         t.join()
+
+
+def recv_lines(s, count):
+    buf = b""
+    while buf.count(b"\n") < count:
+        chunk = s.recv(65536)
+        assert chunk, "server closed the connection"
+        buf += chunk
+    return buf.decode().splitlines()
+
+
+def pipelined_client(host, port, thread_id, results):
+    # Without waiting, every GET must see the SET sent right before it
+    key = f"affine_{thread_id}"
+    commands = "".join(f"SET {key} {i}\nGET {key}\n" for i in range(500))
+    with socket.create_connection((host, port)) as s:
+        s.sendall(commands.encode())
+        lines = recv_lines(s, 1000)
+    results[thread_id] = lines[1::2] == [f"${i}" for i in range(500)]
+
+
+def test_affine_workers_keep_client_order(affine_kv_server):
+    host, port = affine_kv_server
+    results = {}
+    threads = [threading.Thread(target=pipelined_client, args=(host, port, i, results))
+               for i in range(8)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    assert results == {i: True for i in range(8)}
+
+
+def test_affine_workers_serve_concurrent_clients(affine_kv_server):
+    host, port = affine_kv_server
+    threads = [threading.Thread(target=client_task, args=(host, port, i)) for i in range(10)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+
+def test_affine_workers_order_replies_answered_without_a_worker(affine_kv_server):
+    host, port = affine_kv_server
+    big = "x" * (1024 * 1024)
+    with socket.create_connection((host, port)) as s:
+        f = s.makefile("rb")
+        s.sendall(f"SET order_big {big}\n".encode())
+        assert f.readline() == b"+OK\n"
+
+        # Errors and SLOWLOG are answered by the reactor, they must still wait for the GET before them
+        s.sendall(b"GET order_big\nBADCMD\nSLOWLOG LEN\nGET order_big\nPING\n" * 20)
+        for _ in range(20):
+            assert f.readline() == f"${big}\n".encode()
+            assert f.readline().startswith(b"-ERR unknown command")
+            assert f.readline().startswith(b":")
+            assert f.readline() == f"${big}\n".encode()
+            assert f.readline() == b"$Pong\n"
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "kv/bulk.hpp"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace kv;
+
+TEST(BulkFormatTest, RoundTrip) {
+    std::string stream;
+    BulkFormat::append(stream, "key", "value");
+    BulkFormat::append(stream, std::string{"k\0y", 3}, "");
+    BulkFormat::append(stream, "lines", "a\nb\n");
+    EXPECT_EQ(stream.substr(0, BulkFormat::HEADER_BYTES), std::string("\3\0\0\0\5\0\0\0", 8));
+
+    std::vector<BulkRecord> records = BulkFormat::decode(stream);
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].key, "key");
+    EXPECT_EQ(records[0].value, "value");
+    EXPECT_EQ(records[1].key, (std::string{"k\0y", 3}));
+    EXPECT_TRUE(records[1].value.empty());
+    EXPECT_EQ(records[2].value, "a\nb\n");
+    // Records point into the stream
+    EXPECT_EQ(records[0].key.data(), stream.data() + BulkFormat::HEADER_BYTES);
+    EXPECT_TRUE(BulkFormat::decode("").empty());
+}
+
+TEST(BulkFormatTest, RejectsBrokenStreams) {
+    std::string stream;
+    BulkFormat::append(stream, "key", "value");
+    for (size_t size = 1; size < stream.size(); ++size)
+        EXPECT_THROW(BulkFormat::decode(std::string_view{stream}.substr(0, size)), BulkError) << size;
+    EXPECT_THROW(BulkFormat::decode(std::string("\0\0\0\0\1\0\0\0v", 9)), BulkError);
+    // Sizes near the limit don't wrap around
+    EXPECT_THROW(BulkFormat::decode(std::string("\1\0\0\0\xff\xff\xff\xffk", 9)), BulkError);
+    EXPECT_THROW(BulkFormat::append(stream, "", "value"), BulkError);
+}
+
+TEST(BulkFileTest, WriteCommitAndMap) {
+    auto path = std::filesystem::temp_directory_path() / ("kv_bulk_" + std::to_string(getpid()));
+    {
+        BulkFileWriter writer{path.string()};
+        writer.write("abc");
+        writer.write("def");
+        EXPECT_TRUE(std::filesystem::exists(path.string() + ".tmp"));
+        EXPECT_FALSE(std::filesystem::exists(path));
+        writer.commit();
+    }
+    EXPECT_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+    EXPECT_EQ(MappedFile{path.string()}.bytes(), "abcdef");
+
+    {
+        BulkFileWriter abandoned{path.string()};
+        abandoned.write("partial");
+    }
+    // The earlier file stays, the temporary one is gone
+    EXPECT_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+    EXPECT_EQ(MappedFile{path.string()}.bytes(), "abcdef");
+
+    std::ofstream{path, std::ios::trunc};
+    EXPECT_TRUE(MappedFile{path.string()}.bytes().empty());
+    std::filesystem::remove(path);
+    EXPECT_THROW(MappedFile{path.string()}, BulkError);
+    EXPECT_THROW(MappedFile{std::filesystem::temp_directory_path().string()}, BulkError);
+}
+
+TEST(ParallelSlicesTest, CoversEveryIndexOnce) {
+    for (size_t count : {0u, 1u, 7u, 1000u, 100'003u}) {
+        std::vector<std::atomic<int>> seen(count);
+        parallel_slices(count, 100, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                seen[i].fetch_add(1);
+        });
+        for (size_t i = 0; i < count; ++i)
+            ASSERT_EQ(seen[i].load(), 1) << count << " " << i;
+    }
+}
+
+TEST(ParallelSlicesTest, RethrowsFromAnySlice) {
+    EXPECT_THROW(parallel_slices(100'000, 1, [](size_t begin, size_t end) {
+                     if (begin <= 99'999 && 99'999 < end)
+                         throw std::runtime_error("last slice");
+                 }),
+                 std::runtime_error);
+}
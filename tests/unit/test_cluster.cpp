@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include "kv/cluster.hpp"
+#include <string>
+#include <vector>
+
+using namespace kv;
+
+TEST(SlotMapTest, SlotsMatchRedisCluster) {
+    EXPECT_EQ(SlotMap::slot_of("123456789"), 0x31C3); // the CRC16/XMODEM check value
+    EXPECT_EQ(SlotMap::slot_of("foo"), 12182);
+    EXPECT_EQ(SlotMap::slot_of(""), 0);
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_LT(SlotMap::slot_of("key:" + std::to_string(i)), SlotMap::SLOTS);
+}
+
+TEST(SlotMapTest, HashTags) {
+    EXPECT_EQ(SlotMap::slot_of("{user1000}.following"), SlotMap::slot_of("user1000"));
+    EXPECT_EQ(SlotMap::slot_of("{user1000}.followers"), SlotMap::slot_of("{user1000}.following"));
+    EXPECT_EQ(SlotMap::slot_of("foo{bar}{zap}"), SlotMap::slot_of("bar"));
+    EXPECT_EQ(SlotMap::slot_of("foo{{bar}}zap"), SlotMap::slot_of("{bar"));
+    // An empty tag or no closing brace, the whole key counts
+    EXPECT_NE(SlotMap::slot_of("foo{}{bar}"), SlotMap::slot_of("bar"));
+    EXPECT_NE(SlotMap::slot_of("{bar"), SlotMap::slot_of("bar"));
+}
+
+TEST(SlotMapTest, AssignAndDescribe) {
+    ClusterNode a{"127.0.0.1", 7001}, b{"127.0.0.1", 7002};
+    SlotMap map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.owner(0), nullptr);
+    map.assign(a, "0-99,200");
+    map.assign(b, "100-199,201-16383");
+    EXPECT_EQ(map.nodes().size(), 2u);
+    EXPECT_EQ(*map.owner(99), a);
+    EXPECT_EQ(*map.owner(100), b);
+    EXPECT_EQ(*map.owner(200), a);
+    EXPECT_EQ(*map.owner_of("foo"), b);
+    EXPECT_TRUE(map.unassigned().empty());
+    EXPECT_EQ(map.describe(), (std::vector<std::string>{"0-99 127.0.0.1:7001", "100-199 127.0.0.1:7002",
+                                                        "200-200 127.0.0.1:7001", "201-16383 127.0.0.1:7002"}));
+
+    SlotMap copy = SlotMap::from_description(map.describe());
+    for (uint16_t slot = 0; slot < SlotMap::SLOTS; ++slot)
+        ASSERT_EQ(*copy.owner(slot), *map.owner(slot)) << slot;
+
+    map.reassign(12182, a);
+    EXPECT_EQ(*map.owner_of("foo"), a);
+}
+
+TEST(SlotMapTest, RejectsBadRanges) {
+    ClusterNode a{"127.0.0.1", 7001}, b{"127.0.0.1", 7002};
+    SlotMap map;
+    map.assign(a, "0-10");
+    EXPECT_THROW(map.assign(b, "10-20"), ClusterError);
+    EXPECT_THROW(map.assign(b, "20-11"), ClusterError);
+    EXPECT_THROW(map.assign(b, "16384"), ClusterError);
+    EXPECT_THROW(map.assign(b, "x"), ClusterError);
+    EXPECT_THROW(map.assign(b, "1,,2"), ClusterError);
+    map.assign(a, "5"); // again to the same node is fine
+    EXPECT_EQ(map.unassigned(), "11-16383");
+    EXPECT_THROW(SlotMap::from_description({"0-10"}), ClusterError);
+}
+
+TEST(ClusterNodeTest, Parse) {
+    EXPECT_EQ(ClusterNode::parse("10.0.0.5:6000"), (ClusterNode{"10.0.0.5", 6000}));
+    EXPECT_EQ(ClusterNode::parse("kv-3.internal:7001").address(), "kv-3.internal:7001");
+    EXPECT_THROW(ClusterNode::parse("10.0.0.5"), ClusterError);
+    EXPECT_THROW(ClusterNode::parse(":6000"), ClusterError);
+    EXPECT_THROW(ClusterNode::parse("10.0.0.5:0"), ClusterError);
+    EXPECT_THROW(ClusterNode::parse("10.0.0.5:70000"), ClusterError);
+}
+
+TEST(ClusterTest, KeysOfCommands) {
+    auto keys = [](std::string_view line) {
+        std::vector<std::string> found;
+        for_each_key(Protocol::parse(line), [&found](std::string_view key) { found.emplace_back(key); });
+        return found;
+    };
+    EXPECT_EQ(keys("GET a"), (std::vector<std::string>{"a"}));
+    EXPECT_EQ(keys("CAS a 3 b"), (std::vector<std::string>{"a"}));
+    EXPECT_EQ(keys("SETBLOB a 10"), (std::vector<std::string>{"a"}));
+    EXPECT_EQ(keys("MGET a b c"), (std::vector<std::string>{"a", "b", "c"}));
+    EXPECT_EQ(keys("MSET a 1 b 2"), (std::vector<std::string>{"a", "b"}));
+    EXPECT_TRUE(keys("PING").empty());
+    EXPECT_TRUE(keys("SCAN user:").empty());
+    EXPECT_TRUE(keys("DUMP").empty());
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "config.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace kv;
+
+class ConfigTest : public ::testing::Test {
+protected:
+    std::filesystem::path path;
+
+    void SetUp() override {
+        path = std::filesystem::temp_directory_path() / ("kv_config_" + std::to_string(getpid()) + ".conf");
+    }
+
+    void TearDown() override {
+        std::filesystem::remove(path);
+    }
+
+    void write(const std::string& text) {
+        std::ofstream{path} << text;
+    }
+};
+
+
+TEST_F(ConfigTest, DefaultsMatchTheServer) {
+    ServerConfig config = Config::parse({});
+    EXPECT_EQ(config.engine, "map");
+    EXPECT_EQ(config.server.address, "0.0.0.0");
+    EXPECT_EQ(config.server.port, 12345);
+    EXPECT_EQ(config.server.workers, 5u);
+    EXPECT_EQ(config.server.scheduling, WorkerScheduling::Shared);
+    EXPECT_EQ(config.server.inbox_limits.max_size, InboxLimits{}.max_size);
+    EXPECT_EQ(config.server.reactor_cpu, -1);
+    EXPECT_TRUE(config.server.worker_cpus.empty());
+    EXPECT_FALSE(config.server.lock_memory);
+    EXPECT_TRUE(config.server.unix_socket.empty());
+    EXPECT_TRUE(config.server.bulk_directory.empty());
+    EXPECT_EQ(config.server.unix_socket_mode, 0660u);
+}
+
+TEST_F(ConfigTest, CommandLine) {
+    ServerConfig config = Config::parse({"6000", "--workers", "16", "--affine-workers", "--read-buffer", "64K",
+                                         "--max-inbox", "8M", "--worker-cpus", "0,2-4", "--reactor-cpu", "1",
+                                         "--ordered-index", "--engine", "log", "--data-dir", "/tmp/kv"});
+    EXPECT_EQ(config.server.port, 6000);
+    EXPECT_EQ(config.server.workers, 16u);
+    EXPECT_EQ(config.server.scheduling, WorkerScheduling::Affine);
+    EXPECT_EQ(config.server.inbox_limits.read_bytes, 64u * 1024);
+    EXPECT_EQ(config.server.inbox_limits.max_size, 8u * 1024 * 1024);
+    EXPECT_EQ(config.server.worker_cpus, (std::vector<int>{0, 2, 3, 4}));
+    EXPECT_EQ(config.server.reactor_cpu, 1);
+    EXPECT_TRUE(config.store.ordered_index);
+    EXPECT_TRUE(config.log.ordered_index);
+    EXPECT_EQ(config.engine, "log");
+    EXPECT_EQ(config.log.directory, "/tmp/kv");
+}
+
+TEST_F(ConfigTest, FileWithCommandLineOverrides) {
+    write("# tuning for the 16 core box\n"
+          "address = 127.0.0.1\n"
+          "workers = 12   # one per core\n"
+          "\n"
+          "lock-memory = true\n"
+          "outbox-high-watermark = 4M\n"
+          "compress = false\n");
+    ServerConfig config = Config::parse({"--workers", "3", "--config", path.string()});
+    EXPECT_EQ(config.server.address, "127.0.0.1");
+    EXPECT_EQ(config.server.workers, 3u);
+    EXPECT_TRUE(config.server.lock_memory);
+    EXPECT_EQ(config.server.outbox_limits.high_watermark, 4u * 1024 * 1024);
+    EXPECT_FALSE(config.store.compression);
+}
+
+TEST_F(ConfigTest, RejectsBadInput) {
+    EXPECT_THROW(Config::parse({"--no-such-flag"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--workers"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--workers", "0"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--workers", "many"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--port", "70000"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--read-buffer", "12Q"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--worker-cpus", "3-1"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--engine", "btree"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--outbox-low-watermark", "2M", "--outbox-high-watermark", "1M"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--config", "/nonexistent/kv.conf"}), ConfigError);
+
+    write("workers = 4\nlock-memory = maybe\n");
+    try {
+        Config::parse({"--config", path.string()});
+        FAIL() << "expected ConfigError";
+    } catch (const ConfigError& e) {
+        EXPECT_NE(std::string{e.what()}.find(":2: lock-memory"), std::string::npos) << e.what();
+    }
+}
+
+TEST_F(ConfigTest, UsageListsEveryOption) {
+    std::string usage = Config::usage();
+    for (const char* flag : {"--workers n", "--read-buffer size", "--worker-cpus list", "--lock-memory", "--engine map|log"})
+        EXPECT_NE(usage.find(flag), std::string::npos) << flag;
+}
+
+TEST_F(ConfigTest, LogLevel) {
+    EXPECT_EQ(Config::parse({}).log_level, LogLevel::Info);
+    EXPECT_EQ(Config::parse({"--log-level", "warn"}).log_level, LogLevel::Warn);
+    EXPECT_EQ(Config::parse({"--log-level", "OFF"}).log_level, LogLevel::Off);
+    EXPECT_THROW(Config::parse({"--log-level", "loud"}), ConfigError);
+}
+
+TEST_F(ConfigTest, HotKeyTracking) {
+    ServerConfig config = Config::parse({"--hot-key-half-life", "0", "--hot-key-sample", "1"});
+    EXPECT_EQ(config.store.hot_key_half_life.count(), 0);
+    EXPECT_EQ(config.log.hot_key_half_life.count(), 0);
+    EXPECT_EQ(config.store.hot_key_sample, 1u);
+    EXPECT_EQ(config.log.hot_key_sample, 1u);
+    EXPECT_EQ(Config::parse({}).store.hot_key_half_life, StoreOptions{}.hot_key_half_life);
+}
+
+TEST_F(ConfigTest, UnixSocket) {
+    ServerConfig config = Config::parse({"--unix-socket", "/run/kv/kv.sock", "--unix-socket-mode", "600"});
+    EXPECT_EQ(config.server.unix_socket, "/run/kv/kv.sock");
+    EXPECT_EQ(config.server.unix_socket_mode, 0600u);
+    EXPECT_EQ(Config::parse({"--unix-socket-mode", "0777"}).server.unix_socket_mode, 0777u);
+    EXPECT_THROW(Config::parse({"--unix-socket-mode", "680"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--unix-socket-mode", "1777"}), ConfigError);
+}
+
+TEST_F(ConfigTest, Cluster) {
+    EXPECT_TRUE(Config::parse({}).server.cluster_slots.empty());
+
+    write("cluster-node = 127.0.0.1:7001 0-8191\n"
+          "cluster-node = 127.0.0.1:7002 8192-16000,16001-16383\n"
+          "cluster-self = 127.0.0.1:7002\n");
+    ServerConfig config = Config::parse({"--config", path.string()});
+    EXPECT_EQ(config.server.cluster_self, (ClusterNode{"127.0.0.1", 7002}));
+    EXPECT_EQ(config.server.cluster_slots.owner(8191)->port, 7001);
+    EXPECT_EQ(config.server.cluster_slots.owner(16383)->port, 7002);
+
+    // Every slot needs a node, and this server must be one of them
+    EXPECT_THROW(Config::parse({"--cluster-node", "127.0.0.1:7001 0-100", "--cluster-self", "127.0.0.1:7001"}),
+                 ConfigError);
+    EXPECT_THROW(Config::parse({"--cluster-node", "127.0.0.1:7001 0-16383", "--cluster-self", "127.0.0.1:7002"}),
+                 ConfigError);
+    EXPECT_THROW(Config::parse({"--cluster-node", "127.0.0.1:7001 0-16383", "--cluster-node", "127.0.0.1:7002 5"}),
+                 ConfigError);
+    EXPECT_THROW(Config::parse({"--cluster-node", "127.0.0.1:7001"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--cluster-self", "localhost"}), ConfigError);
+}
+
+TEST_F(ConfigTest, WorkerScaling) {
+    EXPECT_EQ(Config::parse({}).server.max_workers, 0u);
+
+    ServerConfig config = Config::parse({"--workers", "2", "--max-workers", "16", "--scale-up-wait", "500",
+                                         "--scale-up-depth", "4", "--scale-down-idle", "30000"});
+    EXPECT_EQ(config.server.workers, 2u);
+    EXPECT_EQ(config.server.max_workers, 16u);
+    EXPECT_EQ(config.server.worker_scaling.grow_wait.count(), 500);
+    EXPECT_EQ(config.server.worker_scaling.grow_depth, 4u);
+    EXPECT_EQ(config.server.worker_scaling.shrink_idle.count(), 30000);
+
+    // Affine workers have a queue each, there is nothing to scale
+    EXPECT_THROW(Config::parse({"--max-workers", "8", "--affine-workers"}), ConfigError);
+    EXPECT_THROW(Config::parse({"--max-workers", "8", "--scale-down-idle", "0"}), ConfigError);
+    EXPECT_NO_THROW(Config::parse({"--max-workers", "5", "--affine-workers"}));
+}
+
+TEST_F(ConfigTest, BulkDirectory) {
+    EXPECT_EQ(Config::parse({"--bulk-dir", "/var/lib/kv/bulk"}).server.bulk_directory, "/var/lib/kv/bulk");
+}
@@ -3,6 +3,7 @@
 #include "kv/socket.hpp"
 #include <sys/socket.h>
 #include <unistd.h>
+#include <thread>
 
 
 using namespace kv;
@@ -102,6 +103,74 @@ TEST_F(ConnectionTest, ReadMessageLargerThanBuffer) {
     EXPECT_EQ(result.value(), "SET key " + large_data);
 }
 
+TEST_F(ConnectionTest, DrainsLargeLineInOneCall) {
+    std::string line = "SET key " + std::string(200 * 1024, 'v');
+    std::thread sender([&]() { client_sends(line + "\n"); });
+    std::optional<std::string> result;
+    int calls = 0;
+    while (!(result = connection->try_get_line()) && calls < 1000) {
+        connection->read_to_inbox();
+        ++calls;
+    }
+    sender.join();
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result, line);
+    // One call per time the sender fills the socket buffer, not one per 4 KB
+    EXPECT_LT(calls, 20);
+}
+
+TEST_F(ConnectionTest, ReadBudgetBoundsOneCall) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    Connection limited{Socket{fds[0]}, {}, nullptr, InboxLimits{.read_bytes = 1024, .read_budget = 8192}};
+    std::string data(32 * 1024, 'x');
+    ASSERT_EQ(write(fds[1], data.data(), data.size()), static_cast<ssize_t>(data.size()));
+    ASSERT_EQ(write(fds[1], "\n", 1), 1);
+
+    int calls = 0;
+    std::optional<std::string> line;
+    while (!(line = limited.try_get_line())) {
+        ASSERT_TRUE(limited.read_to_inbox());
+        ++calls;
+    }
+    EXPECT_EQ(line->size(), data.size());
+    EXPECT_EQ(calls, 5); // 4 full budgets, then the newline
+    close(fds[1]);
+}
+
+TEST_F(ConnectionTest, CommandsBeforeEofAreKept) {
+    client_sends("SET key value\n");
+    close(client_fd_);
+    client_fd_ = -1;
+    EXPECT_TRUE(connection->read_to_inbox());
+    EXPECT_EQ(connection->try_get_line(), "SET key value");
+    EXPECT_FALSE(connection->read_to_inbox());
+}
+
+TEST_F(ConnectionTest, PayloadBypassesInboxLimit) {
+    // Larger than the 2MB inbox limit, and the start arrives with the command line
+    std::string payload(3 * 1024 * 1024, 'P');
+    client_sends("SETBLOB key " + std::to_string(payload.size()) + "\n" + payload.substr(0, 100));
+    connection->read_to_inbox();
+    ASSERT_EQ(connection->try_get_line(), "SETBLOB key " + std::to_string(payload.size()));
+
+    connection->begin_payload(payload.size());
+    EXPECT_FALSE(connection->inbox_has_data());
+    EXPECT_TRUE(connection->receiving_payload());
+    EXPECT_EQ(connection->take_payload(), std::nullopt);
+
+    std::thread sender([&]() { client_sends(payload.substr(100) + "GET key\n"); });
+    std::optional<Value> value;
+    while (!(value = connection->take_payload()))
+        ASSERT_TRUE(connection->read_to_inbox());
+    sender.join();
+
+    EXPECT_EQ(value->text(), payload);
+    EXPECT_FALSE(connection->receiving_payload());
+    connection->read_to_inbox();
+    EXPECT_EQ(connection->try_get_line(), "GET key");
+}
+
 TEST_F(ConnectionTest, WriteLargeMessage) {
     size_t payload_size = 16 * 1024;
     std::string large_data(payload_size, 'A'); // 16KB of 'A's
@@ -127,3 +196,85 @@ TEST_F(ConnectionTest, WriteConnectionClosed) {
     close(client_fd_);
     EXPECT_THROW(connection->write_from_outbox(), IOError);
 }
+
+TEST_F(ConnectionTest, DirtyBitIsSetOnce) {
+    EXPECT_TRUE(connection->mark_dirty());
+    EXPECT_FALSE(connection->mark_dirty()); // already queued
+    connection->clear_dirty();
+    EXPECT_TRUE(connection->mark_dirty());
+}
+
+TEST(ConnectionLimitsTest, WatermarksPauseAndResumeReading) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    OutboxLimits limits{.high_watermark = 100, .low_watermark = 10, .hard_limit = 1000};
+    Connection connection{Socket{fds[0]}, limits};
+
+    connection.append_response(std::string(50, 'A'));
+    EXPECT_FALSE(connection.should_pause_reading());
+    connection.append_response(std::string(60, 'A'));
+    EXPECT_TRUE(connection.should_pause_reading());
+    EXPECT_FALSE(connection.can_resume_reading());
+
+    EXPECT_FALSE(connection.write_from_outbox());
+    EXPECT_EQ(connection.outbox_size(), 0);
+    EXPECT_TRUE(connection.can_resume_reading());
+    close(fds[1]);
+}
+
+TEST(ConnectionLimitsTest, HardLimitDropsOutputAndFlagsClient) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    OutboxLimits limits{.high_watermark = 100, .low_watermark = 10, .hard_limit = 200};
+    Connection connection{Socket{fds[0]}, limits};
+
+    connection.append_response(std::string(150, 'A'));
+    EXPECT_FALSE(connection.over_hard_limit());
+    connection.append_response(std::string(100, 'A'));
+    EXPECT_TRUE(connection.over_hard_limit());
+    EXPECT_EQ(connection.outbox_size(), 150);
+    connection.append_response("OK\n"); // ignored from now on
+    EXPECT_EQ(connection.outbox_size(), 150);
+    close(fds[1]);
+}
+
+TEST(ConnectionLimitsTest, SingleResponseMayExceedHardLimit) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    OutboxLimits limits{.high_watermark = 100, .low_watermark = 10, .hard_limit = 200};
+    Connection connection{Socket{fds[0]}, limits};
+
+    connection.append_response(std::string(500, 'A')); // e.g. one GETBLOB reply
+    EXPECT_FALSE(connection.over_hard_limit());
+    EXPECT_EQ(connection.outbox_size(), 500);
+    connection.append_response("OK\n");
+    EXPECT_TRUE(connection.over_hard_limit());
+    close(fds[1]);
+}
+
+TEST(ConnectionLimitsTest, SharedBudgetTracksAllOutboxes) {
+    int first[2];
+    int second[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, first), 0);
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, second), 0);
+    OutputBudget budget{100};
+    {
+        Connection a{Socket{first[0]}, OutboxLimits{}, &budget};
+        auto b = std::make_unique<Connection>(Socket{second[0]}, OutboxLimits{}, &budget);
+
+        a.append_response(std::string(60, 'A'));
+        EXPECT_FALSE(a.should_pause_reading()); // far below its own watermark
+        b->append_response(std::string(60, 'B'));
+        EXPECT_EQ(budget.used(), 120);
+        EXPECT_TRUE(budget.exhausted());
+        EXPECT_TRUE(a.should_pause_reading());
+
+        b.reset(); // a disconnect gives its bytes back
+        EXPECT_EQ(budget.used(), 60);
+        EXPECT_TRUE(a.can_resume_reading());
+        EXPECT_FALSE(a.write_from_outbox());
+    }
+    EXPECT_EQ(budget.used(), 0);
+    close(first[1]);
+    close(second[1]);
+}
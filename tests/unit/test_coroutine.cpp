@@ -0,0 +1,248 @@
+#include <gtest/gtest.h>
+#include "connection.hpp"
+#include "coroutine.hpp"
+#include "kv/fair_task_queue.hpp"
+#include "kv/socket.hpp"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kv;
+
+namespace {
+
+// Gone once the coroutines of a pool have all finished
+struct Lifetime {
+    int* alive;
+    explicit Lifetime(int* alive) : alive(alive) { ++*alive; }
+    ~Lifetime() { --*alive; }
+};
+
+Job hop_back(FramePool&, FairTaskQueue<int, Resumable>& queue, ReadyQueue& ready, Waker& waker,
+             std::vector<std::thread::id>& threads) {
+    threads.push_back(std::this_thread::get_id());
+    co_await QueueHop{queue, 1, size_t{1}};
+    threads.push_back(std::this_thread::get_id());
+    co_await ReactorHop{ready, waker};
+    threads.push_back(std::this_thread::get_id());
+}
+
+Job report(FramePool&, FairTaskQueue<int, Resumable>& queue, ReadyQueue& ready, Waker& waker,
+           std::vector<int>& order, int id) {
+    co_await QueueHop{queue, 1, size_t{1}};
+    co_await ReactorHop{ready, waker};
+    order.push_back(id);
+}
+
+Job parked(FramePool&, FairTaskQueue<int, Resumable>& queue, int* alive) {
+    Lifetime lifetime{alive};
+    co_await QueueHop{queue, 1, size_t{1}};
+}
+
+Job session(FramePool&, Connection& connection, std::vector<std::string>& lines) {
+    while (true) {
+        std::string line = co_await connection.read_line();
+        if (line == "BLOB")
+            line += ":" + std::string((co_await connection.read_payload(3)).text());
+        lines.push_back(std::move(line));
+    }
+}
+
+Job respond(FramePool&, Connection& connection, std::string response, int& result) {
+    connection.append_response(std::move(response));
+    result = co_await connection.flushed() ? 1 : 0;
+}
+
+class CoroutineConnectionTest : public ::testing::Test {
+protected:
+    int client_fd_;
+    std::unique_ptr<Connection> connection;
+
+    void SetUp() override {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        client_fd_ = fds[1];
+        connection = std::make_unique<Connection>(Socket{fds[0]});
+    }
+
+    void TearDown() override {
+        connection.reset();
+        close(client_fd_);
+    }
+
+    void client_sends(const std::string& data) {
+        [[maybe_unused]] ssize_t _ = write(client_fd_, data.data(), data.size());
+    }
+};
+
+} // namespace
+
+
+TEST(FramePoolTest, FramesComeBackToThePool) {
+    std::unique_ptr<FramePool, FramePool::Release> pool{new FramePool};
+    FairTaskQueue<int, Resumable> queue;
+    int alive = 0;
+    for (int i = 0; i < 3; ++i)
+        parked(*pool, queue, &alive);
+    EXPECT_EQ(alive, 3);
+    EXPECT_EQ(pool->outstanding(), 3u);
+
+    std::stop_source stop;
+    for (int i = 0; i < 3; ++i)
+        queue.wait_and_pop(stop.get_token())->resume(); // runs to completion
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(pool->outstanding(), 0u);
+    EXPECT_EQ(pool->pooled(), 3u);
+
+    parked(*pool, queue, &alive);
+    EXPECT_EQ(pool->pooled(), 2u); // reused, not allocated
+}
+
+TEST(FramePoolTest, DroppedQueueDestroysSuspendedJobs) {
+    std::unique_ptr<FramePool, FramePool::Release> pool{new FramePool};
+    int alive = 0;
+    {
+        FairTaskQueue<int, Resumable> queue;
+        parked(*pool, queue, &alive);
+        parked(*pool, queue, &alive);
+        EXPECT_EQ(alive, 2);
+    }
+    EXPECT_EQ(alive, 0);
+    EXPECT_EQ(pool->outstanding(), 0u);
+}
+
+TEST(FramePoolTest, PoolOutlivesItsOwnerUntilFramesReturn) {
+    FairTaskQueue<int, Resumable> queue;
+    int alive = 0;
+    {
+        std::unique_ptr<FramePool, FramePool::Release> pool{new FramePool};
+        parked(*pool, queue, &alive);
+    }
+    std::stop_source stop;
+    queue.wait_and_pop(stop.get_token())->resume(); // frees into the released pool, which goes away
+    EXPECT_EQ(alive, 0);
+}
+
+TEST(JobTest, HopsToWorkerAndBackToReactor) {
+    std::unique_ptr<FramePool, FramePool::Release> pool{new FramePool};
+    FairTaskQueue<int, Resumable> queue;
+    ReadyQueue ready;
+    Waker waker;
+    std::vector<std::thread::id> threads;
+
+    hop_back(*pool, queue, ready, waker, threads);
+    ASSERT_EQ(threads.size(), 1u);
+
+    std::thread worker{[&queue]() {
+        std::stop_source stop;
+        queue.wait_and_pop(stop.get_token())->resume();
+    }};
+    worker.join();
+    ASSERT_EQ(threads.size(), 2u);
+    EXPECT_NE(threads[1], std::this_thread::get_id());
+    EXPECT_FALSE(ready.empty());
+
+    EXPECT_EQ(ready.resume_all(), 1u);
+    ASSERT_EQ(threads.size(), 3u);
+    EXPECT_EQ(threads[2], std::this_thread::get_id());
+    EXPECT_TRUE(ready.empty());
+    EXPECT_EQ(pool->outstanding(), 0u);
+}
+
+TEST(JobTest, ReadyQueueResumesInPushOrder) {
+    std::unique_ptr<FramePool, FramePool::Release> pool{new FramePool};
+    FairTaskQueue<int, Resumable> queue;
+    ReadyQueue ready;
+    Waker waker;
+    std::vector<int> order;
+    for (int id = 0; id < 3; ++id)
+        report(*pool, queue, ready, waker, order, id);
+
+    std::stop_source stop;
+    for (int i = 0; i < 3; ++i)
+        queue.wait_and_pop(stop.get_token())->resume();
+    EXPECT_TRUE(order.empty());
+    EXPECT_EQ(ready.resume_all(), 3u);
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(pool->outstanding(), 0u);
+}
+
+TEST_F(CoroutineConnectionTest, SessionReadsLinesAsTheyArrive) {
+    std::vector<std::string> lines;
+    session(connection->frames(), *connection, lines);
+    EXPECT_EQ(connection->session_wait(), SessionWait::Input);
+    EXPECT_FALSE(connection->input_ready());
+
+    client_sends("GET a\nGET ");
+    ASSERT_TRUE(connection->read_to_inbox());
+    ASSERT_TRUE(connection->input_ready());
+    connection->resume_session();
+    EXPECT_EQ(lines, (std::vector<std::string>{"GET a"})); // the rest is not a line yet
+    EXPECT_EQ(connection->session_wait(), SessionWait::Input);
+
+    client_sends("b\nBLOB\nx");
+    ASSERT_TRUE(connection->read_to_inbox());
+    connection->resume_session();
+    EXPECT_EQ(lines.back(), "GET b");
+    EXPECT_FALSE(connection->input_ready()); // two payload bytes to go
+
+    client_sends("yz");
+    ASSERT_TRUE(connection->read_to_inbox());
+    ASSERT_TRUE(connection->input_ready());
+    connection->resume_session();
+    EXPECT_EQ(lines.back(), "BLOB:xyz");
+}
+
+TEST(CoroutineConnectionLimitsTest, SessionWaitsWhileOutputIsBackedUp) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    Connection limited{Socket{fds[0]}, OutboxLimits{.high_watermark = 100, .low_watermark = 10}};
+    std::vector<std::string> lines;
+    session(limited.frames(), limited, lines);
+
+    limited.append_response(std::string(200, 'A'));
+    ASSERT_EQ(write(fds[1], "PING\n", 5), 5);
+    ASSERT_TRUE(limited.read_to_inbox());
+    EXPECT_FALSE(limited.input_ready());
+
+    EXPECT_FALSE(limited.write_from_outbox());
+    ASSERT_TRUE(limited.input_ready());
+    limited.resume_session();
+    EXPECT_EQ(lines, (std::vector<std::string>{"PING"}));
+    limited.close();
+    close(fds[1]);
+}
+
+TEST_F(CoroutineConnectionTest, FlushedCompletesOnceResponseIsSent) {
+    int first = -1;
+    int second = -1;
+    respond(connection->frames(), *connection, "+OK\n", first);
+    respond(connection->frames(), *connection, "$value\n", second);
+    EXPECT_EQ(first, -1);
+    EXPECT_EQ(connection->frames().outstanding(), 2u);
+
+    connection->resume_flushed(); // nothing sent yet
+    EXPECT_EQ(first, -1);
+    EXPECT_FALSE(connection->write_from_outbox());
+    connection->resume_flushed();
+    EXPECT_EQ(first, 1);
+    EXPECT_EQ(second, 1);
+    EXPECT_EQ(connection->frames().outstanding(), 0u);
+}
+
+TEST_F(CoroutineConnectionTest, CloseFailsWaitersAndEndsSession) {
+    std::vector<std::string> lines;
+    int result = -1;
+    session(connection->frames(), *connection, lines);
+    respond(connection->frames(), *connection, "+OK\n", result);
+    EXPECT_EQ(connection->frames().outstanding(), 2u);
+
+    connection->close();
+    EXPECT_TRUE(connection->closed());
+    EXPECT_EQ(result, 0);
+    EXPECT_EQ(connection->session_wait(), SessionWait::None);
+    EXPECT_EQ(connection->frames().outstanding(), 0u);
+}
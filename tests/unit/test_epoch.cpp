@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "kv/epoch.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace kv;
+
+namespace {
+
+std::atomic<int> freed_objects{0};
+
+void count_free(void* ptr) {
+    delete static_cast<int*>(ptr);
+    freed_objects++;
+}
+
+} // namespace
+
+
+TEST(EpochTest, RetiredObjectWaitsForActiveReader) {
+    freed_objects = 0;
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+    std::thread reader([&]() {
+        EpochGuard guard;
+        entered = true;
+        while (!release.load())
+            std::this_thread::yield();
+    });
+    while (!entered.load())
+        std::this_thread::yield();
+
+    Epoch::retire(new int{1}, &count_free);
+    Epoch::reclaim();
+    EXPECT_EQ(freed_objects.load(), 0);
+
+    release = true;
+    reader.join();
+    Epoch::reclaim();
+    EXPECT_EQ(freed_objects.load(), 1);
+}
+
+TEST(EpochTest, LaterReadersDoNotBlockReclaim) {
+    freed_objects = 0;
+    std::atomic<bool> entered{false};
+    std::atomic<bool> release{false};
+    std::thread early_reader([&]() {
+        EpochGuard guard;
+        entered = true;
+        while (!release.load())
+            std::this_thread::yield();
+    });
+    while (!entered.load())
+        std::this_thread::yield();
+
+    Epoch::retire(new int{1}, &count_free);
+    Epoch::reclaim(); // advances the epoch, the early reader still blocks
+
+    // Entered after the epoch moved on, so it can't hold the object
+    EpochGuard guard;
+    release = true;
+    early_reader.join();
+    Epoch::reclaim();
+    EXPECT_EQ(freed_objects.load(), 1);
+}
+
+TEST(EpochTest, NestedGuardsStayActiveUntilOutermostLeaves) {
+    freed_objects = 0;
+    {
+        EpochGuard outer;
+        {
+            EpochGuard inner;
+        }
+        Epoch::retire(new int{1}, &count_free);
+        Epoch::reclaim();
+        EXPECT_EQ(freed_objects.load(), 0);
+    }
+    Epoch::reclaim();
+    EXPECT_EQ(freed_objects.load(), 1);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include "kv/fair_task_queue.hpp"
+#include <stop_token>
+#include <string>
+#include <vector>
+
+using namespace kv;
+
+class FairTaskQueueTest : public ::testing::Test {
+protected:
+    using Queue = FairTaskQueue<int, std::string>;
+    Queue queue;
+    std::stop_source stop_source;
+
+    std::string pop() {
+        auto task = queue.wait_and_pop(stop_source.get_token());
+        return task.value_or("<none>");
+    }
+};
+
+
+TEST_F(FairTaskQueueTest, KeepsOrderWithinAFlow) {
+    queue.push(1, "a", 10);
+    queue.push(1, "b", 10);
+    queue.push(1, "c", 10);
+    EXPECT_EQ(pop(), "a");
+    EXPECT_EQ(pop(), "b");
+    EXPECT_EQ(pop(), "c");
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(FairTaskQueueTest, SmallTaskOvertakesBulkBacklog) {
+    for (int i = 0; i < 100; i++)
+        queue.push(1, "bulk", 200 * 1024);
+    queue.push(2, "ping", 64);
+
+    // The bulk flow needs several turns to afford one task, the ping only one
+    EXPECT_EQ(pop(), "ping");
+    EXPECT_EQ(queue.size(), 100);
+}
+
+TEST_F(FairTaskQueueTest, FlowsShareByBytes) {
+    for (int i = 0; i < 100; i++) {
+        queue.push(1, "big", 8 * 1024);
+        queue.push(2, "small", 1024);
+    }
+
+    // Per quantum, flow 1 gets 2 tasks and flow 2 gets 16
+    size_t big = 0;
+    size_t small = 0;
+    for (int i = 0; i < 36; i++)
+        (pop() == "big" ? big : small)++;
+    EXPECT_EQ(big, 4);
+    EXPECT_EQ(small, 32);
+}
+
+TEST_F(FairTaskQueueTest, LoneFlowIsNeverHeldBack) {
+    queue.push(1, "huge", 100 * 1024 * 1024);
+    EXPECT_EQ(pop(), "huge");
+}
+
+TEST_F(FairTaskQueueTest, StopRequestUnblocksWorker) {
+    stop_source.request_stop();
+    EXPECT_EQ(pop(), "<none>");
+}
+
+TEST_F(FairTaskQueueTest, DrainedFlowsAreReusedWithoutCredit) {
+    // Flow 1 drains with unspent credit, its storage goes to flow 2
+    queue.push(1, "a", 10);
+    EXPECT_EQ(pop(), "a");
+    queue.push(2, "big", 12 * 1024);
+    queue.push(2, "big", 12 * 1024);
+    queue.push(3, "small", 64);
+    // Had flow 2 inherited flow 1's credit, it could afford both at once
+    EXPECT_EQ(pop(), "big");
+    EXPECT_EQ(pop(), "small");
+    EXPECT_EQ(pop(), "big");
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "kv/hash_table.hpp"
+#include "kv/epoch.hpp"
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+
+using namespace kv;
+
+class HashTableTest : public ::testing::Test {
+protected:
+    HashTable<int> table;
+
+    void insert_range(int from, int to) {
+        for (int i = from; i < to; i++)
+            table.insert_or_assign("key" + std::to_string(i), i);
+    }
+
+    // One scan call, collecting the keys it reported
+    size_t scan_step(size_t cursor, size_t count, std::multiset<std::string>& seen) {
+        return table.scan(cursor, count, count * 10, [&](std::string_view key, const int&) {
+            seen.emplace(key);
+        });
+    }
+};
+
+
+TEST_F(HashTableTest, InsertFindErase) {
+    auto [value, inserted] = table.insert_or_assign("a", 1);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*value, 1);
+
+    auto [same, inserted_again] = table.insert_or_assign("a", 2);
+    EXPECT_FALSE(inserted_again);
+    EXPECT_EQ(*same, 2);
+
+    ASSERT_NE(table.find("a"), nullptr);
+    EXPECT_EQ(*table.find("a"), 2);
+    EXPECT_TRUE(table.erase("a"));
+    EXPECT_FALSE(table.erase("a"));
+    EXPECT_EQ(table.find("a"), nullptr);
+    EXPECT_EQ(table.size(), 0);
+}
+
+TEST_F(HashTableTest, GrowsAndShrinksInPowersOfTwo) {
+    insert_range(0, 1000);
+    EXPECT_EQ(table.size(), 1000);
+    EXPECT_EQ(table.bucket_count(), 1024);
+    for (int i = 0; i < 1000; i++)
+        ASSERT_EQ(*table.find("key" + std::to_string(i)), i);
+
+    for (int i = 0; i < 990; i++)
+        table.erase("key" + std::to_string(i));
+    EXPECT_LT(table.bucket_count(), 1024);
+    EXPECT_EQ(*table.find("key995"), 995);
+}
+
+TEST_F(HashTableTest, ScanVisitsEveryKeyExactlyOnce) {
+    insert_range(0, 500);
+    std::multiset<std::string> seen;
+    size_t cursor = 0;
+    do {
+        cursor = scan_step(cursor, 7, seen);
+    } while (cursor != 0);
+
+    EXPECT_EQ(seen.size(), 500);
+    EXPECT_EQ(std::set<std::string>(seen.begin(), seen.end()).size(), 500);
+}
+
+TEST_F(HashTableTest, ScanSurvivesGrowth) {
+    insert_range(0, 100);
+    std::multiset<std::string> seen;
+    size_t cursor = scan_step(0, 10, seen);
+
+    insert_range(100, 5000); // several rehashes mid-scan
+    do {
+        cursor = scan_step(cursor, 10, seen);
+    } while (cursor != 0);
+
+    for (int i = 0; i < 100; i++)
+        EXPECT_TRUE(seen.contains("key" + std::to_string(i))) << i;
+}
+
+TEST_F(HashTableTest, ScanSurvivesShrink) {
+    insert_range(0, 4000);
+    std::multiset<std::string> seen;
+    size_t cursor = scan_step(0, 50, seen);
+
+    for (int i = 100; i < 4000; i++) // several shrinks mid-scan
+        table.erase("key" + std::to_string(i));
+    do {
+        cursor = scan_step(cursor, 50, seen);
+    } while (cursor != 0);
+
+    for (int i = 0; i < 100; i++)
+        EXPECT_TRUE(seen.contains("key" + std::to_string(i))) << i;
+}
+
+TEST_F(HashTableTest, ScanTouchesBoundedBuckets) {
+    table.reserve(1 << 16); // mostly empty buckets
+    table.insert_or_assign("only", 1);
+
+    size_t keys = 0;
+    size_t cursor = table.scan(0, 1, 8, [&](std::string_view, const int&) { keys++; });
+    EXPECT_NE(cursor, 0); // stopped early after 8 buckets, not the whole table
+}
+
+TEST(HashTableConcurrentTest, ConcurrentFindSurvivesRehash) {
+    HashTable<int> table{true};
+    for (int i = 0; i < 100; i++)
+        table.insert_or_assign("stable" + std::to_string(i), i);
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> misses{0};
+    std::thread reader([&]() {
+        while (!done.load()) {
+            EpochGuard guard;
+            for (int i = 0; i < 100; i++) {
+                if (!table.find_concurrent("stable" + std::to_string(i)))
+                    misses++;
+            }
+        }
+    });
+
+    // The only writer, grows and shrinks the table several times
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 5000; i++)
+            table.insert_or_assign("churn" + std::to_string(i), i);
+        for (int i = 0; i < 5000; i++)
+            table.erase("churn" + std::to_string(i));
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(misses.load(), 0);
+    EXPECT_EQ(table.size(), 100);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include "kv/hash_table.hpp"
+#include "kv/hot_keys.hpp"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace kv;
+
+namespace {
+
+void read(HotKeyTracker& tracker, const std::string& key, int times) {
+    uint32_t hash = HashTable<int>::hash_of(key);
+    for (int i = 0; i < times; ++i)
+        tracker.record(key, hash);
+}
+
+} // namespace
+
+
+TEST(HotKeyTrackerTest, RanksByReads) {
+    HotKeyTracker tracker{std::chrono::seconds(60)};
+    EXPECT_TRUE(tracker.top(10).empty());
+    read(tracker, "a", 5);
+    read(tracker, "b", 30);
+    read(tracker, "c", 12);
+
+    auto top = tracker.top(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "b");
+    EXPECT_EQ(top[0].count, 30u);
+    EXPECT_EQ(top[1].key, "c");
+    EXPECT_EQ(top[1].count, 12u);
+    EXPECT_EQ(tracker.top(10).size(), 3u);
+    EXPECT_TRUE(tracker.top(0).empty());
+    EXPECT_EQ(tracker.estimate(HashTable<int>::hash_of("b")), 30u);
+}
+
+TEST(HotKeyTrackerTest, HotKeysStandOutOfManyColdOnes) {
+    HotKeyTracker tracker{std::chrono::seconds(60)};
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 5000; ++i)
+            read(tracker, "cold:" + std::to_string(i), 1);
+        read(tracker, "hot:1", 200);
+        read(tracker, "hot:2", 100);
+    }
+    auto top = tracker.top(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "hot:1");
+    EXPECT_EQ(top[1].key, "hot:2");
+    // Collisions can only add to a count
+    EXPECT_GE(top[0].count, 4000u);
+}
+
+TEST(HotKeyTrackerTest, MergesThreads) {
+    HotKeyTracker tracker{std::chrono::seconds(60)};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&tracker, t]() {
+            read(tracker, "shared", 100);
+            read(tracker, "own:" + std::to_string(t), 50 + t);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    auto top = tracker.top(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "shared");
+    EXPECT_EQ(top[0].count, 400u);
+    EXPECT_EQ(top[1].key, "own:3");
+    EXPECT_EQ(tracker.estimate(HashTable<int>::hash_of("shared")), 400u);
+}
+
+TEST(HotKeyTrackerTest, CountsDecay) {
+    HotKeyTracker tracker{std::chrono::milliseconds(50)};
+    read(tracker, "old", 1000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    // Not read since: scaled down when looked at
+    auto top = tracker.top(1);
+    ASSERT_EQ(top.size(), 1u);
+    EXPECT_LE(top[0].count, 500u);
+
+    // Reading catches the thread up, so new traffic soon outranks the old
+    read(tracker, "new", 2 * HotKeyTracker::CLOCK_CHECK);
+    top = tracker.top(2);
+    ASSERT_EQ(top.size(), 2u);
+    EXPECT_EQ(top[0].key, "new");
+    EXPECT_LE(tracker.estimate(HashTable<int>::hash_of("old")), 500u);
+}
+
+TEST(HotKeyTrackerTest, SampledCountsAreScaledBack) {
+    HotKeyTracker tracker{std::chrono::seconds(60), 6};
+    EXPECT_EQ(tracker.sample(), 8u);
+    read(tracker, "hot", 80'000);
+    for (int i = 0; i < 1000; ++i)
+        read(tracker, "cold:" + std::to_string(i), 8);
+
+    auto top = tracker.top(1);
+    ASSERT_EQ(top.size(), 1u);
+    EXPECT_EQ(top[0].key, "hot");
+    EXPECT_GT(top[0].count, 70'000u);
+    EXPECT_LT(top[0].count, 90'000u);
+}
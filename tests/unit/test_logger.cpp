@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include "kv/logger.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace kv;
+
+class LoggerTest : public ::testing::Test {
+protected:
+    std::filesystem::path path;
+    int fd = -1;
+
+    void SetUp() override {
+        path = std::filesystem::temp_directory_path() / ("kv_logger_" + std::to_string(getpid()) + ".log");
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ASSERT_GE(fd, 0);
+        Logger::set_output(fd);
+        Logger::set_level(LogLevel::Debug);
+    }
+
+    void TearDown() override {
+        Logger::set_output(STDOUT_FILENO);
+        Logger::set_level(LogLevel::Info);
+        close(fd);
+        std::filesystem::remove(path);
+    }
+
+    std::vector<std::string> lines() {
+        Logger::flush();
+        std::ifstream file(path);
+        std::vector<std::string> result;
+        for (std::string line; std::getline(file, line);)
+            result.push_back(line);
+        return result;
+    }
+};
+
+
+TEST_F(LoggerTest, FormatsArgumentsAfterPrefix) {
+    KV_LOG(Info, "Client [", 7, "] connected on port ", uint16_t{12345}, ' ', -3, ' ', 0.5);
+    auto written = lines();
+    ASSERT_EQ(written.size(), 1u);
+    EXPECT_NE(written[0].find(" INFO  ["), std::string::npos) << written[0];
+    EXPECT_TRUE(written[0].ends_with("] Client [7] connected on port 12345 -3 0.5")) << written[0];
+    EXPECT_EQ(written[0][4], '-'); // starts with the date
+}
+
+TEST_F(LoggerTest, LevelsBelowThresholdAreSkipped) {
+    Logger::set_level(LogLevel::Warn);
+    KV_LOG(Debug, "debug");
+    KV_LOG(Info, "info");
+    KV_LOG(Warn, "warn");
+    KV_LOG(Error, "error");
+    auto written = lines();
+    ASSERT_EQ(written.size(), 2u);
+    EXPECT_TRUE(written[0].ends_with("warn"));
+    EXPECT_TRUE(written[1].ends_with("error"));
+
+    Logger::set_level(LogLevel::Off);
+    KV_LOG(Error, "error");
+    EXPECT_EQ(lines().size(), 2u);
+}
+
+TEST_F(LoggerTest, LongMessagesAreCut) {
+    std::string text(1000, 'x');
+    KV_LOG(Info, text, 12345);
+    auto written = lines();
+    ASSERT_EQ(written.size(), 1u);
+    EXPECT_TRUE(written[0].ends_with(std::string(Logger::MESSAGE_BYTES, 'x')));
+}
+
+TEST_F(LoggerTest, ThreadsAreMergedInTimeOrder) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 100; ++i)
+                KV_LOG(Info, "thread ", t, " message ", i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    auto written = lines();
+    ASSERT_EQ(written.size(), 400u);
+    std::vector<int> next(4, 0);
+    for (const std::string& line : written) {
+        std::istringstream words(line.substr(line.find("thread ")));
+        std::string word;
+        int t, i;
+        words >> word >> t >> word >> i;
+        EXPECT_EQ(i, next[t]++) << "out of order within thread " << t;
+    }
+    // Timestamps are fixed width, so time order is text order
+    for (size_t i = 1; i < written.size(); ++i)
+        EXPECT_LE(written[i - 1].substr(0, 27), written[i].substr(0, 27));
+}
+
+TEST_F(LoggerTest, FullRingDropsInsteadOfBlocking) {
+    uint64_t dropped_before = Logger::dropped();
+    constexpr int MESSAGES = 100'000;
+    for (int i = 0; i < MESSAGES; ++i)
+        KV_LOG(Debug, "message ", i);
+
+    auto written = lines();
+    uint64_t dropped = Logger::dropped() - dropped_before;
+    size_t messages = 0;
+    for (const std::string& line : written)
+        messages += line.find(" message ") != std::string::npos;
+    EXPECT_EQ(messages + dropped, static_cast<size_t>(MESSAGES));
+    if (dropped > 0) {
+        EXPECT_TRUE(written.back().ends_with("messages dropped")) << written.back();
+    }
+}
+
+TEST(LoggerLevelTest, ParsesNames) {
+    EXPECT_EQ(Logger::parse_level("debug"), LogLevel::Debug);
+    EXPECT_EQ(Logger::parse_level("ERROR"), LogLevel::Error);
+    EXPECT_EQ(Logger::parse_level("verbose"), std::nullopt);
+    EXPECT_EQ(Logger::level_name(LogLevel::Warn), "WARN");
+}
@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+#include "kv/lz4.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace kv;
+
+namespace {
+
+std::string round_trip(const std::string& text, size_t* compressed_size = nullptr) {
+    std::vector<char> compressed(Lz4::max_compressed_size(text.size()));
+    size_t size = Lz4::compress(text, compressed.data());
+    if (compressed_size)
+        *compressed_size = size;
+    std::string back(text.size(), '\0');
+    EXPECT_TRUE(Lz4::decompress({compressed.data(), size}, back.data(), back.size()));
+    return back;
+}
+
+} // namespace
+
+
+TEST(Lz4Test, RoundTripsEdgeSizes) {
+    for (size_t size : {0, 1, 4, 12, 13, 17, 64, 255, 4096}) {
+        std::string text(size, 'a');
+        EXPECT_EQ(round_trip(text), text) << "size " << size;
+    }
+}
+
+TEST(Lz4Test, CompressesRepetitiveText) {
+    std::string text;
+    for (int i = 0; text.size() < 200 * 1024; i++)
+        text += "{\"id\": " + std::to_string(i) + ", \"name\": \"item\", \"active\": true},\n";
+
+    size_t compressed_size = 0;
+    EXPECT_EQ(round_trip(text, &compressed_size), text);
+    EXPECT_LT(compressed_size, text.size() / 4);
+}
+
+TEST(Lz4Test, RandomBytesStayWithinBound) {
+    std::mt19937 rng{42};
+    std::string text(100 * 1024, '\0');
+    for (char& c : text)
+        c = static_cast<char>(rng());
+
+    size_t compressed_size = 0;
+    EXPECT_EQ(round_trip(text, &compressed_size), text);
+    EXPECT_LE(compressed_size, Lz4::max_compressed_size(text.size()));
+}
+
+TEST(Lz4Test, RejectsMalformedInput) {
+    std::string text(1000, 'x');
+    std::vector<char> compressed(Lz4::max_compressed_size(text.size()));
+    size_t size = Lz4::compress(text, compressed.data());
+    std::string back(text.size(), '\0');
+
+    EXPECT_FALSE(Lz4::decompress({compressed.data(), size - 1}, back.data(), back.size()));
+    EXPECT_FALSE(Lz4::decompress({compressed.data(), size}, back.data(), back.size() - 1));
+    // A match pointing before the start of the output
+    EXPECT_FALSE(Lz4::decompress(std::string_view{"\x10" "a" "\x05\x00", 4}, back.data(), 5));
+}
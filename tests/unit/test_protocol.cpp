@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include "kv/command_table.hpp"
 #include "kv/protocol.hpp"
 
 using namespace kv;
@@ -114,6 +115,138 @@ TEST(ProtocolTest, DelTooManyParameters) {
 }
 
 
+// Unlink
+
+TEST(ProtocolTest, UnlinkValidCommand) {
+    Command result = Protocol::parse("UNLINK key");
+    Unlink* unlink_cmd = std::get_if<Unlink>(&result);
+    ASSERT_TRUE(unlink_cmd);
+    EXPECT_EQ(unlink_cmd->key, "key");
+}
+
+TEST(ProtocolTest, UnlinkMissingParameters) {
+    EXPECT_THROW(Protocol::parse("UNLINK"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("UNLINK key extra"), ProtocolError);
+}
+
+
+// Read-modify-write
+
+TEST(ProtocolTest, IncrDecrIncrby) {
+    Command incr = Protocol::parse("INCR counter");
+    Command decr = Protocol::parse("decr counter");
+    Command incrby = Protocol::parse("IncrBy counter -42");
+
+    ASSERT_TRUE(std::get_if<Incr>(&incr));
+    EXPECT_EQ(std::get<Incr>(incr).delta, 1);
+    ASSERT_TRUE(std::get_if<Incr>(&decr));
+    EXPECT_EQ(std::get<Incr>(decr).delta, -1);
+    ASSERT_TRUE(std::get_if<Incr>(&incrby));
+    EXPECT_EQ(std::get<Incr>(incrby).key, "counter");
+    EXPECT_EQ(std::get<Incr>(incrby).delta, -42);
+}
+
+TEST(ProtocolTest, IncrbyRequiresInteger) {
+    EXPECT_THROW(Protocol::parse("INCRBY counter"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("INCRBY counter 1.5"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("INCRBY counter 99999999999999999999"), ProtocolError);
+}
+
+TEST(ProtocolTest, AppendGetSetSetNx) {
+    Command append = Protocol::parse("APPEND key tail");
+    Command getset = Protocol::parse("GETSET key new");
+    Command setnx = Protocol::parse("SETNX key first");
+
+    ASSERT_TRUE(std::get_if<Append>(&append));
+    EXPECT_EQ(std::get<Append>(append).value, "tail");
+    ASSERT_TRUE(std::get_if<GetSet>(&getset));
+    EXPECT_EQ(std::get<GetSet>(getset).value, "new");
+    ASSERT_TRUE(std::get_if<SetNx>(&setnx));
+    EXPECT_EQ(std::get<SetNx>(setnx).value, "first");
+    EXPECT_THROW(Protocol::parse("APPEND key"), ProtocolError);
+}
+
+TEST(ProtocolTest, GetsAndCas) {
+    Command gets = Protocol::parse("GETS key");
+    Command cas = Protocol::parse("CAS key 17 value");
+
+    ASSERT_TRUE(std::get_if<Gets>(&gets));
+    Cas* cas_cmd = std::get_if<Cas>(&cas);
+    ASSERT_TRUE(cas_cmd);
+    EXPECT_EQ(cas_cmd->key, "key");
+    EXPECT_EQ(cas_cmd->version, 17);
+    EXPECT_EQ(cas_cmd->value, "value");
+    EXPECT_THROW(Protocol::parse("CAS key value"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("CAS key -1 value"), ProtocolError);
+}
+
+
+// Scan / Range
+
+TEST(ProtocolTest, ScanValidCommand) {
+    Command result = Protocol::parse("SCAN user:");
+    Scan* scan_cmd = std::get_if<Scan>(&result);
+    ASSERT_TRUE(scan_cmd);
+    EXPECT_EQ(scan_cmd->prefix, "user:");
+    EXPECT_EQ(scan_cmd->limit, 0);
+}
+
+TEST(ProtocolTest, ScanWithLimit) {
+    Command result = Protocol::parse("scan user: limit 10");
+    Scan* scan_cmd = std::get_if<Scan>(&result);
+    ASSERT_TRUE(scan_cmd);
+    EXPECT_EQ(scan_cmd->prefix, "user:");
+    EXPECT_EQ(scan_cmd->limit, 10);
+}
+
+TEST(ProtocolTest, ScanFromKey) {
+    Command result = Protocol::parse("SCAN user: FROM user:7 LIMIT 10");
+    Scan* scan_cmd = std::get_if<Scan>(&result);
+    ASSERT_TRUE(scan_cmd);
+    EXPECT_EQ(scan_cmd->prefix, "user:");
+    EXPECT_EQ(scan_cmd->from, "user:7");
+    EXPECT_EQ(scan_cmd->limit, 10);
+
+    EXPECT_THROW(Protocol::parse("SCAN user: FROM"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN user: FROM a FROM b"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("RANGE a c FROM b"), ProtocolError);
+}
+
+TEST(ProtocolTest, ScanInvalidLimit) {
+    EXPECT_THROW(Protocol::parse("SCAN user: LIMIT"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN user: LIMIT abc"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN user: LIMIT 0"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN user: COUNT 5"), ProtocolError);
+}
+
+TEST(ProtocolTest, CursorScanValidCommand) {
+    Command result = Protocol::parse("SCAN 1234 count 100");
+    CursorScan* scan_cmd = std::get_if<CursorScan>(&result);
+    ASSERT_TRUE(scan_cmd);
+    EXPECT_EQ(scan_cmd->cursor, 1234);
+    EXPECT_EQ(scan_cmd->count, 100);
+}
+
+TEST(ProtocolTest, CursorScanInvalidNumbers) {
+    EXPECT_THROW(Protocol::parse("SCAN abc COUNT 10"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN 0 COUNT 0"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SCAN 0 COUNT -1"), ProtocolError);
+}
+
+TEST(ProtocolTest, RangeValidCommand) {
+    Command result = Protocol::parse("RANGE a c LIMIT 3");
+    Range* range_cmd = std::get_if<Range>(&result);
+    ASSERT_TRUE(range_cmd);
+    EXPECT_EQ(range_cmd->start, "a");
+    EXPECT_EQ(range_cmd->end, "c");
+    EXPECT_EQ(range_cmd->limit, 3);
+}
+
+TEST(ProtocolTest, RangeMissingParameters) {
+    EXPECT_THROW(Protocol::parse("RANGE a"), ProtocolError);
+}
+
+
 // Other
 
 TEST(ProtocolTest, EmptyInput) {
@@ -127,10 +260,159 @@ TEST(ProtocolTest, EmptyInput) {
     ASSERT_TRUE(noop_cmd2);
 }
 
+TEST(ProtocolTest, ParseBlobCommands) {
+    Command set = Protocol::parse("SETBLOB key 1048576");
+    SetBlob* set_cmd = std::get_if<SetBlob>(&set);
+    ASSERT_TRUE(set_cmd);
+    EXPECT_EQ(set_cmd->key, "key");
+    EXPECT_EQ(set_cmd->size, 1048576);
+    EXPECT_FALSE(set_cmd->payload);
+
+    Command get = Protocol::parse("getblob key");
+    ASSERT_TRUE(std::get_if<GetBlob>(&get));
+
+    EXPECT_THROW(Protocol::parse("SETBLOB key"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SETBLOB key -1"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SETBLOB key " + std::to_string(Protocol::MAX_BLOB_SIZE + 1)), PayloadError);
+    EXPECT_EQ(Protocol::format_blob_header(3), "=3\n");
+
+    Command compressed = Protocol::parse("GETBLOB key compressed");
+    ASSERT_TRUE(std::get_if<GetBlob>(&compressed));
+    EXPECT_TRUE(std::get<GetBlob>(compressed).compressed);
+    EXPECT_THROW(Protocol::parse("GETBLOB key zip"), ProtocolError);
+    EXPECT_EQ(Protocol::format_compressed_blob_header(3, 10), "~3 10\n");
+}
+
+TEST(ProtocolTest, ParseMultiKeyCommands) {
+    Command mget = Protocol::parse("mget a b c");
+    ASSERT_TRUE(std::get_if<MGet>(&mget));
+    EXPECT_EQ(std::get<MGet>(mget).keys, (std::vector<std::string>{"a", "b", "c"}));
+
+    Command mset = Protocol::parse("MSET a 1 b 2");
+    ASSERT_TRUE(std::get_if<MSet>(&mset));
+    EXPECT_EQ(std::get<MSet>(mset).pairs, (std::vector<std::pair<std::string, std::string>>{{"a", "1"}, {"b", "2"}}));
+
+    EXPECT_THROW(Protocol::parse("MGET"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("MSET a"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("MSET a 1 b"), ProtocolError);
+}
+
+TEST(ProtocolTest, ParseClusterSlots) {
+    EXPECT_TRUE(std::holds_alternative<ClusterSlots>(Protocol::parse("cluster slots")));
+    EXPECT_THROW(Protocol::parse("CLUSTER"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("CLUSTER NODES"), ProtocolError);
+    EXPECT_EQ(Protocol::format_moved(12182, "127.0.0.1:7003"), "-MOVED 12182 127.0.0.1:7003\n");
+}
+
+TEST(ProtocolTest, ParseBulkCommands) {
+    Command load = Protocol::parse("LOAD 4096");
+    ASSERT_TRUE(std::get_if<Load>(&load));
+    EXPECT_EQ(std::get<Load>(load).size, 4096u);
+    EXPECT_TRUE(std::get<Load>(load).file.empty());
+    EXPECT_EQ(std::get<Load>(Protocol::parse("load file warm.kv")).file, "warm.kv");
+
+    Command dump = Protocol::parse("DUMP");
+    ASSERT_TRUE(std::get_if<Dump>(&dump));
+    EXPECT_TRUE(std::get<Dump>(dump).file.empty());
+    EXPECT_EQ(std::get<Dump>(Protocol::parse("DUMP FILE backup.kv")).file, "backup.kv");
+
+    EXPECT_THROW(Protocol::parse("LOAD"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("LOAD lots"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("LOAD FILE"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("LOAD " + std::to_string(Protocol::MAX_LOAD_SIZE + 1)), PayloadError);
+    EXPECT_THROW(Protocol::parse("DUMP now"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("DUMP FILE a b"), ProtocolError);
+}
+
+TEST(ProtocolTest, ParseSlowLog) {
+    Command get = Protocol::parse("SLOWLOG GET");
+    ASSERT_TRUE(std::get_if<SlowLog>(&get));
+    EXPECT_EQ(std::get<SlowLog>(get).action, SlowLog::Action::Get);
+    EXPECT_EQ(std::get<SlowLog>(get).count, 10u);
+    EXPECT_EQ(std::get<SlowLog>(Protocol::parse("slowlog get 3")).count, 3u);
+    EXPECT_EQ(std::get<SlowLog>(Protocol::parse("SLOWLOG LEN")).action, SlowLog::Action::Len);
+    EXPECT_EQ(std::get<SlowLog>(Protocol::parse("SLOWLOG reset")).action, SlowLog::Action::Reset);
+
+    EXPECT_THROW(Protocol::parse("SLOWLOG"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SLOWLOG GET many"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("SLOWLOG RESET now"), ProtocolError);
+}
+
+TEST(ProtocolTest, ParseHotKeys) {
+    Command hot = Protocol::parse("HOTKEYS");
+    ASSERT_TRUE(std::get_if<HotKeys>(&hot));
+    EXPECT_EQ(std::get<HotKeys>(hot).count, 10u);
+    EXPECT_EQ(std::get<HotKeys>(Protocol::parse("hotkeys 3")).count, 3u);
+
+    EXPECT_THROW(Protocol::parse("HOTKEYS all"), ProtocolError);
+    EXPECT_THROW(Protocol::parse("HOTKEYS 3 4"), ProtocolError);
+}
+
+TEST(ProtocolTest, ParseWorkers) {
+    EXPECT_TRUE(std::holds_alternative<Workers>(Protocol::parse("WORKERS")));
+    EXPECT_THROW(Protocol::parse("WORKERS 2"), ProtocolError);
+}
+
 TEST(ProtocolTest, RejectUnknownCommand) {
     EXPECT_THROW(Protocol::parse("FLUSH"), ProtocolError);
 }
 
+TEST(ProtocolTest, VerbsMatchWholeAndInAnyCase) {
+    EXPECT_TRUE(std::holds_alternative<ClusterSlots>(Protocol::parse("ClUsTeR sLoTs")));
+    EXPECT_TRUE(std::holds_alternative<Gets>(Protocol::parse("GETS key")));
+    EXPECT_EQ(std::get<Incr>(Protocol::parse("Decr key")).delta, -1);
+
+    // Prefixes, extensions and near misses of real verbs
+    for (const char* line : {"GE key", "GETT key", "SETNXX k v", "G", "ping", "getÃ© key"})
+        EXPECT_THROW(Protocol::parse(line), ProtocolError) << line;
+    EXPECT_THROW(Protocol::parse(std::string(4096, 'g') + " key"), ProtocolError);
+}
+
+namespace {
+
+struct TestEntry {
+    std::string_view name;
+    int id;
+};
+
+constexpr CommandTable TEST_TABLE{std::array{
+    TestEntry{"mget", 1}, TestEntry{"mset", 2}, TestEntry{"get", 3}, TestEntry{"gets", 4}, TestEntry{"x", 5},
+}};
+
+// Lookups work at compile time too
+static_assert(TEST_TABLE.find("MSET")->id == 2);
+static_assert(TEST_TABLE.find("mGet")->id == 1);
+static_assert(TEST_TABLE.find("msetx") == nullptr);
+
+} // namespace
+
+TEST(CommandTableTest, FindsEveryEntryInAnyCase) {
+    for (const TestEntry& entry : TEST_TABLE.entries()) {
+        std::string upper{entry.name};
+        for (char& c : upper)
+            c = static_cast<char>(c - 'a' + 'A');
+        ASSERT_EQ(TEST_TABLE.find(entry.name), &entry);
+        ASSERT_EQ(TEST_TABLE.find(upper), &entry);
+    }
+    EXPECT_EQ(TEST_TABLE.find(""), nullptr);
+    EXPECT_EQ(TEST_TABLE.find("X")->id, 5);
+    EXPECT_EQ(TEST_TABLE.find("y"), nullptr);
+    EXPECT_EQ(TEST_TABLE.find("ge"), nullptr);
+    EXPECT_EQ(TEST_TABLE.find("get "), nullptr);
+}
+
+TEST(CommandTableTest, FoldsOnlyAsciiLetters) {
+    EXPECT_EQ(fold_ascii('Q'), 'q');
+    EXPECT_EQ(fold_ascii('q'), 'q');
+    EXPECT_EQ(fold_ascii('@'), '@');
+    EXPECT_EQ(fold_ascii('['), '[');
+    EXPECT_EQ(fold_ascii('\xC9'), '\xC9');
+    EXPECT_TRUE(equals_folded("GeT", "get"));
+    EXPECT_FALSE(equals_folded("GeT", "gets"));
+    // '@' | 0x20 would be '`', folding must not touch it
+    EXPECT_FALSE(equals_folded("@", "`"));
+}
+
 TEST(ProtocolTest, FormatOk) {
     EXPECT_EQ(Protocol::format_ok(), "+OK\n");
 }
@@ -143,6 +425,16 @@ TEST(ProtocolTest, FormatValue) {
     EXPECT_EQ(Protocol::format_value("msg"), "$msg\n");
 }
 
+TEST(ProtocolTest, FormatIntegerAndNil) {
+    EXPECT_EQ(Protocol::format_integer(-7), ":-7\n");
+    EXPECT_EQ(Protocol::format_nil(), "_\n");
+}
+
+TEST(ProtocolTest, FormatArray) {
+    EXPECT_EQ(Protocol::format_array({}), "*0\n");
+    EXPECT_EQ(Protocol::format_array({"a", "b"}), "*2\n$a\n$b\n");
+}
+
 TEST(ProtocolTest, KeysAreCaseSensitive) {
     Command result1 = Protocol::parse("GET key");
     Command result2 = Protocol::parse("GET KEY");
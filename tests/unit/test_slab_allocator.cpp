@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include "kv/slab_allocator.hpp"
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace kv;
+
+
+TEST(SlabAllocatorTest, RoundsUpToSizeClasses) {
+    EXPECT_EQ(SlabAllocator::block_size(1), 16);
+    EXPECT_EQ(SlabAllocator::block_size(16), 16);
+    EXPECT_EQ(SlabAllocator::block_size(17), 32);
+    EXPECT_EQ(SlabAllocator::block_size(129), 160);
+    EXPECT_EQ(SlabAllocator::block_size(4096), 4096);
+    EXPECT_EQ(SlabAllocator::block_size(5000), 5000);
+}
+
+TEST(SlabAllocatorTest, BlocksAreDistinctAndAligned) {
+    std::set<void*> seen;
+    std::vector<void*> blocks;
+    for (int i = 0; i < 1000; i++) {
+        void* block = SlabAllocator::allocate(48);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(block) % 16, 0);
+        EXPECT_TRUE(seen.insert(block).second);
+        std::memset(block, 0xab, 48);
+        blocks.push_back(block);
+    }
+    for (void* block : blocks)
+        SlabAllocator::deallocate(block, 48);
+}
+
+TEST(SlabAllocatorTest, FreedBlocksAreReused) {
+    void* block = SlabAllocator::allocate(64);
+    SlabAllocator::deallocate(block, 64);
+    EXPECT_EQ(SlabAllocator::allocate(64), block); // per-thread free list is LIFO
+    SlabAllocator::deallocate(block, 64);
+}
+
+TEST(SlabAllocatorTest, CrossThreadFreeAndThreadExit) {
+    std::vector<void*> blocks;
+    std::thread producer([&blocks]() {
+        for (int i = 0; i < 500; i++)
+            blocks.push_back(SlabAllocator::allocate(100));
+    });
+    producer.join(); // thread cache flushed back to the depot on exit
+
+    size_t reserved = SlabAllocator::reserved_bytes();
+    for (void* block : blocks)
+        SlabAllocator::deallocate(block, 100);
+    for (int i = 0; i < 500; i++)
+        blocks[i] = SlabAllocator::allocate(100);
+    EXPECT_EQ(SlabAllocator::reserved_bytes(), reserved); // reused, no new slabs
+    for (void* block : blocks)
+        SlabAllocator::deallocate(block, 100);
+}
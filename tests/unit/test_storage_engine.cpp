@@ -0,0 +1,288 @@
+#include <gtest/gtest.h>
+#include "kv/command_dispatcher.hpp"
+#include "kv/kv_store.hpp"
+#include "kv/log_store.hpp"
+#include "kv/protocol.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using namespace kv;
+
+/*
+ * Conformance suite, every StorageEngine the server ships must pass it.
+ * Commands go through CommandDispatcher, so replies are checked byte for byte.
+ */
+template <typename Engine>
+class StorageEngineTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+    std::unique_ptr<Engine> store;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() / ("kv_engine_" + std::to_string(getpid()));
+        std::filesystem::remove_all(directory);
+        store = make(true);
+    }
+
+    void TearDown() override {
+        store.reset();
+        std::filesystem::remove_all(directory);
+    }
+
+    std::unique_ptr<Engine> make(bool ordered_index) {
+        typename Engine::Options options{};
+        options.ordered_index = ordered_index;
+        options.hot_key_sample = 1; // exact HOTKEYS counts
+        if constexpr (std::is_same_v<Engine, LogStore>)
+            options.directory = directory.string();
+        return std::make_unique<Engine>(options);
+    }
+
+    std::string run(std::string_view line) {
+        return CommandDispatcher::execute(Protocol::parse(line), *store);
+    }
+};
+
+using Engines = ::testing::Types<KvStore, LogStore>;
+TYPED_TEST_SUITE(StorageEngineTest, Engines);
+
+
+TYPED_TEST(StorageEngineTest, SetGetDel) {
+    EXPECT_EQ(this->run("GET key"), Protocol::format_error("key not found"));
+    EXPECT_EQ(this->run("SET key value"), Protocol::format_ok());
+    EXPECT_EQ(this->run("GET key"), Protocol::format_value("value"));
+    EXPECT_EQ(this->run("SET key other"), Protocol::format_ok());
+    EXPECT_EQ(this->run("GET key"), Protocol::format_value("other"));
+    EXPECT_EQ(this->run("DEL key"), Protocol::format_ok());
+    EXPECT_EQ(this->run("DEL key"), Protocol::format_error("key not found"));
+    EXPECT_EQ(this->run("SET key value"), Protocol::format_ok());
+    EXPECT_EQ(this->run("UNLINK key"), Protocol::format_ok());
+    EXPECT_FALSE(this->store->exists("key"));
+    EXPECT_EQ(this->store->size(), 0u);
+}
+
+TYPED_TEST(StorageEngineTest, ReadModifyWrite) {
+    EXPECT_EQ(this->run("INCR counter"), Protocol::format_integer(1));
+    EXPECT_EQ(this->run("INCRBY counter 41"), Protocol::format_integer(42));
+    EXPECT_EQ(this->run("DECR counter"), Protocol::format_integer(41));
+    EXPECT_EQ(this->run("APPEND counter 0"), Protocol::format_integer(3));
+    EXPECT_EQ(this->run("GET counter"), Protocol::format_value("410"));
+    EXPECT_EQ(this->run("SET text 007"), Protocol::format_ok());
+    EXPECT_EQ(this->run("INCR text"), Protocol::format_error("value is not an integer"));
+    EXPECT_EQ(this->run("SET max 9223372036854775807"), Protocol::format_ok());
+    EXPECT_EQ(this->run("INCR max"), Protocol::format_error("increment would overflow"));
+
+    EXPECT_EQ(this->run("GETSET key first"), Protocol::format_nil());
+    EXPECT_EQ(this->run("GETSET key second"), Protocol::format_value("first"));
+    EXPECT_EQ(this->run("SETNX key third"), Protocol::format_integer(0));
+    EXPECT_EQ(this->run("SETNX fresh value"), Protocol::format_integer(1));
+    EXPECT_EQ(this->run("GET key"), Protocol::format_value("second"));
+}
+
+TYPED_TEST(StorageEngineTest, CompareAndSet) {
+    EXPECT_EQ(this->run("CAS key 0 first"), Protocol::format_ok());
+    EXPECT_EQ(this->run("CAS key 0 again"), Protocol::format_error("version mismatch"));
+
+    auto versioned = this->store->get_versioned("key");
+    ASSERT_TRUE(versioned.has_value());
+    EXPECT_EQ(versioned->value, "first");
+    EXPECT_EQ(this->run("GETS key"),
+              Protocol::format_array({"first", std::to_string(versioned->version)}));
+    EXPECT_EQ(this->run("CAS key " + std::to_string(versioned->version) + " second"), Protocol::format_ok());
+    EXPECT_EQ(this->run("CAS key " + std::to_string(versioned->version) + " third"),
+              Protocol::format_error("version mismatch"));
+    EXPECT_EQ(this->run("GET key"), Protocol::format_value("second"));
+}
+
+TYPED_TEST(StorageEngineTest, ScansAndRanges) {
+    for (const char* key : {"user:3", "user:1", "item:1", "user:2", "zebra"})
+        this->store->set(key, "v");
+    // Replies lead with the key the next page starts at
+    EXPECT_EQ(this->run("SCAN user: LIMIT 2"), Protocol::format_array({"user:3", "user:1", "user:2"}));
+    EXPECT_EQ(this->run("SCAN user: LIMIT 2 FROM user:3"), Protocol::format_array({"", "user:3"}));
+    EXPECT_EQ(this->run("RANGE item:1 user:3"), Protocol::format_array({"", "item:1", "user:1", "user:2"}));
+    EXPECT_EQ(this->run("RANGE item:1 zzz LIMIT 1"), Protocol::format_array({"user:1", "item:1"}));
+    this->store->del("user:1");
+    EXPECT_EQ(this->run("SCAN user:"), Protocol::format_array({"", "user:2", "user:3"}));
+
+    for (int i = 0; i < 500; ++i)
+        this->store->set("key" + std::to_string(i), "v");
+    std::vector<std::string> keys;
+    size_t cursor = 0;
+    do {
+        cursor = this->store->scan(cursor, 50, keys);
+    } while (cursor != 0);
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(std::unique(keys.begin(), keys.end()), keys.end());
+    EXPECT_EQ(keys.size(), 504u);
+
+    // A COUNT beyond the maximum neither overflows nor walks the whole table at once
+    for (int i = 500; i < 3000; ++i)
+        this->store->set("key" + std::to_string(i), "v");
+    keys.clear();
+    EXPECT_NE(this->store->scan(0, std::numeric_limits<size_t>::max(), keys), 0u);
+    EXPECT_LT(keys.size(), 2 * TypeParam::SCAN_MAX_COUNT);
+
+    // However large the LIMIT, a reply holds one page of keys
+    auto page_key = [](size_t i) { return "page:" + std::string(5 - std::to_string(i).size(), '0') + std::to_string(i); };
+    size_t total = Protocol::MAX_SCAN_KEYS + 500;
+    for (size_t i = 0; i < total; ++i)
+        this->store->set(page_key(i), "v");
+    std::vector<std::string> first{page_key(Protocol::MAX_SCAN_KEYS)};
+    for (size_t i = 0; i < Protocol::MAX_SCAN_KEYS; ++i)
+        first.push_back(page_key(i));
+    EXPECT_EQ(this->run("SCAN page: LIMIT 1000000"), Protocol::format_array(first));
+    std::vector<std::string> rest{""};
+    for (size_t i = Protocol::MAX_SCAN_KEYS; i < total; ++i)
+        rest.push_back(page_key(i));
+    EXPECT_EQ(this->run("RANGE " + first.front() + " page;"), Protocol::format_array(rest));
+
+    this->store = this->make(false);
+    EXPECT_EQ(this->run("SCAN user:"), Protocol::format_error("ordered index disabled"));
+}
+
+TYPED_TEST(StorageEngineTest, BinaryBlobs) {
+    std::string bytes(300 * 1024, '\0');
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = static_cast<char>(i * 31);
+    Value payload = Value::with_size(bytes.size());
+    std::copy(bytes.begin(), bytes.end(), payload.data());
+
+    SetBlob set{"blob", bytes.size(), std::make_shared<Value>(std::move(payload))};
+    EXPECT_EQ(CommandDispatcher::execute(Command{std::move(set)}, *this->store), Protocol::format_ok());
+    EXPECT_EQ(this->run("GETBLOB blob"), Protocol::format_blob_header(bytes.size()) + bytes + "\n");
+    EXPECT_EQ(this->run("GETBLOB missing"), Protocol::format_error("key not found"));
+}
+
+TYPED_TEST(StorageEngineTest, HotKeys) {
+    EXPECT_EQ(this->run("HOTKEYS"), Protocol::format_array({}));
+    for (const char* key : {"hot", "warm", "cold"})
+        this->run(std::string{"SET "} + key + " value");
+    for (int i = 0; i < 50; ++i) {
+        this->run("GET hot");
+        if (i % 5 == 0)
+            this->run("GET warm");
+    }
+    this->run("GET cold");
+    this->run("GET missing");
+
+    EXPECT_EQ(this->run("HOTKEYS 2"), Protocol::format_array({"hot", "50", "warm", "10"}));
+    EXPECT_EQ(this->run("HOTKEYS"), Protocol::format_array({"hot", "50", "warm", "10", "cold", "1"}));
+}
+
+TYPED_TEST(StorageEngineTest, ConcurrentWritersAndReaders) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([this, t]() {
+            for (int i = 0; i < 200; ++i) {
+                std::string key = "k" + std::to_string(t) + "_" + std::to_string(i);
+                this->store->set(key, key);
+                EXPECT_EQ(this->store->get(key), key);
+                this->store->incr_by("shared", 1);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    EXPECT_EQ(this->store->get("shared"), "800");
+    EXPECT_EQ(this->store->size(), 801u);
+}
+
+TYPED_TEST(StorageEngineTest, MultiKeyCommands) {
+    EXPECT_EQ(this->run("SET b old"), Protocol::format_ok());
+    EXPECT_EQ(this->run("MSET a 1 b 2 c 3 a 4"), Protocol::format_ok());
+    EXPECT_EQ(this->run("MGET a b missing c"), "*4\n$4\n$2\n_\n$3\n");
+    EXPECT_EQ(this->run("INCR c"), Protocol::format_integer(4));
+    EXPECT_EQ(this->run("MGET c"), "*1\n$4\n");
+    EXPECT_EQ(this->store->size(), 3u);
+}
+
+TYPED_TEST(StorageEngineTest, LoadAndDump) {
+    EXPECT_EQ(this->run("SET kept old"), Protocol::format_ok());
+    EXPECT_EQ(this->run("SET replaced old"), Protocol::format_ok());
+
+    std::string stream;
+    BulkFormat::append(stream, "replaced", "new");
+    for (int i = 0; i < 3000; ++i)
+        BulkFormat::append(stream, "bulk:" + std::to_string(i), std::to_string(i));
+    BulkFormat::append(stream, "binary", std::string{"a\nb c\0d", 7});
+    BulkFormat::append(stream, "bulk:7", "last wins");
+    Load load{"", stream.size(), std::make_shared<Value>(stream)};
+    EXPECT_EQ(CommandDispatcher::execute(Command{std::move(load)}, *this->store), Protocol::format_integer(3003));
+
+    EXPECT_EQ(this->store->size(), 3003u);
+    EXPECT_EQ(this->run("GET kept"), Protocol::format_value("old"));
+    EXPECT_EQ(this->run("GET replaced"), Protocol::format_value("new"));
+    EXPECT_EQ(this->run("GET bulk:2999"), Protocol::format_value("2999"));
+    EXPECT_EQ(this->run("GET bulk:7"), Protocol::format_value("last wins"));
+    EXPECT_EQ(this->store->get("binary"), (std::string{"a\nb c\0d", 7}));
+    EXPECT_EQ(this->run("SCAN bulk:299 LIMIT 2"), Protocol::format_array({"bulk:2991", "bulk:299", "bulk:2990"}));
+    // Loaded keys get versions like any write
+    EXPECT_EQ(this->run("CAS bulk:5 0 x"), Protocol::format_error("version mismatch"));
+
+    // The dump is a stream LOAD takes back
+    std::string reply = this->run("DUMP");
+    size_t header_end = reply.find('\n');
+    ASSERT_EQ(reply.substr(0, 1), "=");
+    size_t size = std::stoul(reply.substr(1, header_end - 1));
+    ASSERT_EQ(reply.size(), header_end + 1 + size + 1);
+    std::vector<BulkRecord> records = BulkFormat::decode(std::string_view{reply}.substr(header_end + 1, size));
+    EXPECT_EQ(records.size(), 3003u);
+    std::sort(records.begin(), records.end(), [](const BulkRecord& a, const BulkRecord& b) { return a.key < b.key; });
+    EXPECT_EQ(records.front().key, "binary");
+    EXPECT_EQ(records.front().value, (std::string{"a\nb c\0d", 7}));
+    EXPECT_EQ(records.back().key, "replaced");
+    EXPECT_EQ(records.back().value, "new");
+
+    // Over its size cap, a socket DUMP fails instead of building the whole reply
+    EXPECT_EQ(CommandDispatcher::execute(Dump{"", 1024}, *this->store),
+              Protocol::format_error("store too large for DUMP, use DUMP FILE"));
+    EXPECT_EQ(CommandDispatcher::execute(Dump{"", 2 * 1024 * 1024}, *this->store), reply);
+
+    Load corrupt{"", 5, std::make_shared<Value>(std::string_view{stream}.substr(0, 5))};
+    EXPECT_EQ(CommandDispatcher::execute(Command{std::move(corrupt)}, *this->store),
+              Protocol::format_error("bulk stream cut short"));
+}
+
+TYPED_TEST(StorageEngineTest, LoadAndDumpFiles) {
+    std::filesystem::create_directories(this->directory);
+    std::string path = (this->directory / "dump.kv").string();
+    for (int i = 0; i < 100; ++i)
+        this->store->set("file:" + std::to_string(i), std::string(100, 'a' + i % 26));
+    this->run("INCR counter");
+
+    EXPECT_EQ(CommandDispatcher::execute(Dump{path}, *this->store), Protocol::format_ok());
+    EXPECT_FALSE(std::filesystem::exists(path + ".tmp"));
+
+    typename TypeParam::Options options{};
+    if constexpr (std::is_same_v<TypeParam, LogStore>)
+        options.directory = (this->directory / "copy").string();
+    auto copy = std::make_unique<TypeParam>(options);
+    EXPECT_EQ(CommandDispatcher::execute(Load{path, 0, nullptr}, *copy), Protocol::format_integer(101));
+    EXPECT_EQ(copy->get("file:27"), std::string(100, 'b'));
+    EXPECT_EQ(copy->get("counter"), "1");
+    EXPECT_TRUE(CommandDispatcher::execute(Load{path + ".missing", 0, nullptr}, *copy).starts_with("-ERR can't open"));
+}
+
+TYPED_TEST(StorageEngineTest, LoadRefusesKeysItDoesNotAccept) {
+    std::string stream;
+    for (int i = 0; i < 10; ++i)
+        BulkFormat::append(stream, (i % 3 == 0 ? "other:" : "own:") + std::to_string(i), "v");
+    auto accepts = [](std::string_view key) { return key.starts_with("own:"); };
+
+    Load mixed{"", stream.size(), std::make_shared<Value>(stream), accepts};
+    EXPECT_EQ(CommandDispatcher::execute(Command{std::move(mixed)}, *this->store),
+              Protocol::format_error("4 of 10 records are in slots of other nodes, nothing loaded"));
+    EXPECT_EQ(this->store->size(), 0u);
+
+    stream.clear();
+    BulkFormat::append(stream, "own:1", "v");
+    Load own{"", stream.size(), std::make_shared<Value>(stream), accepts};
+    EXPECT_EQ(CommandDispatcher::execute(Command{std::move(own)}, *this->store), Protocol::format_integer(1));
+}
@@ -1,7 +1,15 @@
 #include <gtest/gtest.h>
+#include <cstring>
 #include "kv/kv_store.hpp"
+#include "kv/bulk.hpp"
 #include <thread>
+#include <chrono>
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <filesystem>
+#include <unistd.h>
 
 using namespace kv;
 
@@ -55,6 +63,17 @@ TEST_F(KvStoreTest, HandlesLargeValues) {
     EXPECT_EQ(store.get("big"), big_data);
 }
 
+TEST_F(KvStoreTest, SetStoresPrebuiltValue) {
+    Value value = Value::with_size(64 * 1024);
+    std::memset(value.data(), 'B', value.text().size());
+    store.set("blob", std::move(value));
+
+    std::string seen;
+    EXPECT_TRUE(store.read("blob", [&seen](std::string_view text) { seen = text; }));
+    EXPECT_EQ(seen, std::string(64 * 1024, 'B'));
+    EXPECT_FALSE(store.read("missing", [](std::string_view) { FAIL(); }));
+}
+
 TEST_F(KvStoreTest, ConcurrentGetAndSet) {
     const int num_threads = 10;
     const int ops_per_thread = 100;
@@ -76,3 +95,536 @@ TEST_F(KvStoreTest, ConcurrentGetAndSet) {
 
     EXPECT_EQ(store.size(), num_threads * ops_per_thread);
 }
+
+TEST_F(KvStoreTest, CursorScanReturnsAllKeys) {
+    for (int i = 0; i < 1000; i++)
+        store.set("key" + std::to_string(i), "v");
+
+    std::vector<std::string> keys;
+    size_t cursor = 0;
+    do {
+        cursor = store.scan(cursor, 50, keys);
+    } while (cursor != 0);
+
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(std::unique(keys.begin(), keys.end()), keys.end());
+    EXPECT_EQ(keys.size(), 1000);
+}
+
+TEST_F(KvStoreTest, IncrCreatesAndUpdatesCounter) {
+    EXPECT_EQ(store.incr_by("counter", 1), 1);
+    EXPECT_EQ(store.incr_by("counter", 10), 11);
+    EXPECT_EQ(store.incr_by("counter", -20), -9);
+    EXPECT_EQ(store.get("counter"), "-9");
+}
+
+TEST_F(KvStoreTest, IncrConvertsCanonicalIntegerStrings) {
+    store.set("number", "41");
+    EXPECT_EQ(store.incr_by("number", 1), 42);
+
+    store.set("text", "abc");
+    store.set("padded", "007");
+    EXPECT_THROW(store.incr_by("text", 1), StoreError);
+    EXPECT_THROW(store.incr_by("padded", 1), StoreError);
+    EXPECT_EQ(store.get("padded"), "007");
+}
+
+TEST_F(KvStoreTest, IncrRejectsOverflow) {
+    store.set("big", std::to_string(INT64_MAX));
+    EXPECT_THROW(store.incr_by("big", 1), StoreError);
+    EXPECT_EQ(store.get("big"), std::to_string(INT64_MAX));
+
+    // Both limits can be reached, not passed
+    EXPECT_EQ(store.incr_by("small", INT64_MIN + 1), INT64_MIN + 1);
+    EXPECT_EQ(store.incr_by("small", -1), INT64_MIN);
+    EXPECT_THROW(store.incr_by("small", -1), StoreError);
+    EXPECT_THROW(store.incr_by("small", INT64_MIN), StoreError);
+    EXPECT_EQ(store.incr_by("small", INT64_MAX), -1);
+    EXPECT_EQ(store.incr_by("big", INT64_MIN), -1);
+}
+
+TEST_F(KvStoreTest, AppendToStringAndInteger) {
+    EXPECT_EQ(store.append("key", "foo"), 3);
+    EXPECT_EQ(store.append("key", "bar"), 6);
+    EXPECT_EQ(store.get("key"), "foobar");
+
+    store.incr_by("num", 12);
+    EXPECT_EQ(store.append("num", "34"), 4);
+    EXPECT_EQ(store.get("num"), "1234");
+}
+
+TEST_F(KvStoreTest, GetSetAndSetNx) {
+    EXPECT_EQ(store.getset("key", "first"), std::nullopt);
+    EXPECT_EQ(store.getset("key", "second"), "first");
+    EXPECT_FALSE(store.setnx("key", "third"));
+    EXPECT_TRUE(store.setnx("other", "value"));
+    EXPECT_EQ(store.get("key"), "second");
+    EXPECT_EQ(store.get("other"), "value");
+}
+
+TEST_F(KvStoreTest, CompareAndSetUsesVersions) {
+    EXPECT_TRUE(store.compare_and_set("key", 0, "created"));
+    EXPECT_FALSE(store.compare_and_set("key", 0, "again"));
+
+    auto current = store.get_versioned("key");
+    ASSERT_TRUE(current.has_value());
+    EXPECT_EQ(current->value, "created");
+    EXPECT_TRUE(store.compare_and_set("key", current->version, "updated"));
+    EXPECT_FALSE(store.compare_and_set("key", current->version, "stale"));
+    EXPECT_EQ(store.get("key"), "updated");
+
+    // Versions never repeat, even after the key is recreated
+    store.del("key");
+    store.set("key", "recreated");
+    EXPECT_GT(store.get_versioned("key")->version, current->version);
+}
+
+TEST_F(KvStoreTest, ConcurrentIncrIsAtomic) {
+    const int num_threads = 8;
+    const int ops_per_thread = 1000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([this]() {
+            for (int j = 0; j < ops_per_thread; j++)
+                store.incr_by("counter", 1);
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(store.get("counter"), std::to_string(num_threads * ops_per_thread));
+}
+
+// Poll until the background thread caught up, fails after ~1s
+static bool wait_for_freed(const KvStore& store, size_t expected) {
+    for (int i = 0; i < 1000 && store.lazily_freed() < expected; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return store.lazily_freed() == expected;
+}
+
+TEST(KvStoreLazyFreeTest, UnlinkFreesLargeValuesInBackground) {
+    KvStore store;
+    std::string big(1024 * 1024, 'A');
+    store.set("big", big);
+    store.set("small", "v");
+
+    EXPECT_TRUE(store.unlink("big"));
+    EXPECT_TRUE(store.unlink("small")); // too small to hand off
+    EXPECT_FALSE(store.unlink("big"));
+    EXPECT_FALSE(store.exists("big"));
+    EXPECT_TRUE(wait_for_freed(store, 1));
+}
+
+TEST(KvStoreLazyFreeTest, OverwriteAndDelUseLazyFreeMode) {
+    KvStore store{StoreOptions{.lazy_free = true}};
+    std::string big(256 * 1024, 'A');
+    store.set("key", big);
+    store.set("key", "small");
+    EXPECT_EQ(store.get("key"), "small");
+
+    store.set("key", big);
+    EXPECT_TRUE(store.del("key"));
+    EXPECT_TRUE(wait_for_freed(store, 2));
+}
+
+TEST(KvStoreLazyFreeTest, EagerModeFreesOnCaller) {
+    KvStore store;
+    store.set("key", std::string(256 * 1024, 'A'));
+    store.set("key", "small");
+    store.del("key");
+    EXPECT_EQ(store.lazily_freed(), 0);
+}
+
+TEST(KvStoreIndexTest, ScanPrefixReturnsSortedKeys) {
+    KvStore store{StoreOptions{.ordered_index = true}};
+    store.set("user:2:name", "b");
+    store.set("user:1:name", "a");
+    store.set("order:1", "x");
+    store.set("user:10:name", "c");
+
+    std::vector<std::string> keys;
+    store.scan_prefix("user:", 0, [&](const std::vector<std::string>& page) {
+        keys.insert(keys.end(), page.begin(), page.end());
+    });
+    EXPECT_EQ(keys, (std::vector<std::string>{"user:10:name", "user:1:name", "user:2:name"}));
+}
+
+TEST(KvStoreIndexTest, ScanRangeIsEndExclusiveAndLimited) {
+    KvStore store{StoreOptions{.ordered_index = true}};
+    for (char c = 'a'; c <= 'e'; ++c)
+        store.set(std::string(1, c), "v");
+    store.del("b");
+
+    std::vector<std::string> keys;
+    auto collect = [&](const std::vector<std::string>& page) {
+        keys.insert(keys.end(), page.begin(), page.end());
+    };
+    store.scan_range("a", "d", 0, collect);
+    EXPECT_EQ(keys, (std::vector<std::string>{"a", "c"}));
+
+    keys.clear();
+    store.scan_range("a", "z", 2, collect);
+    EXPECT_EQ(keys, (std::vector<std::string>{"a", "c"}));
+}
+
+TEST(KvStoreIndexTest, LargeScanIsDeliveredInPages) {
+    KvStore store{StoreOptions{.ordered_index = true}};
+    const size_t num_keys = KvStore::SCAN_PAGE_SIZE * 3 + 5;
+    for (size_t i = 0; i < num_keys; i++)
+        store.set("key:" + std::to_string(i), "v");
+
+    size_t pages = 0;
+    size_t total = 0;
+    store.scan_prefix("key:", 0, [&](const std::vector<std::string>& page) {
+        EXPECT_LE(page.size(), KvStore::SCAN_PAGE_SIZE);
+        // The store lock is not held here, writers must not block
+        store.set("other", "v");
+        pages++;
+        total += page.size();
+    });
+    EXPECT_EQ(pages, 4);
+    EXPECT_EQ(total, num_keys);
+}
+
+TEST(KvStoreLockFreeTest, ReadsSeeEveryKindOfWrite) {
+    KvStore store{StoreOptions{.lock_free_reads = true}};
+    store.set("key", "value");
+    EXPECT_EQ(store.get("key"), "value");
+    EXPECT_TRUE(store.exists("key"));
+
+    store.incr_by("counter", 41);
+    store.incr_by("counter", 1);
+    EXPECT_EQ(store.get("counter"), "42");
+    store.append("key", std::string(100, 'x'));
+    EXPECT_EQ(store.get("key"), "value" + std::string(100, 'x'));
+
+    EXPECT_EQ(store.getset("key", "swapped"), "value" + std::string(100, 'x'));
+    EXPECT_EQ(store.get("key"), "swapped");
+    EXPECT_FALSE(store.setnx("key", "ignored"));
+    EXPECT_TRUE(store.setnx("fresh", "new"));
+    EXPECT_EQ(store.get("fresh"), "new");
+    EXPECT_FALSE(store.compare_and_set("key", 0, "ignored"));
+    EXPECT_TRUE(store.compare_and_set("key", store.get_versioned("key")->version, "cas"));
+    EXPECT_EQ(store.get("key"), "cas");
+
+    EXPECT_TRUE(store.del("key"));
+    EXPECT_TRUE(store.unlink("fresh"));
+    EXPECT_FALSE(store.get("key").has_value());
+    EXPECT_FALSE(store.exists("fresh"));
+}
+
+TEST(KvStoreLockFreeTest, ReadersNeverSeeTornValues) {
+    KvStore store{StoreOptions{.lock_free_reads = true}};
+    const std::string short_value(10, 'a');
+    const std::string long_value(5000, 'b');
+    store.set("key", short_value);
+
+    std::atomic<bool> done{false};
+    std::atomic<size_t> bad_reads{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&]() {
+            while (!done.load()) {
+                auto value = store.get("key");
+                if (value != short_value && value != long_value)
+                    bad_reads++;
+            }
+        });
+    }
+
+    // Overwrite the key while other keys come and go, so the table rehashes too
+    for (int i = 0; i < 20000; i++) {
+        store.set("key", i % 2 ? long_value : short_value);
+        store.set("other" + std::to_string(i % 3000), "v");
+        if (i % 3000 == 2999) {
+            for (int j = 0; j < 3000; j++)
+                store.del("other" + std::to_string(j));
+        }
+    }
+    done = true;
+    for (auto& t : readers)
+        t.join();
+
+    EXPECT_EQ(bad_reads.load(), 0);
+}
+
+TEST(KvStoreCompressionTest, LargeValuesReadBackUnchanged) {
+    std::string html;
+    while (html.size() < 200 * 1024)
+        html += "<div class=\"row\"><span>cell</span></div>\n";
+
+    for (bool lock_free : {false, true}) {
+        KvStore store{StoreOptions{.lock_free_reads = lock_free, .compression = true}};
+        store.set("page", html);
+        store.set("small", "tiny");
+        EXPECT_EQ(store.get("page"), html);
+        EXPECT_EQ(store.get("small"), "tiny");
+        EXPECT_EQ(store.get_versioned("page")->value, html);
+
+        // Clients that ask for it get the stored bytes without a decompression
+        size_t stored_size = 0;
+        size_t uncompressed_size = 0;
+        store.read_stored("page", [&](std::string_view bytes, size_t size) {
+            stored_size = bytes.size();
+            uncompressed_size = size;
+        });
+        EXPECT_LT(stored_size, html.size() / 4);
+        EXPECT_EQ(uncompressed_size, html.size());
+
+        // Compressed values reach the reader outside the lock, a write from it doesn't deadlock
+        EXPECT_TRUE(store.read("page", [&](std::string_view text) {
+            EXPECT_EQ(text, html);
+            store.set("written_while_reading", "ok");
+        }));
+        EXPECT_EQ(store.get("written_while_reading"), "ok");
+
+        EXPECT_THROW(store.incr_by("page", 1), StoreError);
+        EXPECT_EQ(store.append("page", "!"), html.size() + 1);
+        EXPECT_EQ(store.getset("page", html), html + "!");
+        EXPECT_EQ(store.get("page"), html);
+
+        // APPEND keeps the value compressed, like a SET of the longer text would
+        EXPECT_EQ(store.append("page", "<footer/>"), html.size() + 9);
+        store.read_stored("page", [&](std::string_view bytes, size_t size) {
+            stored_size = bytes.size();
+            uncompressed_size = size;
+        });
+        EXPECT_LT(stored_size, html.size() / 4);
+        EXPECT_EQ(uncompressed_size, html.size() + 9);
+        EXPECT_EQ(store.get("page"), html + "<footer/>");
+    }
+}
+
+class KvStoreTieringTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() / ("kv_tiering_" + std::to_string(getpid()));
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    StoreOptions options(size_t memory_limit, bool lock_free = false) const {
+        // Passes run only where the test calls tier()
+        return StoreOptions{.lock_free_reads = lock_free, .cold_directory = directory.string(),
+                            .memory_limit = memory_limit, .tiering_interval = std::chrono::milliseconds{0}};
+    }
+};
+
+TEST_F(KvStoreTieringTest, ColdValuesMoveToTheLogAndBack) {
+    for (bool lock_free : {false, true}) {
+        KvStore store{options(200 * 1024, lock_free)};
+        for (int i = 0; i < 100; ++i)
+            store.set("key" + std::to_string(i), std::string(8000, 'a' + i % 26));
+        // Reads make the first ten hot
+        for (int round = 0; round < 5; ++round)
+            for (int i = 0; i < 10; ++i)
+                store.get("key" + std::to_string(i));
+
+        EXPECT_GE(store.resident_bytes(), 100 * 8000u);
+        store.tier();
+        EXPECT_GE(store.cold_values(), 70u);
+        EXPECT_GT(store.cold_log_bytes(), 70 * 8000u);
+        EXPECT_LE(store.resident_bytes(), 200 * 1024u);
+        EXPECT_EQ(store.size(), 100u);
+
+        // Everything still reads the same, the hot keys never left memory
+        size_t cold_before = store.cold_values();
+        for (int i = 0; i < 10; ++i)
+            EXPECT_EQ(store.get("key" + std::to_string(i)), std::string(8000, 'a' + i % 26));
+        EXPECT_EQ(store.cold_values(), cold_before);
+
+        // Reading a cold value promotes it
+        for (int i = 10; i < 100; ++i) {
+            EXPECT_TRUE(store.exists("key" + std::to_string(i)));
+            EXPECT_EQ(store.get("key" + std::to_string(i)), std::string(8000, 'a' + i % 26));
+        }
+        EXPECT_EQ(store.cold_values(), 0u);
+        EXPECT_GE(store.resident_bytes(), 100 * 8000u);
+    }
+}
+
+TEST_F(KvStoreTieringTest, BackgroundPassesSpillOnTheirOwn) {
+    auto background = options(64 * 1024);
+    background.tiering_interval = std::chrono::milliseconds{10};
+    KvStore store{background};
+    for (int i = 0; i < 50; ++i)
+        store.set("key" + std::to_string(i), std::string(8000, 'x'));
+    for (int i = 0; i < 200 && store.resident_bytes() > 64 * 1024; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    EXPECT_LE(store.resident_bytes(), 64 * 1024u);
+    EXPECT_GT(store.cold_values(), 0u);
+}
+
+TEST_F(KvStoreTieringTest, ResidentBytesFollowEveryWrite) {
+    KvStore store{options(1024 * 1024)};
+    std::string large(8000, 'x');
+    store.set("a", large);
+    size_t one = store.resident_bytes();
+    EXPECT_GE(one, large.size());
+    store.set("small", "tiny"); // inline, no heap
+    EXPECT_EQ(store.resident_bytes(), one);
+    EXPECT_TRUE(store.setnx("b", large));
+    EXPECT_TRUE(store.compare_and_set("b", store.get_versioned("b")->version, large));
+    EXPECT_EQ(store.getset("a", large), large);
+    EXPECT_EQ(store.resident_bytes(), 2 * one);
+    store.append("a", "!");
+    EXPECT_GT(store.resident_bytes(), 2 * one);
+    EXPECT_TRUE(store.del("a"));
+    EXPECT_EQ(store.resident_bytes(), one);
+    store.set("b", "1");
+    EXPECT_EQ(store.incr_by("b", 1), 2);
+    EXPECT_EQ(store.resident_bytes(), 0u);
+}
+
+TEST_F(KvStoreTieringTest, ResidentBytesCountLockFreeSnapshots) {
+    KvStore store{options(12 * 1024, true)};
+    std::string large(8000, 'x');
+    store.set("a", large);
+    // The value and the copy lock-free readers see
+    EXPECT_GE(store.resident_bytes(), 2 * large.size());
+    EXPECT_TRUE(store.del("a"));
+    EXPECT_EQ(store.resident_bytes(), 0u);
+
+    // One large value is over the limit with its copy, and spilling drops both
+    store.set("b", large);
+    store.tier();
+    EXPECT_EQ(store.cold_values(), 1u);
+    EXPECT_EQ(store.resident_bytes(), 0u);
+    EXPECT_EQ(store.get("b"), large);
+    EXPECT_GE(store.resident_bytes(), 2 * large.size());
+}
+
+TEST_F(KvStoreTieringTest, WritesToColdValuesSeeTheirContents) {
+    KvStore store{options(0)};
+    std::string html;
+    while (html.size() < 20000)
+        html += "<p>paragraph</p>\n";
+    for (const char* key : {"append", "getset", "versioned", "del", "incr"})
+        store.set(key, html);
+    store.tier();
+    EXPECT_EQ(store.cold_values(), 5u);
+
+    EXPECT_EQ(store.append("append", "!"), html.size() + 1);
+    EXPECT_EQ(store.get("append"), html + "!");
+    EXPECT_EQ(store.getset("getset", "new"), html);
+    auto versioned = store.get_versioned("versioned");
+    ASSERT_TRUE(versioned.has_value());
+    EXPECT_EQ(versioned->value, html);
+    EXPECT_TRUE(store.compare_and_set("versioned", versioned->version, "swapped"));
+    EXPECT_TRUE(store.del("del"));
+    EXPECT_THROW(store.incr_by("incr", 1), StoreError);
+    EXPECT_EQ(store.cold_values(), 1u); // only "incr" is left in the log
+}
+
+TEST_F(KvStoreTieringTest, HotKeysStayInMemory) {
+    for (int half_life_ms : {5000, 0}) {
+        auto tracked = options(0);
+        tracked.cold_directory = (directory / std::to_string(half_life_ms)).string();
+        tracked.hot_key_half_life = std::chrono::milliseconds{half_life_ms};
+        tracked.hot_key_sample = 1;
+        std::filesystem::create_directories(tracked.cold_directory);
+        KvStore store{tracked};
+        for (const char* key : {"hot", "a", "b", "c"})
+            store.set(key, std::string(8000, 'x'));
+        for (int i = 0; i < 20; ++i)
+            store.get("hot");
+
+        store.tier();
+        if (half_life_ms > 0) {
+            EXPECT_EQ(store.hot_keys(1).front().key, "hot");
+            EXPECT_EQ(store.cold_values(), 3u);
+        } else {
+            // Without tracking only the sketch decides, and memory_limit 0 spills everything
+            EXPECT_TRUE(store.hot_keys(10).empty());
+            EXPECT_EQ(store.cold_values(), 4u);
+        }
+    }
+}
+
+TEST_F(KvStoreTieringTest, CompactionReclaimsOverwrittenValues) {
+    KvStore store{options(0)};
+    std::string value(256 * 1024, 'v');
+    // 75MB written, more than one 64MB log segment
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 100; ++i)
+            store.set("key" + std::to_string(i), value);
+        store.tier();
+    }
+    EXPECT_EQ(store.cold_values(), 100u);
+
+    // The first segment holds mostly overwritten values, its live ones are moved and the file dropped
+    store.tier();
+    EXPECT_LT(store.cold_log_bytes(), 2 * 100 * value.size());
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(store.get("key" + std::to_string(i))->size(), value.size());
+}
+
+TEST_F(KvStoreTieringTest, ConcurrentReadersAndWritersDuringTiering) {
+    KvStore store{options(64 * 1024, true)};
+    for (int i = 0; i < 50; ++i)
+        store.set("key" + std::to_string(i), std::string(8000, 'a' + i % 26));
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_reads{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int n = 0; !done; ++n) {
+                int i = (n * 7 + t) % 50;
+                std::string key = "key" + std::to_string(i);
+                if (t == 0) {
+                    store.set(key, std::string(8000, 'a' + i % 26));
+                    continue;
+                }
+                auto value = store.get(key);
+                if (!value || *value != std::string(8000, 'a' + i % 26))
+                    ++bad_reads;
+            }
+        });
+    }
+    for (int pass = 0; pass < 50; ++pass)
+        store.tier();
+    done = true;
+    for (auto& t : threads)
+        t.join();
+
+    EXPECT_EQ(bad_reads.load(), 0);
+}
+
+TEST_F(KvStoreTieringTest, DumpReadsColdAndCompressedValuesDuringTiering) {
+    auto compressed = options(1024);
+    compressed.compression = true;
+    compressed.cold_min_size = 16;
+    KvStore store{compressed};
+    auto text = [](int i) { return std::string(4000, 'a' + i % 26) + std::string(4000, 'z' - i % 26); };
+    for (int i = 0; i < 50; ++i)
+        store.set("key" + std::to_string(i), text(i));
+    store.tier();
+    ASSERT_GT(store.cold_values(), 0u);
+
+    std::atomic<bool> done{false};
+    std::thread churn([&]() {
+        for (int n = 0; !done; ++n) {
+            store.set("key" + std::to_string(n % 50), text(n % 50));
+            store.tier();
+        }
+    });
+    int bad_records = 0;
+    for (int round = 0; round < 20; ++round) {
+        std::string stream;
+        store.dump([&stream](std::string_view chunk) { stream += chunk; });
+        std::vector<BulkRecord> records = BulkFormat::decode(stream);
+        EXPECT_EQ(records.size(), 50u);
+        for (const BulkRecord& record : records)
+            bad_records += record.value != text(std::stoi(std::string{record.key.substr(3)}));
+        EXPECT_EQ(store.get_versioned("key7")->value, text(7));
+    }
+    done = true;
+    churn.join();
+    EXPECT_EQ(bad_records, 0);
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "kv/trace.hpp"
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+using namespace kv;
+
+namespace {
+
+RequestTrace make_trace(std::string command, std::initializer_list<uint64_t> ticks) {
+    RequestTrace trace;
+    std::copy(ticks.begin(), ticks.end(), trace.ticks.begin());
+    trace.command = std::move(command);
+    return trace;
+}
+
+} // namespace
+
+
+TEST(TraceTest, MarkKeepsFirstStamp) {
+    RequestTrace trace;
+    trace.mark(TraceStage::Parsed);
+    uint64_t first = trace.ticks[static_cast<size_t>(TraceStage::Parsed)];
+    EXPECT_NE(first, 0u);
+    trace.mark(TraceStage::Parsed);
+    EXPECT_EQ(trace.ticks[static_cast<size_t>(TraceStage::Parsed)], first);
+}
+
+TEST(TraceTest, TotalSkipsMissingStages) {
+    RequestTrace trace = make_trace("GET key", {0, 100, 150, 0, 0, 400, 1000});
+    EXPECT_EQ(trace.total_ticks(), 900u);
+}
+
+TEST(TraceTest, TscAdvancesWithTime) {
+    uint64_t start = Tsc::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    double ns = Tsc::to_ns(Tsc::now() - start);
+    EXPECT_GT(ns, 4e6);
+    EXPECT_LT(ns, 1e9);
+}
+
+TEST(TraceTest, LockStampsOnlyTheActiveTrace) {
+    TracedSharedMutex mutex;
+    RequestTrace trace;
+    {
+        std::unique_lock lock(mutex); // no active trace, nothing to stamp
+    }
+    {
+        ActiveTrace active{&trace};
+        std::shared_lock lock(mutex);
+    }
+    EXPECT_NE(trace.ticks[static_cast<size_t>(TraceStage::LockAcquired)], 0u);
+
+    RequestTrace other;
+    {
+        std::unique_lock lock(mutex);
+        EXPECT_EQ(other.ticks[static_cast<size_t>(TraceStage::LockAcquired)], 0u);
+    }
+}
+
+TEST(SlowRequestLogTest, KeepsTheSlowest) {
+    SlowRequestLog log{3};
+    uint64_t ticks_per_us = static_cast<uint64_t>(1000 / Tsc::ns_per_tick());
+    for (uint64_t i = 1; i <= 10; ++i)
+        log.record(make_trace("SET k" + std::to_string(i), {1, 1 + i * 100 * ticks_per_us}));
+    EXPECT_EQ(log.size(), 3u);
+
+    auto entries = log.slowest(10);
+    ASSERT_EQ(entries.size(), 3u);
+    EXPECT_EQ(entries[0].command, "SET k10");
+    EXPECT_EQ(entries[1].command, "SET k9");
+    EXPECT_EQ(entries[2].command, "SET k8");
+    EXPECT_EQ(log.slowest(1).size(), 1u);
+
+    log.reset();
+    EXPECT_EQ(log.size(), 0u);
+    EXPECT_TRUE(log.slowest(10).empty());
+}
+
+TEST(SlowRequestLogTest, FormatsStageBreakdown) {
+    SlowRequestLog log{1};
+    log.record(make_trace("GET key", {0, 100, 150, 0, 0, 400, 1000}));
+    std::string line = SlowRequestLog::format(log.slowest(1).at(0));
+    EXPECT_NE(line.find("id=0 "), std::string::npos) << line;
+    EXPECT_NE(line.find(" read=- parse=0.0 "), std::string::npos) << line;
+    EXPECT_NE(line.find(" queue=- lock=- execute="), std::string::npos) << line;
+    EXPECT_TRUE(line.ends_with(" command=GET key")) << line;
+}
+
+TEST(SlowRequestLogTest, ZeroCapacityKeepsNothing) {
+    SlowRequestLog log{0};
+    log.record(make_trace("GET key", {1, 2}));
+    EXPECT_EQ(log.size(), 0u);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "kv/value.hpp"
+#include <string>
+#include <cstring>
+#include <random>
+
+using namespace kv;
+
+
+TEST(ValueTest, ShortStringsStayInline) {
+    std::string text(Value::INLINE_CAPACITY, 'a');
+    Value value{text};
+    EXPECT_FALSE(value.is_integer());
+    EXPECT_EQ(value.text(), text);
+    // Inline data lives inside the object itself
+    EXPECT_GE(value.text().data(), reinterpret_cast<const char*>(&value));
+    EXPECT_LT(value.text().data(), reinterpret_cast<const char*>(&value + 1));
+}
+
+TEST(ValueTest, LongStringsGoToTheHeap) {
+    std::string text(1000, 'b');
+    Value value{text};
+    EXPECT_EQ(value.text(), text);
+    value.assign("short");
+    EXPECT_EQ(value.text(), "short");
+    value.assign(std::string(200 * 1024, 'c'));
+    EXPECT_EQ(value.text().size(), 200 * 1024);
+}
+
+TEST(ValueTest, IntegersAreStoredCompactly) {
+    Value value{int64_t{-1234567890123}};
+    EXPECT_TRUE(value.is_integer());
+    EXPECT_EQ(value.integer(), -1234567890123);
+    EXPECT_EQ(value.to_string(), "-1234567890123");
+}
+
+TEST(ValueTest, AppendCrossesFromInlineToHeap) {
+    Value value{"12345"};
+    std::string expected = "12345";
+    for (int i = 0; i < 100; i++) {
+        value.append("abcdefgh");
+        expected += "abcdefgh";
+    }
+    EXPECT_EQ(value.text(), expected);
+
+    Value number{int64_t{42}};
+    number.append("!");
+    EXPECT_FALSE(number.is_integer());
+    EXPECT_EQ(number.text(), "42!");
+}
+
+TEST(ValueTest, MoveTransfersOwnership) {
+    Value source{std::string(100, 'x')};
+    Value target{std::move(source)};
+    EXPECT_EQ(target.text(), std::string(100, 'x'));
+    EXPECT_EQ(source.text(), "");
+
+    Value assigned{"tiny"};
+    assigned = std::move(target);
+    EXPECT_EQ(assigned.text(), std::string(100, 'x'));
+}
+
+TEST(ValueTest, WithSizeIsFilledInPlace) {
+    Value small = Value::with_size(5);
+    std::memcpy(small.data(), "hello", 5);
+    EXPECT_EQ(small.text(), "hello");
+
+    std::string text(100 * 1024, 'z');
+    Value large = Value::with_size(text.size());
+    std::memcpy(large.data(), text.data(), text.size());
+    EXPECT_EQ(large.text(), text);
+    EXPECT_GE(large.heap_bytes(), text.size());
+}
+
+TEST(ValueTest, CompressOnlyKeepsWorthwhileResults) {
+    std::string text;
+    while (text.size() < 64 * 1024)
+        text += "<li class=\"item\">entry</li>\n";
+    Value value = Value::compress(text);
+    EXPECT_TRUE(value.is_compressed());
+    EXPECT_EQ(value.uncompressed_size(), text.size());
+    EXPECT_LT(value.heap_bytes(), text.size() / 4);
+    EXPECT_EQ(value.to_string(), text);
+
+    // Appending decompresses first
+    value.append("tail");
+    EXPECT_FALSE(value.is_compressed());
+    EXPECT_EQ(value.text(), text + "tail");
+
+    std::mt19937 rng{7};
+    std::string noise(4096, '\0');
+    for (char& c : noise)
+        c = static_cast<char>(rng());
+    EXPECT_FALSE(Value::compress(noise).is_compressed());
+}
+
+TEST(ValueTest, ColdValuesOnlyKeepTheirLocation) {
+    Value value = Value::cold(uint64_t{7} << 40 | 1234);
+    EXPECT_TRUE(value.is_cold());
+    EXPECT_FALSE(value.is_compressed());
+    EXPECT_EQ(value.cold_location(), uint64_t{7} << 40 | 1234);
+    EXPECT_EQ(value.heap_bytes(), 0u);
+    EXPECT_THROW(value.to_string(), std::logic_error);
+
+    Value moved = std::move(value);
+    EXPECT_TRUE(moved.is_cold());
+    EXPECT_FALSE(value.is_cold());
+}
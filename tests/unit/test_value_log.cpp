@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "kv/frequency_sketch.hpp"
+#include "kv/hash_table.hpp"
+#include "kv/value_log.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace kv;
+
+class ValueLogTest : public ::testing::Test {
+protected:
+    std::filesystem::path directory;
+
+    void SetUp() override {
+        directory = std::filesystem::temp_directory_path() / ("kv_value_log_" + std::to_string(getpid()));
+        std::filesystem::create_directories(directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(directory);
+    }
+
+    size_t files() const {
+        return std::distance(std::filesystem::directory_iterator(directory), {});
+    }
+};
+
+
+TEST_F(ValueLogTest, ReadsBackAppendedRecords) {
+    ValueLog log{directory.string()};
+    uint64_t first = log.append("key1", "value one", 0);
+    uint64_t second = log.append("key2", std::string(10000, 'x'), 123456);
+
+    ValueLog::Record record = log.read(first);
+    EXPECT_EQ(record.key, "key1");
+    EXPECT_EQ(record.bytes, "value one");
+    EXPECT_EQ(record.uncompressed_size, 0u);
+
+    record = log.read(second);
+    EXPECT_EQ(record.key, "key2");
+    EXPECT_EQ(record.bytes, std::string(10000, 'x'));
+    EXPECT_EQ(record.uncompressed_size, 123456u);
+}
+
+TEST_F(ValueLogTest, TrimmedPagesStayReadable) {
+    ValueLog log{directory.string()};
+    std::vector<uint64_t> locations;
+    for (int i = 0; i < 100; ++i)
+        locations.push_back(log.append("key" + std::to_string(i), std::string(5000, 'a' + i % 26), 0));
+
+    log.trim();
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(log.read(locations[i]).bytes, std::string(5000, 'a' + i % 26));
+}
+
+TEST_F(ValueLogTest, DeadSegmentsAreCompactedAway) {
+    ValueLog log{directory.string(), 64 * 1024};
+    std::vector<uint64_t> locations;
+    for (int i = 0; i < 40; ++i)
+        locations.push_back(log.append("key" + std::to_string(i), std::string(4000, 'v'), 0));
+    // Records larger than a segment get their own
+    uint64_t large = log.append("large", std::string(100 * 1024, 'L'), 0);
+    EXPECT_EQ(log.read(large).bytes.size(), 100 * 1024u);
+    EXPECT_EQ(files(), 4u);
+    EXPECT_EQ(log.live_bytes(), log.disk_bytes());
+
+    // Nothing to do while everything is live
+    EXPECT_TRUE(log.compaction_candidates(0.5).empty());
+
+    // Kill most of the first segment, keep one record alive
+    std::vector<uint64_t> first_segment;
+    log.for_each_record(static_cast<uint32_t>(locations[0] >> 40), [&](uint64_t location, const ValueLog::Record&) {
+        first_segment.push_back(location);
+    });
+    ASSERT_GT(first_segment.size(), 2u);
+    for (size_t i = 1; i < first_segment.size(); ++i)
+        log.release(first_segment[i]);
+
+    std::vector<uint32_t> candidates = log.compaction_candidates(0.5);
+    ASSERT_EQ(candidates.size(), 1u);
+    EXPECT_FALSE(log.drop_if_empty(candidates[0])); // one record is still live
+
+    // Compaction copies the survivor to the end of the log, then the segment can go
+    ValueLog::Record survivor = log.read(first_segment[0]);
+    uint64_t moved = log.append(survivor.key, survivor.bytes, survivor.uncompressed_size);
+    log.release(first_segment[0]);
+    EXPECT_TRUE(log.drop_if_empty(candidates[0]));
+    EXPECT_EQ(log.read(moved).key, "key0");
+    EXPECT_EQ(log.live_bytes(), log.disk_bytes());
+}
+
+TEST_F(ValueLogTest, DestructorDeletesSegmentFiles) {
+    {
+        ValueLog log{directory.string()};
+        log.append("key", "value", 0);
+        EXPECT_EQ(files(), 1u);
+    }
+    EXPECT_EQ(files(), 0u);
+}
+
+namespace {
+
+uint32_t hash_of(const std::string& key) {
+    return HashTable<int>::hash_of(key);
+}
+
+} // namespace
+
+TEST(FrequencySketchTest, EstimatesSeparateHotFromCold) {
+    FrequencySketch sketch{1024};
+    for (int i = 0; i < 10; ++i)
+        sketch.record(hash_of("hot"));
+    sketch.record(hash_of("warm"));
+
+    EXPECT_EQ(sketch.estimate(hash_of("hot")), 10u);
+    EXPECT_GE(sketch.estimate(hash_of("warm")), 1u);
+    EXPECT_LT(sketch.estimate(hash_of("warm")), sketch.estimate(hash_of("hot")));
+
+    // Counts never drop below the truth, many distinct keys only add noise
+    size_t zero = 0;
+    for (int i = 0; i < 1000; ++i)
+        zero += sketch.estimate(hash_of("never" + std::to_string(i))) == 0;
+    EXPECT_GT(zero, 900u);
+}
+
+TEST(FrequencySketchTest, CountersSaturateAndDecay) {
+    FrequencySketch sketch{16};
+    for (int i = 0; i < 100; ++i)
+        sketch.record(hash_of("key"));
+    EXPECT_EQ(sketch.estimate(hash_of("key")), FrequencySketch::MAX_COUNT);
+
+    sketch.decay();
+    EXPECT_EQ(sketch.estimate(hash_of("key")), FrequencySketch::MAX_COUNT / 2u);
+    for (int i = 0; i < 4; ++i)
+        sketch.decay();
+    EXPECT_EQ(sketch.estimate(hash_of("key")), 0u);
+}
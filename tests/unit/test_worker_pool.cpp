@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "worker_pool.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace kv;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct TestTask {
+    std::function<void()> work;
+    void resume() { work(); }
+};
+
+using Pool = WorkerPool<TestTask>;
+
+// Polls until `done` holds or about two seconds passed
+bool eventually(const std::function<bool()>& done) {
+    for (int i = 0; i < 400 && !done(); ++i)
+        std::this_thread::sleep_for(5ms);
+    return done();
+}
+
+} // namespace
+
+class WorkerPoolTest : public ::testing::Test {
+protected:
+    Pool::Queue queue;
+    std::atomic<int> finished{0};
+
+    // Tasks that hold a worker for a while, like a slow command
+    void push_slow(int count, std::chrono::milliseconds each) {
+        for (int i = 0; i < count; ++i) {
+            queue.push(i, TestTask{[this, each]() {
+                std::this_thread::sleep_for(each);
+                ++finished;
+            }}, 64);
+        }
+    }
+};
+
+
+TEST_F(WorkerPoolTest, FixedPoolRunsEverything) {
+    Pool pool{queue, 3, 3};
+    EXPECT_FALSE(pool.elastic());
+    push_slow(30, 1ms);
+    ASSERT_TRUE(eventually([&]() { return finished == 30; }));
+
+    WorkerPoolStats stats = pool.stats();
+    EXPECT_EQ(stats.running, 3u);
+    EXPECT_EQ(stats.peak, 3u);
+    EXPECT_EQ(stats.grown, 0u);
+    EXPECT_EQ(stats.shrunk, 0u);
+}
+
+TEST_F(WorkerPoolTest, GrowsUnderBacklogUpToMax) {
+    WorkerScaling scaling;
+    scaling.grow_wait = 1ms;
+    scaling.grow_interval = 1ms;
+    scaling.shrink_idle = 10s;
+    Pool pool{queue, 1, 4, scaling};
+    EXPECT_TRUE(pool.elastic());
+
+    push_slow(60, 10ms);
+    ASSERT_TRUE(eventually([&]() { return finished == 60; }));
+    WorkerPoolStats stats = pool.stats();
+    EXPECT_EQ(stats.running, 4u);
+    EXPECT_EQ(stats.peak, 4u);
+    EXPECT_EQ(stats.grown, 3u);
+    EXPECT_EQ(stats.shrunk, 0u);
+}
+
+TEST_F(WorkerPoolTest, ShrinksBackToMinWhenIdle) {
+    WorkerScaling scaling;
+    scaling.grow_wait = 1ms;
+    scaling.grow_interval = 1ms;
+    scaling.shrink_idle = 50ms;
+    Pool pool{queue, 1, 3, scaling};
+
+    push_slow(30, 10ms);
+    ASSERT_TRUE(eventually([&]() { return finished == 30; }));
+    EXPECT_GT(pool.stats().peak, 1u);
+
+    // One worker per idle period, never below the minimum
+    ASSERT_TRUE(eventually([&]() { return pool.stats().running == 1; }));
+    std::this_thread::sleep_for(150ms);
+    WorkerPoolStats stats = pool.stats();
+    EXPECT_EQ(stats.running, 1u);
+    EXPECT_EQ(stats.shrunk, stats.grown);
+
+    // The worker left still takes work, and the pool can grow again
+    push_slow(30, 10ms);
+    ASSERT_TRUE(eventually([&]() { return finished == 60; }));
+    EXPECT_GT(pool.stats().grown, stats.grown);
+}
+
+TEST_F(WorkerPoolTest, QuietLoadDoesNotGrow) {
+    WorkerScaling scaling;
+    // Nothing is ever queued behind another task, only a stalled test machine could wait this long
+    scaling.grow_wait = 1s;
+    scaling.grow_interval = 1ms;
+    Pool pool{queue, 2, 8, scaling};
+    for (int i = 0; i < 20; ++i) {
+        push_slow(1, 0ms);
+        ASSERT_TRUE(eventually([&]() { return finished == i + 1; }));
+    }
+    EXPECT_EQ(pool.stats().grown, 0u);
+}
+
+TEST_F(WorkerPoolTest, StartHookSeesEveryWorker) {
+    std::atomic<size_t> started{0};
+    WorkerScaling scaling;
+    scaling.grow_wait = 1ms;
+    scaling.grow_interval = 1ms;
+    Pool pool{queue, 2, 3, scaling, [&](std::jthread& thread, size_t number) {
+        EXPECT_TRUE(thread.joinable());
+        EXPECT_EQ(number, started.load());
+        ++started;
+    }};
+    EXPECT_EQ(started, 2u);
+    push_slow(30, 5ms);
+    ASSERT_TRUE(eventually([&]() { return finished == 30; }));
+    EXPECT_EQ(started, 2 + pool.stats().grown);
+}
+
+TEST_F(WorkerPoolTest, StopLeavesQueuedTasks) {
+    {
+        Pool pool{queue, 1, 1};
+        pool.stop();
+        push_slow(3, 0ms);
+        std::this_thread::sleep_for(20ms);
+    }
+    EXPECT_EQ(finished, 0);
+    EXPECT_EQ(queue.size(), 3u);
+}